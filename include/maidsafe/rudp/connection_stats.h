@@ -0,0 +1,78 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CONNECTION_STATS_H_
+#define MAIDSAFE_RUDP_CONNECTION_STATS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "boost/asio/ip/udp.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+// A snapshot of the state of a connection to a peer, for diagnosing slow or unreliable peers.
+// Counts are totals since the connection was made.  Packet counts are of data packets only, and
+// byte counts are of their payloads.
+struct ConnectionStats {
+  ConnectionStats()
+      : peer_endpoint(),
+        round_trip_time(0),
+        round_trip_time_variance(0),
+        packets_receiving_rate(0),
+        estimated_link_capacity(0),
+        send_window_size(0),
+        receive_window_size(0),
+        send_data_size(0),
+        packets_sent(0),
+        bytes_sent(0),
+        packets_retransmitted(0),
+        bytes_retransmitted(0),
+        packets_received(0),
+        bytes_received(0),
+        negative_acks_sent(0),
+        negative_acks_received(0),
+        send_timeouts(0),
+        unacknowledged_packets(0),
+        send_queue_messages(0),
+        send_queue_bytes(0) {}
+  boost::asio::ip::udp::endpoint peer_endpoint;
+  // Smoothed round trip time and its variance, in microseconds.
+  uint32_t round_trip_time, round_trip_time_variance;
+  // Packets per second arriving from the peer, and the estimated capacity of the link in packets
+  // per second.
+  uint32_t packets_receiving_rate, estimated_link_capacity;
+  // Window sizes in packets, and the largest payload currently sent in one packet.
+  size_t send_window_size, receive_window_size, send_data_size;
+  // Sent counts include retransmissions, which are also counted separately.
+  uint64_t packets_sent, bytes_sent, packets_retransmitted, bytes_retransmitted;
+  // Received counts include duplicates.
+  uint64_t packets_received, bytes_received;
+  uint64_t negative_acks_sent, negative_acks_received;
+  // Occasions on which packets were deemed lost for want of any acknowledgement.
+  uint64_t send_timeouts;
+  // Packets sent but not yet acknowledged.
+  size_t unacknowledged_packets;
+  // Messages passed to Send of which some data is yet to be sent, and the amount of that data.
+  size_t send_queue_messages, send_queue_bytes;
+};
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CONNECTION_STATS_H_
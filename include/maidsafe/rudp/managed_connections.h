@@ -30,6 +30,7 @@ License.
 #include "boost/asio/ip/udp.hpp"
 #include "boost/asio/deadline_timer.hpp"
 #include "boost/date_time/posix_time/ptime.hpp"
+#include "boost/filesystem/path.hpp"
 #include "boost/signals2/connection.hpp"
 
 #include "maidsafe/common/asio_service.h"
@@ -37,14 +38,19 @@ License.
 #include "maidsafe/common/rsa.h"
 #include "maidsafe/common/utils.h"
 
+#include "maidsafe/rudp/connection_stats.h"
 #include "maidsafe/rudp/nat_type.h"
+#include "maidsafe/rudp/send_options.h"
 
 
 namespace maidsafe {
 
 namespace rudp {
 
-namespace detail { class Transport; }
+namespace detail {
+class BootstrapCache;
+class Transport;
+}  // namespace detail
 
 typedef std::function<void(const std::string& /*message*/)> MessageReceivedFunctor;
 typedef std::function<void(const NodeId& /*peer_id*/)> ConnectionLostFunctor;
@@ -55,6 +61,19 @@ struct EndpointPair {
   boost::asio::ip::udp::endpoint local, external;
 };
 
+typedef std::function<void(int /*result*/,
+                           const NodeId& /*chosen_bootstrap_peer*/,
+                           NatType /*nat_type*/)> BootstrapFunctor;
+typedef std::function<void(int /*result*/,
+                           const EndpointPair& /*this_endpoint_pair*/,
+                           NatType /*this_nat_type*/)> GetAvailableEndpointFunctor;
+typedef std::function<void(int /*result*/)> AddFunctor;
+
+typedef std::vector<std::pair<NodeId, EndpointPair>> PeerEndpointPairs;
+typedef std::function<void(const std::map<NodeId, std::pair<int, EndpointPair>>& /*results*/,
+                           NatType /*this_nat_type*/)> GetAvailableEndpointsFunctor;
+typedef std::function<void(const std::map<NodeId, int>& /*results*/)> AddPeersFunctor;
+
 // Defined as 203.0.113.14:1314 which falls in the 203.0.113.0/24 (TEST-NET-3) range as described in
 // RFC 5737 (http://tools.ietf.org/html/rfc5737).
 extern const boost::asio::ip::udp::endpoint kNonRoutable;
@@ -68,6 +87,11 @@ class ManagedConnections {
   static int32_t kMaxMessageSize() { return 2097152; }
   static unsigned short kResiliencePort() { return kLivePort; }  // NOLINT (Fraser)
 
+  // Keeps a record in the file at cache_path of peers this node connects to, and of how quickly,
+  // persisting between runs.  Subsequent calls to Bootstrap try the recorded peers along with those
+  // passed in, fastest first.  Must be called before Bootstrap.
+  void SetBootstrapCache(const boost::filesystem::path& cache_path);
+
   // Creates a new transport object and bootstraps it to one of the provided bootstrap_endpoints.
   // It first tries bootstrapping to "own_local_address:kLivePort".  Bootstrapping involves
   // connecting to the peer, then connecting again to another endpoint (provided by the same
@@ -88,6 +112,18 @@ class ManagedConnections {
                 NatType& nat_type,
                 boost::asio::ip::udp::endpoint local_endpoint = boost::asio::ip::udp::endpoint());
 
+  // As above, but doesn't block.  bootstrap_functor is invoked with the result, the chosen
+  // bootstrap peer and the NAT type on a thread of the asio service, or before Bootstrap returns if
+  // the parameters are invalid.
+  void Bootstrap(const std::vector<boost::asio::ip::udp::endpoint>& bootstrap_endpoints,
+                 MessageReceivedFunctor message_received_functor,
+                 ConnectionLostFunctor connection_lost_functor,
+                 NodeId this_node_id,
+                 std::shared_ptr<asymm::PrivateKey> private_key,
+                 std::shared_ptr<asymm::PublicKey> public_key,
+                 BootstrapFunctor bootstrap_functor,
+                 boost::asio::ip::udp::endpoint local_endpoint = boost::asio::ip::udp::endpoint());
+
   // Returns a transport's EndpointPair and NatType.  Returns kNotBootstrapped if there are no
   // running Managed Connections.  In this case, Bootstrap must be called to start new Managed
   // Connections.  Returns kFull if all Managed Connections already have the maximum number of
@@ -103,11 +139,42 @@ class ManagedConnections {
                            EndpointPair& this_endpoint_pair,
                            NatType& this_nat_type);
 
+  // As above, but doesn't block.  If no transport has to be started, get_available_functor is
+  // invoked with the result before GetAvailableEndpoint returns, otherwise on a thread of the asio
+  // service once the transport is running.
+  void GetAvailableEndpoint(NodeId peer_id,
+                            EndpointPair peer_endpoint_pair,
+                            GetAvailableEndpointFunctor get_available_functor);
+
+  // As above, but for a batch of peers, each paired with its EndpointPair as passed to the single
+  // version.  Peers are spread over the running transports in one pass, least-loaded first; only
+  // those which can't be placed on a running transport wait for a new one to be started.
+  // get_available_functor is invoked once with the result and this node's EndpointPair for every
+  // distinct peer, either before GetAvailableEndpoints returns or on a thread of the asio service.
+  void GetAvailableEndpoints(const PeerEndpointPairs& peers,
+                             GetAvailableEndpointsFunctor get_available_functor);
+
   // Makes a new connection and sends the validation data (which cannot be empty) to the peer which
   // runs its message_received_functor_ with the data.  All messages sent via this connection are
   // encrypted for the peer.
   int Add(NodeId peer_id, EndpointPair peer_endpoint_pair, std::string validation_data);
 
+  // As above, but add_functor is also told whether the connection is made.  It's invoked with
+  // kSuccess once the connection has been made, or with kConnectError if the attempt fails or times
+  // out.  If the attempt can't be started, or the connection already exists, it's invoked with the
+  // result before Add returns.
+  void Add(NodeId peer_id,
+           EndpointPair peer_endpoint_pair,
+           std::string validation_data,
+           AddFunctor add_functor);
+
+  // As above, but starts connecting to all of the peers at once, each paired with the EndpointPair
+  // returned by its own call to GetAvailableEndpoint(s).  add_functor is invoked once every attempt
+  // has finished, with the result for each distinct peer.
+  void Add(const PeerEndpointPairs& peers,
+           std::string validation_data,
+           AddPeersFunctor add_functor);
+
   // Marks the connection to peer_endpoint as valid.  If it exists and is already permanent, or
   // is successfully upgraded to permanent, then the function is successful.  If the peer is direct-
   // connected, its endpoint is returned.
@@ -123,6 +190,22 @@ class ManagedConnections {
   // kInvalidConnection is used.
   void Send(NodeId peer_id, std::string message, MessageSentFunctor message_sent_functor);
 
+  // As above, but with options controlling delivery of this message.  If options.time_to_live
+  // passes before the peer acknowledges the message, it is abandoned and kMessageTimedOut is used.
+  void Send(NodeId peer_id,
+            std::string message,
+            MessageSentFunctor message_sent_functor,
+            SendOptions options);
+
+  // Sends the message to the peer as a single unreliable datagram, which is never retransmitted and
+  // is delivered at most once.  It isn't queued behind messages passed to Send, so is suited to
+  // small, latency-sensitive messages which are superseded by later ones.  The encrypted message
+  // must fit in one packet, otherwise kMessageTooLarge is used.  If the connection is congested,
+  // the datagram is discarded and kDatagramDropped is used.  Otherwise, message_sent_functor is
+  // executed with kSuccess as soon as the datagram has been sent, since it is not acknowledged.  If
+  // there is no existing connection to peer_id, kInvalidConnection is used.
+  void SendDatagram(NodeId peer_id, std::string message, MessageSentFunctor message_sent_functor);
+
   // Try to ping remote_endpoint.  If this node is already connected, ping_functor is invoked with
   // kWontPingAlreadyConnected.  Otherwise, kPingFailed or kSuccess is passed to ping_functor.
 //  void Ping(boost::asio::ip::udp::endpoint peer_endpoint, PingFunctor ping_functor);
@@ -131,6 +214,13 @@ class ManagedConnections {
 
   unsigned GetActiveConnectionCount() const;
 
+  // Fills in stats with the current state of the connection to the peer.  Returns kSuccess, or
+  // kInvalidConnection if there is no existing connection to peer_id.
+  int GetConnectionStats(NodeId peer_id, ConnectionStats& stats);
+
+  // Returns the current state of every connection, keyed by peer ID.
+  std::map<NodeId, ConnectionStats> GetConnectionStats();
+
  private:
   typedef std::shared_ptr<detail::Transport> TransportPtr;
   typedef std::map<NodeId, TransportPtr> ConnectionMap;
@@ -142,21 +232,21 @@ class ManagedConnections {
     TransportPtr pending_transport;
     boost::asio::deadline_timer timer;
     bool connecting;
+    // Invoked once the connection is made or the attempt fails, if set by Add.
+    AddFunctor add_functor;
   };
+  typedef std::map<NodeId, std::unique_ptr<PendingConnection>> PendingMap;
 
   ManagedConnections(const ManagedConnections&);
   ManagedConnections& operator=(const ManagedConnections&);
 
   void ClearConnectionsAndIdleTransports();
   int TryToDetermineLocalEndpoint(boost::asio::ip::udp::endpoint& local_endpoint);
-  int AttemptStartNewTransport(
-      const std::vector<boost::asio::ip::udp::endpoint>& bootstrap_endpoints,
-      const boost::asio::ip::udp::endpoint& local_endpoint,
-      NodeId& chosen_bootstrap_peer,
-      NatType& nat_type);
-  bool StartNewTransport(
+  // Invokes on_started with whether the transport started.  mutex_ mustn't be locked.
+  void StartNewTransport(
       std::vector<std::pair<NodeId, boost::asio::ip::udp::endpoint> > bootstrap_peers,
-      boost::asio::ip::udp::endpoint local_endpoint);
+      boost::asio::ip::udp::endpoint local_endpoint,
+      std::function<void(bool)> on_started);
 
   void GetBootstrapEndpoints(
       std::vector<std::pair<NodeId, boost::asio::ip::udp::endpoint> >& bootstrap_peers,
@@ -167,16 +257,37 @@ class ManagedConnections {
                           EndpointPair& this_endpoint_pair,
                           int& return_code);
   bool SelectIdleTransport(const NodeId& peer_id, EndpointPair& this_endpoint_pair);
+  // The stages of GetAvailableEndpoint after no idle transport was found, before and after a new
+  // transport is started if necessary.
+  void GetAvailableEndpointFromNewTransport(const NodeId& peer_id,
+                                            const EndpointPair& peer_endpoint_pair,
+                                            const GetAvailableEndpointFunctor& functor);
+  void GetAvailableEndpointFromAnyTransport(const NodeId& peer_id,
+                                            const GetAvailableEndpointFunctor& functor);
   bool SelectAnyTransport(const NodeId& peer_id, EndpointPair& this_endpoint_pair);
   TransportPtr GetAvailableTransport() const;
   bool ShouldStartNewTransport(const EndpointPair& peer_endpoint_pair) const;
+  // mutex_ must be locked by the caller.
+  size_t SpareTransportCount() const;
+  // Starts topping up the idle transports to Parameters::spare_transports in the background, unless
+  // that's already running.  mutex_ must be locked by the caller.
+  void StartReplenishingSpareTransports();
+  void StartSpareTransport();
+  // Returns kPendingResult if the caller is to wait for the connection to be made.  mutex_ must be
+  // locked by the caller.
+  int DoAdd(const NodeId& peer_id,
+            const EndpointPair& peer_endpoint_pair,
+            const std::string& validation_data,
+            const AddFunctor& add_functor);
+  // mutex_ must be locked by the caller.
+  void HandleSendToUnconnectedPeer(const NodeId& peer_id,
+                                   const MessageSentFunctor& message_sent_functor);
 
   void AddPending(std::unique_ptr<PendingConnection> connection);
-  void RemovePending(const NodeId& peer_id);
-  std::vector<std::unique_ptr<PendingConnection> >::const_iterator FindPendingTransportWithNodeId(  // NOLINT (Fraser)
-      const NodeId& peer_id) const;
-  std::vector<std::unique_ptr<PendingConnection> >::iterator FindPendingTransportWithNodeId(  // NOLINT (Fraser)
-      const NodeId& peer_id);
+  // Invokes the connection's add_functor (if any) with "result".
+  void RemovePending(const NodeId& peer_id, int result);
+  PendingMap::const_iterator FindPendingTransportWithNodeId(const NodeId& peer_id) const;
+  PendingMap::iterator FindPendingTransportWithNodeId(const NodeId& peer_id);
 
   void OnMessageSlot(const std::string& message);
   void OnConnectionAddedSlot(const NodeId& peer_id,
@@ -204,11 +315,17 @@ class ManagedConnections {
   std::shared_ptr<asymm::PrivateKey> private_key_;
   std::shared_ptr<asymm::PublicKey> public_key_;
   ConnectionMap connections_;
-  std::vector<std::unique_ptr<PendingConnection>> pendings_;
+  PendingMap pendings_;
   std::set<TransportPtr> idle_transports_;
+  // Transports which haven't finished bootstrapping.
+  std::set<TransportPtr> starting_transports_;
   mutable std::mutex mutex_;
   boost::asio::ip::address local_ip_;
   NatType nat_type_;
+  std::shared_ptr<detail::BootstrapCache> bootstrap_cache_;
+  bool starting_spare_transport_;
+  // Continuations of GetAvailableEndpoint waiting for the spare transport being started.
+  std::vector<std::function<void()>> spare_transport_waiters_;
 };
 
 }  // namespace rudp
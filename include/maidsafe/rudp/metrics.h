@@ -0,0 +1,94 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_METRICS_H_
+#define MAIDSAFE_RUDP_METRICS_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "boost/date_time/posix_time/posix_time_duration.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+// The distribution of a set of recorded values.  Values are grouped into buckets whose width is
+// at most 1/8 of their lower bound, so percentiles are accurate to within 12.5%.
+struct HistogramSnapshot {
+  HistogramSnapshot() : count(0), sum(0), min(0), max(0), buckets() {}
+  // Returns the smallest value such that "percentile" percent of the values recorded are no larger,
+  // to within the precision of the buckets.  Returns 0 if no values have been recorded.
+  uint64_t Percentile(double percentile) const;
+  double Mean() const { return count == 0 ? 0.0 : static_cast<double>(sum) / count; }
+
+  uint64_t count, sum, min, max;
+  // The inclusive upper bound and count of each non-empty bucket, in increasing order.
+  std::vector<std::pair<uint64_t, uint64_t>> buckets;
+};
+
+// The library's process-wide metrics.  Counters are totals since the process started.  Those of
+// each open multiplexer (i.e. each UDP socket) are also given individually, prefixed by
+// "multiplexer.<local endpoint>.".  Histogram values are in microseconds.
+//
+// Counters: packets_in, bytes_in, packets_out, bytes_out, dispatch_iterations (waits for incoming
+// packets), decode_failures (packets ignored because they couldn't be parsed).
+//
+// Histograms: handshake_duration, message_latency (from Send until the peer acknowledges the whole
+// message), encryption_time, decryption_time, callback_delay (from receipt of a message until the
+// message_received_functor is invoked).
+struct MetricsSnapshot {
+  MetricsSnapshot() : counters(), histograms() {}
+  std::map<std::string, uint64_t> counters;
+  std::map<std::string, HistogramSnapshot> histograms;
+};
+
+MetricsSnapshot GetMetrics();
+
+typedef std::function<void(const MetricsSnapshot& /*metrics*/)> MetricsFunctor;
+
+// Invokes a functor with the latest metrics at regular intervals, on a thread of its own, until
+// destroyed.
+class MetricsReporter {
+ public:
+  MetricsReporter(MetricsFunctor metrics_functor, boost::posix_time::time_duration interval);
+  ~MetricsReporter();
+
+ private:
+  MetricsReporter(const MetricsReporter&);
+  MetricsReporter& operator=(const MetricsReporter&);
+
+  void Run();
+
+  MetricsFunctor metrics_functor_;
+  boost::posix_time::time_duration interval_;
+  std::mutex mutex_;
+  std::condition_variable cond_var_;
+  bool stopped_;
+  std::thread thread_;
+};
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_METRICS_H_
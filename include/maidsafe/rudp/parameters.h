@@ -35,6 +35,10 @@ struct Parameters {
   // Maximum number of Transports per ManagedConnections object
   static int max_transports;
 
+  // Number of idle Transports each ManagedConnections object keeps bootstrapped in the background,
+  // so that GetAvailableEndpoint can normally hand one out without starting it.
+  static uint32_t spare_transports;
+
   // Window size permitted in RUDP.
   static uint32_t default_window_size;
   static uint32_t maximum_window_size;
@@ -48,6 +52,12 @@ struct Parameters {
   static uint32_t max_data_size;
   static uint32_t default_data_size;
 
+  // Number of messages on a stream other than the default one which may be sent ahead of the
+  // oldest one the peer has yet to pass up.  The peer grants more as it passes messages up, so a
+  // stalled stream can neither make the peer buffer without limit nor fill the connection's send
+  // window at the expense of other streams.
+  static uint32_t stream_window_size;
+
   // Timeout defined for a packet to be resent.
   static Timeout default_send_timeout;
 
@@ -76,9 +86,20 @@ struct Parameters {
   // Timeout during normal peer-to-peer connection establishment.
   static Timeout rendezvous_connect_timeout;
 
+  // When connecting to a peer, all of its endpoints are tried at once.  An attempt which succeeds
+  // while one to a more preferred endpoint is still in progress waits this long for that to finish.
+  static Timeout connect_race_delay;
+
   // Timeout during connection establishment while bootstrapping a new transport.
   static Timeout bootstrap_connect_timeout;
 
+  // Maximum number of bootstrap peers a new transport tries to connect to at once.
+  static uint32_t bootstrap_connect_concurrency;
+
+  // Maximum number of peers remembered in a bootstrap cache (see ManagedConnections::
+  // SetBootstrapCache).
+  static uint32_t bootstrap_cache_size;
+
   // Timeout during ping attempt.
   static Timeout ping_timeout;
 
@@ -94,9 +115,44 @@ struct Parameters {
   // Maximum length of time for Bootstrapping connection to exist.
   static Timeout bootstrap_connection_lifespan;
 
+  // Interval at which the secret used for the cookies answering unsolicited connection requests is
+  // replaced.  A cookie remains valid for between one and two of these intervals.
+  static Timeout syn_cookie_lifetime;
+
+  // Whether connection requests from nodes predating SYN cookies are accepted without one.  Such
+  // requests each cost a connection, as before, so this can be disabled once all peers have been
+  // upgraded to regain full protection against floods of forged requests.
+  static bool accept_legacy_connection_requests;
+
+  // How long after a session with a peer was last established or closed it can be resumed in a
+  // single round trip, reusing the peer's key and the estimates of the path.
+  static Timeout session_ticket_lifetime;
+
   // Timeout defined for allowing flushing pending data after Connection::Close is called.
   static Timeout disconnection_timeout;
 
+  // Number of unacknowledged path MTU probes of a given size before that size is deemed too large.
+  static uint32_t mtu_probe_max_attempts;
+
+  // Timeout defined to receive a path MTU probe response.
+  static Timeout mtu_probe_timeout;
+
+  // Interval after completing a path MTU search before probing for a larger size again.
+  static Timeout mtu_raise_interval;
+
+  // Consecutive send timeouts of packets larger than default_data_size, with no acknowledged
+  // progress, before the path is deemed to be black-holing them.
+  static uint32_t mtu_black_hole_timeouts;
+
+  // Whether forward error correction repair packets may be sent, allowing the receiver to rebuild
+  // an occasional lost data packet without waiting for its retransmission.  They are only sent
+  // once losses are observed, and at a rate which adapts to them.
+  static bool forward_error_correction;
+
+  // Maximum number of peers' public keys kept decoded and validated, so that their handshakes
+  // needn't be decoded again.
+  static uint32_t public_key_cache_size;
+
   // Defined connection types.
   enum ConnectionType {
     kWireless = 0x0fffffff,
@@ -56,6 +56,8 @@ enum ReturnCode {
   kFailedToGetLocalAddress = -350030,
   kConnectionClosed = -350031,
   kFailedToEncryptMessage = -350032,
+  kDatagramDropped = -350033,
+  kMessageTimedOut = -350034,
 
   // Upper limit of values for this enum.
   kReturnCodeLimit = -359999
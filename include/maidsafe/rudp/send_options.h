@@ -0,0 +1,72 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_SEND_OPTIONS_H_
+#define MAIDSAFE_RUDP_SEND_OPTIONS_H_
+
+#include <cstdint>
+
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+// Relative urgency of a message.  While messages of different priorities are waiting to be sent on
+// a connection, packets of the higher priority messages are always sent first.
+enum class SendPriority : uint8_t { kLow, kNormal, kHigh };
+
+// Options controlling how an individual message is sent.
+struct SendOptions {
+  SendOptions()
+      : in_order(true),
+        stream_id(0),
+        priority(SendPriority::kNormal),
+        weight(1),
+        time_to_live(boost::posix_time::pos_infin) {}
+  // If false, the message is passed to the peer's MessageReceivedFunctor as soon as all of it has
+  // arrived, even if messages sent before it are still incomplete (e.g. awaiting retransmission of
+  // a lost packet).  Messages too large to fit in the default receive window are always delivered
+  // in order.
+  bool in_order;
+  // Logical stream within the connection to the peer.  Messages on the same stream are delivered
+  // in the order they were sent (if in_order is true), but independently of messages on any other
+  // stream, so a stalled bulk transfer on one stream doesn't hold up messages on another.  All
+  // streams share the connection's handshake, keepalives and congestion control, but each stream
+  // other than 0 has its own flow control window (see Parameters::stream_window_size).  Stream 0 is
+  // the connection's default stream.
+  uint16_t stream_id;
+  // Packets of messages waiting to be sent are interleaved, so an urgent message can overtake a
+  // large one queued before it.  Only messages which needn't be delivered after that one (i.e.
+  // unordered messages, or messages on another stream) can overtake it.
+  SendPriority priority;
+  // Share of the connection given to this message relative to other waiting messages of the same
+  // priority.  A message with weight 2 is sent twice as fast as one with weight 1.  0 is treated
+  // as 1.
+  uint32_t weight;
+  // If the message hasn't been fully acknowledged by the peer within this time, it is abandoned:
+  // it is no longer retransmitted, the peer is told to skip it, and the MessageSentFunctor is
+  // invoked with kMessageTimedOut.  Later messages on the same stream are then delivered without
+  // it.  Only honoured for messages sent unordered or on a stream other than 0, and which fit in
+  // the default receive window; other messages form part of a byte stream which can't have gaps.
+  // Time spent waiting for the stream's flow control window counts towards it.
+  boost::posix_time::time_duration time_to_live;
+};
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_SEND_OPTIONS_H_
@@ -0,0 +1,40 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_TRACE_H_
+#define MAIDSAFE_RUDP_TRACE_H_
+
+#include <ostream>
+
+namespace maidsafe {
+
+namespace rudp {
+
+// Packet-level event tracing, for diagnosing poor throughput without the cost of verbose logging.
+// Each thread records packet sends and receipts, acknowledgements, negative acknowledgements, send
+// timeouts, window size changes and ticks into its own fixed-size ring, so only the most recent
+// events are kept.  Tracing is off by default.
+void StartTracing();
+void StopTracing();
+
+// Writes the events currently held in binary form.  The rudp_trace_dump tool converts this to a
+// timeline which can be loaded into chrome://tracing or Perfetto.
+void WriteTrace(std::ostream& binary_stream);
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_TRACE_H_
@@ -0,0 +1,288 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/bootstrap_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/rudp/parameters.h"
+
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+const char kMagic[8] = { 'R', 'U', 'D', 'P', 'B', 'O', 'O', 'T' };
+const uint32_t kVersion(1);
+
+void EncodeUint16(uint16_t n, unsigned char* p) {
+  p[0] = static_cast<unsigned char>(n >> 8);
+  p[1] = static_cast<unsigned char>(n);
+}
+
+void EncodeUint32(uint32_t n, unsigned char* p) {
+  p[0] = static_cast<unsigned char>(n >> 24);
+  p[1] = static_cast<unsigned char>(n >> 16);
+  p[2] = static_cast<unsigned char>(n >> 8);
+  p[3] = static_cast<unsigned char>(n);
+}
+
+uint16_t DecodeUint16(const unsigned char* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+uint32_t DecodeUint32(const unsigned char* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+uint32_t SecondsSinceEpoch() {
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+uint16_t Increment(uint16_t count) {
+  return count == 0xffff ? count : static_cast<uint16_t>(count + 1);
+}
+
+}  // unnamed namespace
+
+const size_t BootstrapCache::kHeaderSize;
+const size_t BootstrapCache::kRecordSize;
+
+BootstrapCache::BootstrapCache(const boost::filesystem::path& path)
+    : mutex_(),
+      file_(),
+      records_() {
+  file_.open(path.string().c_str(), std::ios::in | std::ios::out | std::ios::binary);
+  if (!file_.is_open()) {
+    // The file doesn't exist yet.
+    file_.clear();
+    file_.open(path.string().c_str(),
+               std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+  }
+  if (!file_.is_open()) {
+    LOG(kWarning) << "Failed to open bootstrap cache " << path;
+    return;
+  }
+  if (Load())
+    return;
+
+  // The file was written by an incompatible version (or isn't a cache at all), so is replaced.
+  LOG(kWarning) << "Replacing unrecognised bootstrap cache file " << path;
+  file_.close();
+  file_.clear();
+  file_.open(path.string().c_str(),
+             std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file_.is_open()) {
+    LOG(kWarning) << "Failed to replace bootstrap cache " << path;
+    return;
+  }
+  WriteHeader();
+}
+
+bool BootstrapCache::Load() {
+  unsigned char header[kHeaderSize];
+  if (!file_.read(reinterpret_cast<char*>(header), kHeaderSize)) {
+    // An empty file is given a header.
+    file_.clear();
+    WriteHeader();
+    return true;
+  }
+  if (std::memcmp(header, kMagic, sizeof(kMagic)) != 0 || DecodeUint32(header + 8) != kVersion)
+    return false;
+
+  uint32_t count(std::min(DecodeUint32(header + 12), Parameters::bootstrap_cache_size));
+  unsigned char record[kRecordSize];
+  while (records_.size() != count &&
+         file_.read(reinterpret_cast<char*>(record), kRecordSize)) {
+    ip::address_v6::bytes_type bytes;
+    std::copy(record, record + bytes.size(), bytes.begin());
+    ip::address_v6 address(bytes);
+    Record loaded;
+    loaded.endpoint = Endpoint(address.is_v4_mapped() ? ip::address(address.to_v4()) :
+                                                         ip::address(address),
+                               DecodeUint16(record + 16));
+    loaded.round_trip_time = DecodeUint32(record + 20);
+    loaded.successes = DecodeUint16(record + 24);
+    loaded.failures = DecodeUint16(record + 26);
+    loaded.last_seen = DecodeUint32(record + 28);
+    records_.push_back(loaded);
+  }
+  file_.clear();
+  return true;
+}
+
+void BootstrapCache::WriteHeader() {
+  unsigned char header[kHeaderSize];
+  std::memcpy(header, kMagic, sizeof(kMagic));
+  EncodeUint32(kVersion, header + 8);
+  EncodeUint32(0, header + 12);
+  file_.seekp(0);
+  file_.write(reinterpret_cast<const char*>(header), kHeaderSize);
+  file_.flush();
+}
+
+std::vector<BootstrapCache::Endpoint> BootstrapCache::Rank(
+    const std::vector<Endpoint>& bootstrap_endpoints) const {
+  std::vector<std::pair<double, Endpoint>> candidates;
+  auto add_candidate([&](const Endpoint& endpoint, double expected_connect_time) {
+    if (std::none_of(candidates.begin(), candidates.end(),
+                     [&](const std::pair<double, Endpoint>& candidate) {
+                       return candidate.second == endpoint;
+                     })) {
+      candidates.push_back(std::make_pair(expected_connect_time, endpoint));
+    }
+  });
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& endpoint : bootstrap_endpoints) {
+      auto itr(std::find_if(records_.begin(), records_.end(),
+                            [&](const Record& record) { return record.endpoint == endpoint; }));
+      add_candidate(endpoint, itr == records_.end() ? ExpectedConnectTime(0, 0, 0) :
+                    ExpectedConnectTime(itr->round_trip_time, itr->successes, itr->failures));
+    }
+    for (const auto& record : records_) {
+      add_candidate(record.endpoint,
+                    ExpectedConnectTime(record.round_trip_time, record.successes, record.failures));
+    }
+  }
+
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const std::pair<double, Endpoint>& lhs,
+                      const std::pair<double, Endpoint>& rhs) {
+                     return lhs.first < rhs.first;
+                   });
+  std::vector<Endpoint> ranked;
+  for (const auto& candidate : candidates)
+    ranked.push_back(candidate.second);
+  return ranked;
+}
+
+void BootstrapCache::RecordSuccess(const Endpoint& endpoint, uint32_t round_trip_time) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t index(FindOrAdd(endpoint));
+  Record& record(records_[index]);
+  record.successes = Increment(record.successes);
+  record.last_seen = SecondsSinceEpoch();
+  if (round_trip_time != 0) {
+    record.round_trip_time = record.round_trip_time == 0 ? round_trip_time :
+        static_cast<uint32_t>((7ULL * record.round_trip_time + round_trip_time) / 8);
+  }
+  Write(index);
+}
+
+void BootstrapCache::RecordFailure(const Endpoint& endpoint) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t index(FindOrAdd(endpoint));
+  records_[index].failures = Increment(records_[index].failures);
+  Write(index);
+}
+
+void BootstrapCache::RecordRoundTripTime(const Endpoint& endpoint, uint32_t round_trip_time) {
+  if (round_trip_time == 0)
+    return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(std::find_if(records_.begin(), records_.end(),
+                        [&](const Record& record) { return record.endpoint == endpoint; }));
+  if (itr == records_.end())
+    return;
+  itr->round_trip_time = itr->round_trip_time == 0 ? round_trip_time :
+      static_cast<uint32_t>((7ULL * itr->round_trip_time + round_trip_time) / 8);
+  itr->last_seen = SecondsSinceEpoch();
+  Write(itr - records_.begin());
+}
+
+size_t BootstrapCache::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return records_.size();
+}
+
+double BootstrapCache::ExpectedConnectTime(uint32_t round_trip_time, uint32_t successes,
+                                           uint32_t failures) {
+  // Each attempt is assumed to succeed with the (smoothed) observed probability, which is 1/2 for a
+  // peer never tried.  The expected number of failed attempts before one succeeds is then
+  // (1 - p) / p.
+  double success_probability((successes + 1.0) / (successes + failures + 2.0));
+  return round_trip_time / 1000.0 + (1.0 - success_probability) / success_probability *
+         Parameters::bootstrap_connect_timeout.total_milliseconds();
+}
+
+size_t BootstrapCache::FindOrAdd(const Endpoint& endpoint) {
+  auto itr(std::find_if(records_.begin(), records_.end(),
+                        [&](const Record& record) { return record.endpoint == endpoint; }));
+  if (itr != records_.end())
+    return itr - records_.begin();
+
+  Record added;
+  added.endpoint = endpoint;
+  if (records_.size() < Parameters::bootstrap_cache_size) {
+    records_.push_back(added);
+    return records_.size() - 1;
+  }
+  itr = std::min_element(records_.begin(), records_.end(),
+                         [](const Record& lhs, const Record& rhs) {
+                           return lhs.last_seen < rhs.last_seen;
+                         });
+  *itr = added;
+  return itr - records_.begin();
+}
+
+void BootstrapCache::Write(size_t index) {
+  if (!file_.is_open())
+    return;
+  const Record& record(records_[index]);
+  unsigned char encoded[kRecordSize] = {};
+  ip::address_v6 address(record.endpoint.address().is_v4() ?
+                         ip::address_v6::v4_mapped(record.endpoint.address().to_v4()) :
+                         record.endpoint.address().to_v6());
+  ip::address_v6::bytes_type bytes(address.to_bytes());
+  std::copy(bytes.begin(), bytes.end(), encoded);
+  EncodeUint16(record.endpoint.port(), encoded + 16);
+  EncodeUint32(record.round_trip_time, encoded + 20);
+  EncodeUint16(record.successes, encoded + 24);
+  EncodeUint16(record.failures, encoded + 26);
+  EncodeUint32(record.last_seen, encoded + 28);
+  file_.seekp(kHeaderSize + index * kRecordSize);
+  file_.write(reinterpret_cast<const char*>(encoded), kRecordSize);
+
+  unsigned char count[4];
+  EncodeUint32(static_cast<uint32_t>(records_.size()), count);
+  file_.seekp(12);
+  file_.write(reinterpret_cast<const char*>(count), sizeof(count));
+  file_.flush();
+  if (!file_) {
+    LOG(kWarning) << "Failed to write bootstrap cache - no longer persisting it.";
+    file_.close();
+  }
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,106 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_BOOTSTRAP_CACHE_H_
+#define MAIDSAFE_RUDP_BOOTSTRAP_CACHE_H_
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include "boost/asio/ip/udp.hpp"
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// A record, kept on disk, of peers which were recently reachable, used to choose which peers to
+// bootstrap from first.  The file is a 16 byte header followed by fixed-size 32 byte records, all
+// in network byte order, so it can be read (or memory-mapped) without parsing.  Each change is
+// written back to just the record affected.  At most Parameters::bootstrap_cache_size peers are
+// kept, the one seen least recently being replaced once full.  Thread-safe.
+class BootstrapCache {
+ public:
+  typedef boost::asio::ip::udp::endpoint Endpoint;
+
+  static const size_t kHeaderSize = 16;
+  static const size_t kRecordSize = 32;
+
+  // Loads the cache from "path", creating the file if it doesn't exist.  If the file isn't a cache
+  // file of this version, it is replaced by an empty one.  If the file can't be read or written,
+  // the cache starts empty and isn't persisted.
+  explicit BootstrapCache(const boost::filesystem::path& path);
+
+  // Returns the cached peers' endpoints together with "bootstrap_endpoints", in increasing order of
+  // the expected time to connect to them.  Endpoints not in the cache keep their relative order.
+  std::vector<Endpoint> Rank(const std::vector<Endpoint>& bootstrap_endpoints) const;
+
+  // Records a connection to the peer at "endpoint", with the round trip time in microseconds, or 0
+  // if it hasn't been measured yet.
+  void RecordSuccess(const Endpoint& endpoint, uint32_t round_trip_time);
+
+  // Records a failed attempt to connect to the peer at "endpoint".
+  void RecordFailure(const Endpoint& endpoint);
+
+  // Folds a later measurement of the round trip time to the peer at "endpoint" into its record, if
+  // it has one.
+  void RecordRoundTripTime(const Endpoint& endpoint, uint32_t round_trip_time);
+
+  size_t Size() const;
+
+  // The expected time in milliseconds to connect to a peer with the given history, allowing for
+  // failed attempts taking Parameters::bootstrap_connect_timeout.
+  static double ExpectedConnectTime(uint32_t round_trip_time, uint32_t successes,
+                                    uint32_t failures);
+
+ private:
+  BootstrapCache(const BootstrapCache&);
+  BootstrapCache& operator=(const BootstrapCache&);
+
+  struct Record {
+    Record() : endpoint(), round_trip_time(0), successes(0), failures(0), last_seen(0) {}
+    Endpoint endpoint;
+    // Smoothed, in microseconds.
+    uint32_t round_trip_time;
+    uint16_t successes, failures;
+    // Seconds since the epoch.
+    uint32_t last_seen;
+  };
+
+  // Reads the records from file_, giving an empty file a header.  Returns false if file_ isn't a
+  // cache file of this version.
+  bool Load();
+  // Writes the header for an empty cache to file_.
+  void WriteHeader();
+  // Returns the index of the record for "endpoint", adding one if necessary.
+  size_t FindOrAdd(const Endpoint& endpoint);
+  void Write(size_t index);
+
+  mutable std::mutex mutex_;
+  std::fstream file_;
+  std::vector<Record> records_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_BOOTSTRAP_CACHE_H_
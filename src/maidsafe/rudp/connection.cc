@@ -19,8 +19,10 @@ License.
 
 #include <array>
 #include <algorithm>
+#include <chrono>
 #include <functional>
-#include <queue>
+#include <limits>
+#include <utility>
 #include <thread>
 
 #include "boost/asio/read.hpp"
@@ -31,6 +33,8 @@ License.
 #include "maidsafe/rudp/managed_connections.h"
 #include "maidsafe/rudp/transport.h"
 #include "maidsafe/rudp/utils.h"
+#include "maidsafe/rudp/core/clock.h"
+#include "maidsafe/rudp/core/metrics.h"
 #include "maidsafe/rudp/core/multiplexer.h"
 #include "maidsafe/rudp/core/session.h"
 #include "maidsafe/rudp/core/socket.h"
@@ -56,10 +60,49 @@ std::ostream& operator<<(std::ostream& ostream, const Multiplexer& multiplexer)
 }
 #endif
 
-typedef std::function<void(int)> PingFunctor;
+// Set in the size prefix of a message in the ordered stream if it begins with a stream header.
+const uint32_t kStreamMessageFlag(0x80000000);
+// Stream ID (2 bytes) followed by the sequence number within the stream (4 bytes), where 0 means
+// the message is unordered.
+const size_t kStreamHeaderSize(6);
+// Set in the sequence number of an empty message which stands in for one that timed out.
+const uint32_t kStreamSkipFlag(0x80000000);
+
+uint32_t NextStreamSequenceNumber(uint32_t sequence_number) {
+  return sequence_number == ~kStreamSkipFlag ? 1 : sequence_number + 1;
+}
+
+// The sequence number "count" places after "sequence_number", allowing for wraparound.
+uint32_t AddToStreamSequenceNumber(uint32_t sequence_number, uint32_t count) {
+  uint32_t result(sequence_number + count);
+  return result > ~kStreamSkipFlag ? result - ~kStreamSkipFlag : result;
+}
+
+// Whether "sequence_number" has already been passed by the stream, allowing for wraparound.
+bool StreamSequenceNumberIsBefore(uint32_t sequence_number, uint32_t next_sequence_number) {
+  uint32_t distance((next_sequence_number - sequence_number) & ~kStreamSkipFlag);
+  return distance != 0 && distance <= (~kStreamSkipFlag >> 1);
+}
+
+// Whether a message of this (encrypted) size is sent unordered at the socket level.  It must fit in
+// the peer's receive window, since it is only handed up once all of its packets are held there.
+// The window is at least default_window_size packets, each of at least default_data_size bytes.
+bool FitsUnordered(size_t size) {
+  return size + kStreamHeaderSize <=
+         static_cast<size_t>(Parameters::default_window_size) * Parameters::default_data_size;
+}
 
 }  // unnamed namespace
 
+Connection::Stream::Stream()
+    : next_send_sequence_number(1),
+      send_limit(AddToStreamSequenceNumber(1, Parameters::stream_window_size)),
+      next_receive_sequence_number(1),
+      advertised_limit(send_limit),
+      out_of_order(),
+      skipped(),
+      blocked() {}
+
 Connection::Connection(const std::shared_ptr<Transport> &transport,
                        const asio::io_service::strand& strand,
                        const std::shared_ptr<Multiplexer> &multiplexer)
@@ -72,19 +115,25 @@ Connection::Connection(const std::shared_ptr<Transport> &transport,
       lifespan_timer_(strand_.get_io_service()),
       peer_node_id_(),
       peer_endpoint_(),
-      send_buffer_(),
       receive_buffer_(),
       data_size_(0),
       data_received_(0),
+      receiving_stream_message_(false),
       failed_probe_count_(0),
       state_(State::kPending),
       state_mutex_(),
       timeout_state_(TimeoutState::kConnecting),
-      sending_(false),
       failure_functor_(),
-      send_queue_() {
+      streams_() {
   static_assert((sizeof(DataSize)) == 4, "DataSize must be 4 bytes.");
   timer_.expires_from_now(bptime::pos_infin);
+  // The socket is owned by this connection, so will never invoke this after it's destroyed.
+  socket_.SetMessageReceivedFunctor([this](const std::string& message) {
+    HandleStreamMessage(message);
+  });
+  socket_.SetDatagramReceivedFunctor([this](const std::string& message) {
+    HandleDatagram(message);
+  });
 }
 
 Socket& Connection::Socket() {
@@ -101,12 +150,11 @@ void Connection::DoClose(bool timed_out) {
   if (std::shared_ptr<Transport> transport = transport_.lock()) {
     // We're still connected to the transport. We need to detach and then start flushing the socket
     // to attempt a graceful closure.
+    FailBlockedMessages();
     socket_.NotifyClose();
     socket_.AsyncFlush(strand_.wrap(std::bind(&Connection::DoClose, shared_from_this(), false)));
     transport->RemoveConnection(shared_from_this(), timed_out);
     transport_.reset();
-    sending_ = false;
-    std::queue<SendRequest>().swap(send_queue_);
     timer_.expires_from_now(Parameters::disconnection_timeout);
     timeout_state_ = TimeoutState::kClosing;
   } else {
@@ -124,15 +172,7 @@ void Connection::StartConnecting(const NodeId& peer_node_id,
                                  const std::function<void()>& failure_functor) {
   strand_.dispatch(std::bind(&Connection::DoStartConnecting, shared_from_this(), peer_node_id,
                              peer_endpoint, validation_data, connect_attempt_timeout, lifespan,
-                             PingFunctor(), failure_functor));
-}
-
-void Connection::Ping(const NodeId& peer_node_id,
-                      const ip::udp::endpoint& peer_endpoint,
-                      const PingFunctor& ping_functor) {
-  strand_.dispatch(std::bind(&Connection::DoStartConnecting, shared_from_this(), peer_node_id,
-                             peer_endpoint, "", Parameters::ping_timeout, bptime::time_duration(),
-                             ping_functor, std::function<void()>()));
+                             failure_functor));
 }
 
 void Connection::DoStartConnecting(const NodeId& peer_node_id,
@@ -140,13 +180,12 @@ void Connection::DoStartConnecting(const NodeId& peer_node_id,
                                    const std::string& validation_data,
                                    const boost::posix_time::time_duration& connect_attempt_timeout,
                                    const boost::posix_time::time_duration& lifespan,
-                                   const PingFunctor& ping_functor,
                                    const std::function<void()>& failure_functor) {
   peer_node_id_ = peer_node_id;
   peer_endpoint_ = peer_endpoint;
   failure_functor_ = failure_functor;
   StartTick();
-  StartConnect(validation_data, connect_attempt_timeout, lifespan, ping_functor);
+  StartConnect(validation_data, connect_attempt_timeout, lifespan);
   bs::error_code ignored_ec;
   CheckTimeout(ignored_ec);
 }
@@ -191,8 +230,20 @@ ip::udp::endpoint Connection::RemoteNatDetectionEndpoint() const {
   return socket_.RemoteNatDetectionEndpoint();
 }
 
+std::string Connection::Encrypt(const std::string& data) const {
+#ifdef TESTING
+  if (!Parameters::rudp_encrypt)
+    return data;
+#endif
+  auto start_time(std::chrono::steady_clock::now());
+  std::string encrypted(asymm::Encrypt(asymm::PlainText(data), *socket_.PeerPublicKey()).string());
+  Metrics::Instance().encryption_time.RecordSince(start_time);
+  return encrypted;
+}
+
 void Connection::StartSending(const std::string& data,
-                              const MessageSentFunctor& message_sent_functor) {
+                              const MessageSentFunctor& message_sent_functor,
+                              const SendOptions& options) {
   if (data.size() > static_cast<size_t>(ManagedConnections::kMaxMessageSize())) {
     LOG(kError) << "Data size " << data.size() << " bytes (exceeds limit of "
                 << ManagedConnections::kMaxMessageSize() << ")";
@@ -200,14 +251,12 @@ void Connection::StartSending(const std::string& data,
   }
   try {
     strand_.post(std::bind(
-        &Connection::DoQueueSendRequest,
+        &Connection::DoStartSending,
         shared_from_this(),
         SendRequest(
-#ifdef TESTING
-            !Parameters::rudp_encrypt ? data :
-#endif
-                asymm::Encrypt(asymm::PlainText(data), *socket_.PeerPublicKey()).string(),
-            message_sent_functor)));
+            Encrypt(data),
+            message_sent_functor,
+            options)));
   }
   catch(const std::exception& e) {
     LOG(kError) << "Failed to encrypt message: " << e.what();
@@ -215,40 +264,222 @@ void Connection::StartSending(const std::string& data,
   }
 }
 
-void Connection::DoQueueSendRequest(SendRequest const& request) {
-  if (sending_) {
-    send_queue_.push(request);
-  } else {
-    DoStartSending(request);
+void Connection::StartSendingDatagram(const std::string& data,
+                                      const MessageSentFunctor& message_sent_functor) {
+  try {
+    strand_.post(std::bind(
+        &Connection::DoSendDatagram,
+        shared_from_this(),
+        SendRequest(
+            Encrypt(data),
+            message_sent_functor,
+            SendOptions())));
+  }
+  catch(const std::exception& e) {
+    LOG(kError) << "Failed to encrypt message: " << e.what();
+    return InvokeSentFunctor(message_sent_functor, kFailedToEncryptMessage);
   }
 }
 
-void Connection::FinishSendAndQueueNext() {
-  if (send_queue_.empty()) {
-    sending_ = false;
-  } else {
-    strand_.post(std::bind(&Connection::DoStartSending, shared_from_this(), send_queue_.front()));
-    send_queue_.pop();
+void Connection::DoSendDatagram(SendRequest const& request) {
+  if (Stopped())
+    return InvokeSentFunctor(request.message_sent_functor_, kSendFailure);
+
+  int result(socket_.SendDatagram(request.encrypted_data_));
+  if (result != kSuccess) {
+    LOG(kWarning) << "Failed to send datagram of " << request.encrypted_data_.size()
+                  << " bytes from " << *multiplexer_ << " to " << socket_.PeerEndpoint()
+                  << "  Result: " << result;
+  }
+  InvokeSentFunctor(request.message_sent_functor_, result);
+}
+
+void Connection::HandleDatagram(const std::string& message) {
+  if (std::shared_ptr<Transport> transport = transport_.lock())
+    transport->SignalMessageReceived(message);
+}
+
+void Connection::HandleStreamMessage(const std::string& message) {
+  std::shared_ptr<Transport> transport(transport_.lock());
+  if (!transport)
+    return;
+
+  if (message.size() < kStreamHeaderSize) {
+    LOG(kError) << "Received message of " << message.size() << " bytes from "
+                << socket_.PeerEndpoint() << " - too small to hold a stream header.";
+    return;
+  }
+  const unsigned char* header(reinterpret_cast<const unsigned char*>(message.data()));
+  StreamId stream_id(static_cast<StreamId>((header[0] << 8) | header[1]));
+  uint32_t sequence_number((static_cast<uint32_t>(header[2]) << 24) |
+                           (static_cast<uint32_t>(header[3]) << 16) |
+                           (static_cast<uint32_t>(header[4]) << 8) |
+                           static_cast<uint32_t>(header[5]));
+  bool skip((sequence_number & kStreamSkipFlag) != 0);
+  sequence_number &= ~kStreamSkipFlag;
+  if (sequence_number == 0) {
+    // An unordered "skip" marker carries a credit for the stream instead.
+    if (skip)
+      HandleStreamCredit(stream_id, message.substr(kStreamHeaderSize));
+    else
+      transport->SignalMessageReceived(message.substr(kStreamHeaderSize));
+    return;
+  }
+
+  // A message can arrive after its skip marker, or vice versa, if it timed out while in flight.
+  // Whichever arrives second is ignored.
+  Stream& stream(streams_[stream_id]);
+  if (StreamSequenceNumberIsBefore(sequence_number, stream.next_receive_sequence_number))
+    return;
+  if (skip)
+    stream.skipped.insert(sequence_number);
+  else
+    stream.out_of_order.insert(std::make_pair(sequence_number, message.substr(kStreamHeaderSize)));
+
+  for (;;) {
+    uint32_t next(stream.next_receive_sequence_number);
+    auto itr(stream.out_of_order.find(next));
+    bool delivered(itr != stream.out_of_order.end());
+    if (delivered) {
+      transport->SignalMessageReceived(itr->second);
+      stream.out_of_order.erase(itr);
+    }
+    if (!stream.skipped.erase(next) && !delivered)
+      break;
+    stream.next_receive_sequence_number = NextStreamSequenceNumber(next);
+  }
+
+  // Credit is granted in batches of half the window, rather than for every message passed up.
+  uint32_t limit(AddToStreamSequenceNumber(stream.next_receive_sequence_number,
+                                           Parameters::stream_window_size));
+  if (((limit - stream.advertised_limit) & ~kStreamSkipFlag) >=
+      std::max(Parameters::stream_window_size / 2, 1U)) {
+    stream.advertised_limit = limit;
+    SendStreamCredit(stream_id, limit);
   }
 }
 
+void Connection::SendStreamSkip(StreamId stream_id, uint32_t sequence_number) {
+  std::shared_ptr<std::vector<unsigned char>> send_buffer(
+      std::make_shared<std::vector<unsigned char>>());
+  EncodeStreamData(std::string(), stream_id, sequence_number | kStreamSkipFlag, false,
+                   *send_buffer);
+  SendOptions options;
+  options.in_order = false;
+  options.stream_id = stream_id;
+  options.priority = SendPriority::kHigh;
+  StartWrite(send_buffer, [](int) {}, options);  // NOLINT (Fraser)
+}
 
+void Connection::SendStreamCredit(StreamId stream_id, uint32_t limit) {
+  std::string payload;
+  for (int i = 0; i != 4; ++i)
+    payload.push_back(static_cast<char>(limit >> (8 * (3 - i))));
+  std::shared_ptr<std::vector<unsigned char>> send_buffer(
+      std::make_shared<std::vector<unsigned char>>());
+  EncodeStreamData(payload, stream_id, kStreamSkipFlag, false, *send_buffer);
+  SendOptions options;
+  options.in_order = false;
+  options.stream_id = stream_id;
+  options.priority = SendPriority::kHigh;
+  StartWrite(send_buffer, [](int) {}, options);  // NOLINT (Fraser)
+}
+
+void Connection::HandleStreamCredit(StreamId stream_id, const std::string& payload) {
+  if (payload.size() != 4) {
+    LOG(kError) << "Received stream credit of " << payload.size() << " bytes from "
+                << socket_.PeerEndpoint() << " - expected 4.";
+    return;
+  }
+  uint32_t limit((static_cast<uint32_t>(static_cast<unsigned char>(payload[0])) << 24) |
+                 (static_cast<uint32_t>(static_cast<unsigned char>(payload[1])) << 16) |
+                 (static_cast<uint32_t>(static_cast<unsigned char>(payload[2])) << 8) |
+                 static_cast<uint32_t>(static_cast<unsigned char>(payload[3])));
+  Stream& stream(streams_[stream_id]);
+  // Credits can arrive out of order, so a lower limit than the current one is stale.
+  if (StreamSequenceNumberIsBefore(stream.send_limit, limit))
+    stream.send_limit = limit;
+
+  while (!stream.blocked.empty() &&
+         StreamSequenceNumberIsBefore(stream.next_send_sequence_number, stream.send_limit)) {
+    BlockedRequest blocked(stream.blocked.front());
+    stream.blocked.pop_front();
+    // The time to live includes the time spent waiting for credit.
+    SendOptions& options(blocked.request.options_);
+    if (options.time_to_live != bptime::pos_infin &&
+        FitsUnordered(blocked.request.encrypted_data_.size())) {
+      bptime::time_duration waited(Clock::Now() - blocked.queued_at);
+      if (waited >= options.time_to_live) {
+        InvokeSentFunctor(blocked.request.message_sent_functor_, kMessageTimedOut);
+        continue;
+      }
+      options.time_to_live -= waited;
+    }
+    WriteMessage(blocked.request);
+  }
+}
+
+void Connection::FailBlockedMessages() {
+  for (auto& stream : streams_) {
+    std::deque<BlockedRequest> blocked;
+    blocked.swap(stream.second.blocked);
+    for (const auto& blocked_request : blocked)
+      InvokeSentFunctor(blocked_request.request.message_sent_functor_, kSendFailure);
+  }
+}
 
 void Connection::DoStartSending(SendRequest const& request) {
-  sending_ = true;
+  if (Stopped())
+    return InvokeSentFunctor(request.message_sent_functor_, kSendFailure);
+
+  // An ordered message on a stream other than the default one waits if the peer hasn't granted
+  // credit for it, or if earlier messages on its stream are already waiting.
+  if (request.options_.in_order && request.options_.stream_id != 0) {
+    Stream& stream(streams_[request.options_.stream_id]);
+    if (!stream.blocked.empty() ||
+        !StreamSequenceNumberIsBefore(stream.next_send_sequence_number, stream.send_limit)) {
+      stream.blocked.push_back(BlockedRequest(request, Clock::Now()));
+      return;
+    }
+  }
+  WriteMessage(request);
+}
+
+void Connection::WriteMessage(SendRequest const& request) {
   const std::function<void(int)> &message_sent_functor = request.message_sent_functor_;  // NOLINT (Dan)
-  MessageSentFunctor wrapped_functor([this,
-                                     message_sent_functor] (int result) {
+  SendOptions options(request.options_);
+  std::shared_ptr<std::vector<unsigned char>> send_buffer(
+      std::make_shared<std::vector<unsigned char>>());
+  uint32_t sequence_number(0);
+  if (options.in_order && options.stream_id == 0) {
+    EncodeData(request.encrypted_data_, *send_buffer);
+  } else {
+    // Messages too large to be sent unordered are sent in the ordered stream instead; their stream
+    // header still lets the peer order them correctly relative to other messages on the same
+    // stream.
+    if (options.in_order) {
+      Stream& stream(streams_[options.stream_id]);
+      sequence_number = stream.next_send_sequence_number;
+      stream.next_send_sequence_number = NextStreamSequenceNumber(sequence_number);
+    }
+    options.in_order = !FitsUnordered(request.encrypted_data_.size());
+    EncodeStreamData(request.encrypted_data_, options.stream_id, sequence_number,
+                     options.in_order, *send_buffer);
+  }
+
+  // Only a message sent unordered at the socket level can be abandoned; the rest of the socket's
+  // ordered stream would be corrupted by a gap.  If one on a stream times out, the peer is told to
+  // skip it so that later messages on that stream aren't held up waiting for it.
+  if (options.in_order)
+    options.time_to_live = bptime::pos_infin;
+  StreamId stream_id(options.stream_id);
+  MessageSentFunctor wrapped_functor([this, message_sent_functor, stream_id,
+                                      sequence_number] (int result) {
+                                       if (result == kMessageTimedOut && sequence_number != 0)
+                                         SendStreamSkip(stream_id, sequence_number);
                                        InvokeSentFunctor(message_sent_functor, result);
                                      });
-
-  if (Stopped()) {
-    InvokeSentFunctor(message_sent_functor, kSendFailure);
-    FinishSendAndQueueNext();
-  } else {
-    EncodeData(request.encrypted_data_);
-    strand_.dispatch(std::bind(&Connection::StartWrite, shared_from_this(), wrapped_functor));
-  }
+  StartWrite(send_buffer, wrapped_functor, options);
 }
 
 void Connection::CheckTimeout(const bs::error_code& ec) {
@@ -314,10 +545,9 @@ void Connection::HandleTick() {
 
 void Connection::StartConnect(const std::string& validation_data,
                               const boost::posix_time::time_duration& connect_attempt_timeout,
-                              const boost::posix_time::time_duration& lifespan,
-                              const PingFunctor& ping_functor) {
+                              const boost::posix_time::time_duration& lifespan) {
   auto handler = strand_.wrap(std::bind(&Connection::HandleConnect, shared_from_this(),
-                                        args::_1, validation_data, ping_functor));
+                                        args::_1, validation_data));
   Session::Mode open_mode(Session::kNormal);
   lifespan_timer_.expires_from_now(lifespan);
   if (validation_data.empty()) {
@@ -368,39 +598,49 @@ void Connection::CheckLifespanTimeout(const bs::error_code& ec) {
 }
 
 void Connection::HandleConnect(const bs::error_code& ec,
-                               const std::string& validation_data,
-                               PingFunctor ping_functor) {
+                               const std::string& validation_data) {
   if (ec) {
 #ifndef NDEBUG
     if (!Stopped())
       LOG(kError) << "Failed to connect from " << *multiplexer_ << " to "
                   << socket_.PeerEndpoint() << " - " << ec.message();
 #endif
-    if (ping_functor)
-      ping_functor(kPingFailed);
     return DoClose();
   }
 
   if (Stopped()) {
-    if (ping_functor) {
-      ping_functor(kSuccess);
 #ifndef NDEBUG
-    } else if (state_ != State::kTemporary) {
+    if (state_ != State::kTemporary) {
       LOG(kWarning) << "Connection from " << *multiplexer_ << " to " << socket_.PeerEndpoint()
                     << " already stopped.";
-#endif
     }
+#endif
     return DoClose();
   }
 
   if (std::shared_ptr<Transport> transport = transport_.lock()) {
     peer_node_id_ = socket_.PeerNodeId();
-    transport->AddConnection(shared_from_this());
+    // If this is one of several attempts racing to reach the peer, a more preferred one which is
+    // still in progress may be given a little longer before this one is used.
+    if (transport->DeferConnect(shared_from_this(),
+                                std::bind(&Connection::CompleteConnect, shared_from_this(),
+                                          validation_data))) {
+      return;
+    }
   } else {
     LOG(kError) << "Pointer to Transport already destroyed.";
     return DoClose();
   }
 
+  CompleteConnect(validation_data);
+}
+
+void Connection::CompleteConnect(const std::string& validation_data) {
+  std::shared_ptr<Transport> transport(transport_.lock());
+  if (!transport || !socket_.IsOpen())
+    return DoClose();
+  transport->AddConnection(shared_from_this());
+
   timer_.expires_at(boost::posix_time::pos_infin);
   timeout_state_ = TimeoutState::kConnected;
 
@@ -446,8 +686,12 @@ void Connection::HandleReadSize(const bs::error_code& ec) {
     return DoClose();
   }
 
-  data_size_ = (((((receive_buffer_.at(0) << 8) | receive_buffer_.at(1)) << 8) |
-                receive_buffer_.at(2)) << 8) | receive_buffer_.at(3);
+  uint32_t size_field((static_cast<uint32_t>(receive_buffer_.at(0)) << 24) |
+                      (static_cast<uint32_t>(receive_buffer_.at(1)) << 16) |
+                      (static_cast<uint32_t>(receive_buffer_.at(2)) << 8) |
+                      static_cast<uint32_t>(receive_buffer_.at(3)));
+  receiving_stream_message_ = (size_field & kStreamMessageFlag) != 0;
+  data_size_ = static_cast<DataSize>(size_field & ~kStreamMessageFlag);
   // Allow some leeway for encryption overhead
   if (data_size_ > ManagedConnections::kMaxMessageSize() + 1024) {
     LOG(kError) << "Won't receive a message of size " << data_size_ << " which is > "
@@ -496,7 +740,11 @@ void Connection::HandleReadData(const bs::error_code& ec, size_t length) {
   data_received_ += static_cast<DataSize>(length);
   if (data_received_ == data_size_) {
     if (std::shared_ptr<Transport> transport = transport_.lock()) {
-      transport->SignalMessageReceived(std::string(receive_buffer_.begin(), receive_buffer_.end()));
+      std::string message(receive_buffer_.begin(), receive_buffer_.end());
+      if (receiving_stream_message_)
+        HandleStreamMessage(message);
+      else
+        transport->SignalMessageReceived(message);
       StartReadSize();
     }
   } else {
@@ -513,33 +761,53 @@ void Connection::HandleReadData(const bs::error_code& ec, size_t length) {
   }
 }
 
-void Connection::EncodeData(const std::string& data) {
-  // Serialize message to internal buffer
+void Connection::EncodeData(const std::string& data, std::vector<unsigned char>& send_buffer) {
+  // Serialize message to send buffer
   DataSize msg_size = static_cast<DataSize>(data.size());
-  send_buffer_.clear();
+  send_buffer.clear();
+  for (int i = 0; i != 4; ++i)
+    send_buffer.push_back(static_cast<char>(msg_size >> (8 * (3 - i))));
+  send_buffer.insert(send_buffer.end(), data.begin(), data.end());
+}
+
+void Connection::EncodeStreamData(const std::string& data, StreamId stream_id,
+                                  uint32_t sequence_number, bool framed,
+                                  std::vector<unsigned char>& send_buffer) {
+  send_buffer.clear();
+  if (framed) {
+    uint32_t size_field(static_cast<uint32_t>(kStreamHeaderSize + data.size()) |
+                        kStreamMessageFlag);
+    for (int i = 0; i != 4; ++i)
+      send_buffer.push_back(static_cast<unsigned char>(size_field >> (8 * (3 - i))));
+  }
+  send_buffer.push_back(static_cast<unsigned char>(stream_id >> 8));
+  send_buffer.push_back(static_cast<unsigned char>(stream_id));
   for (int i = 0; i != 4; ++i)
-    send_buffer_.push_back(static_cast<char>(msg_size >> (8 * (3 - i))));
-  send_buffer_.insert(send_buffer_.end(), data.begin(), data.end());
+    send_buffer.push_back(static_cast<unsigned char>(sequence_number >> (8 * (3 - i))));
+  send_buffer.insert(send_buffer.end(), data.begin(), data.end());
 }
 
-void Connection::StartWrite(const MessageSentFunctor& message_sent_functor) {
+void Connection::StartWrite(const std::shared_ptr<std::vector<unsigned char>>& send_buffer,
+                            const MessageSentFunctor& message_sent_functor,
+                            const SendOptions& options) {
   if (Stopped()) {
     LOG(kError) << "Failed to write from " << *multiplexer_ << " to " << socket_.PeerEndpoint()
                 << " - connection stopped.";
     InvokeSentFunctor(message_sent_functor, kSendFailure);
-    FinishSendAndQueueNext();
     return DoClose();
   }
-  socket_.AsyncWrite(asio::buffer(send_buffer_),
+  // send_buffer is bound to the handler to keep it alive until the socket has finished with it.
+  socket_.AsyncWrite(asio::buffer(*send_buffer),
                      message_sent_functor,
                      strand_.wrap(std::bind(&Connection::HandleWrite, shared_from_this(),
-                                  message_sent_functor)));
+                                  send_buffer, message_sent_functor)),
+                     options);
 }
 
-void Connection::HandleWrite(MessageSentFunctor message_sent_functor) {
-  // Message has now been fully sent, so safe to start sending next.  message_sent_functor will be
+void Connection::HandleWrite(std::shared_ptr<std::vector<unsigned char>> /*send_buffer*/,
+                             MessageSentFunctor message_sent_functor) {
+  // Message has now been fully added to the socket's send window.  message_sent_functor will be
   // invoked by Socket::HandleAck once peer has acknowledged receipt.
-  FinishSendAndQueueNext();
   if (Stopped()) {
     LOG(kError) << "Failed to write from " << *multiplexer_ << " to " << socket_.PeerEndpoint()
                 << " - connection stopped.";
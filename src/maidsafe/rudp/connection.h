@@ -18,10 +18,13 @@ License.
 #ifndef MAIDSAFE_RUDP_CONNECTION_H_
 #define MAIDSAFE_RUDP_CONNECTION_H_
 
+#include <cstdint>
+#include <deque>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -40,6 +43,7 @@ namespace rudp {
 namespace detail {
 
 typedef int32_t DataSize;
+typedef uint16_t StreamId;
 
 class Multiplexer;
 
@@ -88,10 +92,15 @@ class Connection : public std::enable_shared_from_this<Connection> {
                        const boost::posix_time::time_duration& connect_attempt_timeout,
                        const boost::posix_time::time_duration& lifespan,
                        const std::function<void()>& failure_functor);
-  void Ping(const NodeId& peer_node_id,
-            const boost::asio::ip::udp::endpoint& peer_endpoint,
-            const std::function<void(int)> &ping_functor);  // NOLINT (Fraser)
-  void StartSending(const std::string& data, const std::function<void(int)> &message_sent_functor);  // NOLINT (Fraser)
+  void StartSending(const std::string& data,
+                    const std::function<void(int)> &message_sent_functor,  // NOLINT (Fraser)
+                    const SendOptions& options = SendOptions());
+  // Sends data as a single unreliable datagram which bypasses the socket's send window.
+  // message_sent_functor is invoked once the datagram has been handed to the network (or has failed
+  // to be), since it is never acknowledged.
+  void StartSendingDatagram(
+      const std::string& data,
+      const std::function<void(int)> &message_sent_functor);  // NOLINT (Fraser)
   State state() const;
   // Sets the state_ to kPermanent or kUnvalidated and sets the lifespan_timer_ to expire at
   // pos_infin.
@@ -113,11 +122,14 @@ class Connection : public std::enable_shared_from_this<Connection> {
   struct SendRequest {
     std::string encrypted_data_;
     std::function<void(int)> message_sent_functor_;  // NOLINT (Dan)
+    SendOptions options_;
 
     SendRequest(const std::string& encrypted_data,
-                const std::function<void(int)>& message_sent_functor)  // NOLINT (Dan)
+                const std::function<void(int)>& message_sent_functor,  // NOLINT (Dan)
+                const SendOptions& options)
         : encrypted_data_(encrypted_data),
-          message_sent_functor_(message_sent_functor) {}
+          message_sent_functor_(message_sent_functor),
+          options_(options) {}
   };
 
   void DoClose(bool timed_out = false);
@@ -126,11 +138,51 @@ class Connection : public std::enable_shared_from_this<Connection> {
                          const std::string& validation_data,
                          const boost::posix_time::time_duration& connect_attempt_timeout,
                          const boost::posix_time::time_duration& lifespan,
-                         const std::function<void(int)>& ping_functor,  // NOLINT (Fraser)
                          const std::function<void()>& failure_functor);
+  // A message held back because its stream has used up the credit granted by the peer.
+  struct BlockedRequest {
+    BlockedRequest(const SendRequest& request_in, const boost::posix_time::ptime& queued_at_in)
+        : request(request_in),
+          queued_at(queued_at_in) {}
+    SendRequest request;
+    boost::posix_time::ptime queued_at;
+  };
+
+  // Per-stream state for streams other than the default one.  Every message on such a stream
+  // carries a stream header (see EncodeStreamData) giving its stream ID and, if it is to be
+  // delivered in order, its sequence number within the stream.  Ordered messages are flow
+  // controlled per stream: only those with sequence numbers before send_limit may be sent, and the
+  // receiver raises the limit (see SendStreamCredit) as it passes messages up.
+  struct Stream {
+    Stream();
+    uint32_t next_send_sequence_number, send_limit;
+    uint32_t next_receive_sequence_number, advertised_limit;
+    // Complete messages received ahead of next_receive_sequence_number, indexed by sequence number.
+    std::map<uint32_t, std::string> out_of_order;
+    // Sequence numbers ahead of next_receive_sequence_number which the peer abandoned.
+    std::set<uint32_t> skipped;
+    // Messages waiting for credit, in the order they were sent.
+    std::deque<BlockedRequest> blocked;
+  };
+
+  // Encrypts data for the peer.  Throws if encryption fails.
+  std::string Encrypt(const std::string& data) const;
   void DoStartSending(SendRequest const& request);  // NOLINT (Fraser)
-  void DoQueueSendRequest(SendRequest const& request);
-  void FinishSendAndQueueNext();
+  // Assigns the message its stream sequence number (if any), encodes and writes it.
+  void WriteMessage(SendRequest const& request);  // NOLINT (Fraser)
+  void DoSendDatagram(SendRequest const& request);  // NOLINT (Fraser)
+  void HandleDatagram(const std::string& message);
+  // Handles a message carrying a stream header, having arrived either unordered or in the ordered
+  // stream.  It's passed up once all earlier messages on the same stream have been.
+  void HandleStreamMessage(const std::string& message);
+  // Tells the peer to stop waiting for the given message on the stream, since it timed out.
+  void SendStreamSkip(StreamId stream_id, uint32_t sequence_number);
+  // Allows the peer to send messages on the stream with sequence numbers before "limit".
+  void SendStreamCredit(StreamId stream_id, uint32_t limit);
+  // Raises the stream's send_limit and writes any blocked messages which it now allows.
+  void HandleStreamCredit(StreamId stream_id, const std::string& payload);
+  // Fails all messages waiting for credit.
+  void FailBlockedMessages();
 
   void CheckTimeout(const boost::system::error_code& ec);
   void CheckLifespanTimeout(const boost::system::error_code& ec);
@@ -141,11 +193,10 @@ class Connection : public std::enable_shared_from_this<Connection> {
 
   void StartConnect(const std::string& validation_data,
                     const boost::posix_time::time_duration& connect_attempt_timeout,
-                    const boost::posix_time::time_duration& lifespan,
-                    const std::function<void(int)> &ping_functor);  // NOLINT (Fraser)
-  void HandleConnect(const boost::system::error_code& ec,
-                     const std::string& validation_data,
-                     std::function<void(int)> ping_functor);  // NOLINT (Fraser)
+                    const boost::posix_time::time_duration& lifespan);
+  void HandleConnect(const boost::system::error_code& ec, const std::string& validation_data);
+  // Adds the newly-connected connection to the transport and starts using it.
+  void CompleteConnect(const std::string& validation_data);
 
   void StartReadSize();
   void HandleReadSize(const boost::system::error_code& ec);
@@ -153,8 +204,11 @@ class Connection : public std::enable_shared_from_this<Connection> {
   void StartReadData();
   void HandleReadData(const boost::system::error_code& ec, size_t length);
 
-  void StartWrite(const std::function<void(int)> &message_sent_functor);  // NOLINT (Fraser)
-  void HandleWrite(std::function<void(int)> message_sent_functor);  // NOLINT (Fraser)
+  void StartWrite(const std::shared_ptr<std::vector<unsigned char>>& send_buffer,
+                  const std::function<void(int)> &message_sent_functor,  // NOLINT (Fraser)
+                  const SendOptions& options);
+  void HandleWrite(std::shared_ptr<std::vector<unsigned char>> send_buffer,
+                   std::function<void(int)> message_sent_functor);  // NOLINT (Fraser)
 
   void StartProbing();
   void DoProbe(const boost::system::error_code& ec);
@@ -162,7 +216,11 @@ class Connection : public std::enable_shared_from_this<Connection> {
 
   void DoMakePermanent(bool validated);
 
-  void EncodeData(const std::string& data);
+  void EncodeData(const std::string& data, std::vector<unsigned char>& send_buffer);
+  // If "framed", the stream header is preceded by a size (with kStreamMessageFlag set) for sending
+  // in the ordered stream.  Otherwise the socket delimits the message.
+  void EncodeStreamData(const std::string& data, StreamId stream_id, uint32_t sequence_number,
+                        bool framed, std::vector<unsigned char>& send_buffer);
 
   void InvokeSentFunctor(const std::function<void(int)> &message_sent_functor, int result) const;  // NOLINT (Fraser)
 
@@ -173,15 +231,15 @@ class Connection : public std::enable_shared_from_this<Connection> {
   boost::asio::deadline_timer timer_, probe_interval_timer_, lifespan_timer_;
   NodeId peer_node_id_;
   boost::asio::ip::udp::endpoint peer_endpoint_;
-  std::vector<unsigned char> send_buffer_, receive_buffer_;
+  std::vector<unsigned char> receive_buffer_;
   DataSize data_size_, data_received_;
+  bool receiving_stream_message_;
   uint8_t failed_probe_count_;
   State state_;
   mutable std::mutex state_mutex_;
   enum class TimeoutState { kConnecting, kConnected, kClosing } timeout_state_;
-  bool sending_;
   std::function<void()> failure_functor_;
-  std::queue<SendRequest> send_queue_;
+  std::map<StreamId, Stream> streams_;
 };
 
 
@@ -18,14 +18,19 @@ License.
 #include <algorithm>
 #include <cassert>
 #include <utility>
+#include <vector>
 
 #include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
 
 #include "maidsafe/rudp/connection.h"
 #include "maidsafe/rudp/transport.h"
+#include "maidsafe/rudp/core/metrics.h"
 #include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/session_tickets.h"
 #include "maidsafe/rudp/core/socket.h"
 #include "maidsafe/rudp/packets/handshake_packet.h"
+#include "maidsafe/rudp/packets/ping_packet.h"
 #include "maidsafe/rudp/parameters.h"
 #include "maidsafe/rudp/utils.h"
 
@@ -65,7 +70,12 @@ ConnectionManager::ConnectionManager(std::shared_ptr<Transport> transport,
       multiplexer_(multiplexer),
       kThisNodeId_(this_node_id),
       this_public_key_(this_public_key),
-      sockets_() {
+      sockets_(),
+      sockets_by_address_(),
+      syn_cookies_(),
+      pings_(),
+      ping_sequence_number_(RandomUint32() | 0x00000001),
+      ping_timer_(strand.get_io_service()) {
   multiplexer_->dispatcher_.SetConnectionManager(this);
 }
 
@@ -76,19 +86,24 @@ void ConnectionManager::Close() {
   std::lock_guard<std::mutex> lock(mutex_);
   for (auto connection : connections_)
     strand_.post(std::bind(&Connection::Close, connection));
+  if (std::shared_ptr<Transport> transport = transport_.lock())
+    strand_.post([this, transport] { FailOutstandingPings(); });  // NOLINT (Fraser)
 }
 
-void ConnectionManager::Connect(const NodeId& peer_id,
-                                const Endpoint& peer_endpoint,
-                                const std::string& validation_data,
-                                const bptime::time_duration& connect_attempt_timeout,
-                                const bptime::time_duration& lifespan,
-                                const std::function<void()>& failure_functor) {
+ConnectionManager::ConnectionPtr ConnectionManager::Connect(
+    const NodeId& peer_id,
+    const Endpoint& peer_endpoint,
+    const std::string& validation_data,
+    const bptime::time_duration& connect_attempt_timeout,
+    const bptime::time_duration& lifespan,
+    const std::function<void()>& failure_functor) {
   if (std::shared_ptr<Transport> transport = transport_.lock()) {
     ConnectionPtr connection(std::make_shared<Connection>(transport, strand_, multiplexer_));
     connection->StartConnecting(peer_id, peer_endpoint, validation_data, connect_attempt_timeout,
                                 lifespan, failure_functor);
+    return connection;
   }
+  return ConnectionPtr();
 }
 
 int ConnectionManager::AddConnection(ConnectionPtr connection) {
@@ -133,16 +148,121 @@ ConnectionManager::ConnectionPtr ConnectionManager::GetConnection(const NodeId&
 void ConnectionManager::Ping(const NodeId& peer_id,
                              const Endpoint& peer_endpoint,
                              const std::function<void(int)> &ping_functor) {  // NOLINT (Fraser)
+  assert(ping_functor);
   if (std::shared_ptr<Transport> transport = transport_.lock()) {
-    assert(ping_functor);
-    ConnectionPtr connection(std::make_shared<Connection>(transport, strand_, multiplexer_));
-    connection->Ping(peer_id, peer_endpoint, ping_functor);
+    strand_.dispatch([this, transport, peer_id, peer_endpoint, ping_functor] {
+      DoPing(peer_id, peer_endpoint, ping_functor);
+    });
+  }
+}
+
+void ConnectionManager::DoPing(const NodeId& peer_id,
+                               const Endpoint& peer_endpoint,
+                               const std::function<void(int)>& ping_functor) {  // NOLINT (Fraser)
+  if (!multiplexer_->IsOpen())
+    return ping_functor(kPingFailed);
+
+  PingPacket ping_packet;
+  ping_packet.SetSequenceNumber(ping_sequence_number_);
+  ping_packet.SetDestinationSocketId(0);
+  ping_packet.set_node_id(kThisNodeId_);
+  if (multiplexer_->SendTo(ping_packet, peer_endpoint) != kSuccess) {
+    LOG(kWarning) << DebugId(kThisNodeId_) << " Failed to send ping to " << peer_endpoint;
+    return ping_functor(kPingFailed);
+  }
+
+  OutstandingPing ping = { peer_id, peer_endpoint,
+                           asio::deadline_timer::traits_type::now() + Parameters::ping_timeout,
+                           ping_functor };
+  pings_[ping_sequence_number_] = ping;
+  ping_sequence_number_ += 2;
+
+  // All pings have the same timeout, so if others are outstanding the timer is already due to fire
+  // before this one's deadline.
+  if (pings_.size() == 1U) {
+    ping_timer_.expires_at(ping.deadline);
+    ping_timer_.async_wait(strand_.wrap(std::bind(&ConnectionManager::HandlePingTimeout, this,
+                                                  transport_, std::placeholders::_1)));
+  }
+}
+
+void ConnectionManager::HandlePing(const PingPacket& ping_packet, const Endpoint& endpoint) {
+  if (ping_packet.IsRequest()) {
+    if (ping_packet.node_id() == kThisNodeId_) {
+      LOG(kWarning) << DebugId(kThisNodeId_) << " is pinging another local transport.";
+      return;
+    }
+    if (!IsValid(endpoint))
+      return;
+    PingPacket pong_packet;
+    pong_packet.SetSequenceNumber(ping_packet.SequenceNumber() + 1);
+    pong_packet.SetDestinationSocketId(0);
+    pong_packet.set_node_id(kThisNodeId_);
+    if (multiplexer_->SendTo(pong_packet, endpoint) != kSuccess)
+      LOG(kWarning) << DebugId(kThisNodeId_) << " Failed to answer ping from " << endpoint;
+    return;
+  }
+
+  auto itr(pings_.find(ping_packet.SequenceNumber() - 1));
+  if (itr == pings_.end() || !ping_packet.IsResponseOf(itr->first) ||
+      itr->second.peer_endpoint != endpoint ||
+      (!itr->second.peer_id.IsZero() && itr->second.peer_id != ping_packet.node_id())) {
+    LOG(kVerbose) << DebugId(kThisNodeId_) << " Ignoring unexpected ping response from "
+                  << endpoint;
+    return;
+  }
+  std::function<void(int)> ping_functor(itr->second.ping_functor);  // NOLINT (Fraser)
+  pings_.erase(itr);
+  ping_functor(kSuccess);
+}
+
+void ConnectionManager::HandlePingTimeout(const std::weak_ptr<Transport>& transport,
+                                          const boost::system::error_code& ec) {
+  // The timer is only cancelled when being reset or destroyed, and in the latter case "this" is
+  // no longer valid.  Otherwise, the transport owning "this" must still exist.
+  if (ec == asio::error::operation_aborted || !transport.lock())
+    return;
+
+  std::vector<std::function<void(int)>> expired;  // NOLINT (Fraser)
+  auto now(asio::deadline_timer::traits_type::now());
+  auto itr(pings_.begin());
+  while (itr != pings_.end()) {
+    if (itr->second.deadline <= now) {
+      expired.push_back(itr->second.ping_functor);
+      itr = pings_.erase(itr);
+    } else {
+      ++itr;
+    }
   }
+
+  if (!pings_.empty()) {
+    auto earliest(std::min_element(pings_.begin(), pings_.end(),
+                                   [](const PingMap::value_type& lhs,
+                                      const PingMap::value_type& rhs) {
+                                     return lhs.second.deadline < rhs.second.deadline;
+                                   }));
+    ping_timer_.expires_at(earliest->second.deadline);
+    ping_timer_.async_wait(strand_.wrap(std::bind(&ConnectionManager::HandlePingTimeout, this,
+                                                  transport, std::placeholders::_1)));
+  }
+
+  for (const auto& ping_functor : expired)
+    ping_functor(kPingFailed);
+}
+
+void ConnectionManager::FailOutstandingPings() {
+  PingMap pings;
+  pings.swap(pings_);
+  boost::system::error_code ignored_ec;
+  ping_timer_.cancel(ignored_ec);
+  for (const auto& ping : pings)
+    ping.second.ping_functor(kPingFailed);
 }
 
 bool ConnectionManager::Send(const NodeId& peer_id,
                              const std::string& message,
-                             const std::function<void(int)>& message_sent_functor) {  // NOLINT (Fraser)
+                             const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
+                             const SendOptions& options) {
   std::unique_lock<std::mutex> lock(mutex_);
   auto itr(FindConnection(peer_id));
   if (itr == connections_.end()) {
@@ -152,21 +272,59 @@ bool ConnectionManager::Send(const NodeId& peer_id,
 
   ConnectionPtr connection(*itr);
   lock.unlock();
-  strand_.dispatch([=] { connection->StartSending(message, message_sent_functor); });  // NOLINT (Fraser)
+  strand_.dispatch([=] { connection->StartSending(message, message_sent_functor, options); });  // NOLINT (Fraser)
+  return true;
+}
+
+bool ConnectionManager::SendDatagram(const NodeId& peer_id,
+                                     const std::string& message,
+                                     const std::function<void(int)>& message_sent_functor) {  // NOLINT (Fraser)
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto itr(FindConnection(peer_id));
+  if (itr == connections_.end()) {
+    LOG(kWarning) << DebugId(kThisNodeId_) << " Not currently connected to " << DebugId(peer_id);
+    return false;
+  }
+
+  ConnectionPtr connection(*itr);
+  lock.unlock();
+  strand_.dispatch([=] { connection->StartSendingDatagram(message, message_sent_functor); });  // NOLINT (Fraser)
   return true;
 }
 
 Socket* ConnectionManager::GetSocket(const asio::const_buffer& data, const Endpoint& endpoint) {
   uint32_t socket_id(0);
   if (!Packet::DecodeDestinationSocketId(&socket_id, data)) {
+    Metrics::Instance().decode_failures.Add();
     LOG(kError) << DebugId(kThisNodeId_) << " Received a non-RUDP packet from " << endpoint;
     return nullptr;
   }
 
-  SocketMap::const_iterator socket_iter(sockets_.end());
+  if (socket_id == 0 && PingPacket::IsValid(data)) {
+    // Pings are answered here, without a socket.
+    PingPacket ping_packet;
+    if (ping_packet.Decode(data))
+      HandlePing(ping_packet, endpoint);
+    else
+      Metrics::Instance().decode_failures.Add();
+    return nullptr;
+  }
+
+  Socket* socket(nullptr);
   if (socket_id == 0) {
+    // Only a peer's cookie carries its public key, and an unsolicited request never does, so one
+    // which does is rejected before the (costly) key is parsed.  A request may carry a ticket.
+    if (boost::asio::buffer_size(data) >
+            HandshakePacket::kMinPacketSize + HandshakePacket::kTicketSize &&
+        sockets_by_address_.count(endpoint.address()) == 0) {
+      Metrics::Instance().decode_failures.Add();
+      LOG(kVerbose) << DebugId(kThisNodeId_) << " Dropping unexpected handshake with key from "
+                    << endpoint;
+      return nullptr;
+    }
     HandshakePacket handshake_packet;
     if (!handshake_packet.Decode(data)) {
+      Metrics::Instance().decode_failures.Add();
       LOG(kVerbose) << DebugId(kThisNodeId_) << " Failed to decode handshake packet from "
                     << endpoint;
       return nullptr;
@@ -175,39 +333,29 @@ Socket* ConnectionManager::GetSocket(const asio::const_buffer& data, const Endpo
       // This is a handshake packet on a newly-added socket
       LOG(kVerbose) << DebugId(kThisNodeId_)
                     << " This is a handshake packet on a newly-added socket from " << endpoint;
-      socket_iter = std::find_if(sockets_.begin(),
-                                 sockets_.end(),
-                                 [endpoint] (const SocketMap::value_type& socket_pair) {
-                                   return socket_pair.second->PeerEndpoint() == endpoint &&
-                                         !socket_pair.second->IsConnected();
-                                 });
+      socket = FindSocket(endpoint.address(), [endpoint](const Socket& candidate) {
+        return candidate.PeerEndpoint() == endpoint && !candidate.IsConnected();
+      });
       // If the socket wasn't found, this could be a connect attempt from a peer using symmetric
       // NAT, so the peer's port may be different to what this node was told to expect.
-      if (socket_iter == sockets_.end()) {
-        socket_iter = std::find_if(sockets_.begin(),
-                                   sockets_.end(),
-                                   [endpoint] (const SocketMap::value_type& socket_pair) {
-                                     return socket_pair.second->PeerEndpoint().address() ==
-                                                endpoint.address() &&
-                                            !OnPrivateNetwork(socket_pair.second->PeerEndpoint()) &&
-                                            !socket_pair.second->IsConnected();
-                                   });
-        if (socket_iter != sockets_.end()) {
+      if (!socket) {
+        socket = FindSocket(endpoint.address(), [](const Socket& candidate) {
+          return !OnPrivateNetwork(candidate.PeerEndpoint()) && !candidate.IsConnected();
+        });
+        if (socket) {
           LOG(kVerbose) << DebugId(kThisNodeId_) << " Updating peer's endpoint from "
-                        << socket_iter->second->PeerEndpoint() << " to " << endpoint;
-          socket_iter->second->UpdatePeerEndpoint(endpoint);
+                        << socket->PeerEndpoint() << " to " << endpoint;
+          socket->UpdatePeerEndpoint(endpoint);
           LOG(kVerbose) << DebugId(kThisNodeId_) << " Peer's endpoint now: "
-                        << socket_iter->second->PeerEndpoint() << "  and guessed port = "
-                        << socket_iter->second->PeerGuessedPort();
+                        << socket->PeerEndpoint() << "  and guessed port = "
+                        << socket->PeerGuessedPort();
         }
       }
     } else {  // Session::mode_ != kNormal
-      socket_iter = std::find_if(sockets_.begin(),
-                                 sockets_.end(),
-                                 [endpoint] (const SocketMap::value_type& socket_pair) {
-                                   return socket_pair.second->PeerEndpoint() == endpoint;
-                                 });
-      if (socket_iter == sockets_.end()) {
+      socket = FindSocket(endpoint.address(), [endpoint](const Socket& candidate) {
+        return candidate.PeerEndpoint() == endpoint;
+      });
+      if (!socket) {
         // This is a handshake packet from a peer trying to ping this node or join the network
         HandlePingFrom(handshake_packet, endpoint);
         return nullptr;
@@ -225,18 +373,29 @@ Socket* ConnectionManager::GetSocket(const asio::const_buffer& data, const Endpo
     }
   } else {
     // This packet is intended for a specific connection.
-    socket_iter = sockets_.find(socket_id);
+    auto socket_iter(sockets_.find(socket_id));
+    if (socket_iter != sockets_.end())
+      socket = socket_iter->second;
   }
 
-  if (socket_iter != sockets_.end()) {
-    return socket_iter->second;
-  } else {
+  if (!socket) {
     const unsigned char* p = asio::buffer_cast<const unsigned char*>(data);
     LOG(kVerbose) << DebugId(kThisNodeId_) << "  Received a packet \"0x" << std::hex
                   << static_cast<int>(*p) << std::dec << "\" for unknown connection " << socket_id
                   << " from " << endpoint;
-    return nullptr;
   }
+  return socket;
+}
+
+template <typename Predicate>
+Socket* ConnectionManager::FindSocket(const asio::ip::address& address,
+                                      Predicate predicate) const {
+  auto range(sockets_by_address_.equal_range(address));
+  for (auto itr(range.first); itr != range.second; ++itr) {
+    if (predicate(*itr->second))
+      return itr->second;
+  }
+  return nullptr;
 }
 
 void ConnectionManager::HandlePingFrom(const HandshakePacket& handshake_packet,
@@ -247,7 +406,31 @@ void ConnectionManager::HandlePingFrom(const HandshakePacket& handshake_packet,
     LOG(kWarning) << DebugId(kThisNodeId_) << " is handshaking with another local transport.";
     return;
   }
+  if (handshake_packet.SocketId() == 0) {
+    // Genuine requests always carry the sender's socket ID.  Without this check, another node's
+    // cookie (which has none) would be answered with a cookie, and so on back and forth.
+    LOG(kVerbose) << DebugId(kThisNodeId_) << " Ignoring handshake without socket ID from "
+                  << endpoint;
+    return;
+  }
   if (IsValid(endpoint)) {
+    if (handshake_packet.RudpVersion() < HandshakePacket::kSynCookieVersion) {
+      // An older node would mistake a cookie for the start of our session, so is either let
+      // through as it always was, or refused.
+      if (!Parameters::accept_legacy_connection_requests) {
+        LOG(kVerbose) << DebugId(kThisNodeId_) << " Refusing version "
+                      << handshake_packet.RudpVersion() << " connection request from " << endpoint;
+        return;
+      }
+    } else if (!syn_cookies_.Validate(handshake_packet.SynCookie(), endpoint,
+                                      handshake_packet.node_id(), handshake_packet.SocketId()) &&
+               !HasSessionTicket(handshake_packet, endpoint)) {
+      // No state is held for the peer until it proves that it can receive at "endpoint" by
+      // echoing a cookie, so a flood of requests from forged addresses costs just a hash and a
+      // reply each.
+      SendSynCookie(handshake_packet, endpoint);
+      return;
+    }
     // Check if this joining node is already connected
     ConnectionPtr joining_connection;
     bool bootstrap_and_drop(handshake_packet.ConnectionReason() == Session::kBootstrapAndDrop);
@@ -275,6 +458,35 @@ void ConnectionManager::HandlePingFrom(const HandshakePacket& handshake_packet,
   }
 }
 
+bool ConnectionManager::HasSessionTicket(const HandshakePacket& handshake_packet,
+                                         const Endpoint& endpoint) const {
+  // Such a ticket proves as much as an echoed cookie would.
+  SessionTicket ticket;
+  return handshake_packet.Resume() &&
+         SessionTickets::Instance().Redeem(kThisNodeId_, handshake_packet.node_id(),
+                                           handshake_packet.ResumptionTicket(),
+                                           handshake_packet.ResumptionTicketMac(), endpoint,
+                                           ticket);
+}
+
+void ConnectionManager::SendSynCookie(const HandshakePacket& handshake_packet,
+                                      const Endpoint& endpoint) {
+  // The reply is no larger than the request, so can't be used to amplify a flood.
+  HandshakePacket cookie_packet;
+  cookie_packet.SetRudpVersion(HandshakePacket::kRudpVersion);
+  cookie_packet.SetSocketType(HandshakePacket::kStreamSocketType);
+  cookie_packet.SetSocketId(0);
+  cookie_packet.set_node_id(kThisNodeId_);
+  cookie_packet.SetPeerEndpoint(endpoint);
+  cookie_packet.SetDestinationSocketId(handshake_packet.SocketId());
+  cookie_packet.SetConnectionType(1);
+  cookie_packet.SetConnectionReason(handshake_packet.ConnectionReason());
+  cookie_packet.SetSynCookie(syn_cookies_.Generate(endpoint, handshake_packet.node_id(),
+                                                   handshake_packet.SocketId()));
+  if (multiplexer_->SendTo(cookie_packet, endpoint) != kSuccess)
+    LOG(kWarning) << DebugId(kThisNodeId_) << " Failed to send SYN cookie to " << endpoint;
+}
+
 bool ConnectionManager::MakeConnectionPermanent(const NodeId& peer_id,
                                                 bool validated,
                                                 Endpoint& peer_endpoint) {
@@ -292,6 +504,15 @@ bool ConnectionManager::MakeConnectionPermanent(const NodeId& peer_id,
   return true;
 }
 
+bool ConnectionManager::GetStats(const NodeId& peer_id, ConnectionStats& stats) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(FindConnection(peer_id));
+  if (itr == connections_.end())
+    return false;
+  stats = (*itr)->Socket().StatsSnapshot();
+  return true;
+}
+
 Endpoint ConnectionManager::ThisEndpoint(const NodeId& peer_id) {
   std::lock_guard<std::mutex> lock(mutex_);
   auto itr(FindConnection(peer_id));
@@ -320,12 +541,22 @@ uint32_t ConnectionManager::AddSocket(Socket* socket) {
     id = RandomUint32();
 
   sockets_[id] = socket;
+  sockets_by_address_.insert(std::make_pair(socket->PeerEndpoint().address(), socket));
   return id;
 }
 
 void ConnectionManager::RemoveSocket(uint32_t id) {
-  if (id)
-    sockets_.erase(id);
+  auto socket_iter(sockets_.find(id));
+  if (id == 0 || socket_iter == sockets_.end())
+    return;
+  auto range(sockets_by_address_.equal_range(socket_iter->second->PeerEndpoint().address()));
+  for (auto itr(range.first); itr != range.second; ++itr) {
+    if (itr->second == socket_iter->second) {
+      sockets_by_address_.erase(itr);
+      break;
+    }
+  }
+  sockets_.erase(socket_iter);
 }
 
 size_t ConnectionManager::NormalConnectionsCount() const {
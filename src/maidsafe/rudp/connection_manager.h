@@ -26,18 +26,26 @@ License.
 #include <string>
 
 #include "boost/asio/buffer.hpp"
+#include "boost/asio/deadline_timer.hpp"
 #include "boost/asio/strand.hpp"
 #include "boost/asio/ip/udp.hpp"
 #include "boost/date_time/posix_time/posix_time_duration.hpp"
+#include "boost/date_time/posix_time/ptime.hpp"
+#include "boost/system/error_code.hpp"
 
 #include "maidsafe/common/node_id.h"
 #include "maidsafe/common/rsa.h"
 
+#include "maidsafe/rudp/core/syn_cookies.h"
+
 
 namespace maidsafe {
 
 namespace rudp {
 
+struct ConnectionStats;
+struct SendOptions;
+
 namespace detail {
 
 class Transport;
@@ -45,6 +53,7 @@ class Connection;
 class Multiplexer;
 class Socket;
 class HandshakePacket;
+class PingPacket;
 
 
 class ConnectionManager {
@@ -58,30 +67,43 @@ class ConnectionManager {
 
   void Close();
 
-  void Connect(const NodeId& peer_id,
-               const boost::asio::ip::udp::endpoint& peer_endpoint,
-               const std::string& validation_data,
-               const boost::posix_time::time_duration& connect_attempt_timeout,
-               const boost::posix_time::time_duration& lifespan,
-               const std::function<void()>& failure_functor = nullptr);
+  // Returns the connection making the attempt, or null if the transport has been destroyed.
+  std::shared_ptr<Connection> Connect(
+      const NodeId& peer_id,
+      const boost::asio::ip::udp::endpoint& peer_endpoint,
+      const std::string& validation_data,
+      const boost::posix_time::time_duration& connect_attempt_timeout,
+      const boost::posix_time::time_duration& lifespan,
+      const std::function<void()>& failure_functor = nullptr);
 
   int AddConnection(std::shared_ptr<Connection> connection);
   bool CloseConnection(const NodeId& peer_id);
   void RemoveConnection(std::shared_ptr<Connection> connection);
   std::shared_ptr<Connection> GetConnection(const NodeId& peer_id);
 
+  // Sends a PingPacket to peer_endpoint and invokes ping_functor with kSuccess if peer_id answers
+  // within Parameters::ping_timeout, otherwise with kPingFailed.  No connection is made.
   void Ping(const NodeId& peer_id,
             const boost::asio::ip::udp::endpoint& peer_endpoint,
             const std::function<void(int)> &ping_functor);  // NOLINT (Fraser)
   // Returns false if the connection doesn't exist.
   bool Send(const NodeId& peer_id,
             const std::string& message,
-            const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
+            const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
+            const SendOptions& options);
+  // Returns false if the connection doesn't exist.
+  bool SendDatagram(const NodeId& peer_id,
+                    const std::string& message,
+                    const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
 
   bool MakeConnectionPermanent(const NodeId& peer_id,
                                bool validated,
                                boost::asio::ip::udp::endpoint& peer_endpoint);
 
+  // Fills in "stats" for the connection to peer_id.  Returns false if the connection doesn't exist.
+  // The stats are the socket's latest snapshot, so this never waits on strand_.
+  bool GetStats(const NodeId& peer_id, ConnectionStats& stats);
+
   // This node's endpoint as viewed by peer
   boost::asio::ip::udp::endpoint ThisEndpoint(const NodeId& peer_id);
 
@@ -116,10 +138,40 @@ class ConnectionManager {
   typedef std::set<ConnectionPtr> ConnectionGroup;
   // Map of destination socket id to corresponding socket object.
   typedef std::unordered_map<uint32_t, Socket*> SocketMap;
+  // The same sockets keyed by their peer's address, so that those which an unsolicited handshake
+  // could be meant for are found without visiting every socket.  A socket's peer address doesn't
+  // change once added (UpdatePeerEndpoint only changes the port).
+  typedef std::multimap<boost::asio::ip::address, Socket*> SocketsByAddress;
+  struct OutstandingPing {
+    NodeId peer_id;
+    boost::asio::ip::udp::endpoint peer_endpoint;
+    boost::posix_time::ptime deadline;
+    std::function<void(int)> ping_functor;  // NOLINT (Fraser)
+  };
+  // Map of ping request sequence number to the ping awaiting a response.
+  typedef std::map<uint32_t, OutstandingPing> PingMap;
 
   void HandlePingFrom(const HandshakePacket& handshake_packet,
                       const boost::asio::ip::udp::endpoint& endpoint);
+  // Reply to an unsolicited connection request with the cookie which it must echo to be accepted.
+  void SendSynCookie(const HandshakePacket& handshake_packet,
+                     const boost::asio::ip::udp::endpoint& endpoint);
+  // Whether a request to resume a session presents a ticket this node issued to the peer at
+  // "endpoint", so needn't echo a cookie.
+  bool HasSessionTicket(const HandshakePacket& handshake_packet,
+                        const boost::asio::ip::udp::endpoint& endpoint) const;
   ConnectionGroup::iterator FindConnection(const NodeId& peer_id) const;
+  // Returns the first socket for a peer at "address" which satisfies "predicate", or nullptr.
+  template <typename Predicate>
+  Socket* FindSocket(const boost::asio::ip::address& address, Predicate predicate) const;
+  // These run on strand_.
+  void DoPing(const NodeId& peer_id,
+              const boost::asio::ip::udp::endpoint& peer_endpoint,
+              const std::function<void(int)>& ping_functor);  // NOLINT (Fraser)
+  void HandlePing(const PingPacket& ping_packet, const boost::asio::ip::udp::endpoint& endpoint);
+  void HandlePingTimeout(const std::weak_ptr<Transport>& transport,
+                         const boost::system::error_code& ec);
+  void FailOutstandingPings();
 
   // Because the connections can be in an idle state with no pending async operations, they are kept
   // alive with a shared_ptr in this set, as well as in the async operation handlers.
@@ -131,6 +183,12 @@ class ConnectionManager {
   const NodeId kThisNodeId_;
   std::shared_ptr<asymm::PublicKey> this_public_key_;
   SocketMap sockets_;
+  SocketsByAddress sockets_by_address_;
+  SynCookies syn_cookies_;
+  // Like sockets_, only accessed on strand_.  A single timer serves all of the outstanding pings.
+  PingMap pings_;
+  uint32_t ping_sequence_number_;
+  boost::asio::deadline_timer ping_timer_;
 };
 
 }  // namespace detail
@@ -0,0 +1,38 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/core/clock.h"
+
+#include "boost/asio/deadline_timer.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+Clock::NowFunctor Clock::now_functor_;
+
+boost::posix_time::ptime Clock::Now() {
+  return now_functor_ ? now_functor_() : boost::asio::deadline_timer::traits_type::now();
+}
+
+void Clock::SetNowFunctor(const NowFunctor& now_functor) { now_functor_ = now_functor; }
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
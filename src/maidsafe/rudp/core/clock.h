@@ -0,0 +1,52 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CORE_CLOCK_H_
+#define MAIDSAFE_RUDP_CORE_CLOCK_H_
+
+#include <functional>
+
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// The source of the current time for the protocol's timers and measurements.  By default this is
+// the clock used by asio's deadline_timer.  A simulation can substitute a virtual clock (see
+// NetworkEmulator) so that its runs are deterministic and needn't wait in real time.  The clock may
+// only be changed while no sockets exist.
+class Clock {
+ public:
+  typedef std::function<boost::posix_time::ptime()> NowFunctor;
+
+  static boost::posix_time::ptime Now();
+
+  // Use "now_functor" as the clock.  An empty functor restores the real clock.
+  static void SetNowFunctor(const NowFunctor& now_functor);
+
+ private:
+  static NowFunctor now_functor_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_CLOCK_H_
@@ -18,7 +18,6 @@ License.
 #include <algorithm>
 #include <cmath>
 #include <limits>
-#include <vector>
 
 #include "boost/assert.hpp"
 
@@ -33,6 +32,8 @@ namespace rudp {
 namespace detail {
 
 static const bptime::time_duration kSynPeriod = bptime::milliseconds(10);
+// Used in place of the round trip time until it has been measured.
+static const bptime::time_duration kDefaultDatagramPeriod = bptime::milliseconds(100);
 
 CongestionControl::CongestionControl()
   : slow_start_phase_(true),
@@ -50,12 +51,12 @@ CongestionControl::CongestionControl()
     ack_delay_(bptime::milliseconds(10)),
     ack_timeout_(Parameters::default_ack_timeout),
     ack_interval_(16),
-    lost_packets_(0),
-    corrupted_packets_(0),
-    arrival_times_(),
+    datagram_period_start_(),
+    datagrams_in_period_(0),
+    last_arrival_time_(),
+    arrival_intervals_(),
     packet_pair_intervals_(),
     peer_connection_type_(0),
-    allowed_lost_(0),
     transmitted_bytes_(std::numeric_limits<uintmax_t>::max()),
     bits_per_second_(0),
     last_record_transmit_time_() {}
@@ -64,6 +65,25 @@ void CongestionControl::OnOpen(uint32_t /*send_seqnum*/, uint32_t /*receive_seqn
   transmitted_bytes_ = std::numeric_limits<uintmax_t>::max();
 }
 
+void CongestionControl::OnResume(uint32_t round_trip_time,
+                                 uint32_t round_trip_time_variance,
+                                 uint32_t packets_receiving_rate,
+                                 uint32_t estimated_link_capacity,
+                                 size_t send_window_size) {
+  slow_start_phase_ = false;
+  round_trip_time_ = round_trip_time;
+  round_trip_time_variance_ = round_trip_time_variance;
+  packets_receiving_rate_ = packets_receiving_rate;
+  estimated_link_capacity_ = estimated_link_capacity;
+  send_window_size_ = std::min(std::max(send_window_size,
+                                        static_cast<size_t>(Parameters::default_window_size)),
+                               static_cast<size_t>(Parameters::maximum_window_size));
+
+  ack_delay_ = bptime::microseconds(UINT64_C(4) * round_trip_time_);
+  ack_delay_ += bptime::microseconds(round_trip_time_variance_);
+  ack_delay_ += kSynPeriod;
+}
+
 void CongestionControl::OnClose() {
   transmitted_bytes_ = std::numeric_limits<uintmax_t>::max();
 }
@@ -71,44 +91,35 @@ void CongestionControl::OnClose() {
 void CongestionControl::OnDataPacketSent(uint32_t /*seqnum*/) {
 }
 
+void CongestionControl::OnDatagramSent() {
+  DatagramsInFlight();
+  ++datagrams_in_period_;
+}
+
 void CongestionControl::OnDataPacketReceived(uint32_t seqnum) {
   bptime::ptime now = TickTimer::Now();
 
-  if ((seqnum % 16 == 1) && !arrival_times_.empty()) {
+  if (!last_arrival_time_.is_not_a_date_time()) {
+    // The clock isn't guaranteed to be monotonic, so treat a backwards step as a zero interval.
+    int64_t interval((now - last_arrival_time_).total_microseconds());
+    uint64_t interval_us(interval > 0 ? static_cast<uint64_t>(interval) : 0);
+    arrival_intervals_.Push(interval_us);
     // The pushed in interval is the interval between every 16 arrived packets
-    packet_pair_intervals_.push_back(now - arrival_times_.back());
-    while (packet_pair_intervals_.size() > kMaxPacketPairIntervals)
-      packet_pair_intervals_.pop_front();
+    if (seqnum % 16 == 1)
+      packet_pair_intervals_.Push(interval_us);
   }
 
-  arrival_times_.push_back(now);
-  while (arrival_times_.size() > kMaxArrivalTimes)
-    arrival_times_.pop_front();
+  last_arrival_time_ = now;
 }
 
 void CongestionControl::OnGenerateAck(uint32_t /*seqnum*/) {
-  // Need to have received at least 8 packets to calculate receiving rate.
-  if (arrival_times_.size() <= 8)
+  // Need to have received at least 8 packet arrival intervals to calculate receiving rate.
+  if (arrival_intervals_.Size() < 8)
     return;
 
-  // Calculate all packet arrival intervals.
-  std::vector<uint64_t> intervals;
-  for (auto iter = arrival_times_.begin() + 1; iter != arrival_times_.end(); ++iter)
-    intervals.push_back((*iter - *(iter - 1)).total_microseconds());
-
-  // Find the median packet arrival interval.
-  std::sort(intervals.begin(), intervals.end());
-  uint64_t median = intervals[intervals.size() / 2];
-
-  // Calculate average of all intervals in range (median / 8) to (median * 8).
-  size_t num_valid_intervals = 0;
-  uint64_t total = 0;
-  for (auto& item : intervals) {
-    if ((median / 8 <= item) && (item <= median * 8)) {
-      ++num_valid_intervals;
-      total += item;
-    }
-  }
+  // Calculate total of all intervals in range (median / 8) to (median * 8).
+  uint64_t total(0);
+  size_t num_valid_intervals(arrival_intervals_.SumAroundMedian(8, total));
 
   // Determine packet arrival speed only if we had more than 8 valid values.
   if ((total > 0) && (num_valid_intervals > 8)) {
@@ -121,15 +132,11 @@ void CongestionControl::OnGenerateAck(uint32_t /*seqnum*/) {
 
   // Need to have recorded some packet pair intervals to be able to calculate
   // the estimated link capacity.
-  if (!packet_pair_intervals_.empty()) {
+  if (!packet_pair_intervals_.IsEmpty()) {
     // Calculate the estimated link capacity by determining the median of the
     // packet pair intervals, and from that determining the number of packets
     // per second.
-    std::vector<uint64_t> packet_pair_intervals;
-    for (auto& item : packet_pair_intervals_)
-      packet_pair_intervals.push_back(item.total_microseconds());
-    std::sort(packet_pair_intervals.begin(), packet_pair_intervals.end());
-    uint64_t packet_pair_median = packet_pair_intervals[packet_pair_intervals.size() / 2];
+    uint64_t packet_pair_median = packet_pair_intervals_.Median();
     estimated_link_capacity_ =
         (packet_pair_median > 0) ? static_cast<uint32_t>(1000000 / packet_pair_median) : 0;
   }
@@ -172,18 +179,8 @@ void CongestionControl::OnAck(uint32_t /*seqnum*/,
     tmp = (tmp + estimated_link_capacity) / 8;
     estimated_link_capacity_ = static_cast<uint32_t>(tmp);
   }
-  // Each time an ack packet received, we check whether during this interval,
-  // any packet reported to be lost or corrupted. If none, increase size,
-  // otherwise decrease size
-  if ((corrupted_packets_ + lost_packets_) > AllowedLost()) {
-    send_data_size_ = static_cast<size_t>(0.9 * send_data_size_);
-    send_data_size_ = std::max(static_cast<size_t>(Parameters::default_data_size), send_data_size_);
-  } else {
-    send_data_size_ = static_cast<size_t>(1.5 * send_data_size_);
-    send_data_size_ = std::min(static_cast<size_t>(Parameters::max_data_size), send_data_size_);
-  }
-  corrupted_packets_ = 0;
-  lost_packets_ = 0;
+  // The send data size is no longer adjusted here based on loss; growing it blindly caused IP
+  // fragmentation.  It is set via SetSendDataSize() from the results of path MTU discovery.
   // If the other side still has some available buffer size, then the speed
   // can be increased this side. Otherwise, the sender's speed shall be reduced
   // To prevent osillator:
@@ -200,13 +197,9 @@ void CongestionControl::OnAck(uint32_t /*seqnum*/,
   }
 }
 
-void CongestionControl::OnNegativeAck(uint32_t /*seqnum*/) {
-  ++corrupted_packets_;
-}
+void CongestionControl::OnNegativeAck(uint32_t /*seqnum*/) {}
 
-void CongestionControl::OnSendTimeout(uint32_t /*seqnum*/) {
-  ++lost_packets_;
-}
+void CongestionControl::OnSendTimeout(uint32_t /*seqnum*/) {}
 
 void CongestionControl::OnAckOfAck(uint32_t round_trip_time) {
   uint32_t diff = (round_trip_time < round_trip_time_) ? (round_trip_time_ - round_trip_time) :
@@ -227,15 +220,6 @@ void CongestionControl::OnAckOfAck(uint32_t round_trip_time) {
 
 void CongestionControl::SetPeerConnectionType(uint32_t connection_type) {
   peer_connection_type_ = connection_type;
-  uint32_t local_connection_type = Parameters::connection_type;
-  uint32_t worst_connection_type = std::min(peer_connection_type_, local_connection_type);
-  if (worst_connection_type <= Parameters::kWireless) {
-    allowed_lost_ = 5;
-  } else if (worst_connection_type <= Parameters::kE1) {
-    allowed_lost_ = 2;
-  } else if (worst_connection_type <= Parameters::k1GEthernet) {
-    allowed_lost_ = 1;
-  }
 }
 
 bool CongestionControl::IsSlowTransmission(size_t /*length*/) {
@@ -262,10 +246,6 @@ bool CongestionControl::IsSlowTransmission(size_t /*length*/) {
   return false;
 }
 
-size_t CongestionControl::AllowedLost() const {
-  return allowed_lost_;
-}
-
 uint32_t CongestionControl::RoundTripTime() const {
   return round_trip_time_;
 }
@@ -294,6 +274,24 @@ size_t CongestionControl::SendDataSize() const {
   return send_data_size_;
 }
 
+size_t CongestionControl::DatagramsInFlight() {
+  bptime::ptime now(TickTimer::Now());
+  bptime::time_duration period(round_trip_time_ == 0 ? kDefaultDatagramPeriod :
+      bptime::microseconds(round_trip_time_ + round_trip_time_variance_));
+  if (datagram_period_start_.is_not_a_date_time() || now < datagram_period_start_ ||
+      now - datagram_period_start_ >= period) {
+    datagram_period_start_ = now;
+    datagrams_in_period_ = 0;
+  }
+  return datagrams_in_period_;
+}
+
+void CongestionControl::SetSendDataSize(size_t send_data_size) {
+  assert(send_data_size >= Parameters::default_data_size &&
+         send_data_size <= Parameters::max_data_size);
+  send_data_size_ = send_data_size;
+}
+
 int32_t CongestionControl::BestReadBufferSize() const {
   assert(static_cast<int32_t>(receive_window_size_ * Parameters::max_data_size) > 0);
   return static_cast<int32_t>(receive_window_size_ * Parameters::max_data_size);
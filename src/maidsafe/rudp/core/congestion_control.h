@@ -19,10 +19,10 @@ License.
 #define MAIDSAFE_RUDP_CORE_CONGESTION_CONTROL_H_
 
 #include <cstdint>
-#include <deque>
 
 #include "boost/date_time/posix_time/posix_time_types.hpp"
 
+#include "maidsafe/rudp/core/sample_ring_buffer.h"
 #include "maidsafe/rudp/core/sliding_window.h"
 #include "maidsafe/rudp/packets/data_packet.h"
 #include "maidsafe/rudp/core/tick_timer.h"
@@ -40,8 +40,16 @@ class CongestionControl {
 
   // Event notifications.
   void OnOpen(uint32_t send_seqnum, uint32_t receive_seqnum);
+  // Called after OnOpen when resuming an earlier session with the same peer, with the estimates
+  // from when it closed, so that they needn't be learned afresh.
+  void OnResume(uint32_t round_trip_time,
+                uint32_t round_trip_time_variance,
+                uint32_t packets_receiving_rate,
+                uint32_t estimated_link_capacity,
+                size_t send_window_size);
   void OnClose();
   void OnDataPacketSent(uint32_t seqnum);
+  void OnDatagramSent();
   void OnDataPacketReceived(uint32_t seqnum);
   void OnGenerateAck(uint32_t seqnum);
   void OnAck(uint32_t seqnum);
@@ -65,6 +73,11 @@ class CongestionControl {
   size_t SendWindowSize() const;
   size_t ReceiveWindowSize() const;
   size_t SendDataSize() const;
+  // Set from the result of path MTU discovery.
+  void SetSendDataSize(size_t send_data_size);
+  // Unreliable datagrams aren't held in the send window, so instead each one is charged against the
+  // window for a round trip after it's sent.  Returns the number currently charged.
+  size_t DatagramsInFlight();
   boost::posix_time::time_duration SendDelay() const;
   boost::posix_time::time_duration SendTimeout() const;
   boost::posix_time::time_duration ReceiveDelay() const;
@@ -79,7 +92,6 @@ class CongestionControl {
 
   // Connection type related
   void SetPeerConnectionType(uint32_t connection_type);
-  size_t AllowedLost() const;
 
   // Calculate if the transmission speed is too slow
   bool IsSlowTransmission(size_t length);
@@ -107,21 +119,22 @@ class CongestionControl {
   boost::posix_time::time_duration ack_timeout_;
   uint32_t ack_interval_;
 
-  size_t lost_packets_;
-  size_t corrupted_packets_;
+  // The datagrams sent since datagram_period_start_, which is reset once a round trip has passed.
+  boost::posix_time::ptime datagram_period_start_;
+  size_t datagrams_in_period_;
 
-  enum { kMaxArrivalTimes = 16 + 1 };
-  std::deque<boost::posix_time::ptime> arrival_times_;
+  // Intervals in microseconds between consecutive data packet arrivals.
+  enum { kMaxArrivalIntervals = 16 };
+  boost::posix_time::ptime last_arrival_time_;
+  SampleRingBuffer<uint64_t, kMaxArrivalIntervals> arrival_intervals_;
 
+  // Intervals in microseconds between the arrival of every 16th packet and its predecessor.
   enum { kMaxPacketPairIntervals = 16 + 1 };
-  std::deque<boost::posix_time::time_duration> packet_pair_intervals_;
+  SampleRingBuffer<uint64_t, kMaxPacketPairIntervals> packet_pair_intervals_;
 
   // The peer's connection type
   uint32_t peer_connection_type_;
 
-  // Allowed num of lost packets between two ack packets
-  size_t allowed_lost_;
-
   // Speed calculation related;
   uintmax_t transmitted_bytes_, bits_per_second_;
   boost::posix_time::ptime last_record_transmit_time_;
@@ -0,0 +1,299 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/core/fec.h"
+
+#include <algorithm>
+#include <cstring>
+
+// SSE2 (baseline on x86-64) and NEON are used whenever the compiler targets them.  AVX2 can't be
+// assumed on x86, so GCC and Clang builds compile an AVX2 version separately and pick it at runtime
+// if the CPU supports it.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define MAIDSAFE_RUDP_USE_SSE2
+#  include <emmintrin.h>
+#  if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define MAIDSAFE_RUDP_USE_AVX2
+#    include <immintrin.h>
+#  endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define MAIDSAFE_RUDP_USE_NEON
+#  include <arm_neon.h>
+#endif
+
+#include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/packets/fec_packet.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+// Number of packets sent between adjustments of the encoder's block size.
+const uint32_t kSamplePackets(256);
+// Number of consecutive samples with no losses before the encoder's block size is increased.
+const uint32_t kCleanSamplesToRelax(8);
+// Number of decoder accumulators kept, enough to cover two of the largest blocks.
+const size_t kMaxAccumulators(2 * kFecMaxBlockSize / kFecMinBlockSize);
+const uint32_t kMaxSequenceNumber(0x7fffffff);
+
+// The fields of a data packet needed to rebuild it, other than its data and sequence number.  This
+// is only used within repair packets, so needn't match the data packet's own encoding.
+uint32_t HeaderWord(const DataPacket& packet) {
+  return (packet.FirstPacketInMessage() ? 0x80000000 : 0) |
+         (packet.LastPacketInMessage() ? 0x40000000 : 0) |
+         (packet.InOrder() ? 0x20000000 : 0) |
+         (packet.MessageNumber() & 0x1fffffff);
+}
+
+void XorData(std::string& payload_xor, const std::string& data) {
+  if (payload_xor.size() < data.size())
+    payload_xor.resize(data.size(), '\0');
+  XorInto(reinterpret_cast<unsigned char*>(&payload_xor[0]),
+          reinterpret_cast<const unsigned char*>(data.data()), data.size());
+}
+
+typedef void (*XorFunction)(unsigned char*, const unsigned char*, size_t);
+
+void Xor128(unsigned char* destination, const unsigned char* source, size_t size) {
+  size_t i(0);
+#if defined(MAIDSAFE_RUDP_USE_SSE2)
+  for (; i + 16 <= size; i += 16) {
+    __m128i d(_mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + i)));
+    __m128i s(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_xor_si128(d, s));
+  }
+#elif defined(MAIDSAFE_RUDP_USE_NEON)
+  for (; i + 16 <= size; i += 16)
+    vst1q_u8(destination + i, veorq_u8(vld1q_u8(destination + i), vld1q_u8(source + i)));
+#endif
+  for (; i + 8 <= size; i += 8) {
+    uint64_t d, s;
+    std::memcpy(&d, destination + i, 8);
+    std::memcpy(&s, source + i, 8);
+    d ^= s;
+    std::memcpy(destination + i, &d, 8);
+  }
+  for (; i != size; ++i)
+    destination[i] ^= source[i];
+}
+
+#ifdef MAIDSAFE_RUDP_USE_AVX2
+__attribute__((target("avx2")))
+void Xor256(unsigned char* destination, const unsigned char* source, size_t size) {
+  size_t i(0);
+  for (; i + 32 <= size; i += 32) {
+    __m256i d(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + i)));
+    __m256i s(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_xor_si256(d, s));
+  }
+  Xor128(destination + i, source + i, size - i);
+}
+#endif
+
+XorFunction SelectXorFunction() {
+#ifdef MAIDSAFE_RUDP_USE_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return &Xor256;
+#endif
+  return &Xor128;
+}
+
+}  // unnamed namespace
+
+void XorInto(unsigned char* destination, const unsigned char* source, size_t size) {
+  static const XorFunction xor_function(SelectXorFunction());
+  xor_function(destination, source, size);
+}
+
+const char* XorInstructionSet() {
+#ifdef MAIDSAFE_RUDP_USE_AVX2
+  if (SelectXorFunction() == &Xor256)
+    return "AVX2";
+#endif
+#if defined(MAIDSAFE_RUDP_USE_SSE2)
+  return "SSE2";
+#elif defined(MAIDSAFE_RUDP_USE_NEON)
+  return "NEON";
+#else
+  return "64-bit words";
+#endif
+}
+
+FecEncoder::FecEncoder()
+    : target_block_size_(0),
+      block_size_(0),
+      first_sequence_number_(0),
+      next_sequence_number_(0),
+      count_(0),
+      length_xor_(0),
+      header_xor_(0),
+      payload_xor_(),
+      packets_sent_(0),
+      packets_lost_(0),
+      clean_samples_(0) {}
+
+bool FecEncoder::Add(const DataPacket& packet, size_t max_data_size, FecPacket& repair_packet) {
+  uint32_t sequence_number(packet.PacketSequenceNumber());
+  if (count_ != 0 && sequence_number != next_sequence_number_)
+    count_ = 0;
+  next_sequence_number_ = (sequence_number == kMaxSequenceNumber) ? 0 : sequence_number + 1;
+
+  if (++packets_sent_ == kSamplePackets)
+    Adapt();
+
+  if (packet.Data().size() > max_data_size) {
+    count_ = 0;
+    return false;
+  }
+
+  if (count_ == 0) {
+    // Start a new block only at a multiple of the block size.
+    block_size_ = target_block_size_;
+    if (block_size_ == 0 || sequence_number % block_size_ != 0)
+      return false;
+    first_sequence_number_ = sequence_number;
+    length_xor_ = 0;
+    header_xor_ = 0;
+    payload_xor_.clear();
+  }
+
+  length_xor_ ^= static_cast<uint16_t>(packet.Data().size());
+  header_xor_ ^= HeaderWord(packet);
+  XorData(payload_xor_, packet.Data());
+  if (++count_ != block_size_)
+    return false;
+
+  count_ = 0;
+  repair_packet.SetFirstSequenceNumber(first_sequence_number_);
+  repair_packet.SetBlockSize(static_cast<uint32_t>(block_size_));
+  repair_packet.SetLengthXor(length_xor_);
+  repair_packet.SetHeaderXor(header_xor_);
+  repair_packet.SetPayloadXor(payload_xor_);
+  return true;
+}
+
+void FecEncoder::OnPacketLost() { ++packets_lost_; }
+
+void FecEncoder::Adapt() {
+  if (packets_lost_ == 0) {
+    if (target_block_size_ != 0 && ++clean_samples_ >= kCleanSamplesToRelax) {
+      clean_samples_ = 0;
+      target_block_size_ *= 2;
+      if (target_block_size_ > kFecMaxBlockSize)
+        target_block_size_ = 0;
+    }
+  } else {
+    clean_samples_ = 0;
+    if (target_block_size_ == 0) {
+      // Start with blocks expected to suffer no more than one loss in four.
+      target_block_size_ = kFecMaxBlockSize;
+      while (target_block_size_ > kFecMinBlockSize &&
+             target_block_size_ * packets_lost_ * 4 > packets_sent_) {
+        target_block_size_ /= 2;
+      }
+    } else if (packets_lost_ > 1) {
+      target_block_size_ = std::max<size_t>(target_block_size_ / 2, kFecMinBlockSize);
+    }
+  }
+  packets_sent_ = packets_lost_ = 0;
+}
+
+FecDecoder::FecDecoder() : block_size_(0), accumulators_(), accumulator_order_() {}
+
+void FecDecoder::Add(const DataPacket& packet) {
+  uint32_t sequence_number(packet.PacketSequenceNumber());
+  uint32_t first(sequence_number - sequence_number % kFecMinBlockSize);
+  auto itr(accumulators_.find(first));
+  if (itr == accumulators_.end()) {
+    itr = accumulators_.insert(std::make_pair(first, Accumulator())).first;
+    accumulator_order_.push_back(first);
+    if (accumulator_order_.size() > kMaxAccumulators) {
+      accumulators_.erase(accumulator_order_.front());
+      accumulator_order_.pop_front();
+    }
+  }
+
+  Accumulator& accumulator(itr->second);
+  uint32_t bit(1U << (sequence_number - first));
+  if ((accumulator.received & bit) != 0)
+    return;
+  accumulator.received |= bit;
+  accumulator.length_xor ^= static_cast<uint16_t>(packet.Data().size());
+  accumulator.header_xor ^= HeaderWord(packet);
+  XorData(accumulator.payload_xor, packet.Data());
+}
+
+bool FecDecoder::Recover(const FecPacket& repair_packet, DataPacket& recovered_packet) {
+  uint32_t block_size(repair_packet.BlockSize());
+  uint32_t first(repair_packet.FirstSequenceNumber());
+  if (block_size < kFecMinBlockSize || block_size > kFecMaxBlockSize ||
+      (block_size & (block_size - 1)) != 0 || first > kMaxSequenceNumber ||
+      first % block_size != 0) {
+    return false;
+  }
+  block_size_ = block_size;
+
+  // XOR the repair packet with every packet received from the block, leaving the missing one.
+  uint16_t length_xor(repair_packet.LengthXor());
+  uint32_t header_xor(repair_packet.HeaderXor());
+  std::string payload_xor(repair_packet.PayloadXor());
+  size_t missing_count(0);
+  uint32_t missing(0);
+  for (uint32_t offset(0); offset != block_size; offset += kFecMinBlockSize) {
+    auto itr(accumulators_.find(first + offset));
+    uint32_t received(itr == accumulators_.end() ? 0 : itr->second.received);
+    for (uint32_t i(0); i != kFecMinBlockSize; ++i) {
+      if ((received & (1U << i)) == 0) {
+        ++missing_count;
+        missing = first + offset + i;
+      }
+    }
+    if (missing_count > 1)
+      return false;
+    if (itr != accumulators_.end()) {
+      const Accumulator& accumulator(itr->second);
+      if (accumulator.payload_xor.size() > payload_xor.size())
+        return false;
+      length_xor ^= accumulator.length_xor;
+      header_xor ^= accumulator.header_xor;
+      XorInto(reinterpret_cast<unsigned char*>(&payload_xor[0]),
+              reinterpret_cast<const unsigned char*>(accumulator.payload_xor.data()),
+              accumulator.payload_xor.size());
+    }
+  }
+  if (missing_count != 1 || length_xor == 0 || length_xor > payload_xor.size())
+    return false;
+
+  recovered_packet.SetPacketSequenceNumber(missing);
+  recovered_packet.SetFirstPacketInMessage((header_xor & 0x80000000) != 0);
+  recovered_packet.SetLastPacketInMessage((header_xor & 0x40000000) != 0);
+  recovered_packet.SetInOrder((header_xor & 0x20000000) != 0);
+  recovered_packet.SetMessageNumber(header_xor & 0x1fffffff);
+  recovered_packet.SetTimeStamp(0);
+  recovered_packet.SetDestinationSocketId(repair_packet.DestinationSocketId());
+  recovered_packet.SetData(payload_xor.begin(), payload_xor.begin() + length_xor);
+  return true;
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,129 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CORE_FEC_H_
+#define MAIDSAFE_RUDP_CORE_FEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+class DataPacket;
+class FecPacket;
+
+// XOR "size" bytes from "source" into "destination".  Uses AVX2 if the CPU supports it (chosen at
+// runtime), otherwise SSE2 or NEON where the compiler targets them.
+void XorInto(unsigned char* destination, const unsigned char* source, size_t size);
+
+// The widest instructions used by XorInto on this CPU, for reporting.
+const char* XorInstructionSet();
+
+// Forward error correction uses one XOR repair packet per block of consecutive data packets, which
+// lets the receiver rebuild a single lost packet per block.  Blocks are aligned to a multiple of
+// their size in the sequence number space, and sizes are powers of two, so a receiver can
+// accumulate packets in blocks of kMinBlockSize and combine them for a repair of any size.
+enum { kFecMinBlockSize = 4, kFecMaxBlockSize = 32 };
+
+// Builds repair packets for data packets as they are first sent.  The block size adapts to the
+// losses still seen (i.e. which FEC failed to repair): they make the blocks smaller, down to
+// kFecMinBlockSize, while a sustained absence of losses makes them larger until FEC is switched off
+// altogether.
+class FecEncoder {
+ public:
+  FecEncoder();
+
+  // The size of blocks being protected, or 0 if no repair packets are being sent.
+  size_t BlockSize() const { return target_block_size_; }
+
+  // Add a data packet which is being sent for the first time.  Packets must be added in sequence
+  // order; a gap abandons the current block, as does a packet with more than "max_data_size" bytes
+  // of data.  If the packet completes a block, returns true and sets all of "repair_packet" except
+  // its destination socket ID.
+  bool Add(const DataPacket& packet, size_t max_data_size, FecPacket& repair_packet);
+
+  // Record that a sent data packet was reported lost, i.e. will have to be retransmitted.
+  void OnPacketLost();
+
+ private:
+  // Disallow copying and assignment.
+  FecEncoder(const FecEncoder&);
+  FecEncoder& operator=(const FecEncoder&);
+
+  // Choose the block size for the next sample of packets.
+  void Adapt();
+
+  size_t target_block_size_, block_size_;
+  // The block being built: its first sequence number, the sequence number expected next, and how
+  // many packets it holds.
+  uint32_t first_sequence_number_, next_sequence_number_;
+  size_t count_;
+  uint16_t length_xor_;
+  uint32_t header_xor_;
+  std::string payload_xor_;
+  // Packets sent and lost in the current sample, and consecutive samples with no losses.
+  uint32_t packets_sent_, packets_lost_, clean_samples_;
+};
+
+// Rebuilds lost data packets from repair packets and the data packets received alongside them.
+class FecDecoder {
+ public:
+  FecDecoder();
+
+  // The size of the block covered by the latest repair packet, or 0 if none has arrived.
+  size_t BlockSize() const { return block_size_; }
+
+  // Add a data packet received for the first time.
+  void Add(const DataPacket& packet);
+
+  // If exactly one data packet covered by "repair_packet" is missing, rebuilds it as
+  // "recovered_packet" and returns true.
+  bool Recover(const FecPacket& repair_packet, DataPacket& recovered_packet);
+
+ private:
+  // Disallow copying and assignment.
+  FecDecoder(const FecDecoder&);
+  FecDecoder& operator=(const FecDecoder&);
+
+  // The XOR of the packets received in a block of kFecMinBlockSize.
+  struct Accumulator {
+    Accumulator() : received(0), length_xor(0), header_xor(0), payload_xor() {}
+    uint32_t received;  // Bit i is set if the block's ith packet has been added.
+    uint16_t length_xor;
+    uint32_t header_xor;
+    std::string payload_xor;
+  };
+
+  size_t block_size_;
+  // Indexed by first sequence number.  Only the most recent are kept, and the order in which they
+  // were created is used to discard the oldest.
+  std::map<uint32_t, Accumulator> accumulators_;
+  std::deque<uint32_t> accumulator_order_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_FEC_H_
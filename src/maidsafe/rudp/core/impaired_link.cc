@@ -0,0 +1,73 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/core/impaired_link.h"
+
+#include <algorithm>
+
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+ImpairedLink::ImpairedLink()
+    : conditions_(), busy_until_(bptime::neg_infin), in_loss_burst_(false) {}
+
+void ImpairedLink::SetConditions(const LinkConditions& conditions) { conditions_ = conditions; }
+
+ImpairedLink::Result ImpairedLink::Transmit(const bptime::ptime& now, size_t size,
+                                            std::mt19937& generator, bptime::ptime& arrival_time) {
+  if (in_loss_burst_) {
+    in_loss_burst_ = !std::bernoulli_distribution(conditions_.burst_loss_end)(generator);
+    return Result::kLost;
+  }
+  if (conditions_.burst_loss_start > 0.0 &&
+      std::bernoulli_distribution(conditions_.burst_loss_start)(generator)) {
+    in_loss_burst_ = !std::bernoulli_distribution(conditions_.burst_loss_end)(generator);
+    return Result::kLost;
+  }
+  if (conditions_.loss > 0.0 && std::bernoulli_distribution(conditions_.loss)(generator))
+    return Result::kLost;
+
+  bptime::ptime departure(now);
+  if (conditions_.bandwidth != 0) {
+    bptime::ptime start(std::max(now, busy_until_));
+    uint64_t queued_bytes((start - now).total_microseconds() * conditions_.bandwidth / 1000000);
+    if (conditions_.queue_size != 0 && queued_bytes + size > conditions_.queue_size)
+      return Result::kQueueFull;
+    departure = start + bptime::microseconds(size * 1000000 / conditions_.bandwidth);
+    busy_until_ = departure;
+  }
+
+  arrival_time = departure + conditions_.delay;
+  if (conditions_.jitter.total_microseconds() > 0) {
+    arrival_time += bptime::microseconds(std::uniform_int_distribution<int64_t>(
+        0, conditions_.jitter.total_microseconds())(generator));
+  }
+  if (conditions_.reordering > 0.0 &&
+      std::bernoulli_distribution(conditions_.reordering)(generator)) {
+    arrival_time += conditions_.delay;
+  }
+  return Result::kDelivered;
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
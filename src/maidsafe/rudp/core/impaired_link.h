@@ -0,0 +1,90 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CORE_IMPAIRED_LINK_H_
+#define MAIDSAFE_RUDP_CORE_IMPAIRED_LINK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Impairments applied to packets travelling one way between two endpoints.
+struct LinkConditions {
+  LinkConditions()
+      : bandwidth(0),
+        queue_size(0),
+        delay(boost::posix_time::time_duration()),
+        jitter(boost::posix_time::time_duration()),
+        loss(0.0),
+        burst_loss_start(0.0),
+        burst_loss_end(1.0),
+        reordering(0.0) {}
+  // Bytes per second, or 0 for unlimited.  Packets are sent one at a time at this rate.
+  uint64_t bandwidth;
+  // Bytes which may be waiting to be sent before further packets are dropped, or 0 for unlimited.
+  uint64_t queue_size;
+  // Propagation delay, plus a random extra delay of up to "jitter".
+  boost::posix_time::time_duration delay, jitter;
+  // Probability of a packet being lost independently of any other.
+  double loss;
+  // Bursty loss, following the Gilbert model: each packet has a probability of "burst_loss_start"
+  // of starting a burst, during which every packet is lost.  After each lost packet, the burst ends
+  // with a probability of "burst_loss_end", so bursts average 1 / burst_loss_end packets.
+  double burst_loss_start, burst_loss_end;
+  // Probability of a packet being held back by a further "delay", so that it arrives after packets
+  // sent after it.
+  double reordering;
+};
+
+// The state of one direction of a link with the given conditions, deciding the fate of each packet
+// offered to it.  All random decisions are taken from the generator passed in, so that a caller
+// with a seeded generator gets reproducible results.
+class ImpairedLink {
+ public:
+  enum class Result { kDelivered, kLost, kQueueFull };
+
+  ImpairedLink();
+
+  // Changing the conditions keeps the packets already queued and any loss burst in progress.
+  const LinkConditions& Conditions() const { return conditions_; }
+  void SetConditions(const LinkConditions& conditions);
+
+  // Offer a packet of "size" bytes to the link at time "now".  If it is delivered, "arrival_time"
+  // is set to when it reaches the far end.
+  Result Transmit(const boost::posix_time::ptime& now, size_t size, std::mt19937& generator,
+                  boost::posix_time::ptime& arrival_time);
+
+ private:
+  LinkConditions conditions_;
+  // When the last packet queued will have been sent.
+  boost::posix_time::ptime busy_until_;
+  bool in_loss_burst_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_IMPAIRED_LINK_H_
@@ -0,0 +1,264 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/core/metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+void AddCounter(MetricsSnapshot& snapshot, const std::string& name, uint64_t value) {
+  snapshot.counters[name] += value;
+}
+
+}  // unnamed namespace
+
+Histogram::Histogram()
+    : buckets_(),
+      count_(0),
+      sum_(0),
+      min_(std::numeric_limits<uint64_t>::max()),
+      max_(0) {
+  for (auto& bucket : buckets_)
+    bucket.store(0);
+}
+
+size_t Histogram::BucketIndex(uint64_t value) {
+  if (value < kSubBuckets)
+    return static_cast<size_t>(value);
+  size_t most_significant_bit(kSubBucketBits);
+  while (most_significant_bit != 63 && (value >> (most_significant_bit + 1)) != 0)
+    ++most_significant_bit;
+  // Shift the value so that it lies in [kSubBuckets / 2, kSubBuckets).
+  size_t shift(most_significant_bit - kSubBucketBits + 1);
+  return kSubBuckets + (shift - 1) * (kSubBuckets / 2) +
+         static_cast<size_t>((value >> shift) - kSubBuckets / 2);
+}
+
+uint64_t Histogram::BucketUpperBound(size_t index) {
+  if (index < kSubBuckets)
+    return index;
+  size_t shift((index - kSubBuckets) / (kSubBuckets / 2) + 1);
+  uint64_t sub_bucket((index - kSubBuckets) % (kSubBuckets / 2) + kSubBuckets / 2);
+  if (shift + kSubBucketBits > 64)
+    return std::numeric_limits<uint64_t>::max();
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+void Histogram::Record(uint64_t value) {
+  buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t current(min_.load(std::memory_order_relaxed));
+  while (value < current && !min_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+  }
+  current = max_.load(std::memory_order_relaxed);
+  while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+  }
+}
+
+void Histogram::Record(const bptime::time_duration& duration) {
+  Record(duration.is_negative() ? 0 : static_cast<uint64_t>(duration.total_microseconds()));
+}
+
+void Histogram::RecordSince(const std::chrono::steady_clock::time_point& start) {
+  auto elapsed(std::chrono::steady_clock::now() - start);
+  Record(static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+}
+
+HistogramSnapshot Histogram::Snapshot() const {
+  // The fields are read separately, so a snapshot taken while values are being recorded may be
+  // slightly inconsistent.  The count is taken from the buckets so that percentiles add up.
+  HistogramSnapshot snapshot;
+  for (size_t i(0); i != kBucketCount; ++i) {
+    uint64_t count(buckets_[i].load(std::memory_order_relaxed));
+    if (count != 0) {
+      snapshot.buckets.push_back(std::make_pair(BucketUpperBound(i), count));
+      snapshot.count += count;
+    }
+  }
+  if (snapshot.count != 0) {
+    snapshot.sum = sum_.load(std::memory_order_relaxed);
+    snapshot.min = min_.load(std::memory_order_relaxed);
+    snapshot.max = max_.load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
+
+MultiplexerMetrics::MultiplexerMetrics()
+    : packets_in(),
+      bytes_in(),
+      packets_out(),
+      bytes_out(),
+      dispatch_iterations(),
+      mutex_(),
+      label_() {}
+
+MultiplexerMetrics::~MultiplexerMetrics() { Metrics::Instance().Retire(*this); }
+
+void MultiplexerMetrics::SetLabel(const std::string& label) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  label_ = label;
+}
+
+std::string MultiplexerMetrics::Label() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return label_;
+}
+
+Metrics& Metrics::Instance() {
+  // Never destroyed, since multiplexers may outlive other statics.
+  static Metrics* metrics(new Metrics);
+  return *metrics;
+}
+
+Metrics::Metrics()
+    : decode_failures(),
+      handshake_duration(),
+      message_latency(),
+      encryption_time(),
+      decryption_time(),
+      callback_delay(),
+      mutex_(),
+      multiplexers_(),
+      next_multiplexer_id_(0),
+      retired_packets_in_(),
+      retired_bytes_in_(),
+      retired_packets_out_(),
+      retired_bytes_out_(),
+      retired_dispatch_iterations_() {}
+
+std::shared_ptr<MultiplexerMetrics> Metrics::AddMultiplexer() {
+  std::shared_ptr<MultiplexerMetrics> multiplexer_metrics(std::make_shared<MultiplexerMetrics>());
+  std::lock_guard<std::mutex> lock(mutex_);
+  multiplexer_metrics->SetLabel("#" + std::to_string(next_multiplexer_id_++));
+  multiplexers_.erase(std::remove_if(multiplexers_.begin(), multiplexers_.end(),
+                                     [](const std::weak_ptr<MultiplexerMetrics>& multiplexer) {
+                                       return multiplexer.expired();
+                                     }),
+                      multiplexers_.end());
+  multiplexers_.push_back(multiplexer_metrics);
+  return multiplexer_metrics;
+}
+
+void Metrics::Retire(const MultiplexerMetrics& multiplexer_metrics) {
+  retired_packets_in_.Add(multiplexer_metrics.packets_in.Value());
+  retired_bytes_in_.Add(multiplexer_metrics.bytes_in.Value());
+  retired_packets_out_.Add(multiplexer_metrics.packets_out.Value());
+  retired_bytes_out_.Add(multiplexer_metrics.bytes_out.Value());
+  retired_dispatch_iterations_.Add(multiplexer_metrics.dispatch_iterations.Value());
+}
+
+MetricsSnapshot Metrics::Snapshot() const {
+  MetricsSnapshot snapshot;
+  AddCounter(snapshot, "packets_in", retired_packets_in_.Value());
+  AddCounter(snapshot, "bytes_in", retired_bytes_in_.Value());
+  AddCounter(snapshot, "packets_out", retired_packets_out_.Value());
+  AddCounter(snapshot, "bytes_out", retired_bytes_out_.Value());
+  AddCounter(snapshot, "dispatch_iterations", retired_dispatch_iterations_.Value());
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& weak_multiplexer : multiplexers_) {
+      std::shared_ptr<MultiplexerMetrics> multiplexer(weak_multiplexer.lock());
+      if (!multiplexer)
+        continue;
+      const std::string kPrefix("multiplexer." + multiplexer->Label() + ".");
+      const std::pair<const char*, const Counter*> kCounters[] = {
+        std::make_pair("packets_in", &multiplexer->packets_in),
+        std::make_pair("bytes_in", &multiplexer->bytes_in),
+        std::make_pair("packets_out", &multiplexer->packets_out),
+        std::make_pair("bytes_out", &multiplexer->bytes_out),
+        std::make_pair("dispatch_iterations", &multiplexer->dispatch_iterations)
+      };
+      for (const auto& counter : kCounters) {
+        uint64_t value(counter.second->Value());
+        AddCounter(snapshot, counter.first, value);
+        AddCounter(snapshot, kPrefix + counter.first, value);
+      }
+    }
+  }
+  AddCounter(snapshot, "decode_failures", decode_failures.Value());
+
+  snapshot.histograms["handshake_duration"] = handshake_duration.Snapshot();
+  snapshot.histograms["message_latency"] = message_latency.Snapshot();
+  snapshot.histograms["encryption_time"] = encryption_time.Snapshot();
+  snapshot.histograms["decryption_time"] = decryption_time.Snapshot();
+  snapshot.histograms["callback_delay"] = callback_delay.Snapshot();
+  return snapshot;
+}
+
+}  // namespace detail
+
+uint64_t HistogramSnapshot::Percentile(double percentile) const {
+  if (count == 0)
+    return 0;
+  uint64_t rank(static_cast<uint64_t>(std::ceil(std::max(0.0, std::min(percentile, 100.0)) *
+                                                count / 100.0)));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen(0);
+  for (const auto& bucket : buckets) {
+    seen += bucket.second;
+    if (seen >= rank)
+      return std::min(std::max(bucket.first, min), max);
+  }
+  return max;
+}
+
+MetricsSnapshot GetMetrics() { return detail::Metrics::Instance().Snapshot(); }
+
+MetricsReporter::MetricsReporter(MetricsFunctor metrics_functor, bptime::time_duration interval)
+    : metrics_functor_(metrics_functor),
+      interval_(interval),
+      mutex_(),
+      cond_var_(),
+      stopped_(false),
+      thread_([this] { Run(); }) {}
+
+MetricsReporter::~MetricsReporter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  cond_var_.notify_one();
+  thread_.join();
+}
+
+void MetricsReporter::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    if (cond_var_.wait_for(lock, std::chrono::microseconds(interval_.total_microseconds()),
+                           [this] { return stopped_; })) {
+      return;
+    }
+    lock.unlock();
+    metrics_functor_(GetMetrics());
+    lock.lock();
+  }
+}
+
+}  // namespace rudp
+
+}  // namespace maidsafe
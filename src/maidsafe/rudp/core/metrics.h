@@ -0,0 +1,139 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CORE_METRICS_H_
+#define MAIDSAFE_RUDP_CORE_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "boost/date_time/posix_time/posix_time_duration.hpp"
+
+#include "maidsafe/rudp/metrics.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+class Counter {
+ public:
+  Counter() : value_(0) {}
+  void Add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  Counter(const Counter&);
+  Counter& operator=(const Counter&);
+
+  std::atomic<uint64_t> value_;
+};
+
+// A log-linear histogram in the style of HdrHistogram.  Values below kSubBuckets have a bucket
+// each; above that, each power of two is split into kSubBuckets / 2 equal buckets.  Recording is
+// lock-free and allocates nothing.
+class Histogram {
+ public:
+  enum {
+    kSubBucketBits = 4,
+    kSubBuckets = 1 << kSubBucketBits,
+    kBucketCount = kSubBuckets + (64 - kSubBucketBits) * (kSubBuckets / 2)
+  };
+
+  Histogram();
+
+  void Record(uint64_t value);
+  // Records the duration in microseconds.  Negative durations are recorded as 0.
+  void Record(const boost::posix_time::time_duration& duration);
+  void RecordSince(const std::chrono::steady_clock::time_point& start);
+
+  HistogramSnapshot Snapshot() const;
+
+  static size_t BucketIndex(uint64_t value);
+  // The largest value held by the bucket.
+  static uint64_t BucketUpperBound(size_t index);
+
+ private:
+  Histogram(const Histogram&);
+  Histogram& operator=(const Histogram&);
+
+  std::array<std::atomic<uint64_t>, kBucketCount> buckets_;
+  std::atomic<uint64_t> count_, sum_, min_, max_;
+};
+
+// The counters of a single multiplexer.  When destroyed, its counts are kept in the process totals.
+class MultiplexerMetrics {
+ public:
+  MultiplexerMetrics();
+  ~MultiplexerMetrics();
+
+  // Identifies the multiplexer in metric names; the local endpoint once it is open.
+  void SetLabel(const std::string& label);
+  std::string Label() const;
+
+  Counter packets_in, bytes_in, packets_out, bytes_out, dispatch_iterations;
+
+ private:
+  MultiplexerMetrics(const MultiplexerMetrics&);
+  MultiplexerMetrics& operator=(const MultiplexerMetrics&);
+
+  mutable std::mutex mutex_;
+  std::string label_;
+};
+
+// The process-wide registry.
+class Metrics {
+ public:
+  static Metrics& Instance();
+
+  // Creates the counters for a new multiplexer, which are included in snapshots while they exist.
+  std::shared_ptr<MultiplexerMetrics> AddMultiplexer();
+
+  MetricsSnapshot Snapshot() const;
+
+  Counter decode_failures;
+  Histogram handshake_duration, message_latency, encryption_time, decryption_time, callback_delay;
+
+ private:
+  friend class MultiplexerMetrics;
+
+  Metrics();
+  Metrics(const Metrics&);
+  Metrics& operator=(const Metrics&);
+
+  // Adds the counts of a multiplexer being destroyed to the retired totals.
+  void Retire(const MultiplexerMetrics& multiplexer_metrics);
+
+  mutable std::mutex mutex_;
+  std::vector<std::weak_ptr<MultiplexerMetrics>> multiplexers_;
+  uint32_t next_multiplexer_id_;
+  Counter retired_packets_in_, retired_bytes_in_, retired_packets_out_, retired_bytes_out_,
+          retired_dispatch_iterations_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_METRICS_H_
@@ -19,6 +19,9 @@ License.
 #include "maidsafe/rudp/core/multiplexer.h"
 
 #include <cassert>
+#include <string>
+
+#include "boost/lexical_cast.hpp"
 
 #include "maidsafe/rudp/managed_connections.h"
 #include "maidsafe/rudp/packets/packet.h"
@@ -42,7 +45,10 @@ Multiplexer::Multiplexer(asio::io_service& asio_service)
       dispatcher_(),
       external_endpoint_(),
       best_guess_external_endpoint_(),
-      mutex_() {}
+      mutex_(),
+      metrics_(Metrics::Instance().AddMultiplexer()),
+      emulator_(nullptr),
+      emulated_endpoint_() {}
 
 ReturnCode Multiplexer::Open(const ip::udp::endpoint& endpoint) {
   if (socket_.is_open()) {
@@ -73,8 +79,10 @@ ReturnCode Multiplexer::Open(const ip::udp::endpoint& endpoint) {
   if (endpoint.port() == 0U) {
     // Try to bind to Resilience port first. If this fails, just fall back to port 0 (i.e. any port)
     socket_.bind(ip::udp::endpoint(endpoint.address(), ManagedConnections::kResiliencePort()), ec);
-    if (!ec)
+    if (!ec) {
+      metrics_->SetLabel(boost::lexical_cast<std::string>(local_endpoint()));
       return kSuccess;
+    }
   }
 
   socket_.bind(endpoint, ec);
@@ -84,14 +92,23 @@ ReturnCode Multiplexer::Open(const ip::udp::endpoint& endpoint) {
     return kBindError;
   }
 
+  metrics_->SetLabel(boost::lexical_cast<std::string>(local_endpoint()));
   return kSuccess;
 }
 
 bool Multiplexer::IsOpen() const {
-  return socket_.is_open();
+  return socket_.is_open() || emulator_ != nullptr;
+}
+
+void Multiplexer::UseEmulator(NetworkEmulator& emulator, const ip::udp::endpoint& endpoint) {
+  assert(!socket_.is_open());
+  emulator_ = &emulator;
+  emulated_endpoint_ = endpoint;
+  metrics_->SetLabel(boost::lexical_cast<std::string>(endpoint));
 }
 
 void Multiplexer::Close() {
+  emulator_ = nullptr;
   bs::error_code ec;
   socket_.close(ec);
   if (ec)
@@ -103,6 +120,8 @@ void Multiplexer::Close() {
 }
 
 ip::udp::endpoint Multiplexer::local_endpoint() const {
+  if (emulator_)
+    return emulated_endpoint_;
   boost::system::error_code ec;
   ip::udp::endpoint local_endpoint(socket_.local_endpoint(ec));
   if (ec) {
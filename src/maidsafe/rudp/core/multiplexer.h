@@ -19,6 +19,7 @@ License.
 #define MAIDSAFE_RUDP_CORE_MULTIPLEXER_H_
 
 #include <array>  // NOLINT
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -29,6 +30,8 @@ License.
 
 #include "maidsafe/rudp/operations/dispatch_op.h"
 #include "maidsafe/rudp/core/dispatcher.h"
+#include "maidsafe/rudp/core/metrics.h"
+#include "maidsafe/rudp/core/network_emulator.h"
 #include "maidsafe/rudp/packets/packet.h"
 #include "maidsafe/rudp/parameters.h"
 #include "maidsafe/rudp/return_codes.h"
@@ -55,14 +58,21 @@ class Multiplexer {
   // Close the multiplexer.
   void Close();
 
+  // Send packets through "emulator" as though from "endpoint", rather than through a UDP socket.
+  // Packets sent to "endpoint" go to whatever is attached to it in the emulator.  The multiplexer
+  // is then treated as open, with "endpoint" as its local endpoint, until closed.
+  void UseEmulator(NetworkEmulator& emulator, const boost::asio::ip::udp::endpoint& endpoint);
+
   // Asynchronously receive a single packet and dispatch it.
   template <typename DispatchHandler>
   void AsyncDispatch(DispatchHandler handler) {
+    metrics_->dispatch_iterations.Add();
     DispatchOp<DispatchHandler> op(handler,
                                    socket_,
                                    boost::asio::buffer(receive_buffer_),
                                    sender_endpoint_,
-                                   dispatcher_);
+                                   dispatcher_,
+                                   *metrics_);
     socket_.async_receive_from(boost::asio::buffer(receive_buffer_), sender_endpoint_, 0, op);
   }
 
@@ -73,6 +83,13 @@ class Multiplexer {
     std::array<unsigned char, Parameters::kUDPPayload> data;
     auto buffer = boost::asio::buffer(&data[0], Parameters::max_size);
     if (size_t length = packet.Encode(buffer)) {
+      if (emulator_) {
+        ReturnCode result(
+            emulator_->Send(emulated_endpoint_, endpoint, boost::asio::buffer(buffer, length)));
+        if (result == kSuccess)
+          CountSent(length);
+        return result;
+      }
       boost::system::error_code ec;
       socket_.send_to(boost::asio::buffer(buffer, length), endpoint, 0, ec);
       if (ec) {
@@ -84,6 +101,7 @@ class Multiplexer {
 #endif
         return kSendFailure;
       } else {
+        CountSent(length);
         return kSuccess;
       }
     }
@@ -103,6 +121,11 @@ class Multiplexer {
   Multiplexer(const Multiplexer&);
   Multiplexer& operator=(const Multiplexer&);
 
+  void CountSent(size_t length) {
+    metrics_->packets_out.Add();
+    metrics_->bytes_out.Add(length);
+  }
+
   // The UDP socket used for all RUDP protocol communication.
   boost::asio::ip::udp::socket socket_;
 
@@ -122,6 +145,13 @@ class Multiplexer {
 
   // Mutex to protect access to external_endpoint_.
   mutable std::mutex mutex_;
+
+  // Packet counts, reported by GetMetrics.
+  std::shared_ptr<MultiplexerMetrics> metrics_;
+
+  // If set, used in place of socket_.
+  NetworkEmulator* emulator_;
+  boost::asio::ip::udp::endpoint emulated_endpoint_;
 };
 
 }  // namespace detail
@@ -0,0 +1,158 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/core/network_emulator.h"
+
+#include <algorithm>
+
+#include "boost/date_time/gregorian/gregorian_types.hpp"
+
+#include "maidsafe/rudp/core/clock.h"
+#include "maidsafe/rudp/core/tick_timer.h"
+
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+NetworkEmulator::NetworkEmulator(uint32_t seed)
+    : now_(boost::gregorian::date(2000, 1, 1)),
+      generator_(seed),
+      default_conditions_(),
+      link_conditions_(),
+      links_(),
+      receive_functors_(),
+      timers_(),
+      deliveries_(),
+      next_order_(0),
+      packets_sent_(0),
+      packets_lost_(0) {
+  Clock::SetNowFunctor([this] { return now_; });  // NOLINT (Fraser)
+}
+
+NetworkEmulator::~NetworkEmulator() { Clock::SetNowFunctor(Clock::NowFunctor()); }
+
+bptime::ptime NetworkEmulator::Now() const { return now_; }
+
+void NetworkEmulator::SetDefaultLinkConditions(const LinkConditions& conditions) {
+  default_conditions_ = conditions;
+}
+
+void NetworkEmulator::SetLinkConditions(const ip::udp::endpoint& source,
+                                        const ip::udp::endpoint& destination,
+                                        const LinkConditions& conditions) {
+  link_conditions_[std::make_pair(source, destination)] = conditions;
+}
+
+void NetworkEmulator::Attach(const ip::udp::endpoint& endpoint,
+                             const ReceiveFunctor& receive_functor) {
+  receive_functors_[endpoint] = receive_functor;
+}
+
+void NetworkEmulator::Detach(const ip::udp::endpoint& endpoint) {
+  receive_functors_.erase(endpoint);
+}
+
+void NetworkEmulator::AddTickTimer(TickTimer& tick_timer,
+                                   const std::function<void()>& tick_handler) {  // NOLINT (Fraser)
+  Timer timer = { &tick_timer, tick_handler };
+  timers_.push_back(timer);
+}
+
+ReturnCode NetworkEmulator::Send(const ip::udp::endpoint& source,
+                                 const ip::udp::endpoint& destination,
+                                 const asio::const_buffer& data) {
+  ++packets_sent_;
+  LinkId link_id(source, destination);
+  auto conditions_itr(link_conditions_.find(link_id));
+  ImpairedLink& link(links_[link_id]);
+  link.SetConditions(conditions_itr == link_conditions_.end() ? default_conditions_ :
+                                                                conditions_itr->second);
+  Delivery delivery;
+  if (link.Transmit(now_, asio::buffer_size(data), generator_, delivery.time) !=
+      ImpairedLink::Result::kDelivered) {
+    ++packets_lost_;
+    return kSuccess;
+  }
+  delivery.order = next_order_++;
+  delivery.source = source;
+  delivery.destination = destination;
+  const unsigned char* begin(asio::buffer_cast<const unsigned char*>(data));
+  delivery.data.assign(begin, begin + asio::buffer_size(data));
+  deliveries_.push(delivery);
+  return kSuccess;
+}
+
+void NetworkEmulator::RunFor(const bptime::time_duration& duration) {
+  bptime::ptime limit(now_ + duration);
+  while (RunOne(limit)) {}
+}
+
+bool NetworkEmulator::RunUntil(const std::function<bool()>& done,  // NOLINT (Fraser)
+                               const bptime::time_duration& limit) {
+  bptime::ptime end(now_ + limit);
+  while (!done()) {
+    if (!RunOne(end))
+      return done();
+  }
+  return true;
+}
+
+bool NetworkEmulator::RunOne(const bptime::ptime& limit) {
+  // Deliveries go before timers due at the same time.
+  bptime::ptime event_time(bptime::pos_infin);
+  Timer* timer(nullptr);
+  for (auto& candidate : timers_) {
+    if (candidate.tick_timer->ExpiresAt() < event_time) {
+      event_time = candidate.tick_timer->ExpiresAt();
+      timer = &candidate;
+    }
+  }
+  if (!deliveries_.empty() && deliveries_.top().time <= event_time) {
+    event_time = deliveries_.top().time;
+    timer = nullptr;
+  }
+
+  if (event_time.is_special() || event_time > limit) {
+    now_ = std::max(now_, limit);
+    return false;
+  }
+  now_ = std::max(now_, event_time);
+
+  if (timer) {
+    timer->tick_timer->Reset();
+    // Copied, since the handler may add timers.
+    std::function<void()> tick_handler(timer->tick_handler);  // NOLINT (Fraser)
+    tick_handler();
+  } else {
+    Delivery delivery(deliveries_.top());
+    deliveries_.pop();
+    auto itr(receive_functors_.find(delivery.destination));
+    if (itr != receive_functors_.end())
+      itr->second(asio::buffer(delivery.data), delivery.source);
+  }
+  return true;
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
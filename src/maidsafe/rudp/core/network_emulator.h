@@ -0,0 +1,136 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CORE_NETWORK_EMULATOR_H_
+#define MAIDSAFE_RUDP_CORE_NETWORK_EMULATOR_H_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/ip/udp.hpp"
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+#include "maidsafe/rudp/core/impaired_link.h"
+#include "maidsafe/rudp/return_codes.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+class TickTimer;
+
+// An in-process network running on a virtual clock.  Packets sent between attached endpoints are
+// delayed, reordered or lost according to the conditions of the link, all decided by a seeded
+// random number generator, so a run is exactly reproducible.  Time only advances as Run* processes
+// events, so a simulation runs as fast as it can be computed.
+//
+// While an emulator exists, it is installed as the Clock.  Only one may exist at a time.  It is not
+// thread-safe; everything must be driven from the thread calling Run*.
+class NetworkEmulator {
+ public:
+  typedef std::function<void(const boost::asio::const_buffer& /*data*/,
+                             const boost::asio::ip::udp::endpoint& /*sender*/)> ReceiveFunctor;
+
+  explicit NetworkEmulator(uint32_t seed);
+  ~NetworkEmulator();
+
+  // The virtual time.
+  boost::posix_time::ptime Now() const;
+
+  // Conditions for links without their own.  By default, packets are delivered instantly.
+  void SetDefaultLinkConditions(const LinkConditions& conditions);
+  // Conditions for packets sent from "source" to "destination".
+  void SetLinkConditions(const boost::asio::ip::udp::endpoint& source,
+                         const boost::asio::ip::udp::endpoint& destination,
+                         const LinkConditions& conditions);
+
+  // Deliver packets sent to "endpoint" to "receive_functor", replacing any functor already there.
+  // Packets sent to an endpoint with no functor are lost.
+  void Attach(const boost::asio::ip::udp::endpoint& endpoint,
+              const ReceiveFunctor& receive_functor);
+  void Detach(const boost::asio::ip::udp::endpoint& endpoint);
+
+  // Have "tick_handler" invoked once the virtual time reaches the timer's expiry time, after
+  // resetting the timer, as TickOp does for real timers.
+  void AddTickTimer(TickTimer& tick_timer, const std::function<void()>& tick_handler);  // NOLINT (Fraser)
+
+  // Send a packet.  Like UDP, this succeeds even if the packet is then lost.
+  ReturnCode Send(const boost::asio::ip::udp::endpoint& source,
+                  const boost::asio::ip::udp::endpoint& destination,
+                  const boost::asio::const_buffer& data);
+
+  // Process events until "duration" has passed.
+  void RunFor(const boost::posix_time::time_duration& duration);
+  // Process events until "done" returns true, which is checked after each event, or until "limit"
+  // has passed.  Returns the result of "done".
+  bool RunUntil(const std::function<bool()>& done, const boost::posix_time::time_duration& limit);  // NOLINT (Fraser)
+
+  // Counts of packets handed to Send, and of those lost by it.
+  uint64_t PacketsSent() const { return packets_sent_; }
+  uint64_t PacketsLost() const { return packets_lost_; }
+
+ private:
+  // Disallow copying and assignment.
+  NetworkEmulator(const NetworkEmulator&);
+  NetworkEmulator& operator=(const NetworkEmulator&);
+
+  typedef std::pair<boost::asio::ip::udp::endpoint, boost::asio::ip::udp::endpoint> LinkId;
+
+  struct Delivery {
+    boost::posix_time::ptime time;
+    uint64_t order;  // Breaks ties in time, so that delivery is deterministic.
+    boost::asio::ip::udp::endpoint source, destination;
+    std::vector<unsigned char> data;
+    bool operator>(const Delivery& other) const {
+      return time != other.time ? time > other.time : order > other.order;
+    }
+  };
+
+  struct Timer {
+    TickTimer* tick_timer;
+    std::function<void()> tick_handler;  // NOLINT (Fraser)
+  };
+
+  // Process the earliest event due no later than "limit".  Returns false if there is none, in which
+  // case the time is advanced to "limit".
+  bool RunOne(const boost::posix_time::ptime& limit);
+
+  boost::posix_time::ptime now_;
+  std::mt19937 generator_;
+  LinkConditions default_conditions_;
+  std::map<LinkId, LinkConditions> link_conditions_;
+  // The state of each link which has carried a packet.
+  std::map<LinkId, ImpairedLink> links_;
+  std::map<boost::asio::ip::udp::endpoint, ReceiveFunctor> receive_functors_;
+  std::vector<Timer> timers_;
+  std::priority_queue<Delivery, std::vector<Delivery>, std::greater<Delivery>> deliveries_;
+  uint64_t next_order_, packets_sent_, packets_lost_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_NETWORK_EMULATOR_H_
@@ -0,0 +1,132 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/core/path_mtu_discovery.h"
+
+#include "maidsafe/rudp/parameters.h"
+
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+PathMtuDiscovery::PathMtuDiscovery()
+    : base_size_(Parameters::default_data_size),
+      confirmed_size_(base_size_),
+      upper_bound_(Parameters::max_data_size + 1),
+      searching_(true),
+      candidate_size_(0),
+      candidate_attempts_(0),
+      probe_outstanding_(false),
+      probe_timeout_(bptime::pos_infin),
+      next_probe_time_(bptime::neg_infin),
+      consecutive_timeouts_(0) {
+  ScheduleNextProbe(bptime::neg_infin);
+}
+
+size_t PathMtuDiscovery::DataSize() const { return confirmed_size_; }
+
+bool PathMtuDiscovery::IsSearching() const { return searching_; }
+
+size_t PathMtuDiscovery::NextProbe(const bptime::ptime& now) {
+  if (probe_outstanding_ || now < next_probe_time_)
+    return 0;
+
+  if (!searching_) {
+    // The raise timer has expired; check whether the path now supports a larger size.
+    searching_ = true;
+    upper_bound_ = Parameters::max_data_size + 1;
+    if (upper_bound_ - confirmed_size_ <= kSearchGranularity) {
+      ScheduleNextProbe(now);
+      return 0;
+    }
+  }
+
+  if (candidate_size_ == 0)
+    candidate_size_ = confirmed_size_ + (upper_bound_ - confirmed_size_) / 2;
+  ++candidate_attempts_;
+  probe_outstanding_ = true;
+  probe_timeout_ = now + Parameters::mtu_probe_timeout;
+  return candidate_size_;
+}
+
+bptime::ptime PathMtuDiscovery::ProbeTimeout() const { return probe_timeout_; }
+
+bool PathMtuDiscovery::OnProbeAcknowledged(size_t data_size, const bptime::ptime& now) {
+  if (!probe_outstanding_ || data_size != candidate_size_)
+    return false;
+
+  confirmed_size_ = candidate_size_;
+  candidate_size_ = 0;
+  candidate_attempts_ = 0;
+  probe_outstanding_ = false;
+  probe_timeout_ = bptime::pos_infin;
+  ScheduleNextProbe(now);
+  return true;
+}
+
+void PathMtuDiscovery::HandleTick(const bptime::ptime& now) {
+  if (!probe_outstanding_ || now < probe_timeout_)
+    return;
+
+  probe_outstanding_ = false;
+  probe_timeout_ = bptime::pos_infin;
+  if (candidate_attempts_ >= Parameters::mtu_probe_max_attempts) {
+    upper_bound_ = candidate_size_;
+    candidate_size_ = 0;
+    candidate_attempts_ = 0;
+  }
+  ScheduleNextProbe(now);
+}
+
+bool PathMtuDiscovery::OnSendTimeout(size_t largest_data_size, const bptime::ptime& now) {
+  if (largest_data_size <= base_size_ || confirmed_size_ <= base_size_)
+    return false;
+
+  if (++consecutive_timeouts_ < Parameters::mtu_black_hole_timeouts)
+    return false;
+
+  // The previously confirmed size is no longer getting through; start again from the base.
+  upper_bound_ = confirmed_size_;
+  confirmed_size_ = base_size_;
+  searching_ = true;
+  candidate_size_ = 0;
+  candidate_attempts_ = 0;
+  probe_outstanding_ = false;
+  probe_timeout_ = bptime::pos_infin;
+  consecutive_timeouts_ = 0;
+  ScheduleNextProbe(now + Parameters::mtu_probe_timeout);
+  return true;
+}
+
+void PathMtuDiscovery::OnAck() { consecutive_timeouts_ = 0; }
+
+void PathMtuDiscovery::ScheduleNextProbe(const bptime::ptime& now) {
+  if (upper_bound_ - confirmed_size_ <= kSearchGranularity) {
+    searching_ = false;
+    next_probe_time_ = now + Parameters::mtu_raise_interval;
+  } else {
+    next_probe_time_ = now;
+  }
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,107 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CORE_PATH_MTU_DISCOVERY_H_
+#define MAIDSAFE_RUDP_CORE_PATH_MTU_DISCOVERY_H_
+
+#include <cstdint>
+
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Datagram packetization layer path MTU discovery (see RFC 8899).  Starting from the base size
+// (Parameters::default_data_size), a binary search is made up towards Parameters::max_data_size
+// using padded probe packets which are acknowledged separately from data.  A size which goes
+// unacknowledged for Parameters::mtu_probe_max_attempts consecutive probes is deemed too large.
+// Once the search converges, it is repeated after Parameters::mtu_raise_interval in case the path
+// has changed.  If packets larger than the base size repeatedly time out without any progress
+// being acknowledged, the path is deemed to have become a black hole for them and the confirmed
+// size falls back to the base size before searching again.
+//
+// All sizes handled by this class are data payload sizes, i.e. excluding the packet header.
+class PathMtuDiscovery {
+ public:
+  PathMtuDiscovery();
+
+  // The largest data payload size confirmed to be deliverable on the path.
+  size_t DataSize() const;
+
+  // Returns whether a search is in progress.
+  bool IsSearching() const;
+
+  // If a probe is due at "now", returns the data payload size it should carry and records the probe
+  // as outstanding.  Otherwise returns 0.
+  size_t NextProbe(const boost::posix_time::ptime& now);
+
+  // The time at which the outstanding probe will be deemed lost, or pos_infin if there is none.
+  boost::posix_time::ptime ProbeTimeout() const;
+
+  // Handle acknowledgement of a probe which carried "data_size" bytes.  Returns true if this
+  // increased DataSize().
+  bool OnProbeAcknowledged(size_t data_size, const boost::posix_time::ptime& now);
+
+  // Handle a tick in the system time.
+  void HandleTick(const boost::posix_time::ptime& now);
+
+  // Handle the send timeout expiring for unacknowledged packets, the largest of which carried
+  // "largest_data_size" bytes.  Returns true if this caused DataSize() to fall back to the base.
+  bool OnSendTimeout(size_t largest_data_size, const boost::posix_time::ptime& now);
+
+  // Handle acknowledgement of data packets.
+  void OnAck();
+
+ private:
+  // Disallow copying and assignment.
+  PathMtuDiscovery(const PathMtuDiscovery&);
+  PathMtuDiscovery& operator=(const PathMtuDiscovery&);
+
+  // Decide whether the search has converged and schedule the next probe accordingly.
+  void ScheduleNextProbe(const boost::posix_time::ptime& now);
+
+  // The search stops once the bounds are closer than this.
+  enum { kSearchGranularity = 32 };
+
+  // The size which is always assumed to be deliverable.
+  const size_t base_size_;
+
+  // The largest confirmed size, and the smallest size known (or assumed) to be undeliverable.
+  size_t confirmed_size_, upper_bound_;
+
+  bool searching_;
+
+  // The size being probed and the number of probes sent for it so far.
+  size_t candidate_size_;
+  uint32_t candidate_attempts_;
+
+  bool probe_outstanding_;
+  boost::posix_time::ptime probe_timeout_;
+  boost::posix_time::ptime next_probe_time_;
+
+  // Number of send timeouts involving packets larger than base_size_ since the last ack.
+  uint32_t consecutive_timeouts_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_PATH_MTU_DISCOVERY_H_
@@ -30,7 +30,11 @@ License.
 #include "maidsafe/rudp/core/congestion_control.h"
 #include "maidsafe/rudp/core/peer.h"
 #include "maidsafe/rudp/core/tick_timer.h"
+#include "maidsafe/rudp/core/trace.h"
 #include "maidsafe/rudp/packets/ack_of_ack_packet.h"
+#include "maidsafe/rudp/packets/datagram_packet.h"
+#include "maidsafe/rudp/packets/fec_packet.h"
+#include "maidsafe/rudp/packets/message_drop_packet.h"
 #include "maidsafe/rudp/packets/negative_ack_packet.h"
 
 namespace asio = boost::asio;
@@ -48,9 +52,15 @@ Receiver::Receiver(Peer& peer, TickTimer& tick_timer, CongestionControl& congest
       tick_timer_(tick_timer),
       congestion_control_(congestion_control),
       unread_packets_(),
+      fec_decoder_(),
       acks_(),
       last_ack_packet_sequence_number_(0),
-      ack_sent_time_(tick_timer_.Now()) {}
+      ack_sent_time_(tick_timer_.Now()),
+      highest_datagram_sequence_number_(0),
+      received_datagrams_(0),
+      packets_received_(0),
+      bytes_received_(0),
+      negative_acks_sent_(0) {}
 
 void Receiver::Reset(uint32_t initial_sequence_number) {
   unread_packets_.Reset(initial_sequence_number);
@@ -76,6 +86,12 @@ size_t Receiver::ReadData(const boost::asio::mutable_buffer& data) {
 //                  << p.packet.FirstPacketInMessage() << "\t" << p.packet.LastPacketInMessage();
     if (p.lost) {
       break;
+    } else if (p.dropped) {
+      unread_packets_.Remove();
+    } else if (!p.packet.InOrder() && p.bytes_read == 0) {
+      // Part of an unordered message which hasn't fully arrived yet.  Once it has, its packets are
+      // marked as read and are simply removed here.
+      break;
     } else if (p.packet.Data().size() > p.bytes_read) {
       size_t length = std::min<size_t>(end - ptr, p.packet.Data().size() - p.bytes_read);
       std::memcpy(ptr, p.packet.Data().data() + p.bytes_read, length);
@@ -92,7 +108,17 @@ size_t Receiver::ReadData(const boost::asio::mutable_buffer& data) {
   return ptr - begin;
 }
 
-void Receiver::HandleData(const DataPacket& packet) {
+void Receiver::GetStats(ConnectionStats& stats) const {
+  stats.packets_received = packets_received_;
+  stats.bytes_received = bytes_received_;
+  stats.negative_acks_sent = negative_acks_sent_;
+}
+
+void Receiver::HandleData(const DataPacket& packet, std::vector<std::string>& unordered_messages) {
+  ++packets_received_;
+  bytes_received_ += packet.Data().size();
+  Trace::Record(TraceEvent::kDataReceived, peer_.SocketId(), packet.PacketSequenceNumber(),
+                static_cast<uint32_t>(packet.Data().size()));
   unread_packets_.SetMaximumSize(congestion_control_.ReceiveWindowSize());
 
   uint32_t seqnum = packet.PacketSequenceNumber();
@@ -117,6 +143,10 @@ void Receiver::HandleData(const DataPacket& packet) {
       p.packet = packet;
       p.lost = false;
       p.bytes_read = 0;
+      fec_decoder_.Add(packet);
+      std::string message;
+      if (!packet.InOrder() && ExtractUnorderedMessage(seqnum, message))
+        unordered_messages.push_back(message);
     }
   } else {
     LOG(kWarning) << "Ignoring incoming packet with seqnum " << seqnum
@@ -136,6 +166,67 @@ void Receiver::HandleData(const DataPacket& packet) {
 //  }
 }
 
+bool Receiver::HandleDatagram(const DatagramPacket& packet) {
+  uint32_t sequence_number(packet.SequenceNumber());
+  if (received_datagrams_ == 0) {
+    highest_datagram_sequence_number_ = sequence_number;
+    received_datagrams_ = 1;
+    return true;
+  }
+
+  // Sequence numbers wrap, so the distance from the highest is treated as signed.
+  int32_t distance(static_cast<int32_t>(sequence_number - highest_datagram_sequence_number_));
+  if (distance > 0) {
+    received_datagrams_ = (distance < kDatagramHistory) ? (received_datagrams_ << distance) : 0;
+    received_datagrams_ |= 1;
+    highest_datagram_sequence_number_ = sequence_number;
+    return true;
+  }
+
+  if (-static_cast<int64_t>(distance) >= kDatagramHistory)
+    return false;
+  uint64_t bit(UINT64_C(1) << -distance);
+  if ((received_datagrams_ & bit) != 0)
+    return false;
+  received_datagrams_ |= bit;
+  return true;
+}
+
+bool Receiver::HandleFec(const FecPacket& packet, DataPacket& recovered_packet) {
+  if (!fec_decoder_.Recover(packet, recovered_packet))
+    return false;
+  uint32_t seqnum(recovered_packet.PacketSequenceNumber());
+  return unread_packets_.Contains(seqnum) && unread_packets_[seqnum].lost;
+}
+
+void Receiver::HandleMessageDrop(const MessageDropPacket& packet) {
+  unread_packets_.SetMaximumSize(congestion_control_.ReceiveWindowSize());
+
+  uint32_t first(packet.FirstSequenceNumber()), last(packet.LastSequenceNumber());
+  while (unread_packets_.IsComingSoon(last) && !unread_packets_.IsFull())
+    unread_packets_.Append();
+
+  // Only the part of the range inside the window is relevant; the rest has been dropped already or
+  // will be announced again.
+  const uint32_t kMask(UnreadPacketWindow::kMaxSequenceNumber);
+  uint32_t range_size((last - first) & kMask);
+  for (uint32_t n = unread_packets_.Begin();
+       n != unread_packets_.End();
+       n = unread_packets_.Next(n)) {
+    UnreadPacket& p = unread_packets_[n];
+    if (((n - first) & kMask) <= range_size && !p.dropped) {
+      // A received packet of an in-order message has data belonging to the byte stream, so the
+      // peer can't legitimately drop it.
+      if (!p.lost && p.packet.InOrder())
+        continue;
+      p.lost = false;
+      p.dropped = true;
+    }
+  }
+
+  tick_timer_.TickAfter(congestion_control_.AckDelay());
+}
+
 void Receiver::HandleAckOfAck(const AckOfAckPacket& packet) {
   uint32_t ack_seqnum = packet.AckSequenceNumber();
 
@@ -171,7 +262,10 @@ void Receiver::HandleTick() {
   negative_ack.SetDestinationSocketId(peer_.SocketId());
   AddMissingSequenceNumbersToNegAck(negative_ack);
   if (negative_ack.HasSequenceNumbers()) {
-    peer_.Send(negative_ack);
+    if (peer_.Send(negative_ack) == kSuccess) {
+      ++negative_acks_sent_;
+      Trace::Record(TraceEvent::kNegativeAckSent, peer_.SocketId());
+    }
     tick_timer_.TickAt(now + congestion_control_.AckTimeout());
   }
 }
@@ -200,20 +294,61 @@ void Receiver::AddAckToWindow(const bptime::ptime& now) {
     a.packet.SetEstimatedLinkCapacity(congestion_control_.EstimatedLinkCapacity());
     a.send_time = now;
     peer_.Send(a.packet);
+    Trace::Record(TraceEvent::kAckSent, peer_.SocketId(), ack_packet_seqnum, n);
     last_ack_packet_sequence_number_ = ack_packet_seqnum;
   }
 }
 
+bool Receiver::ExtractUnorderedMessage(uint32_t seqnum, std::string& message) {
+  uint32_t message_number(unread_packets_[seqnum].packet.MessageNumber());
+  auto is_part_of_message([&](const UnreadPacket& p) {
+    return !p.dropped && !p.packet.InOrder() && p.packet.MessageNumber() == message_number;
+  });
+
+  // Find the packets of the message.  Packets of other messages may be interleaved with them, but
+  // any lost packet could be one of them, so give up at the first gap.
+  std::deque<uint32_t> packets(1, seqnum);
+  for (uint32_t n(seqnum); !unread_packets_[packets.front()].packet.FirstPacketInMessage();) {
+    if (n == unread_packets_.Begin())
+      return false;
+    n = unread_packets_.Previous(n);
+    const UnreadPacket& p = unread_packets_[n];
+    if (p.lost)
+      return false;
+    if (is_part_of_message(p))
+      packets.push_front(n);
+  }
+  for (uint32_t n(seqnum); !unread_packets_[packets.back()].packet.LastPacketInMessage();) {
+    n = unread_packets_.Next(n);
+    if (n == unread_packets_.End() || unread_packets_[n].lost)
+      return false;
+    if (is_part_of_message(unread_packets_[n]))
+      packets.push_back(n);
+  }
+
+  message.clear();
+  for (uint32_t n : packets) {
+    UnreadPacket& p = unread_packets_[n];
+    message += p.packet.Data();
+    p.bytes_read = p.packet.Data().size();
+  }
+  return true;
+}
+
 void Receiver::AddMissingSequenceNumbersToNegAck(NegativeAckPacket& negative_ack) {
+  bptime::ptime now = tick_timer_.Now();
+  auto is_missing([&](uint32_t n) {
+    return unread_packets_[n].lost && !AwaitingRepair(n, now);
+  });
   uint32_t n = unread_packets_.Begin();
   while (n != unread_packets_.End()) {
-    if (unread_packets_[n].lost) {
+    if (is_missing(n)) {
       uint32_t begin = n;
       uint32_t end;
       do {
         end = n;
         n = unread_packets_.Next(n);
-      } while (n != unread_packets_.End() && unread_packets_[n].lost);
+      } while (n != unread_packets_.End() && is_missing(n));
       if (begin == end)
         negative_ack.AddSequenceNumber(begin);
       else
@@ -224,6 +359,23 @@ void Receiver::AddMissingSequenceNumbersToNegAck(NegativeAckPacket& negative_ack
   }
 }
 
+bool Receiver::AwaitingRepair(uint32_t seqnum, const bptime::ptime& now) {
+  size_t block_size(fec_decoder_.BlockSize());
+  if (block_size == 0 || unread_packets_.IsEmpty())
+    return false;
+  // The repair packet follows the last packet of the block, so is still due if the block holds the
+  // latest packet.  If that was the last of the block, the repair packet has one ack delay to turn
+  // up before the loss is reported anyway.
+  uint32_t latest(unread_packets_.Previous(unread_packets_.End()));
+  if (seqnum - seqnum % block_size != latest - latest % block_size)
+    return false;
+  bptime::ptime report_time(unread_packets_[seqnum].reserve_time + congestion_control_.AckDelay());
+  if (report_time <= now)
+    return false;
+  tick_timer_.TickAt(report_time);
+  return true;
+}
+
 uint32_t Receiver::AvailableBufferSize() const {
   size_t free_packets =
       unread_packets_.IsFull() ? 0 : unread_packets_.MaximumSize() - unread_packets_.Size();
@@ -20,15 +20,19 @@ License.
 
 #include <cstdint>
 #include <deque>
+#include <string>
+#include <vector>
 
 #include "boost/asio/buffer.hpp"
-#include "boost/asio/deadline_timer.hpp"
 #include "boost/asio/ip/udp.hpp"
 #include "boost/date_time/posix_time/posix_time_types.hpp"
 
+#include "maidsafe/rudp/connection_stats.h"
 #include "maidsafe/rudp/packets/ack_packet.h"
 #include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/core/fec.h"
 #include "maidsafe/rudp/core/sliding_window.h"
+#include "maidsafe/rudp/core/tick_timer.h"
 
 
 namespace maidsafe {
@@ -39,9 +43,11 @@ namespace detail {
 
 class AckOfAckPacket;
 class CongestionControl;
+class DatagramPacket;
+class FecPacket;
+class MessageDropPacket;
 class NegativeAckPacket;
 class Peer;
-class TickTimer;
 
 class Receiver {
  public:
@@ -53,11 +59,27 @@ class Receiver {
   // Determine whether all acknowledgements have been processed.
   bool Flushed() const;
 
-  // Reads some application data. Returns number of bytes copied.
+  // Fill in the receiving counters of "stats".
+  void GetStats(ConnectionStats& stats) const;
+
+  // Reads some application data from the ordered stream. Returns number of bytes copied.
   size_t ReadData(const boost::asio::mutable_buffer& data);
 
-  // Handle a data packet.
-  void HandleData(const DataPacket& packet);
+  // Handle a data packet.  If this completes a message which was sent out of order, the message is
+  // appended to unordered_messages and its packets are skipped by subsequent calls to ReadData.
+  void HandleData(const DataPacket& packet, std::vector<std::string>& unordered_messages);
+
+  // Handle a datagram packet.  Returns false if it duplicates a recently-received datagram or is
+  // too old to tell, in which case it should be discarded.
+  bool HandleDatagram(const DatagramPacket& packet);
+
+  // Handle a forward error correction repair packet.  Returns true if it allows a lost data packet
+  // to be rebuilt, in which case that packet should be passed to HandleData.
+  bool HandleFec(const FecPacket& packet, DataPacket& recovered_packet);
+
+  // Handle notice that the peer has abandoned a range of packets.  They are acknowledged without
+  // having arrived, and skipped by subsequent calls to ReadData.
+  void HandleMessageDrop(const MessageDropPacket& packet);
 
   // Handle an acknowledgement of an acknowledgement packet.
   void HandleAckOfAck(const AckOfAckPacket& packet);
@@ -73,9 +95,18 @@ class Receiver {
   // Helper function to decide the addition of an ack packet to the sliding window
   void AddAckToWindow(const boost::posix_time::ptime& now);
 
-  // Helper function to add the sequence numbers of missing packets to a negative ack packet
+  // Helper function to extract the unordered message containing the packet with the given sequence
+  // number if all of its packets have arrived.  Returns false if the message is incomplete.
+  bool ExtractUnorderedMessage(uint32_t seqnum, std::string& message);
+
+  // Helper function to add the sequence numbers of missing packets to a negative ack packet.  While
+  // the peer is sending repair packets, a packet in the latest block isn't reported until the repair
+  // packet for that block has had a chance to arrive.
   void AddMissingSequenceNumbersToNegAck(NegativeAckPacket& negative_ack);
 
+  // Whether a lost packet might yet be rebuilt from the repair packet for the latest block.
+  bool AwaitingRepair(uint32_t seqnum, const boost::posix_time::ptime& now);
+
   // Helper function to calculate the available buffer size.
   uint32_t AvailableBufferSize() const;
 
@@ -95,15 +126,17 @@ class Receiver {
     UnreadPacket()
         : packet(),
           lost(true),
+          dropped(false),
           bytes_read(0),
-          reserve_time(boost::asio::deadline_timer::traits_type::now()) {}
+          reserve_time(TickTimer::Now()) {}
     DataPacket packet;
     bool lost;
+    bool dropped;
     size_t bytes_read;
     boost::posix_time::ptime reserve_time;
 
     bool Missing(boost::posix_time::time_duration time_out) {
-      boost::posix_time::ptime now = boost::asio::deadline_timer::traits_type::now();
+      boost::posix_time::ptime now = TickTimer::Now();
       return (lost && ((reserve_time + time_out) < now));
     }
   };
@@ -114,11 +147,14 @@ class Receiver {
   UnreadPacketWindow unread_packets_;
 
   struct Ack {
-    Ack() : packet(), send_time(boost::asio::deadline_timer::traits_type::now()) {}
+    Ack() : packet(), send_time(TickTimer::Now()) {}
     AckPacket packet;
     boost::posix_time::ptime send_time;
   };
 
+  // The rebuilder of lost packets from forward error correction repair packets.
+  FecDecoder fec_decoder_;
+
   // The receiver's window of acknowledgements. New acks are generated on a regular basis, so if
   // this window fills up the oldest entries are removed.
   typedef SlidingWindow<Ack> AckWindow;
@@ -129,6 +165,15 @@ class Receiver {
 
   // Next time the ack packet shall be sent
   boost::posix_time::ptime ack_sent_time_;
+
+  // The highest datagram sequence number received, and a bitmask of which of the kDatagramHistory
+  // sequence numbers up to and including it have been received.
+  enum { kDatagramHistory = 64 };
+  uint32_t highest_datagram_sequence_number_;
+  uint64_t received_datagrams_;
+
+  // Counters reported by GetStats.  Received counts include duplicates.
+  uint64_t packets_received_, bytes_received_, negative_acks_sent_;
 };
 
 }  // namespace detail
@@ -0,0 +1,111 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CORE_SAMPLE_RING_BUFFER_H_
+#define MAIDSAFE_RUDP_CORE_SAMPLE_RING_BUFFER_H_
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Fixed-capacity ring of integer samples (e.g. packet arrival intervals in microseconds).  Once the
+// ring is full, each new sample overwrites the oldest one.  No memory is allocated after
+// construction, and all queries run in time bounded by the capacity.
+template <typename T, size_t kCapacity>
+class SampleRingBuffer {
+ public:
+  SampleRingBuffer() : samples_(), next_(0), size_(0) {}
+
+  // Add a sample, discarding the oldest one if the ring is full.
+  void Push(T sample) {
+    samples_[next_] = sample;
+    next_ = (next_ + 1) % kCapacity;
+    if (size_ < kCapacity)
+      ++size_;
+  }
+
+  // Discard all samples.
+  void Clear() { next_ = size_ = 0; }
+
+  // Get the number of samples currently held.
+  size_t Size() const { return size_; }
+
+  // Get whether the ring is empty.
+  bool IsEmpty() const { return size_ == 0; }
+
+  // Get the maximum number of samples which can be held.
+  static size_t Capacity() { return kCapacity; }
+
+  // Get the median sample.  For an even number of samples, the upper of the two middle samples is
+  // returned.
+  // Precondition: !IsEmpty().
+  T Median() const {
+    assert(!IsEmpty());
+    std::array<T, kCapacity> scratch;
+    std::copy(samples_.begin(), samples_.begin() + size_, scratch.begin());
+    auto middle(scratch.begin() + size_ / 2);
+    std::nth_element(scratch.begin(), middle, scratch.begin() + size_);
+    return *middle;
+  }
+
+  // Sum the samples which lie within a factor of "spread" either side of the median, i.e. in the
+  // range [median / spread, median * spread].  This filters out outliers before taking an average.
+  // Returns the number of samples contributing to "total".
+  // Precondition: !IsEmpty() && spread != 0.
+  size_t SumAroundMedian(T spread, T& total) const {
+    assert(spread != 0);
+    T median(Median());
+    T lower(median / spread), upper(median * spread);
+    size_t count(0);
+    total = 0;
+    for (size_t i(0); i != size_; ++i) {
+      if (lower <= samples_[i] && samples_[i] <= upper) {
+        ++count;
+        total += samples_[i];
+      }
+    }
+    return count;
+  }
+
+ private:
+  // Disallow copying and assignment.
+  SampleRingBuffer(const SampleRingBuffer&);
+  SampleRingBuffer& operator=(const SampleRingBuffer&);
+
+  // The samples.  Only the first size_ are valid; the order is irrelevant to all queries.
+  std::array<T, kCapacity> samples_;
+
+  // The index at which the next sample will be written.
+  size_t next_;
+
+  // The number of valid samples.
+  size_t size_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_SAMPLE_RING_BUFFER_H_
@@ -24,9 +24,14 @@ License.
 #include "maidsafe/rudp/core/congestion_control.h"
 #include "maidsafe/rudp/core/peer.h"
 #include "maidsafe/rudp/core/tick_timer.h"
+#include "maidsafe/rudp/core/trace.h"
 #include "maidsafe/rudp/packets/ack_packet.h"
 #include "maidsafe/rudp/packets/ack_of_ack_packet.h"
+#include "maidsafe/rudp/packets/datagram_packet.h"
+#include "maidsafe/rudp/packets/fec_packet.h"
 #include "maidsafe/rudp/packets/keepalive_packet.h"
+#include "maidsafe/rudp/packets/message_drop_packet.h"
+#include "maidsafe/rudp/packets/mtu_probe_packet.h"
 #include "maidsafe/rudp/packets/negative_ack_packet.h"
 
 namespace asio = boost::asio;
@@ -45,48 +50,141 @@ Sender::Sender(Peer& peer, TickTimer& tick_timer, CongestionControl& congestion_
       congestion_control_(congestion_control),
       unacked_packets_(),
       send_timeout_(),
-      current_message_number_(0) {}
+      next_deadline_(bptime::pos_infin),
+      path_mtu_discovery_(),
+      fec_encoder_(),
+      mtu_probe_sequence_number_(1),
+      datagram_sequence_number_(0),
+      packets_sent_(0),
+      bytes_sent_(0),
+      packets_retransmitted_(0),
+      bytes_retransmitted_(0),
+      negative_acks_received_(0),
+      send_timeouts_(0),
+      traced_send_window_size_(0),
+      traced_receive_window_size_(0) {}
 
 uint32_t Sender::GetNextPacketSequenceNumber() const { return unacked_packets_.End(); }
 
 bool Sender::Flushed() const { return unacked_packets_.IsEmpty(); }
 
-size_t Sender::AddData(const asio::const_buffer& data, const uint32_t& message_number) {
-  if ((congestion_control_.SendWindowSize() == 0) && (unacked_packets_.Size() == 0))
+void Sender::GetStats(ConnectionStats& stats) const {
+  stats.packets_sent = packets_sent_;
+  stats.bytes_sent = bytes_sent_;
+  stats.packets_retransmitted = packets_retransmitted_;
+  stats.bytes_retransmitted = bytes_retransmitted_;
+  stats.negative_acks_received = negative_acks_received_;
+  stats.send_timeouts = send_timeouts_;
+  stats.unacknowledged_packets = unacked_packets_.Size();
+}
+
+size_t Sender::AddPacket(const asio::const_buffer& data,
+                         const uint32_t& message_number,
+                         bool first_packet_in_message,
+                         bool in_order,
+                         const bptime::ptime& deadline) {
+  if ((congestion_control_.SendWindowSize() == 0) && (unacked_packets_.Size() == 0)) {
     unacked_packets_.SetMaximumSize(Parameters::default_window_size);
-  else
-    unacked_packets_.SetMaximumSize(congestion_control_.SendWindowSize());
+  } else {
+    // Datagrams sent recently share the window, but reliable data always keeps at least one slot.
+    size_t window_size(congestion_control_.SendWindowSize());
+    size_t datagrams(window_size == 0 ? 0 :
+                     std::min(congestion_control_.DatagramsInFlight(), window_size - 1));
+    unacked_packets_.SetMaximumSize(window_size - datagrams);
+  }
 
   const unsigned char* begin = asio::buffer_cast<const unsigned char*>(data);
-  const unsigned char* ptr = begin;
   const unsigned char* end = begin + asio::buffer_size(data);
+  if (unacked_packets_.IsFull() || begin == end)
+    return 0;
+
+  // While repair packets are being sent, data packets are kept small enough that the repair
+  // packets are no larger than the path can carry.
+  size_t data_size(congestion_control_.SendDataSize());
+  if (fec_encoder_.BlockSize() != 0)
+    data_size -= FecPacket::kOverhead;
+  size_t length = std::min<size_t>(data_size, end - begin);
+  uint32_t n = unacked_packets_.Append();
+
+  UnackedPacket& p = unacked_packets_[n];
+  p.packet.SetPacketSequenceNumber(n);
+  p.packet.SetFirstPacketInMessage(first_packet_in_message);
+  p.packet.SetLastPacketInMessage(begin + length == end);
+  p.packet.SetInOrder(in_order);
+  p.packet.SetMessageNumber(message_number);
+  p.packet.SetTimeStamp(0);
+  p.packet.SetDestinationSocketId(peer_.SocketId());
+  p.packet.SetData(begin, begin + length);
+  p.lost = true;  // Mark as lost so that DoSend() will send it.
+  p.dropped = false;
+  p.deadline = deadline;
+
+  if (deadline < next_deadline_) {
+    next_deadline_ = deadline;
+    tick_timer_.TickAt(deadline);
+  }
 
-  while (!unacked_packets_.IsFull() && (ptr < end)) {
-    size_t length = std::min<size_t>(congestion_control_.SendDataSize(), end - ptr);
-    uint32_t n = unacked_packets_.Append();
+  return length;
+}
 
-    UnackedPacket& p = unacked_packets_[n];
-    p.packet.SetPacketSequenceNumber(n);
-    p.packet.SetFirstPacketInMessage(current_message_number_ == message_number);
-    current_message_number_ = message_number;
-    p.packet.SetLastPacketInMessage(ptr + length == end);
-    p.packet.SetInOrder(true);
-    p.packet.SetMessageNumber(message_number);
-    p.packet.SetTimeStamp(0);
-    p.packet.SetDestinationSocketId(peer_.SocketId());
-    p.packet.SetData(ptr, ptr + length);
-    p.lost = true;  // Mark as lost so that DoSend() will send it.
-
-    ptr += length;
+void Sender::SendPackets() {
+  DoSend();
+}
+
+ReturnCode Sender::SendDatagram(const std::string& data) {
+  if (data.size() > congestion_control_.SendDataSize())
+    return kMessageTooLarge;
+
+  // Rather than queueing behind reliable data, datagrams are dropped while the connection is
+  // congested, i.e. while they and the unacknowledged packets fill the congestion window.
+  if (unacked_packets_.Size() + congestion_control_.DatagramsInFlight() >=
+      congestion_control_.SendWindowSize()) {
+    return kDatagramDropped;
   }
 
-  DoSend();
+  DatagramPacket packet;
+  packet.SetDestinationSocketId(peer_.SocketId());
+  packet.SetSequenceNumber(datagram_sequence_number_++);
+  packet.SetData(data);
+  ReturnCode result(peer_.Send(packet));
+  if (result == kSuccess)
+    congestion_control_.OnDatagramSent();
+  return result;
+}
+
+void Sender::DropExpiredMessages(std::vector<uint32_t>& dropped_message_numbers) {
+  bptime::ptime now = tick_timer_.Now();
+  if (next_deadline_ > now)
+    return;
+
+  // All packets of a message share its deadline, so the whole message is dropped at once.
+  next_deadline_ = bptime::pos_infin;
+  for (uint32_t n = unacked_packets_.Begin();
+       n != unacked_packets_.End();
+       n = unacked_packets_.Next(n)) {
+    UnackedPacket& p = unacked_packets_[n];
+    if (p.dropped)
+      continue;
+    if (p.deadline <= now) {
+      p.dropped = true;
+      p.lost = true;  // Mark as lost so that DoSend() will send the MessageDropPacket.
+      uint32_t message_number(p.packet.MessageNumber());
+      if (std::find(dropped_message_numbers.begin(), dropped_message_numbers.end(),
+                    message_number) == dropped_message_numbers.end()) {
+        dropped_message_numbers.push_back(message_number);
+      }
+    } else {
+      next_deadline_ = std::min(next_deadline_, p.deadline);
+    }
+  }
 
-  return ptr - begin;
+  if (!next_deadline_.is_special())
+    tick_timer_.TickAt(next_deadline_);
 }
 
 void Sender::HandleAck(const AckPacket& packet, std::vector<uint32_t>& completed_message_numbers) {
   uint32_t seqnum = packet.PacketSequenceNumber();
+  Trace::Record(TraceEvent::kAckReceived, peer_.SocketId(), seqnum, packet.AckSequenceNumber());
 
   if (packet.HasOptionalFields()) {
     congestion_control_.OnAck(seqnum,
@@ -98,6 +196,7 @@ void Sender::HandleAck(const AckPacket& packet, std::vector<uint32_t>& completed
   } else {
     congestion_control_.OnAck(seqnum);
   }
+  TraceWindowSizes();
 
   AckOfAckPacket response_packet;
   response_packet.SetDestinationSocketId(peer_.SocketId());
@@ -105,8 +204,10 @@ void Sender::HandleAck(const AckPacket& packet, std::vector<uint32_t>& completed
   peer_.Send(response_packet);
 
   if (unacked_packets_.Contains(seqnum) || unacked_packets_.End() == seqnum) {
+    uint32_t previous_begin(unacked_packets_.Begin());
     while (unacked_packets_.Begin() != seqnum) {
-      if (unacked_packets_.Front().packet.LastPacketInMessage()) {
+      if (unacked_packets_.Front().packet.LastPacketInMessage() &&
+          !unacked_packets_.Front().dropped) {
         completed_message_numbers.push_back(unacked_packets_.Front().packet.MessageNumber());
 //        LOG(kVerbose) << "Received ACK for last packet in message "
 //                      << unacked_packets_.Front().packet.MessageNumber();
@@ -114,42 +215,73 @@ void Sender::HandleAck(const AckPacket& packet, std::vector<uint32_t>& completed
       unacked_packets_.Remove();
     }
 
+    if (unacked_packets_.Begin() != previous_begin)
+      path_mtu_discovery_.OnAck();
+
     DoSend();
   }
 }
 
 void Sender::HandleNegativeAck(const NegativeAckPacket& packet) {
+  ++negative_acks_received_;
+  Trace::Record(TraceEvent::kNegativeAckReceived, peer_.SocketId());
+
   // Mark the specified packets as lost.
   for (uint32_t n = unacked_packets_.Begin();
        n != unacked_packets_.End();
        n = unacked_packets_.Next(n)) {
     if (packet.ContainsSequenceNumber(n)) {
       congestion_control_.OnNegativeAck(n);
-      unacked_packets_[n].lost = true;
+      MarkLost(n);
     }
   }
+  TraceWindowSizes();
 
   DoSend();
 }
 
 void Sender::HandleTick() {
-  if (send_timeout_ <= tick_timer_.Now()) {
+  bptime::ptime now = tick_timer_.Now();
+  if (send_timeout_ <= now) {
     // Clear timeout. Will be reset next time a data packet is sent.
     send_timeout_ = bptime::pos_infin;
 
     // Mark all timedout unacknowledged packets as lost.
+    uint32_t packets_lost(0);
+    size_t largest_lost_data_size(0);
     for (uint32_t n = unacked_packets_.Begin();
          n != unacked_packets_.End();
          n = unacked_packets_.Next(n)) {
-      if ((unacked_packets_[n].last_send_time + congestion_control_.SendTimeout()) <
-          tick_timer_.Now()) {
+      if ((unacked_packets_[n].last_send_time + congestion_control_.SendTimeout()) < now) {
         congestion_control_.OnSendTimeout(n);
-        unacked_packets_[n].lost = true;
+        MarkLost(n);
+        ++packets_lost;
+        if (!unacked_packets_[n].dropped) {
+          largest_lost_data_size =
+              std::max(largest_lost_data_size, unacked_packets_[n].packet.Data().size());
+        }
         // LOG(kVerbose) << "Lost packet " << n;
       }
     }
+
+    if (packets_lost != 0) {
+      ++send_timeouts_;
+      Trace::Record(TraceEvent::kSendTimeout, peer_.SocketId(), packets_lost);
+      TraceWindowSizes();
+    }
+
+    // Packets already in the window keep their size, so only subsequent data benefits from this.
+    if (largest_lost_data_size != 0 &&
+        path_mtu_discovery_.OnSendTimeout(largest_lost_data_size, now)) {
+      LOG(kWarning) << "Packets of " << largest_lost_data_size << " bytes repeatedly lost to "
+                    << peer_.PeerEndpoint() << "; reducing data size to "
+                    << path_mtu_discovery_.DataSize();
+      congestion_control_.SetSendDataSize(path_mtu_discovery_.DataSize());
+    }
   }
 
+  path_mtu_discovery_.HandleTick(now);
+  DoProbe();
   DoSend();
 }
 
@@ -160,7 +292,30 @@ void Sender::DoSend() {
        n != unacked_packets_.End();
        n = unacked_packets_.Next(n)) {
     UnackedPacket& p = unacked_packets_[n];
-    if (p.lost) {
+    if (p.lost && p.dropped) {
+      // Rather than retransmitting, tell the peer to skip this run of dropped packets.
+      uint32_t last(n);
+      while (unacked_packets_.Next(last) != unacked_packets_.End() &&
+             unacked_packets_[unacked_packets_.Next(last)].dropped) {
+        last = unacked_packets_.Next(last);
+      }
+      MessageDropPacket drop_packet;
+      drop_packet.SetDestinationSocketId(peer_.SocketId());
+      drop_packet.SetFirstSequenceNumber(n);
+      drop_packet.SetLastSequenceNumber(last);
+      if (peer_.Send(drop_packet) == kSuccess) {
+        for (uint32_t m = n; ; m = unacked_packets_.Next(m)) {
+          unacked_packets_[m].lost = false;
+          unacked_packets_[m].last_send_time = now;
+          if (m == last)
+            break;
+        }
+        tick_timer_.TickAt(now + congestion_control_.SendDelay());
+        return;
+      } else {
+        LOG(kVerbose) << "DoSend - failed sending drop of packets " << n << " to " << last;
+      }
+    } else if (p.lost) {
       // peer_.Send is a blockable function call, it will only returned when
       // the UDP socket sent out the packet successfully. So here the all
       // un-acked packets can be sent out one-by-one in a bunch, i.e. the whole
@@ -170,11 +325,27 @@ void Sender::DoSend() {
       // send another packet at this time, and then once request a packet to be
       // sent, set the ticker to be with a fixed interval or
       // tick_timer_.TickAt(now + congestion_control_.SendDelay());
+      bool first_send(p.last_send_time.is_not_a_date_time());
       if (peer_.Send(p.packet) == kSuccess) {
         p.lost = false;
         p.last_send_time = now;
         congestion_control_.OnDataPacketSent(n);
         tick_timer_.TickAt(now + congestion_control_.SendDelay());
+        ++packets_sent_;
+        bytes_sent_ += p.packet.Data().size();
+        Trace::Record(first_send ? TraceEvent::kDataSent : TraceEvent::kDataResent,
+                      peer_.SocketId(), n, static_cast<uint32_t>(p.packet.Data().size()));
+        if (!first_send) {
+          ++packets_retransmitted_;
+          bytes_retransmitted_ += p.packet.Data().size();
+        }
+        FecPacket repair_packet;
+        if (first_send && Parameters::forward_error_correction &&
+            fec_encoder_.Add(p.packet, congestion_control_.SendDataSize() - FecPacket::kOverhead,
+                             repair_packet)) {
+          repair_packet.SetDestinationSocketId(peer_.SocketId());
+          peer_.Send(repair_packet);
+        }
         // LOG(kVerbose) << "Sent packet " << n;
         return;
       } else {
@@ -188,6 +359,45 @@ void Sender::DoSend() {
   }
 }
 
+void Sender::TraceWindowSizes() {
+  if (!Trace::Enabled())
+    return;
+  size_t send_window_size(congestion_control_.SendWindowSize());
+  size_t receive_window_size(congestion_control_.ReceiveWindowSize());
+  if (send_window_size != traced_send_window_size_ ||
+      receive_window_size != traced_receive_window_size_) {
+    traced_send_window_size_ = send_window_size;
+    traced_receive_window_size_ = receive_window_size;
+    Trace::Record(TraceEvent::kWindowChanged, peer_.SocketId(),
+                  static_cast<uint32_t>(send_window_size),
+                  static_cast<uint32_t>(receive_window_size));
+  }
+}
+
+void Sender::MarkLost(uint32_t n) {
+  UnackedPacket& p = unacked_packets_[n];
+  if (!p.lost && !p.dropped && Parameters::forward_error_correction)
+    fec_encoder_.OnPacketLost();
+  p.lost = true;
+}
+
+void Sender::DoProbe() {
+  bptime::ptime now = tick_timer_.Now();
+  size_t data_size(path_mtu_discovery_.NextProbe(now));
+  if (data_size != 0) {
+    // Each probe has a distinct sequence number so that late responses can be discarded.
+    mtu_probe_sequence_number_ += 2;
+    MtuProbePacket probe_packet;
+    probe_packet.SetDestinationSocketId(peer_.SocketId());
+    probe_packet.SetSequenceNumber(mtu_probe_sequence_number_);
+    probe_packet.SetProbeSize(static_cast<uint32_t>(data_size + DataPacket::kHeaderSize));
+    // A failure to send is treated just like a lost probe.
+    if (peer_.Send(probe_packet) != kSuccess)
+      LOG(kVerbose) << "DoProbe - failed sending probe of " << data_size << " bytes";
+  }
+  tick_timer_.TickAt(path_mtu_discovery_.ProbeTimeout());
+}
+
 void Sender::NotifyClose() {
   ShutdownPacket shut_down_packet;
   shut_down_packet.SetDestinationSocketId(peer_.SocketId());
@@ -208,6 +418,30 @@ ReturnCode Sender::SendKeepalive(const KeepalivePacket& keepalive_packet) {
   return peer_.Send(keepalive_packet);
 }
 
+void Sender::HandleMtuProbe(const MtuProbePacket& packet) {
+  if (packet.IsRequest()) {
+    MtuProbePacket response_packet;
+    response_packet.SetSequenceNumber(packet.SequenceNumber() + 1);
+    response_packet.SetProbeSize(packet.ProbeSize());
+    response_packet.SetDestinationSocketId(peer_.SocketId());
+    peer_.Send(response_packet);
+    return;
+  }
+
+  if (!packet.IsResponseOf(mtu_probe_sequence_number_) ||
+      packet.ProbeSize() < DataPacket::kHeaderSize) {
+    return;
+  }
+
+  size_t data_size(packet.ProbeSize() - DataPacket::kHeaderSize);
+  if (path_mtu_discovery_.OnProbeAcknowledged(data_size, tick_timer_.Now())) {
+    LOG(kVerbose) << "Path to " << peer_.PeerEndpoint() << " can carry " << data_size
+                  << " bytes of data per packet";
+    congestion_control_.SetSendDataSize(data_size);
+  }
+  DoProbe();
+}
+
 }  // namespace detail
 
 }  // namespace rudp
@@ -19,13 +19,17 @@ License.
 #define MAIDSAFE_RUDP_CORE_SENDER_H_
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include "boost/asio/buffer.hpp"
 #include "boost/asio/ip/udp.hpp"
 #include "boost/date_time/posix_time/posix_time_types.hpp"
 
+#include "maidsafe/rudp/connection_stats.h"
 #include "maidsafe/rudp/return_codes.h"
+#include "maidsafe/rudp/core/fec.h"
+#include "maidsafe/rudp/core/path_mtu_discovery.h"
 #include "maidsafe/rudp/core/sliding_window.h"
 #include "maidsafe/rudp/packets/data_packet.h"
 #include "maidsafe/rudp/packets/shutdown_packet.h"
@@ -38,7 +42,9 @@ namespace detail {
 
 class AckPacket;
 class CongestionControl;
+class DatagramPacket;
 class KeepalivePacket;
+class MtuProbePacket;
 class NegativeAckPacket;
 class Peer;
 class TickTimer;
@@ -53,14 +59,39 @@ class Sender {
   // Determine whether all data has been transmitted to the peer.
   bool Flushed() const;
 
-  // Adds some application data to be sent. Returns number of bytes copied.
-  size_t AddData(const boost::asio::const_buffer& data, const uint32_t& message_number);
+  // Fill in the sending counters of "stats", and the number of unacknowledged packets.
+  void GetStats(ConnectionStats& stats) const;
+
+  // Adds a single packet holding the start of "data" to the window, without sending it.  Returns
+  // the number of bytes copied, which is 0 if the window is full.  "data" must be the remainder of
+  // the message so that its last packet can be flagged.  If in_order is false, the receiver may
+  // deliver the message as soon as all of its packets have arrived.  Packets of different messages
+  // may be interleaved.  If the message hasn't been acknowledged by "deadline", its packets will be
+  // dropped by DropExpiredMessages.
+  size_t AddPacket(const boost::asio::const_buffer& data,
+                   const uint32_t& message_number,
+                   bool first_packet_in_message,
+                   bool in_order,
+                   const boost::posix_time::ptime& deadline);
+
+  // Sends packets added to the window, as far as congestion control allows.
+  void SendPackets();
+
+  // Sends a whole message in a single unreliable datagram, bypassing the window of unacknowledged
+  // packets.  Returns kMessageTooLarge if the data won't fit in one packet, or kDatagramDropped if
+  // the congestion window is currently full.  Each datagram sent takes a slot in the window for a
+  // round trip, so a burst can't exceed what the connection's congestion control allows.
+  ReturnCode SendDatagram(const std::string& data);
+
+  // Stops retransmitting packets of messages whose deadline has passed, and tells the peer to skip
+  // them instead.  Inserts the message_number of each newly-dropped message.
+  void DropExpiredMessages(std::vector<uint32_t>& dropped_message_numbers);
 
   // Notify the other side that the current connection is to be dropped
   void NotifyClose();
 
   // Handle an acknowlegement packet.  Inserts the message_number for any completed messages
-  // received so their sent functors can be invoked by Socket.
+  // received so their sent functors can be invoked by Socket.  Dropped messages aren't included.
   void HandleAck(const AckPacket& packet, std::vector<uint32_t>& completed_message_numbers);
 
   // Handle an negative acknowlegement packet.
@@ -75,6 +106,9 @@ class Sender {
   // Send a keepalive packet to the other side.
   ReturnCode SendKeepalive(const KeepalivePacket& keepalive_packet);
 
+  // Handle a path MTU probe request or response.
+  void HandleMtuProbe(const MtuProbePacket& packet);
+
  private:
   // Disallow copying and assignment.
   Sender(const Sender&);
@@ -83,6 +117,15 @@ class Sender {
   // Send waiting packets.
   void DoSend();
 
+  // Send a path MTU probe if one is due.
+  void DoProbe();
+
+  // Record the window sizes in the trace if they have changed since they were last recorded.
+  void TraceWindowSizes();
+
+  // Mark a packet as lost so that DoSend() will retransmit it.
+  void MarkLost(uint32_t n);
+
   // The peer with which we are communicating.
   Peer& peer_;
 
@@ -93,10 +136,15 @@ class Sender {
   CongestionControl& congestion_control_;
 
   struct UnackedPacket {
-    UnackedPacket() : packet(), lost(false), last_send_time() {}
+    UnackedPacket()
+        : packet(), lost(false), dropped(false), last_send_time(), deadline() {}
     DataPacket packet;
     bool lost;
+    // Set once the deadline has passed.  A dropped packet which is "lost" is due a MessageDropPacket
+    // rather than a retransmission.
+    bool dropped;
     boost::posix_time::ptime last_send_time;
+    boost::posix_time::ptime deadline;
   };
 
   // The sender's window of unacknowledged packets.
@@ -106,7 +154,27 @@ class Sender {
   // The next time at which all unacked packets will be considered lost.
   boost::posix_time::ptime send_timeout_;
 
-  uint32_t current_message_number_;
+  // The earliest deadline of any packet not yet dropped.
+  boost::posix_time::ptime next_deadline_;
+
+  // The search for the largest data size which the path can carry without fragmentation.
+  PathMtuDiscovery path_mtu_discovery_;
+
+  // The builder of forward error correction repair packets.
+  FecEncoder fec_encoder_;
+
+  // Sequence number of the latest path MTU probe request (always odd).
+  uint32_t mtu_probe_sequence_number_;
+
+  // Sequence number for the next datagram sent.
+  uint32_t datagram_sequence_number_;
+
+  // Counters reported by GetStats.  Sent counts include retransmissions.
+  uint64_t packets_sent_, bytes_sent_, packets_retransmitted_, bytes_retransmitted_;
+  uint64_t negative_acks_received_, send_timeouts_;
+
+  // The window sizes last recorded in the trace.
+  size_t traced_send_window_size_, traced_receive_window_size_;
 };
 
 }  // namespace detail
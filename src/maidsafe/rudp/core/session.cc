@@ -20,8 +20,11 @@ License.
 #include <cassert>
 
 #include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
 
 #include "maidsafe/rudp/utils.h"
+#include "maidsafe/rudp/core/congestion_control.h"
+#include "maidsafe/rudp/core/metrics.h"
 #include "maidsafe/rudp/core/peer.h"
 #include "maidsafe/rudp/core/sliding_window.h"
 #include "maidsafe/rudp/core/tick_timer.h"
@@ -55,10 +58,16 @@ Session::Session(Peer& peer,
       sending_sequence_number_(0),
       receiving_sequence_number_(0),
       peer_connection_type_(0),
+      peer_rudp_version_(0),
       peer_requested_nat_detection_port_(false),
       peer_nat_detection_endpoint_(),
       mode_(kNormal),
       state_(kClosed),
+      open_time_(),
+      syn_cookie_(0),
+      issued_ticket_(0),
+      resumption_(),
+      resumed_(false),
       on_nat_detection_requested_(),
       signal_connection_() {}
 
@@ -76,6 +85,17 @@ void Session::Open(uint32_t id,
   sending_sequence_number_ = sequence_number;
   mode_ = mode;
   state_ = kProbing;
+  open_time_ = tick_timer_.Now();
+  syn_cookie_ = 0;
+  peer_rudp_version_ = 0;
+  resumed_ = false;
+  resumption_ = SessionTicket();
+  if (peer_.node_id() != NodeId())
+    SessionTickets::Instance().Find(this_node_id_, peer_.node_id(), resumption_);
+  // The peer may still hold the ticket we issued in an earlier session, so it's reused.
+  issued_ticket_ = resumption_.issued_ticket;
+  while (issued_ticket_ == 0)
+    issued_ticket_ = RandomUint32();
   signal_connection_ = on_nat_detection_requested_.connect(on_nat_detection_requested_slot);
   SendConnectionRequest();
 }
@@ -100,6 +120,34 @@ uint32_t Session::PeerConnectionType() const {
   return peer_connection_type_;
 }
 
+bool Session::Resumed() const {
+  return resumed_;
+}
+
+void Session::RestoreCongestion(CongestionControl& congestion_control) const {
+  if (resumed_ && resumption_.round_trip_time != 0) {
+    congestion_control.OnResume(resumption_.round_trip_time,
+                                resumption_.round_trip_time_variance,
+                                resumption_.packets_receiving_rate,
+                                resumption_.estimated_link_capacity,
+                                resumption_.send_window_size);
+  }
+}
+
+void Session::SaveCongestion(const CongestionControl& congestion_control) {
+  SessionTicket ticket;
+  if (state_ != kConnected ||
+      !SessionTickets::Instance().Find(this_node_id_, peer_.node_id(), ticket)) {
+    return;
+  }
+  ticket.round_trip_time = congestion_control.RoundTripTime();
+  ticket.round_trip_time_variance = congestion_control.RoundTripTimeVariance();
+  ticket.packets_receiving_rate = congestion_control.PacketsReceivingRate();
+  ticket.estimated_link_capacity = congestion_control.EstimatedLinkCapacity();
+  ticket.send_window_size = congestion_control.SendWindowSize();
+  SessionTickets::Instance().Store(this_node_id_, peer_.node_id(), ticket);
+}
+
 void Session::Close() {
   signal_connection_.disconnect();
   state_ = kClosed;
@@ -124,24 +172,42 @@ void Session::HandleHandshakeWhenHandshaking(const HandshakePacket& packet) {
   if (!CalculateEndpoint())
     return;
 
-  if (!packet.PublicKey()) {
+  // A resumed peer doesn't resend its key.
+  std::shared_ptr<asymm::PublicKey> peer_public_key(packet.PublicKey());
+  if (!peer_public_key && resumed_)
+    peer_public_key = resumption_.peer_public_key;
+  if (!peer_public_key) {
     LOG(kError) << "Handshake packet is missing peer's public key";
     state_ = kClosed;
     return;
   }
 
   state_ = kConnected;
+  Metrics::Instance().handshake_duration.Record(tick_timer_.Now() - open_time_);
   peer_connection_type_ = packet.ConnectionType();
   receiving_sequence_number_ = packet.InitialPacketSequenceNumber();
-  peer_.SetPublicKey(packet.PublicKey());
+  peer_.SetPublicKey(peer_public_key);
   if (packet.NatDetectionPort() != 0) {
     peer_nat_detection_endpoint_ = boost::asio::ip::udp::endpoint(peer_.PeerEndpoint().address(),
                                                                   packet.NatDetectionPort());
+  } else if (resumed_) {
+    peer_nat_detection_endpoint_ = resumption_.peer_nat_detection_endpoint;
   }
 
   if (mode_ == kBootstrapAndDrop)
     return;
 
+  SessionTicket ticket(resumed_ ? resumption_ : SessionTicket());
+  ticket.issued_ticket = issued_ticket_;
+  if (!resumed_) {
+    ticket.peer_ticket = packet.ResumptionTicket();
+    ticket.peer_ticket_mac = packet.ResumptionTicketMac();
+  }
+  ticket.peer_public_key = peer_public_key;
+  ticket.peer_nat_detection_endpoint = peer_nat_detection_endpoint_;
+  ticket.peer_connection_type = peer_connection_type_;
+  SessionTickets::Instance().Store(this_node_id_, peer_.node_id(), ticket);
+
   if (packet.ConnectionReason() != kNormal && mode_ == kNormal)
     mode_ = static_cast<Mode>(packet.ConnectionReason());
   if (packet.ConnectionReason() == kBootstrapAndDrop && mode_ == kBootstrapAndKeep)
@@ -152,6 +218,33 @@ void Session::HandleHandshakeWhenHandshaking(const HandshakePacket& packet) {
 }
 
 
+void Session::HandleResumption(const HandshakePacket& packet) {
+  SessionTicket ticket;
+  if (!SessionTickets::Instance().Redeem(this_node_id_, packet.node_id(), packet.ResumptionTicket(),
+                                         packet.ResumptionTicketMac(), peer_.PeerEndpoint(),
+                                         ticket)) {
+    // Answered as a plain connection request, so that the peer completes a full handshake.
+    LOG(kVerbose) << "Unknown, expired or misdirected session ticket from "
+                  << peer_.PeerEndpoint();
+    if (state_ == kProbing)
+      HandleHandshakeWhenProbing(packet);
+    return;
+  }
+
+  if (state_ == kConnected) {
+    // The reply to an earlier copy of the request must have been lost.
+    if (resumed_)
+      SendCookie();
+    return;
+  }
+
+  // The request carries everything a cookie would, save for the key which we already hold.
+  resumption_ = ticket;
+  resumed_ = true;
+  state_ = kHandshaking;
+  HandleHandshakeWhenHandshaking(packet);
+}
+
 void Session::HandleHandshake(const HandshakePacket& packet) {
   if (peer_.SocketId() == 0)
     peer_.SetSocketId(packet.SocketId());
@@ -170,8 +263,34 @@ void Session::HandleHandshake(const HandshakePacket& packet) {
     state_ = kClosed;
     return;
   }
+  peer_rudp_version_ = packet.RudpVersion();
+
+  // A peer which holds no state for us yet replies to our connection request with just a cookie
+  // (and no socket ID).  It will only start a session of its own once we echo the cookie.
+  if (packet.SocketId() == 0) {
+    if (state_ == kProbing && packet.SynCookie() != 0 && packet.SynCookie() != syn_cookie_) {
+      syn_cookie_ = packet.SynCookie();
+      SendConnectionRequest();
+    }
+    return;
+  }
+
+  if (packet.Resume()) {
+    HandleResumption(packet);
+    return;
+  }
+
+  if (packet.Resumed()) {
+    // The peer accepted the ticket in our request to resume, and its reply completes the handshake.
+    if (state_ != kConnected && resumption_.peer_ticket != 0 &&
+        packet.ResumptionTicket() == resumption_.peer_ticket) {
+      resumed_ = true;
+      state_ = kHandshaking;
+      HandleHandshakeWhenHandshaking(packet);
+    }
+    return;
+  }
 
-  // TODO(Fraser#5#): 2012-04-04 - Handle SynCookies
   if (state_ == kProbing) {
     HandleHandshakeWhenProbing(packet);
   } else if (state_ == kHandshaking) {
@@ -235,7 +354,7 @@ void Session::HandleTick() {
 
 void Session::SendConnectionRequest() {
   HandshakePacket packet;
-  packet.SetRudpVersion(4);
+  packet.SetRudpVersion(HandshakePacket::kRudpVersion);
   packet.SetSocketType(HandshakePacket::kStreamSocketType);
   packet.SetSocketId(id_);
   packet.set_node_id(this_node_id_);
@@ -243,8 +362,21 @@ void Session::SendConnectionRequest() {
   packet.SetDestinationSocketId(0);
   packet.SetConnectionType(1);
   packet.SetConnectionReason(mode_);
-  packet.SetRequestNatDetectionPort(nat_type_ == NatType::kUnknown &&
-                                    !OnPrivateNetwork(peer_.PeerEndpoint()));
+  packet.SetSynCookie(syn_cookie_);
+  if (resumption_.peer_ticket != 0) {
+    // Ask to resume the earlier session, sending all that the peer would otherwise learn from our
+    // cookie, except for our key which it already holds.  NAT detection was done then too.
+    packet.SetResume(true);
+    packet.SetResumptionTicket(resumption_.peer_ticket);
+    packet.SetResumptionTicketMac(resumption_.peer_ticket_mac);
+    packet.SetInitialPacketSequenceNumber(sending_sequence_number_);
+    packet.SetMaximumPacketSize(Parameters::max_size);
+    packet.SetMaximumFlowWindowSize(Parameters::maximum_window_size);
+    packet.SetConnectionType(Parameters::connection_type);
+  } else {
+    packet.SetRequestNatDetectionPort(nat_type_ == NatType::kUnknown &&
+                                      !OnPrivateNetwork(peer_.PeerEndpoint()));
+  }
 
   int result(peer_.Send(packet));
   if (result != kSuccess)
@@ -258,7 +390,7 @@ void Session::SendCookie() {
   HandshakePacket packet;
   packet.SetPeerEndpoint(peer_.PeerEndpoint());
   packet.SetDestinationSocketId(peer_.SocketId());
-  packet.SetRudpVersion(4);
+  packet.SetRudpVersion(HandshakePacket::kRudpVersion);
   packet.SetSocketType(HandshakePacket::kStreamSocketType);
   packet.SetInitialPacketSequenceNumber(sending_sequence_number_);
   packet.SetMaximumPacketSize(Parameters::max_size);
@@ -266,13 +398,22 @@ void Session::SendCookie() {
   packet.SetConnectionType(Parameters::connection_type);
   packet.SetSocketId(id_);
   packet.set_node_id(this_node_id_);
-  packet.SetSynCookie(1);  // TODO(Team) calculate cookie
+  packet.SetSynCookie(syn_cookie_);
+  packet.SetResumed(resumed_);
+  // A peer predating tickets would fail to decode a packet carrying one.
+  if (peer_rudp_version_ >= HandshakePacket::kSessionTicketVersion) {
+    packet.SetResumptionTicket(issued_ticket_);
+    packet.SetResumptionTicketMac(SessionTickets::Instance().Mac(
+        this_node_id_, peer_.node_id(), issued_ticket_, peer_.PeerEndpoint()));
+  }
   packet.SetRequestNatDetectionPort(false);
   uint16_t port(0);
   if (peer_requested_nat_detection_port_)
     on_nat_detection_requested_(kThisLocalEndpoint_, peer_.node_id(), peer_.PeerEndpoint(), port);
   packet.SetNatDetectionPort(port);
-  packet.SetPublicKey(this_public_key_);
+  // A resumed peer already holds our key.
+  if (!resumed_)
+    packet.SetPublicKey(this_public_key_);
 
   int result(peer_.Send(packet));
   if (result != kSuccess)
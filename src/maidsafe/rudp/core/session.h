@@ -29,6 +29,7 @@ License.
 #include "maidsafe/common/rsa.h"
 
 #include "maidsafe/rudp/nat_type.h"
+#include "maidsafe/rudp/core/session_tickets.h"
 
 
 namespace maidsafe {
@@ -37,6 +38,7 @@ namespace rudp {
 
 namespace detail {
 
+class CongestionControl;
 class HandshakePacket;
 class Peer;
 class TickTimer;
@@ -80,6 +82,15 @@ class Session {
   // Get the peer connection type.
   uint32_t PeerConnectionType() const;
 
+  // Get whether the session was established by resuming an earlier one with the same peer.
+  bool Resumed() const;
+
+  // Seed "congestion_control" with the estimates saved when the resumed session closed.
+  void RestoreCongestion(CongestionControl& congestion_control) const;
+
+  // Save the estimates of a connected session in its ticket, for use if it's resumed.
+  void SaveCongestion(const CongestionControl& congestion_control);
+
   // Close the session. Clears the id.
   void Close();
 
@@ -110,6 +121,7 @@ class Session {
 
   void HandleHandshakeWhenProbing(const HandshakePacket& packet);
   void HandleHandshakeWhenHandshaking(const HandshakePacket& packet);
+  void HandleResumption(const HandshakePacket& packet);
 
   // The peer with which we are communicating.
   Peer& peer_;
@@ -147,6 +159,9 @@ class Session {
   // The peer's connection type.
   uint32_t peer_connection_type_;
 
+  // The protocol version in the peer's latest handshake, or 0 if none has been received.
+  uint32_t peer_rudp_version_;
+
   // Whether the peer requested another port to do NAT detection.
   bool peer_requested_nat_detection_port_;
 
@@ -159,6 +174,23 @@ class Session {
   // The state of the session.
   enum State { kClosed, kProbing, kHandshaking, kConnected } state_;
 
+  // When Open was called, for measuring the duration of the handshake.
+  boost::posix_time::ptime open_time_;
+
+  // The cookie last issued by the peer in reply to our connection request, echoed in subsequent
+  // requests.  0 until one is received.
+  uint32_t syn_cookie_;
+
+  // The ticket issued to the peer in our cookies, with which it can later resume this session.
+  uint32_t issued_ticket_;
+
+  // What is remembered of an earlier session with the peer.  If its peer_ticket is non-zero, our
+  // connection requests ask to resume that session.
+  SessionTicket resumption_;
+
+  // Whether the session was established by resumption.
+  bool resumed_;
+
   OnNatDetectionRequested on_nat_detection_requested_;
   boost::signals2::connection signal_connection_;
 };
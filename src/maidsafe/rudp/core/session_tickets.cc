@@ -0,0 +1,115 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/core/session_tickets.h"
+
+#include <algorithm>
+
+#include "maidsafe/rudp/parameters.h"
+#include "maidsafe/rudp/core/clock.h"
+
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+SessionTickets& SessionTickets::Instance() {
+  // Never destroyed, since sockets may be closed during the destruction of other statics.
+  static SessionTickets* tickets(new SessionTickets);
+  return *tickets;
+}
+
+SessionTickets::SessionTickets() : mutex_(), tickets_(), kMacKey_(SipHasher::RandomKey()) {}
+
+bool SessionTickets::Find(const NodeId& this_node_id, const NodeId& peer_id,
+                          SessionTicket& ticket) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(tickets_.find(std::make_pair(this_node_id, peer_id)));
+  if (itr == tickets_.end())
+    return false;
+  if (itr->second.second <= Clock::Now()) {
+    tickets_.erase(itr);
+    return false;
+  }
+  ticket = itr->second.first;
+  return true;
+}
+
+void SessionTickets::Store(const NodeId& this_node_id, const NodeId& peer_id,
+                           const SessionTicket& ticket) {
+  bptime::ptime now(Clock::Now());
+  std::lock_guard<std::mutex> lock(mutex_);
+  Key key(this_node_id, peer_id);
+  if (tickets_.size() >= kMaxTickets && tickets_.find(key) == tickets_.end()) {
+    for (auto itr(tickets_.begin()); itr != tickets_.end();) {
+      if (itr->second.second <= now)
+        itr = tickets_.erase(itr);
+      else
+        ++itr;
+    }
+    if (tickets_.size() >= kMaxTickets) {
+      tickets_.erase(std::min_element(
+          tickets_.begin(), tickets_.end(),
+          [](const TicketMap::value_type& lhs, const TicketMap::value_type& rhs) {
+            return lhs.second.second < rhs.second.second;
+          }));
+    }
+  }
+  tickets_[key] = std::make_pair(ticket, now + Parameters::session_ticket_lifetime);
+}
+
+uint64_t SessionTickets::Mac(const NodeId& this_node_id, const NodeId& peer_id,
+                             uint32_t issued_ticket,
+                             const boost::asio::ip::udp::endpoint& peer_endpoint) const {
+  SipHasher hasher(kMacKey_);
+  hasher.Update(issued_ticket);
+  hasher.Update(this_node_id);
+  hasher.Update(peer_id);
+  hasher.Update(peer_endpoint);
+  return hasher.Final();
+}
+
+bool SessionTickets::Redeem(const NodeId& this_node_id, const NodeId& peer_id,
+                            uint32_t issued_ticket, uint64_t mac,
+                            const boost::asio::ip::udp::endpoint& peer_endpoint,
+                            SessionTicket& ticket) {
+  if (issued_ticket == 0 || mac != Mac(this_node_id, peer_id, issued_ticket, peer_endpoint))
+    return false;
+  return Find(this_node_id, peer_id, ticket) && ticket.issued_ticket == issued_ticket;
+}
+
+void SessionTickets::Remove(const NodeId& this_node_id, const NodeId& peer_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tickets_.erase(std::make_pair(this_node_id, peer_id));
+}
+
+void SessionTickets::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tickets_.clear();
+}
+
+size_t SessionTickets::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tickets_.size();
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,124 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CORE_SESSION_TICKETS_H_
+#define MAIDSAFE_RUDP_CORE_SESSION_TICKETS_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "boost/asio/ip/udp.hpp"
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+#include "maidsafe/common/node_id.h"
+#include "maidsafe/common/rsa.h"
+
+#include "maidsafe/rudp/core/sip_hasher.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// What is remembered of a session with a peer, so that a new session with it can be resumed in a
+// single round trip rather than repeating the whole handshake.
+struct SessionTicket {
+  SessionTicket()
+      : issued_ticket(0),
+        peer_ticket(0),
+        peer_ticket_mac(0),
+        peer_public_key(),
+        peer_nat_detection_endpoint(),
+        peer_connection_type(0),
+        round_trip_time(0),
+        round_trip_time_variance(0),
+        packets_receiving_rate(0),
+        estimated_link_capacity(0),
+        send_window_size(0) {}
+
+  // The ticket this node issued to the peer, which the peer presents to resume.
+  uint32_t issued_ticket;
+  // The ticket the peer issued to this node, or 0 if none was received, and the peer's MAC of it
+  // which must be presented with it.
+  uint32_t peer_ticket;
+  uint64_t peer_ticket_mac;
+  std::shared_ptr<asymm::PublicKey> peer_public_key;
+  boost::asio::ip::udp::endpoint peer_nat_detection_endpoint;
+  uint32_t peer_connection_type;
+  // The congestion control estimates when the session closed, or 0 while it's still open.
+  uint32_t round_trip_time;
+  uint32_t round_trip_time_variance;
+  uint32_t packets_receiving_rate;
+  uint32_t estimated_link_capacity;
+  size_t send_window_size;
+};
+
+// The tickets of this process's nodes, keyed by this node's and the peer's IDs.  A ticket expires
+// Parameters::session_ticket_lifetime after it was last stored.  A ticket is issued along with a
+// MAC binding it to both nodes and to the endpoint of the peer it was issued to, so it can only be
+// redeemed by that peer from that endpoint.  All methods are thread-safe.
+class SessionTickets {
+ public:
+  enum { kMaxTickets = 4096 };
+
+  static SessionTickets& Instance();
+
+  // Returns false if there's no unexpired ticket for the pair of nodes.
+  bool Find(const NodeId& this_node_id, const NodeId& peer_id, SessionTicket& ticket);
+
+  // Adds or replaces the ticket for the pair of nodes, and restarts its lifetime.  If kMaxTickets
+  // are already held, the one closest to expiry is discarded.
+  void Store(const NodeId& this_node_id, const NodeId& peer_id, const SessionTicket& ticket);
+
+  // Get the MAC to be sent with "issued_ticket" to the peer at "peer_endpoint".
+  uint64_t Mac(const NodeId& this_node_id, const NodeId& peer_id, uint32_t issued_ticket,
+               const boost::asio::ip::udp::endpoint& peer_endpoint) const;
+
+  // As Find, but also returns false unless "issued_ticket" is the one this node issued to the peer,
+  // and "mac" is its MAC for a peer at "peer_endpoint".
+  bool Redeem(const NodeId& this_node_id, const NodeId& peer_id, uint32_t issued_ticket,
+              uint64_t mac, const boost::asio::ip::udp::endpoint& peer_endpoint,
+              SessionTicket& ticket);
+
+  void Remove(const NodeId& this_node_id, const NodeId& peer_id);
+
+  void Clear();
+
+  size_t Size() const;
+
+ private:
+  typedef std::pair<NodeId, NodeId> Key;
+  typedef std::map<Key, std::pair<SessionTicket, boost::posix_time::ptime>> TicketMap;
+
+  SessionTickets();
+  SessionTickets(const SessionTickets&);
+  SessionTickets& operator=(const SessionTickets&);
+
+  mutable std::mutex mutex_;
+  TicketMap tickets_;
+  const SipHasher::Key kMacKey_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_SESSION_TICKETS_H_
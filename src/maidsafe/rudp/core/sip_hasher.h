@@ -0,0 +1,138 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CORE_SIP_HASHER_H_
+#define MAIDSAFE_RUDP_CORE_SIP_HASHER_H_
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "boost/asio/ip/udp.hpp"
+
+#include "maidsafe/common/node_id.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Incremental SipHash-2-4, so that the fields of a packet can be hashed without being gathered
+// into a buffer first.  Used as a MAC for values which this node hands out and must later accept
+// only if they're returned unaltered.
+class SipHasher {
+ public:
+  typedef std::array<uint64_t, 2> Key;
+
+  explicit SipHasher(const Key& key)
+      : v0_(key[0] ^ 0x736f6d6570736575ULL),
+        v1_(key[1] ^ 0x646f72616e646f6dULL),
+        v2_(key[0] ^ 0x6c7967656e657261ULL),
+        v3_(key[1] ^ 0x7465646279746573ULL),
+        tail_(0),
+        length_(0) {}
+
+  static Key RandomKey() {
+    std::string random(RandomString(sizeof(Key)));
+    Key key;
+    std::memcpy(&key[0], random.data(), sizeof(Key));
+    return key;
+  }
+
+  void Update(const unsigned char* data, size_t size) {
+    for (size_t i(0); i != size; ++i) {
+      tail_ |= static_cast<uint64_t>(data[i]) << (8 * (length_ % 8));
+      if (++length_ % 8 == 0) {
+        Compress(tail_);
+        tail_ = 0;
+      }
+    }
+  }
+
+  void Update(uint32_t n) {
+    unsigned char bytes[4] = { static_cast<unsigned char>(n >> 24),
+                               static_cast<unsigned char>(n >> 16),
+                               static_cast<unsigned char>(n >> 8),
+                               static_cast<unsigned char>(n) };
+    Update(bytes, sizeof(bytes));
+  }
+
+  void Update(const NodeId& node_id) {
+    const std::string& id(node_id.string());
+    Update(reinterpret_cast<const unsigned char*>(id.data()), id.size());
+  }
+
+  void Update(const boost::asio::ip::udp::endpoint& endpoint) {
+    if (endpoint.address().is_v4()) {
+      auto bytes(endpoint.address().to_v4().to_bytes());
+      Update(&bytes[0], bytes.size());
+    } else {
+      auto bytes(endpoint.address().to_v6().to_bytes());
+      Update(&bytes[0], bytes.size());
+    }
+    unsigned char port[2] = { static_cast<unsigned char>(endpoint.port() >> 8),
+                              static_cast<unsigned char>(endpoint.port()) };
+    Update(port, sizeof(port));
+  }
+
+  uint64_t Final() {
+    Compress(tail_ | (static_cast<uint64_t>(length_) << 56));
+    v2_ ^= 0xff;
+    for (int i(0); i != 4; ++i)
+      Round();
+    return v0_ ^ v1_ ^ v2_ ^ v3_;
+  }
+
+ private:
+  static uint64_t RotateLeft(uint64_t x, int b) { return (x << b) | (x >> (64 - b)); }
+
+  void Round() {
+    v0_ += v1_;
+    v1_ = RotateLeft(v1_, 13);
+    v1_ ^= v0_;
+    v0_ = RotateLeft(v0_, 32);
+    v2_ += v3_;
+    v3_ = RotateLeft(v3_, 16);
+    v3_ ^= v2_;
+    v0_ += v3_;
+    v3_ = RotateLeft(v3_, 21);
+    v3_ ^= v0_;
+    v2_ += v1_;
+    v1_ = RotateLeft(v1_, 17);
+    v1_ ^= v2_;
+    v2_ = RotateLeft(v2_, 32);
+  }
+
+  void Compress(uint64_t m) {
+    v3_ ^= m;
+    Round();
+    Round();
+    v0_ ^= m;
+  }
+
+  uint64_t v0_, v1_, v2_, v3_, tail_;
+  size_t length_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_SIP_HASHER_H_
@@ -145,6 +145,11 @@ class SlidingWindow {
   // Get the sequence number that follows a given number.
   static uint32_t Next(uint32_t n) { return (n == kMaxSequenceNumber) ? 0 : n + 1; }
 
+  // Get the sequence number that precedes a given number.
+  static uint32_t Previous(uint32_t n) {
+    return (n == 0) ? static_cast<uint32_t>(kMaxSequenceNumber) : n - 1;
+  }
+
  private:
   // Disallow copying and assignment.
   SlidingWindow(const SlidingWindow&);
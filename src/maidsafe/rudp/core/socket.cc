@@ -27,12 +27,18 @@ License.
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/utils.h"
 
+#include "maidsafe/rudp/core/metrics.h"
 #include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/trace.h"
 #include "maidsafe/rudp/packets/ack_of_ack_packet.h"
 #include "maidsafe/rudp/packets/ack_packet.h"
 #include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/packets/datagram_packet.h"
+#include "maidsafe/rudp/packets/fec_packet.h"
 #include "maidsafe/rudp/packets/handshake_packet.h"
 #include "maidsafe/rudp/packets/keepalive_packet.h"
+#include "maidsafe/rudp/packets/message_drop_packet.h"
+#include "maidsafe/rudp/packets/mtu_probe_packet.h"
 #include "maidsafe/rudp/packets/negative_ack_packet.h"
 #include "maidsafe/rudp/packets/shutdown_packet.h"
 
@@ -59,11 +65,10 @@ Socket::Socket(Multiplexer& multiplexer, NatType& nat_type)  // NOLINT (Fraser)
       receiver_(peer_, tick_timer_, congestion_control_),
       waiting_connect_(multiplexer.socket_.get_io_service()),
       waiting_connect_ec_(),
-      waiting_write_(multiplexer.socket_.get_io_service()),
-      waiting_write_buffer_(),
-      waiting_write_ec_(),
-      waiting_write_bytes_transferred_(0),
-      waiting_write_message_number_(0),
+      io_service_(multiplexer.socket_.get_io_service()),
+      pending_writes_(),
+      write_scheduler_(Parameters::default_window_size),
+      last_message_number_(0),
       message_sent_functors_(),
       waiting_read_(multiplexer.socket_.get_io_service()),
       waiting_read_buffer_(),
@@ -75,9 +80,12 @@ Socket::Socket(Multiplexer& multiplexer, NatType& nat_type)  // NOLINT (Fraser)
       waiting_probe_(multiplexer.socket_.get_io_service()),
       waiting_probe_ec_(),
       waiting_flush_(multiplexer.socket_.get_io_service()),
-      waiting_flush_ec_() {
+      waiting_flush_ec_(),
+      message_received_functor_(),
+      datagram_received_functor_(),
+      stats_mutex_(),
+      stats_snapshot_() {
   waiting_connect_.expires_at(bptime::pos_infin);
-  waiting_write_.expires_at(bptime::pos_infin);
   waiting_read_.expires_at(bptime::pos_infin);
   waiting_flush_.expires_at(bptime::pos_infin);
 }
@@ -93,6 +101,28 @@ uint32_t Socket::Id() const { return session_.Id(); }
 
 int32_t Socket::BestReadBufferSize() const { return congestion_control_.BestReadBufferSize(); }
 
+void Socket::GetStats(ConnectionStats& stats) const {
+  stats.peer_endpoint = peer_.PeerEndpoint();
+  stats.round_trip_time = congestion_control_.RoundTripTime();
+  stats.round_trip_time_variance = congestion_control_.RoundTripTimeVariance();
+  stats.packets_receiving_rate = congestion_control_.PacketsReceivingRate();
+  stats.estimated_link_capacity = congestion_control_.EstimatedLinkCapacity();
+  stats.send_window_size = congestion_control_.SendWindowSize();
+  stats.receive_window_size = congestion_control_.ReceiveWindowSize();
+  stats.send_data_size = congestion_control_.SendDataSize();
+  sender_.GetStats(stats);
+  receiver_.GetStats(stats);
+  stats.send_queue_messages = pending_writes_.size();
+  stats.send_queue_bytes = 0;
+  for (const auto& pending_write : pending_writes_)
+    stats.send_queue_bytes += asio::buffer_size(pending_write.second.buffer);
+}
+
+ConnectionStats Socket::StatsSnapshot() const {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  return stats_snapshot_;
+}
+
 ip::udp::endpoint Socket::PeerEndpoint() const { return peer_.PeerEndpoint(); }
 
 uint32_t Socket::PeerSocketId() const { return peer_.SocketId(); }
@@ -120,6 +150,7 @@ void Socket::NotifyClose() {
 }
 
 void Socket::Close() {
+  session_.SaveCongestion(congestion_control_);
   waiting_connect_ec_ = session_.IsConnected() ? boost::system::error_code() :
                                                  asio::error::operation_aborted;
   if (session_.IsOpen()) {
@@ -131,9 +162,12 @@ void Socket::Close() {
   peer_.SetSocketId(0);
   tick_timer_.Cancel();
   waiting_connect_.cancel();
-  waiting_write_ec_ = asio::error::operation_aborted;
-  waiting_write_bytes_transferred_ = 0;
-  waiting_write_.cancel();
+  for (auto& pending_write : pending_writes_) {
+    io_service_.post(std::bind(pending_write.second.handler,
+                               bs::error_code(asio::error::operation_aborted), 0));
+  }
+  pending_writes_.clear();
+  write_scheduler_.Clear();
   waiting_read_ec_ = asio::error::operation_aborted;
   waiting_read_bytes_transferred_ = 0;
   waiting_read_.cancel();
@@ -179,40 +213,81 @@ void Socket::StartProbe() {
 }
 
 void Socket::StartWrite(const asio::const_buffer& data,
-                        const std::function<void(int)>& message_sent_functor) {  // NOLINT (Fraser)
+                        const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
+                        const WriteHandlerFunctor& handler,
+                        const SendOptions& options) {
   // Check for a no-op write.
   if (asio::buffer_size(data) == 0) {
-    waiting_write_ec_.clear();
-    waiting_write_.cancel();
+    io_service_.post(std::bind(handler, bs::error_code(), 0));
     return;
   }
 
   // Try processing the write immediately. If there's space in the write buffer then the operation
   // will complete immediately. Otherwise, it will wait until some other event frees up space in the
   // buffer.
-  waiting_write_buffer_ = data;
-  waiting_write_bytes_transferred_ = 0;
-  ++waiting_write_message_number_;
-  message_sent_functors_[waiting_write_message_number_] = message_sent_functor;
+  bptime::ptime deadline(bptime::pos_infin);
+  if (!options.in_order && !options.time_to_live.is_pos_infinity()) {
+    deadline = tick_timer_.Now() + options.time_to_live;
+    tick_timer_.TickAt(deadline);
+  }
+  ++last_message_number_;
+  pending_writes_.insert(std::make_pair(last_message_number_,
+                                        PendingWrite(data, handler, options.in_order, deadline)));
+  write_scheduler_.Add(last_message_number_, asio::buffer_size(data), options);
+  bptime::ptime start_time(tick_timer_.Now());
+  message_sent_functors_[last_message_number_] = [message_sent_functor, start_time](int result) {
+    if (result == kSuccess)
+      Metrics::Instance().message_latency.Record(TickTimer::Now() - start_time);
+    message_sent_functor(result);
+  };
   ProcessWrite();
 }
 
 void Socket::ProcessWrite() {
-  // There's only a waiting write if the write buffer is non-empty.
-  if (asio::buffer_size(waiting_write_buffer_) == 0)
+  if (pending_writes_.empty())
     return;
 
-  // Copy whatever data we can into the write buffer.
-  size_t length(sender_.AddData(waiting_write_buffer_, waiting_write_message_number_));
-  waiting_write_buffer_ = waiting_write_buffer_ + length;
-  waiting_write_bytes_transferred_ += length;
-  // If we have finished writing all of the data then it's time to trigger the write's completion
-  // handler.
-  if (asio::buffer_size(waiting_write_buffer_) == 0) {
-    // The write is done. Trigger the write's completion handler.
-    waiting_write_ec_.clear();
-    waiting_write_.cancel();
+  // Copy whatever data we can into the write buffer, a packet at a time from whichever write the
+  // scheduler chooses.  The sender sends at most one packet per call, so it's called once for each
+  // packet added, or once anyway in case packets already in the window are waiting to be sent.
+  bool added(false);
+  uint32_t message_number(0);
+  while (write_scheduler_.Next(congestion_control_.SendDataSize(), message_number)) {
+    auto itr(pending_writes_.find(message_number));
+    BOOST_ASSERT(itr != pending_writes_.end());
+    PendingWrite& write(itr->second);
+    size_t length(sender_.AddPacket(write.buffer, message_number, write.bytes_transferred == 0,
+                                    write.in_order, write.deadline));
+    if (length == 0)
+      break;
+    added = true;
+    sender_.SendPackets();
+    write_scheduler_.OnPacketAdded(message_number, length);
+    write.buffer = write.buffer + length;
+    write.bytes_transferred += length;
+    // If we have finished writing all of the data then it's time to trigger the write's completion
+    // handler.
+    if (asio::buffer_size(write.buffer) == 0) {
+      io_service_.post(std::bind(write.handler, bs::error_code(), write.bytes_transferred));
+      pending_writes_.erase(itr);
+    }
   }
+  if (!added)
+    sender_.SendPackets();
+}
+
+ReturnCode Socket::SendDatagram(const std::string& data) {
+  if (!session_.IsConnected())
+    return kSendFailure;
+  return sender_.SendDatagram(data);
+}
+
+void Socket::SetMessageReceivedFunctor(const MessageReceivedFunctor& message_received_functor) {
+  message_received_functor_ = message_received_functor;
+}
+
+void Socket::SetDatagramReceivedFunctor(const MessageReceivedFunctor& datagram_received_functor) {
+  datagram_received_functor_ = datagram_received_functor;
 }
 
 void Socket::StartRead(const asio::mutable_buffer& data, size_t transfer_at_least) {
@@ -272,6 +347,10 @@ void Socket::HandleReceiveFrom(const asio::const_buffer& data, const ip::udp::en
     HandshakePacket handshake_packet;
     ShutdownPacket shutdown_packet;
     KeepalivePacket keepalive_packet;
+    MtuProbePacket mtu_probe_packet;
+    DatagramPacket datagram_packet;
+    MessageDropPacket message_drop_packet;
+    FecPacket fec_packet;
     if (data_packet.Decode(data)) {
       HandleData(data_packet);
     } else if (ack_packet.Decode(data)) {
@@ -286,9 +365,19 @@ void Socket::HandleReceiveFrom(const asio::const_buffer& data, const ip::udp::en
       HandleHandshake(handshake_packet);
     } else if (shutdown_packet.Decode(data)) {
       Close();
+    } else if (datagram_packet.Decode(data)) {
+      HandleDatagram(datagram_packet);
+    } else if (mtu_probe_packet.Decode(data)) {
+      HandleMtuProbe(mtu_probe_packet);
+    } else if (message_drop_packet.Decode(data)) {
+      HandleMessageDrop(message_drop_packet);
+    } else if (fec_packet.Decode(data)) {
+      HandleFec(fec_packet);
     } else {
+      Metrics::Instance().decode_failures.Add();
       LOG(kWarning) << "Socket " << session_.Id() << " ignoring invalid packet from " << endpoint;
     }
+    UpdateStatsSnapshot();
   } else {
     LOG(kWarning) << "Socket " << session_.Id() << " ignoring spurious packet from " << endpoint;
   }
@@ -311,6 +400,7 @@ void Socket::HandleHandshake(const HandshakePacket& packet) {
       congestion_control_.OnOpen(sender_.GetNextPacketSequenceNumber(),
                                  session_.ReceivingSequenceNumber());
       congestion_control_.SetPeerConnectionType(session_.PeerConnectionType());
+      session_.RestoreCongestion(congestion_control_);
       receiver_.Reset(session_.ReceivingSequenceNumber());
       waiting_connect_ec_.clear();
       waiting_connect_.cancel();
@@ -343,7 +433,12 @@ void Socket::HandleKeepalive(const KeepalivePacket& packet) {
 
 void Socket::HandleData(const DataPacket& packet) {
   if (session_.IsConnected()) {
-    receiver_.HandleData(packet);
+    std::vector<std::string> unordered_messages;
+    receiver_.HandleData(packet, unordered_messages);
+    if (message_received_functor_) {
+      for (const auto& message : unordered_messages)
+        message_received_functor_(message);
+    }
     ProcessRead();
     ProcessWrite();
   }
@@ -383,8 +478,70 @@ void Socket::HandleNegativeAck(const NegativeAckPacket& packet) {
   }
 }
 
+void Socket::HandleDatagram(const DatagramPacket& packet) {
+  if (session_.IsConnected() && receiver_.HandleDatagram(packet) && datagram_received_functor_)
+    datagram_received_functor_(packet.Data());
+}
+
+void Socket::HandleMtuProbe(const MtuProbePacket& packet) {
+  if (session_.IsConnected())
+    sender_.HandleMtuProbe(packet);
+}
+
+void Socket::HandleFec(const FecPacket& packet) {
+  DataPacket recovered_packet;
+  if (session_.IsConnected() && receiver_.HandleFec(packet, recovered_packet))
+    HandleData(recovered_packet);
+}
+
+void Socket::HandleMessageDrop(const MessageDropPacket& packet) {
+  if (session_.IsConnected()) {
+    receiver_.HandleMessageDrop(packet);
+    ProcessRead();
+  }
+}
+
+void Socket::ExpireWrites() {
+  std::vector<uint32_t> expired_message_numbers;
+  sender_.DropExpiredMessages(expired_message_numbers);
+
+  // Writes not yet wholly added to the sender's window are abandoned too.
+  bptime::ptime now(tick_timer_.Now()), next_deadline(bptime::pos_infin);
+  for (auto itr(pending_writes_.begin()); itr != pending_writes_.end();) {
+    PendingWrite& write(itr->second);
+    if (write.deadline <= now) {
+      write_scheduler_.Remove(itr->first);
+      io_service_.post(std::bind(write.handler, bs::error_code(asio::error::timed_out),
+                                 write.bytes_transferred));
+      if (std::find(expired_message_numbers.begin(), expired_message_numbers.end(),
+                    itr->first) == expired_message_numbers.end()) {
+        expired_message_numbers.push_back(itr->first);
+      }
+      itr = pending_writes_.erase(itr);
+    } else {
+      next_deadline = std::min(next_deadline, write.deadline);
+      ++itr;
+    }
+  }
+  if (!next_deadline.is_special())
+    tick_timer_.TickAt(next_deadline);
+
+  for (auto num : expired_message_numbers) {
+    auto itr(message_sent_functors_.find(num));
+    if (itr != message_sent_functors_.end()) {
+      LOG(kVerbose) << "Socket " << session_.Id() << " abandoning message " << num
+                    << " to " << peer_.PeerEndpoint() << " - timed out.";
+      auto message_sent_functor(itr->second);
+      message_sent_functors_.erase(itr);
+      message_sent_functor(kMessageTimedOut);
+    }
+  }
+}
+
 void Socket::HandleTick() {
+  Trace::Record(TraceEvent::kTick, peer_.SocketId());
   if (session_.IsConnected()) {
+    ExpireWrites();
     sender_.HandleTick();
     receiver_.HandleTick();
     ProcessRead();
@@ -393,6 +550,14 @@ void Socket::HandleTick() {
   } else {
     session_.HandleTick();
   }
+  UpdateStatsSnapshot();
+}
+
+void Socket::UpdateStatsSnapshot() {
+  ConnectionStats stats;
+  GetStats(stats);
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  stats_snapshot_ = stats;
 }
 
 void Socket::MakeNormal() { session_.MakeNormal(); }
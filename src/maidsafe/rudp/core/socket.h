@@ -23,6 +23,7 @@ License.
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 
 #include "boost/asio/buffer.hpp"
 #include "boost/asio/deadline_timer.hpp"
@@ -39,16 +40,18 @@ License.
 #include "maidsafe/rudp/core/sender.h"
 #include "maidsafe/rudp/core/session.h"
 #include "maidsafe/rudp/core/tick_timer.h"
+#include "maidsafe/rudp/core/write_scheduler.h"
 
 #include "maidsafe/rudp/operations/connect_op.h"
 #include "maidsafe/rudp/operations/flush_op.h"
 #include "maidsafe/rudp/operations/probe_op.h"
 #include "maidsafe/rudp/operations/read_op.h"
 #include "maidsafe/rudp/operations/tick_op.h"
-#include "maidsafe/rudp/operations/write_op.h"
 
+#include "maidsafe/rudp/connection_stats.h"
 #include "maidsafe/rudp/nat_type.h"
 #include "maidsafe/rudp/parameters.h"
+#include "maidsafe/rudp/send_options.h"
 
 namespace maidsafe {
 
@@ -59,14 +62,20 @@ namespace detail {
 class AckPacket;
 class AckOfAckPacket;
 class DataPacket;
+class DatagramPacket;
 class Dispatcher;
+class FecPacket;
 class HandshakePacket;
 class KeepalivePacket;
+class MessageDropPacket;
+class MtuProbePacket;
 class NegativeAckPacket;
 
 
 class Socket {
  public:
+  typedef std::function<void(const std::string& /*message*/)> MessageReceivedFunctor;
+
   Socket(Multiplexer& multiplexer, NatType& nat_type);  // NOLINT (Fraser)
   ~Socket();
 
@@ -108,6 +117,13 @@ class Socket {
   // Return the best read-buffer size calculated by congestion_control
   int32_t BestReadBufferSize() const;
 
+  // Fill in "stats" with the current state of the connection.  Must be called on the strand.
+  void GetStats(ConnectionStats& stats) const;
+
+  // Returns the state of the connection as of the most recent tick or packet received.  Safe to
+  // call on any thread.
+  ConnectionStats StatsSnapshot() const;
+
   // Calculate if the transmission speed is too slow
   bool IsSlowTransmission(size_t length) { return congestion_control_.IsSlowTransmission(length); }
 
@@ -145,16 +161,33 @@ class Socket {
   // generally complete immediately unless congestion has caused the internal
   // buffer for unprocessed send data to fill up. when the operation completes, the handler is
   // invoked, but the message_sent_functor is not invoked until the last packet of the message has
-  // been acknowledged by the peer.
+  // been acknowledged by the peer.  Any number of writes may be outstanding, each being a separate
+  // message; their packets are interleaved according to options.priority and options.weight (see
+  // WriteScheduler).  If options.in_order is true, the data forms part of the ordered stream read
+  // via AsyncRead, and is written only after any earlier in-order writes.  Otherwise, the data is a
+  // whole message which the peer passes to its message received functor as soon as it has fully
+  // arrived.  Such a message is abandoned if not acknowledged within options.time_to_live: the
+  // handler (if still pending) gets asio::error::timed_out and message_sent_functor gets
+  // kMessageTimedOut.  The time to live of in-order data is ignored.
   template <typename WriteHandler>
   void AsyncWrite(const boost::asio::const_buffer& data,
                   const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
-                  WriteHandler handler) {
-    WriteOp<WriteHandler> op(handler, waiting_write_ec_, waiting_write_bytes_transferred_);
-    waiting_write_.async_wait(op);
-    StartWrite(data, message_sent_functor);
+                  WriteHandler handler,
+                  const SendOptions& options = SendOptions()) {
+    StartWrite(data, message_sent_functor, WriteHandlerFunctor(handler), options);
   }
 
+  // Send a message in a single unreliable datagram.  It is never retransmitted, and the peer's
+  // datagram received functor is invoked at most once for it.
+  ReturnCode SendDatagram(const std::string& data);
+
+  // Set the functor to be invoked with each unordered message received, i.e. each message which
+  // bypasses the ordered stream read via AsyncRead.
+  void SetMessageReceivedFunctor(const MessageReceivedFunctor& message_received_functor);
+
+  // Set the functor to be invoked with each datagram received.
+  void SetDatagramReceivedFunctor(const MessageReceivedFunctor& datagram_received_functor);
+
   // Initiate an asynchronous operation to read data.
   template <typename ReadHandler>
   void AsyncRead(const boost::asio::mutable_buffer& data,
@@ -208,8 +241,12 @@ class Socket {
       const NodeId& peer_node_id,
       Session::Mode open_mode,
       const Session::OnNatDetectionRequested::slot_type& on_nat_detection_requested_slot);
+  typedef std::function<void(const boost::system::error_code&, size_t)> WriteHandlerFunctor;
+
   void StartWrite(const boost::asio::const_buffer& data,
-                  const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
+                  const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
+                  const WriteHandlerFunctor& handler,
+                  const SendOptions& options);
   void ProcessWrite();
   void StartRead(const boost::asio::mutable_buffer& data, size_t transfer_at_least);
   void ProcessRead();
@@ -240,10 +277,28 @@ class Socket {
   // Called to process a newly received Keepalive packet.
   void HandleKeepalive(const KeepalivePacket& packet);
 
+  // Called to process a newly received datagram packet.
+  void HandleDatagram(const DatagramPacket& packet);
+
+  // Called to process a newly received path MTU probe packet.
+  void HandleMtuProbe(const MtuProbePacket& packet);
+
+  // Called to process a newly received forward error correction repair packet.
+  void HandleFec(const FecPacket& packet);
+
+  // Called to process a newly received message drop packet.
+  void HandleMessageDrop(const MessageDropPacket& packet);
+
+  // Abandons writes whose time to live has passed.
+  void ExpireWrites();
+
   // Called to handle a tick event.
   void HandleTick();
   friend void DispatchTick(Socket& socket) { socket.HandleTick(); }
 
+  // Refreshes stats_snapshot_ from the current state of the connection.
+  void UpdateStatsSnapshot();
+
   // The dispatcher that holds this sockets registration.
   Dispatcher& dispatcher_;
 
@@ -273,14 +328,30 @@ class Socket {
   boost::asio::deadline_timer waiting_connect_;
   boost::system::error_code waiting_connect_ec_;
 
-  // This class allows only one outstanding asynchronous write operation at a
-  // time. The following data members store the pending write, and the result
-  // that is intended for its completion handler.
-  boost::asio::deadline_timer waiting_write_;
-  boost::asio::const_buffer waiting_write_buffer_;
-  boost::system::error_code waiting_write_ec_;
-  size_t waiting_write_bytes_transferred_;
-  uint32_t waiting_write_message_number_;
+  // This class allows any number of outstanding asynchronous write operations.  The following data
+  // members store the pending writes, indexed by message number, and decide which of them supplies
+  // each packet added to the sender's window.  Completion handlers are posted to io_service_.
+  struct PendingWrite {
+    PendingWrite(const boost::asio::const_buffer& buffer_in,
+                 const WriteHandlerFunctor& handler_in,
+                 bool in_order_in,
+                 const boost::posix_time::ptime& deadline_in)
+        : buffer(buffer_in),
+          bytes_transferred(0),
+          in_order(in_order_in),
+          deadline(deadline_in),
+          handler(handler_in) {}
+    // The part of the data not yet added to the sender's window.
+    boost::asio::const_buffer buffer;
+    size_t bytes_transferred;
+    bool in_order;
+    boost::posix_time::ptime deadline;
+    WriteHandlerFunctor handler;
+  };
+  boost::asio::io_service& io_service_;
+  std::map<uint32_t, PendingWrite> pending_writes_;
+  WriteScheduler write_scheduler_;
+  uint32_t last_message_number_;
   std::map<uint32_t, std::function<void(int)>> message_sent_functors_;  // NOLINT (Fraser)
 
   // This class allows only one outstanding asynchronous read operation at a
@@ -301,6 +372,17 @@ class Socket {
   // intended for its completion handler.
   boost::asio::deadline_timer waiting_flush_;
   boost::system::error_code waiting_flush_ec_;
+
+  // Invoked with each unordered message received.
+  MessageReceivedFunctor message_received_functor_;
+
+  // Invoked with each datagram received.
+  MessageReceivedFunctor datagram_received_functor_;
+
+  // A copy of the statistics taken on each tick and packet received, so they can be read off the
+  // strand.
+  mutable std::mutex stats_mutex_;
+  ConnectionStats stats_snapshot_;
 };
 
 }  // namespace detail
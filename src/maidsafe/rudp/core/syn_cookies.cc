@@ -0,0 +1,78 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/core/syn_cookies.h"
+
+#include "maidsafe/rudp/parameters.h"
+#include "maidsafe/rudp/core/clock.h"
+
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+SynCookies::SynCookies()
+    : mutex_(),
+      current_key_(SipHasher::RandomKey()),
+      previous_key_(SipHasher::RandomKey()),
+      rotation_time_(Clock::Now() + Parameters::syn_cookie_lifetime) {}
+
+uint32_t SynCookies::Generate(const boost::asio::ip::udp::endpoint& endpoint,
+                              const NodeId& node_id, uint32_t socket_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Rotate();
+  return Calculate(current_key_, endpoint, node_id, socket_id);
+}
+
+bool SynCookies::Validate(uint32_t cookie, const boost::asio::ip::udp::endpoint& endpoint,
+                          const NodeId& node_id, uint32_t socket_id) {
+  if (cookie == 0)
+    return false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  Rotate();
+  return cookie == Calculate(current_key_, endpoint, node_id, socket_id) ||
+         cookie == Calculate(previous_key_, endpoint, node_id, socket_id);
+}
+
+void SynCookies::Rotate() {
+  bptime::ptime now(Clock::Now());
+  if (now < rotation_time_)
+    return;
+  // If a whole lifetime has passed since the last rotation, no outstanding cookie should survive.
+  previous_key_ = (now < rotation_time_ + Parameters::syn_cookie_lifetime) ?
+                      current_key_ : SipHasher::RandomKey();
+  current_key_ = SipHasher::RandomKey();
+  rotation_time_ = now + Parameters::syn_cookie_lifetime;
+}
+
+uint32_t SynCookies::Calculate(const Key& key, const boost::asio::ip::udp::endpoint& endpoint,
+                               const NodeId& node_id, uint32_t socket_id) {
+  SipHasher hasher(key);
+  hasher.Update(endpoint);
+  hasher.Update(socket_id);
+  hasher.Update(node_id);
+  uint64_t hash(hasher.Final());
+  uint32_t cookie(static_cast<uint32_t>(hash ^ (hash >> 32)));
+  return cookie == 0 ? 1 : cookie;
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
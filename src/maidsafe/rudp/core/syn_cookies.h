@@ -0,0 +1,77 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CORE_SYN_COOKIES_H_
+#define MAIDSAFE_RUDP_CORE_SYN_COOKIES_H_
+
+#include <cstdint>
+#include <mutex>
+
+#include "boost/asio/ip/udp.hpp"
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+#include "maidsafe/common/node_id.h"
+
+#include "maidsafe/rudp/core/sip_hasher.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Stateless cookies for unsolicited connection requests.  Rather than allocating a connection for
+// every request from a new endpoint, the ConnectionManager replies with a cookie which is a keyed
+// hash (SipHash-2-4) of the requester's endpoint, node ID and socket ID.  Only a request echoing a
+// valid cookie - proving that the requester can receive at its claimed endpoint - is given a
+// connection.  The secret key is replaced every Parameters::syn_cookie_lifetime, and the previous
+// key is still accepted, so a cookie remains valid for between one and two lifetimes.
+class SynCookies {
+ public:
+  SynCookies();
+
+  // Get the cookie for a request.  Never returns 0, which denotes the absence of a cookie.
+  uint32_t Generate(const boost::asio::ip::udp::endpoint& endpoint, const NodeId& node_id,
+                    uint32_t socket_id);
+
+  // Determine whether "cookie" was generated for these values under the current or previous key.
+  bool Validate(uint32_t cookie, const boost::asio::ip::udp::endpoint& endpoint,
+                const NodeId& node_id, uint32_t socket_id);
+
+ private:
+  typedef SipHasher::Key Key;
+
+  // Disallow copying and assignment.
+  SynCookies(const SynCookies&);
+  SynCookies& operator=(const SynCookies&);
+
+  // Replace the keys if the current one has expired.  Requires mutex_ to be held.
+  void Rotate();
+
+  static uint32_t Calculate(const Key& key, const boost::asio::ip::udp::endpoint& endpoint,
+                            const NodeId& node_id, uint32_t socket_id);
+
+  std::mutex mutex_;
+  Key current_key_, previous_key_;
+  boost::posix_time::ptime rotation_time_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_SYN_COOKIES_H_
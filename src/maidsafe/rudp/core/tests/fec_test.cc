@@ -0,0 +1,182 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/fec.h"
+#include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/packets/fec_packet.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+const size_t kMaxDataSize(1000);
+
+DataPacket MakePacket(uint32_t sequence_number, std::mt19937& generator) {
+  DataPacket packet;
+  packet.SetPacketSequenceNumber(sequence_number);
+  packet.SetFirstPacketInMessage(sequence_number % 3 == 0);
+  packet.SetLastPacketInMessage(sequence_number % 3 == 2);
+  packet.SetInOrder(sequence_number % 2 == 0);
+  packet.SetMessageNumber((sequence_number / 3) & 0x1fffffff);
+  std::string data(1 + generator() % kMaxDataSize, '\0');
+  for (auto& c : data)
+    c = static_cast<char>(generator());
+  packet.SetData(data);
+  return packet;
+}
+
+// Reports enough losses over one sample for the encoder to start protecting blocks.
+void StartEncoder(FecEncoder& encoder, std::mt19937& generator) {
+  FecPacket repair_packet;
+  for (uint32_t n(0); n != 256; ++n) {
+    if (n % 64 == 0)
+      encoder.OnPacketLost();
+    encoder.Add(MakePacket(0x7fffff00 + n, generator), kMaxDataSize, repair_packet);
+  }
+}
+
+}  // unnamed namespace
+
+TEST(FecTest, BEH_XorInto) {
+  std::mt19937 generator(1);
+  for (size_t size(0); size != 70; ++size) {
+    std::vector<unsigned char> destination(size + 1), source(size + 1), expected;
+    for (size_t i(0); i != size + 1; ++i) {
+      destination[i] = static_cast<unsigned char>(generator());
+      source[i] = static_cast<unsigned char>(generator());
+    }
+    expected = destination;
+    for (size_t i(0); i != size; ++i)
+      expected[i + 1] ^= source[i];
+    // Deliberately misaligned.
+    XorInto(&destination[1], &source[0], size);
+    EXPECT_EQ(expected, destination);
+  }
+}
+
+TEST(FecTest, BEH_RecoverSingleLoss) {
+  std::mt19937 generator(2);
+  FecEncoder encoder;
+  EXPECT_EQ(0U, encoder.BlockSize());
+  StartEncoder(encoder, generator);
+  size_t block_size(encoder.BlockSize());
+  ASSERT_GE(block_size, static_cast<size_t>(kFecMinBlockSize));
+  ASSERT_LE(block_size, static_cast<size_t>(kFecMaxBlockSize));
+
+  // Blocks wrap around the end of the sequence number space.
+  FecDecoder decoder;
+  FecPacket repair_packet;
+  uint32_t first(0x80000000 - static_cast<uint32_t>(block_size));
+  for (uint32_t block(0); block != 4; ++block) {
+    uint32_t lost(static_cast<uint32_t>(block * 3 % block_size));
+    DataPacket lost_packet;
+    for (uint32_t i(0); i != block_size; ++i) {
+      uint32_t sequence_number((first + block * block_size + i) & 0x7fffffff);
+      DataPacket packet(MakePacket(sequence_number, generator));
+      EXPECT_EQ(i + 1 == block_size, encoder.Add(packet, kMaxDataSize, repair_packet));
+      if (i == lost)
+        lost_packet = packet;
+      else
+        decoder.Add(packet);
+    }
+
+    DataPacket recovered_packet;
+    ASSERT_TRUE(decoder.Recover(repair_packet, recovered_packet));
+    EXPECT_EQ(block_size, decoder.BlockSize());
+    EXPECT_EQ(lost_packet.PacketSequenceNumber(), recovered_packet.PacketSequenceNumber());
+    EXPECT_EQ(lost_packet.FirstPacketInMessage(), recovered_packet.FirstPacketInMessage());
+    EXPECT_EQ(lost_packet.LastPacketInMessage(), recovered_packet.LastPacketInMessage());
+    EXPECT_EQ(lost_packet.InOrder(), recovered_packet.InOrder());
+    EXPECT_EQ(lost_packet.MessageNumber(), recovered_packet.MessageNumber());
+    EXPECT_EQ(lost_packet.Data(), recovered_packet.Data());
+
+    // Nothing to recover once the packet is held.
+    decoder.Add(recovered_packet);
+    EXPECT_FALSE(decoder.Recover(repair_packet, recovered_packet));
+  }
+}
+
+TEST(FecTest, BEH_NoRecoveryOfTwoLosses) {
+  std::mt19937 generator(3);
+  FecEncoder encoder;
+  StartEncoder(encoder, generator);
+  size_t block_size(encoder.BlockSize());
+  ASSERT_NE(0U, block_size);
+
+  FecDecoder decoder;
+  FecPacket repair_packet;
+  for (uint32_t i(0); i != block_size; ++i) {
+    DataPacket packet(MakePacket(static_cast<uint32_t>(block_size * 10 + i), generator));
+    encoder.Add(packet, kMaxDataSize, repair_packet);
+    if (i != 0 && i != 2)
+      decoder.Add(packet);
+  }
+  DataPacket recovered_packet;
+  EXPECT_FALSE(decoder.Recover(repair_packet, recovered_packet));
+
+  // A gap in the packets sent abandons the block.
+  for (uint32_t i(0); i != block_size; ++i) {
+    if (i != 1) {
+      EXPECT_FALSE(encoder.Add(MakePacket(static_cast<uint32_t>(block_size * 20 + i), generator),
+                               kMaxDataSize, repair_packet));
+    }
+  }
+}
+
+TEST(FecTest, BEH_Adapt) {
+  std::mt19937 generator(4);
+  FecEncoder encoder;
+  FecPacket repair_packet;
+  uint32_t sequence_number(0);
+  // No repair packets while there are no losses.
+  for (int i(0); i != 1000; ++i)
+    EXPECT_FALSE(encoder.Add(MakePacket(sequence_number++, generator), kMaxDataSize,
+                             repair_packet));
+  EXPECT_EQ(0U, encoder.BlockSize());
+
+  // Heavy losses make blocks as small as possible.
+  for (int i(0); i != 256 * 4; ++i) {
+    if (i % 8 == 0)
+      encoder.OnPacketLost();
+    encoder.Add(MakePacket(sequence_number++, generator), kMaxDataSize, repair_packet);
+  }
+  EXPECT_EQ(static_cast<size_t>(kFecMinBlockSize), encoder.BlockSize());
+
+  // Once losses stop, FEC is eventually switched off again.
+  for (int i(0); i != 256 * 8 * 5; ++i)
+    encoder.Add(MakePacket(sequence_number++, generator), kMaxDataSize, repair_packet);
+  EXPECT_EQ(0U, encoder.BlockSize());
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
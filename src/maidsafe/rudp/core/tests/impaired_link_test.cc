@@ -0,0 +1,93 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include <cstdint>
+#include <random>
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/impaired_link.h"
+
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+TEST(ImpairedLinkTest, BEH_BurstLoss) {
+  const int kPackets(100000);
+  const bptime::ptime kNow(bptime::microsec_clock::universal_time());
+  std::mt19937 generator(1);
+  ImpairedLink link;
+  LinkConditions conditions;
+  conditions.burst_loss_start = 0.01;
+  conditions.burst_loss_end = 0.25;
+  link.SetConditions(conditions);
+
+  int lost(0), bursts(0);
+  bool previous_lost(false);
+  for (int i(0); i != kPackets; ++i) {
+    bptime::ptime arrival_time;
+    bool is_lost(link.Transmit(kNow, 100, generator, arrival_time) !=
+                 ImpairedLink::Result::kDelivered);
+    if (is_lost) {
+      ++lost;
+      if (!previous_lost)
+        ++bursts;
+    } else {
+      EXPECT_EQ(kNow, arrival_time);
+    }
+    previous_lost = is_lost;
+  }
+  // Bursts should average 4 packets, and start at roughly 1% of packets which aren't lost.
+  EXPECT_GT(bursts * 5, lost);
+  EXPECT_LT(bursts * 3, lost);
+  EXPECT_GT(bursts, (kPackets - lost) / 200);
+  EXPECT_LT(bursts, (kPackets - lost) / 50);
+}
+
+TEST(ImpairedLinkTest, BEH_Queue) {
+  const bptime::ptime kNow(bptime::microsec_clock::universal_time());
+  std::mt19937 generator(1);
+  ImpairedLink link;
+  LinkConditions conditions;
+  conditions.bandwidth = 1000;
+  conditions.queue_size = 1000;
+  conditions.delay = bptime::milliseconds(10);
+  link.SetConditions(conditions);
+
+  bptime::ptime arrival_time;
+  for (int i(0); i != 10; ++i) {
+    ASSERT_EQ(ImpairedLink::Result::kDelivered, link.Transmit(kNow, 100, generator, arrival_time));
+    EXPECT_EQ(kNow + bptime::milliseconds(100 * (i + 1) + 10), arrival_time);
+  }
+  EXPECT_EQ(ImpairedLink::Result::kQueueFull, link.Transmit(kNow, 100, generator, arrival_time));
+  // The queue drains at the link's rate.
+  EXPECT_EQ(ImpairedLink::Result::kDelivered,
+            link.Transmit(kNow + bptime::milliseconds(100), 100, generator, arrival_time));
+  EXPECT_EQ(kNow + bptime::milliseconds(1110), arrival_time);
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,149 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "boost/asio/io_service.hpp"
+#include "boost/lexical_cast.hpp"
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/rudp/core/metrics.h"
+#include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/network_emulator.h"
+#include "maidsafe/rudp/packets/keepalive_packet.h"
+
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+TEST(MetricsTest, BEH_HistogramBuckets) {
+  // Small values have exact buckets.
+  for (uint64_t value(0); value != Histogram::kSubBuckets; ++value) {
+    EXPECT_EQ(value, Histogram::BucketIndex(value));
+    EXPECT_EQ(value, Histogram::BucketUpperBound(value));
+  }
+  // Larger values fall in buckets no wider than 1/8 of their lower bound.
+  uint64_t previous_upper_bound(Histogram::kSubBuckets - 1);
+  for (size_t index(Histogram::kSubBuckets); index != Histogram::kBucketCount; ++index) {
+    uint64_t lower_bound(previous_upper_bound + 1), upper_bound(Histogram::BucketUpperBound(index));
+    ASSERT_LT(lower_bound, upper_bound) << index;
+    EXPECT_LE(upper_bound - lower_bound, lower_bound / 8) << index;
+    EXPECT_EQ(index, Histogram::BucketIndex(lower_bound));
+    EXPECT_EQ(index, Histogram::BucketIndex(upper_bound));
+    previous_upper_bound = upper_bound;
+  }
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(), previous_upper_bound);
+}
+
+TEST(MetricsTest, BEH_HistogramPercentiles) {
+  Histogram histogram;
+  EXPECT_EQ(0U, histogram.Snapshot().count);
+  EXPECT_EQ(0U, histogram.Snapshot().Percentile(50));
+
+  for (uint64_t value(1); value <= 1000; ++value)
+    histogram.Record(value);
+  histogram.Record(bptime::milliseconds(-1));
+  HistogramSnapshot snapshot(histogram.Snapshot());
+  EXPECT_EQ(1001U, snapshot.count);
+  EXPECT_EQ(500500U, snapshot.sum);
+  EXPECT_EQ(0U, snapshot.min);
+  EXPECT_EQ(1000U, snapshot.max);
+  EXPECT_NEAR(500.0, snapshot.Mean(), 1.0);
+  EXPECT_EQ(0U, snapshot.Percentile(0));
+  EXPECT_NEAR(500.0, static_cast<double>(snapshot.Percentile(50)), 500 / 8.0);
+  EXPECT_NEAR(990.0, static_cast<double>(snapshot.Percentile(99)), 990 / 8.0);
+  EXPECT_EQ(1000U, snapshot.Percentile(100));
+}
+
+TEST(MetricsTest, BEH_MultiplexerCounters) {
+  const ip::udp::endpoint kEndpoint(ip::address_v4::loopback(), 5000);
+  const std::string kName("multiplexer." + boost::lexical_cast<std::string>(kEndpoint) + ".");
+  uint64_t packets_out_before(GetMetrics().counters["packets_out"]);
+  KeepalivePacket packet;
+  packet.SetSequenceNumber(1);
+  size_t packet_size(0);
+  {
+    asio::io_service io_service;
+    NetworkEmulator emulator(1);
+    Multiplexer multiplexer(io_service);
+    multiplexer.UseEmulator(emulator, kEndpoint);
+    emulator.Attach(ip::udp::endpoint(ip::address_v4::loopback(), 5001),
+                    [&](const asio::const_buffer& data, const ip::udp::endpoint&) {
+                      packet_size = asio::buffer_size(data);
+                    });
+    ASSERT_EQ(kSuccess, multiplexer.SendTo(packet,
+                                           ip::udp::endpoint(ip::address_v4::loopback(), 5001)));
+    ASSERT_EQ(kSuccess, multiplexer.SendTo(packet,
+                                           ip::udp::endpoint(ip::address_v4::loopback(), 5001)));
+    emulator.RunFor(bptime::seconds(1));
+    ASSERT_NE(0U, packet_size);
+
+    MetricsSnapshot metrics(GetMetrics());
+    EXPECT_EQ(2U, metrics.counters[kName + "packets_out"]);
+    EXPECT_EQ(2 * packet_size, metrics.counters[kName + "bytes_out"]);
+    EXPECT_EQ(0U, metrics.counters[kName + "packets_in"]);
+    EXPECT_LE(packets_out_before + 2, metrics.counters["packets_out"]);
+  }
+  // The counts of a destroyed multiplexer remain in the totals.
+  MetricsSnapshot metrics(GetMetrics());
+  EXPECT_EQ(0U, metrics.counters.count(kName + "packets_out"));
+  EXPECT_LE(packets_out_before + 2, metrics.counters["packets_out"]);
+  for (const char* name : { "handshake_duration", "message_latency", "encryption_time",
+                            "decryption_time", "callback_delay" }) {
+    EXPECT_EQ(1U, metrics.histograms.count(name)) << name;
+  }
+}
+
+TEST(MetricsTest, BEH_Reporter) {
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  int reports(0);
+  {
+    MetricsReporter reporter([&](const MetricsSnapshot& metrics) {
+                               EXPECT_EQ(1U, metrics.counters.count("packets_in"));
+                               std::lock_guard<std::mutex> lock(mutex);
+                               ++reports;
+                               cond_var.notify_one();
+                             },
+                             bptime::milliseconds(10));
+    std::unique_lock<std::mutex> lock(mutex);
+    EXPECT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10), [&] { return reports >= 3; }));
+  }
+  // No reports once the reporter is destroyed.
+  std::lock_guard<std::mutex> lock(mutex);
+  int final_reports(reports);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(final_reports, reports);
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
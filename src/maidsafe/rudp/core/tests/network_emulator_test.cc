@@ -0,0 +1,355 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/clock.h"
+#include "maidsafe/rudp/core/congestion_control.h"
+#include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/network_emulator.h"
+#include "maidsafe/rudp/core/peer.h"
+#include "maidsafe/rudp/core/receiver.h"
+#include "maidsafe/rudp/core/sender.h"
+#include "maidsafe/rudp/core/tick_timer.h"
+#include "maidsafe/rudp/packets/ack_of_ack_packet.h"
+#include "maidsafe/rudp/packets/ack_packet.h"
+#include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/packets/datagram_packet.h"
+#include "maidsafe/rudp/packets/fec_packet.h"
+#include "maidsafe/rudp/packets/message_drop_packet.h"
+#include "maidsafe/rudp/packets/mtu_probe_packet.h"
+#include "maidsafe/rudp/packets/negative_ack_packet.h"
+
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+namespace bptime = boost::posix_time;
+namespace args = std::placeholders;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+// Records the arrival time and first byte of each packet received at an endpoint.
+struct Recorder {
+  explicit Recorder(NetworkEmulator& emulator) : emulator(emulator), times(), contents() {}
+  void Receive(const asio::const_buffer& data, const ip::udp::endpoint& /*sender*/) {
+    times.push_back(emulator.Now());
+    contents.push_back(*asio::buffer_cast<const unsigned char*>(data));
+  }
+  NetworkEmulator& emulator;
+  std::vector<bptime::ptime> times;
+  std::vector<unsigned char> contents;
+};
+
+// Sends "count" packets of "size" bytes, each holding its index in the first byte, then runs the
+// emulator until they have all arrived or been lost.
+void SendPackets(NetworkEmulator& emulator, const ip::udp::endpoint& source,
+                 const ip::udp::endpoint& destination, int count, size_t size) {
+  for (int i(0); i != count; ++i) {
+    std::vector<unsigned char> data(size, static_cast<unsigned char>(i));
+    EXPECT_EQ(kSuccess, emulator.Send(source, destination, asio::buffer(data)));
+  }
+  emulator.RunFor(bptime::seconds(60));
+}
+
+// One end of a connection, with the protocol state Socket would hold but driven directly by the
+// emulator rather than by an io_service.
+class Node {
+ public:
+  Node(asio::io_service& io_service, NetworkEmulator& emulator, const ip::udp::endpoint& endpoint)
+      : multiplexer_(io_service),
+        peer_(multiplexer_),
+        tick_timer_(io_service),
+        congestion_control_(),
+        sender_(peer_, tick_timer_, congestion_control_),
+        receiver_(peer_, tick_timer_, congestion_control_),
+        to_send_(),
+        sent_(0),
+        received_(),
+        datagrams_received_(0) {
+    multiplexer_.UseEmulator(emulator, endpoint);
+    emulator.Attach(endpoint, [this](const asio::const_buffer& data,
+                                     const ip::udp::endpoint& /*sender*/) { HandlePacket(data); });
+    emulator.AddTickTimer(tick_timer_, [this] { HandleTick(); });
+  }
+
+  void Connect(Node& other) {
+    peer_.SetPeerEndpoint(other.multiplexer_.local_endpoint());
+    peer_.SetSocketId(1);
+    congestion_control_.OnOpen(sender_.GetNextPacketSequenceNumber(),
+                               other.sender_.GetNextPacketSequenceNumber());
+    receiver_.Reset(other.sender_.GetNextPacketSequenceNumber());
+  }
+
+  void Send(const std::string& data) {
+    to_send_ = data;
+    sent_ = 0;
+    Write();
+  }
+
+  ReturnCode SendDatagram(const std::string& data) { return sender_.SendDatagram(data); }
+
+  const std::string& Received() const { return received_; }
+  size_t DatagramsReceived() const { return datagrams_received_; }
+  size_t SendWindowSize() const { return congestion_control_.SendWindowSize(); }
+
+ private:
+  void HandlePacket(const asio::const_buffer& data) {
+    DataPacket data_packet;
+    AckPacket ack_packet;
+    AckOfAckPacket ack_of_ack_packet;
+    NegativeAckPacket negative_ack_packet;
+    MtuProbePacket mtu_probe_packet;
+    MessageDropPacket message_drop_packet;
+    FecPacket fec_packet;
+    DatagramPacket datagram_packet;
+    std::vector<std::string> unordered_messages;
+    std::vector<uint32_t> completed_message_numbers;
+    if (data_packet.Decode(data)) {
+      receiver_.HandleData(data_packet, unordered_messages);
+    } else if (ack_packet.Decode(data)) {
+      sender_.HandleAck(ack_packet, completed_message_numbers);
+    } else if (ack_of_ack_packet.Decode(data)) {
+      receiver_.HandleAckOfAck(ack_of_ack_packet);
+    } else if (negative_ack_packet.Decode(data)) {
+      sender_.HandleNegativeAck(negative_ack_packet);
+    } else if (mtu_probe_packet.Decode(data)) {
+      sender_.HandleMtuProbe(mtu_probe_packet);
+    } else if (message_drop_packet.Decode(data)) {
+      receiver_.HandleMessageDrop(message_drop_packet);
+    } else if (fec_packet.Decode(data)) {
+      DataPacket recovered_packet;
+      if (receiver_.HandleFec(fec_packet, recovered_packet))
+        receiver_.HandleData(recovered_packet, unordered_messages);
+    } else if (datagram_packet.Decode(data)) {
+      ++datagrams_received_;
+    }
+    Read();
+    Write();
+  }
+
+  void HandleTick() {
+    sender_.HandleTick();
+    receiver_.HandleTick();
+    Read();
+    Write();
+  }
+
+  void Read() {
+    char buffer[4096];
+    while (size_t length = receiver_.ReadData(asio::buffer(buffer)))
+      received_.append(buffer, length);
+  }
+
+  void Write() {
+    while (sent_ != to_send_.size()) {
+      size_t length(sender_.AddPacket(asio::buffer(&to_send_[sent_], to_send_.size() - sent_), 1,
+                                      sent_ == 0, true, bptime::pos_infin));
+      if (length == 0)
+        break;
+      sent_ += length;
+    }
+    sender_.SendPackets();
+  }
+
+  Multiplexer multiplexer_;
+  Peer peer_;
+  TickTimer tick_timer_;
+  CongestionControl congestion_control_;
+  Sender sender_;
+  Receiver receiver_;
+  std::string to_send_;
+  size_t sent_;
+  std::string received_;
+  size_t datagrams_received_;
+};
+
+}  // unnamed namespace
+
+TEST(NetworkEmulatorTest, BEH_Clock) {
+  bptime::ptime start;
+  {
+    NetworkEmulator emulator(1);
+    start = emulator.Now();
+    EXPECT_EQ(start, Clock::Now());
+    EXPECT_EQ(start, TickTimer::Now());
+    emulator.RunFor(bptime::seconds(5));
+    EXPECT_EQ(start + bptime::seconds(5), Clock::Now());
+  }
+  // The real clock is restored once the emulator is destroyed.
+  EXPECT_GT(Clock::Now(), start + bptime::hours(24 * 365));
+}
+
+TEST(NetworkEmulatorTest, BEH_LinkConditions) {
+  const ip::udp::endpoint kSource(ip::address_v4::loopback(), 1000);
+  const ip::udp::endpoint kDestination(ip::address_v4::loopback(), 2000);
+  {
+    // Delay and bandwidth
+    NetworkEmulator emulator(1);
+    Recorder recorder(emulator);
+    emulator.Attach(kDestination, std::bind(&Recorder::Receive, &recorder, args::_1, args::_2));
+    LinkConditions conditions;
+    conditions.delay = bptime::milliseconds(50);
+    conditions.bandwidth = 100000;
+    emulator.SetLinkConditions(kSource, kDestination, conditions);
+    bptime::ptime start(emulator.Now());
+    SendPackets(emulator, kSource, kDestination, 100, 1000);
+    ASSERT_EQ(100U, recorder.times.size());
+    for (int i(0); i != 100; ++i) {
+      EXPECT_EQ(i, recorder.contents[i]);
+      EXPECT_EQ(start + bptime::milliseconds(50 + 10 * (i + 1)), recorder.times[i]);
+    }
+    // The reverse link is unaffected.
+    Recorder reverse_recorder(emulator);
+    emulator.Attach(kSource,
+                    std::bind(&Recorder::Receive, &reverse_recorder, args::_1, args::_2));
+    start = emulator.Now();
+    SendPackets(emulator, kDestination, kSource, 1, 1000);
+    ASSERT_EQ(1U, reverse_recorder.times.size());
+    EXPECT_EQ(start, reverse_recorder.times[0]);
+  }
+  {
+    // Queue limit
+    NetworkEmulator emulator(1);
+    Recorder recorder(emulator);
+    emulator.Attach(kDestination, std::bind(&Recorder::Receive, &recorder, args::_1, args::_2));
+    LinkConditions conditions;
+    conditions.bandwidth = 100000;
+    conditions.queue_size = 10000;
+    emulator.SetDefaultLinkConditions(conditions);
+    SendPackets(emulator, kSource, kDestination, 100, 1000);
+    EXPECT_EQ(10U, recorder.times.size());
+    EXPECT_EQ(90U, emulator.PacketsLost());
+  }
+  // Loss, jitter and reordering are identical for identical seeds.
+  std::vector<unsigned char> first_contents;
+  std::vector<bptime::time_duration> first_times;
+  for (int run(0); run != 2; ++run) {
+    NetworkEmulator emulator(12345);
+    Recorder recorder(emulator);
+    emulator.Attach(kDestination, std::bind(&Recorder::Receive, &recorder, args::_1, args::_2));
+    LinkConditions conditions;
+    conditions.delay = bptime::milliseconds(20);
+    conditions.jitter = bptime::milliseconds(10);
+    conditions.loss = 0.1;
+    conditions.reordering = 0.1;
+    emulator.SetDefaultLinkConditions(conditions);
+    bptime::ptime start(emulator.Now());
+    SendPackets(emulator, kSource, kDestination, 250, 100);
+    EXPECT_EQ(250U, emulator.PacketsSent());
+    EXPECT_EQ(250U - recorder.times.size(), emulator.PacketsLost());
+    EXPECT_LT(10U, emulator.PacketsLost());
+    EXPECT_GT(50U, emulator.PacketsLost());
+    EXPECT_FALSE(std::is_sorted(recorder.contents.begin(), recorder.contents.end()));
+    std::vector<bptime::time_duration> times;
+    for (const auto& time : recorder.times)
+      times.push_back(time - start);
+    if (run == 0) {
+      first_contents = recorder.contents;
+      first_times = times;
+    } else {
+      EXPECT_EQ(first_contents, recorder.contents);
+      EXPECT_EQ(first_times, times);
+    }
+  }
+}
+
+TEST(NetworkEmulatorTest, BEH_Transfer) {
+  const ip::udp::endpoint kEndpoint0(ip::address_v4::loopback(), 1000);
+  const ip::udp::endpoint kEndpoint1(ip::address_v4::loopback(), 2000);
+  const size_t kDataSize(256 * 1024);
+  std::string data(kDataSize, '\0');
+  for (size_t i(0); i != kDataSize; ++i)
+    data[i] = static_cast<char>(i * 7 + i / 256);
+
+  NetworkEmulator emulator(1);
+  LinkConditions conditions;
+  conditions.bandwidth = 1024 * 1024;
+  conditions.delay = bptime::milliseconds(20);
+  conditions.jitter = bptime::milliseconds(2);
+  conditions.loss = 0.02;
+  emulator.SetDefaultLinkConditions(conditions);
+
+  // The io_service is never run; the emulator fires the tick timers itself.
+  asio::io_service io_service;
+  Node node0(io_service, emulator, kEndpoint0), node1(io_service, emulator, kEndpoint1);
+  node0.Connect(node1);
+  node1.Connect(node0);
+
+  bptime::ptime start(emulator.Now());
+  node0.Send(data);
+  EXPECT_TRUE(emulator.RunUntil([&] { return node1.Received().size() >= kDataSize; },
+                                bptime::minutes(10)));
+  EXPECT_TRUE(node1.Received() == data);
+  EXPECT_LT(0U, emulator.PacketsLost());
+  // The transfer is limited by the link's bandwidth in virtual time only.
+  EXPECT_LT(bptime::milliseconds(250), emulator.Now() - start);
+}
+
+TEST(NetworkEmulatorTest, BEH_DatagramBurstIsThrottled) {
+  const ip::udp::endpoint kEndpoint0(ip::address_v4::loopback(), 1000);
+  const ip::udp::endpoint kEndpoint1(ip::address_v4::loopback(), 2000);
+  NetworkEmulator emulator(1);
+  LinkConditions conditions;
+  conditions.delay = bptime::milliseconds(20);
+  emulator.SetDefaultLinkConditions(conditions);
+
+  asio::io_service io_service;
+  Node node0(io_service, emulator, kEndpoint0), node1(io_service, emulator, kEndpoint1);
+  node0.Connect(node1);
+  node1.Connect(node0);
+
+  // A burst is cut off once it fills the congestion window.
+  const size_t kWindowSize(node0.SendWindowSize());
+  ASSERT_LT(0U, kWindowSize);
+  const std::string kDatagram(100, 'd');
+  size_t sent(0);
+  for (size_t i(0); i != 2 * kWindowSize; ++i) {
+    ReturnCode result(node0.SendDatagram(kDatagram));
+    if (result == kSuccess)
+      ++sent;
+    else
+      EXPECT_EQ(kDatagramDropped, result);
+  }
+  EXPECT_EQ(kWindowSize, sent);
+  emulator.RunFor(bptime::milliseconds(50));
+  EXPECT_EQ(kWindowSize, node1.DatagramsReceived());
+
+  // The window is released once a round trip has passed.
+  emulator.RunFor(bptime::milliseconds(100));
+  EXPECT_EQ(kSuccess, node0.SendDatagram(kDatagram));
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
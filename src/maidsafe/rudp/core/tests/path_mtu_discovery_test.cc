@@ -0,0 +1,141 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/path_mtu_discovery.h"
+#include "maidsafe/rudp/parameters.h"
+
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+// Runs probes against a path which delivers data sizes up to "path_data_size", returning the time
+// at which the search completed.
+bptime::ptime SearchPath(PathMtuDiscovery& discovery, size_t path_data_size, bptime::ptime now) {
+  while (discovery.IsSearching()) {
+    size_t probe_size(discovery.NextProbe(now));
+    if (probe_size == 0) {
+      now += Parameters::mtu_probe_timeout;
+      discovery.HandleTick(now);
+    } else if (probe_size <= path_data_size) {
+      EXPECT_TRUE(discovery.OnProbeAcknowledged(probe_size, now));
+    }
+  }
+  return now;
+}
+
+}  // unnamed namespace
+
+TEST(PathMtuDiscoveryTest, BEH_Search) {
+  bptime::ptime now(bptime::microsec_clock::universal_time());
+  {
+    // Path carries everything
+    PathMtuDiscovery discovery;
+    EXPECT_EQ(Parameters::default_data_size, discovery.DataSize());
+    SearchPath(discovery, Parameters::max_data_size, now);
+    EXPECT_GE(discovery.DataSize(), Parameters::max_data_size - 32);
+    EXPECT_LE(discovery.DataSize(), Parameters::max_data_size);
+  }
+  {
+    // Path carries nothing above the base size
+    PathMtuDiscovery discovery;
+    SearchPath(discovery, Parameters::default_data_size, now);
+    EXPECT_EQ(Parameters::default_data_size, discovery.DataSize());
+  }
+  {
+    // Path carries up to a size in between
+    const size_t kPathDataSize(4000);
+    PathMtuDiscovery discovery;
+    bptime::ptime finished(SearchPath(discovery, kPathDataSize, now));
+    EXPECT_GE(discovery.DataSize(), kPathDataSize - 32);
+    EXPECT_LE(discovery.DataSize(), kPathDataSize);
+
+    // No further probes until the raise interval has expired
+    EXPECT_EQ(0U, discovery.NextProbe(finished + Parameters::mtu_raise_interval / 2));
+    EXPECT_NE(0U, discovery.NextProbe(finished + Parameters::mtu_raise_interval));
+    EXPECT_TRUE(discovery.IsSearching());
+  }
+}
+
+TEST(PathMtuDiscoveryTest, BEH_ProbeRetries) {
+  bptime::ptime now(bptime::microsec_clock::universal_time());
+  PathMtuDiscovery discovery;
+  size_t probe_size(discovery.NextProbe(now));
+  ASSERT_NE(0U, probe_size);
+  // Only one probe outstanding at a time
+  EXPECT_EQ(0U, discovery.NextProbe(now));
+  EXPECT_EQ(now + Parameters::mtu_probe_timeout, discovery.ProbeTimeout());
+
+  // The same size is retried until the maximum attempts are exhausted
+  for (uint32_t i(1); i != Parameters::mtu_probe_max_attempts; ++i) {
+    now += Parameters::mtu_probe_timeout;
+    discovery.HandleTick(now);
+    EXPECT_EQ(probe_size, discovery.NextProbe(now));
+  }
+  now += Parameters::mtu_probe_timeout;
+  discovery.HandleTick(now);
+  size_t smaller_probe_size(discovery.NextProbe(now));
+  EXPECT_LT(smaller_probe_size, probe_size);
+  EXPECT_GT(smaller_probe_size, Parameters::default_data_size);
+
+  // A late response for a previous size is ignored
+  EXPECT_FALSE(discovery.OnProbeAcknowledged(probe_size, now));
+  EXPECT_TRUE(discovery.OnProbeAcknowledged(smaller_probe_size, now));
+  EXPECT_EQ(smaller_probe_size, discovery.DataSize());
+}
+
+TEST(PathMtuDiscoveryTest, BEH_BlackHole) {
+  bptime::ptime now(bptime::microsec_clock::universal_time());
+  PathMtuDiscovery discovery;
+  now = SearchPath(discovery, Parameters::max_data_size, now);
+  size_t confirmed_size(discovery.DataSize());
+  ASSERT_GT(confirmed_size, Parameters::default_data_size);
+
+  // Timeouts of base-sized packets don't indicate a black hole
+  for (uint32_t i(0); i != Parameters::mtu_black_hole_timeouts; ++i)
+    EXPECT_FALSE(discovery.OnSendTimeout(Parameters::default_data_size, now));
+
+  // An ack in between resets the count
+  for (uint32_t i(1); i != Parameters::mtu_black_hole_timeouts; ++i)
+    EXPECT_FALSE(discovery.OnSendTimeout(confirmed_size, now));
+  discovery.OnAck();
+  for (uint32_t i(1); i != Parameters::mtu_black_hole_timeouts; ++i)
+    EXPECT_FALSE(discovery.OnSendTimeout(confirmed_size, now));
+  EXPECT_TRUE(discovery.OnSendTimeout(confirmed_size, now));
+  EXPECT_EQ(Parameters::default_data_size, discovery.DataSize());
+  EXPECT_TRUE(discovery.IsSearching());
+
+  // The search restarts below the size which stopped getting through
+  now = SearchPath(discovery, 2000, now);
+  EXPECT_LE(discovery.DataSize(), 2000U);
+  EXPECT_GT(discovery.DataSize(), Parameters::default_data_size);
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,88 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/rudp/core/sample_ring_buffer.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+TEST(SampleRingBufferTest, BEH_PushAndOverwrite) {
+  SampleRingBuffer<uint64_t, 4> ring;
+  EXPECT_TRUE(ring.IsEmpty());
+  EXPECT_EQ(4U, ring.Capacity());
+
+  for (uint64_t i(1); i <= 4; ++i) {
+    ring.Push(i);
+    EXPECT_EQ(i, ring.Size());
+  }
+  EXPECT_EQ(3U, ring.Median());
+
+  // Overwrite the oldest two samples (1 and 2).
+  ring.Push(100);
+  ring.Push(101);
+  EXPECT_EQ(4U, ring.Size());
+  EXPECT_EQ(100U, ring.Median());
+
+  ring.Clear();
+  EXPECT_TRUE(ring.IsEmpty());
+  ring.Push(7);
+  EXPECT_EQ(7U, ring.Median());
+}
+
+TEST(SampleRingBufferTest, BEH_Median) {
+  SampleRingBuffer<uint64_t, 17> ring;
+  const uint64_t kOdd[] = { 9, 2, 7, 4, 5 };
+  for (auto sample : kOdd)
+    ring.Push(sample);
+  EXPECT_EQ(5U, ring.Median());
+
+  // With an even number of samples, the upper middle one is chosen.
+  ring.Push(1);
+  EXPECT_EQ(5U, ring.Median());
+
+  // The query must not reorder the stored samples.
+  ring.Push(3);
+  EXPECT_EQ(4U, ring.Median());
+}
+
+TEST(SampleRingBufferTest, BEH_SumAroundMedian) {
+  SampleRingBuffer<uint64_t, 16> ring;
+  for (int i(0); i != 10; ++i)
+    ring.Push(1000);
+  // Outliers either side of [median / 8, median * 8].
+  ring.Push(100);
+  ring.Push(9000);
+  // Samples on the boundaries are included.
+  ring.Push(125);
+  ring.Push(8000);
+
+  uint64_t total(0);
+  EXPECT_EQ(12U, ring.SumAroundMedian(8, total));
+  EXPECT_EQ(10000U + 125U + 8000U, total);
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
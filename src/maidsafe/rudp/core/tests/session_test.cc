@@ -0,0 +1,216 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "boost/asio/io_service.hpp"
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/parameters.h"
+#include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/network_emulator.h"
+#include "maidsafe/rudp/core/peer.h"
+#include "maidsafe/rudp/core/session.h"
+#include "maidsafe/rudp/core/session_tickets.h"
+#include "maidsafe/rudp/core/tick_timer.h"
+#include "maidsafe/rudp/packets/handshake_packet.h"
+
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+// A Session and the state which Socket would hold for it, exchanging handshakes via the emulator.
+// As by ConnectionManager, packets addressed to a previous session are discarded.
+class Node {
+ public:
+  Node(asio::io_service& io_service, NetworkEmulator& emulator, const ip::udp::endpoint& endpoint)
+      : multiplexer_(io_service),
+        peer_(multiplexer_),
+        tick_timer_(io_service),
+        external_endpoint_(),
+        external_endpoint_mutex_(),
+        nat_type_(NatType::kUnknown),
+        session_(peer_, tick_timer_, external_endpoint_, external_endpoint_mutex_, endpoint,
+                 nat_type_),
+        node_id_(NodeId::kRandomId),
+        public_key_(std::make_shared<asymm::PublicKey>(asymm::GenerateKeyPair().public_key)) {
+    multiplexer_.UseEmulator(emulator, endpoint);
+    emulator.Attach(endpoint, [this](const asio::const_buffer& data,
+                                     const ip::udp::endpoint& /*sender*/) {
+      HandshakePacket packet;
+      if (packet.Decode(data) &&
+          (packet.DestinationSocketId() == 0 || packet.DestinationSocketId() == session_.Id())) {
+        session_.HandleHandshake(packet);
+      }
+    });
+    emulator.AddTickTimer(tick_timer_, [this] { session_.HandleTick(); });
+  }
+
+  void Open(const Node& other, uint32_t id) {
+    session_.Close();
+    peer_.SetPeerEndpoint(other.multiplexer_.local_endpoint());
+    peer_.set_node_id(other.node_id_);
+    peer_.SetSocketId(0);
+    session_.Open(id, node_id_, public_key_, 1000 + id, Session::kNormal,
+                  [](const ip::udp::endpoint& /*this_local_endpoint*/, const NodeId& /*peer_id*/,
+                     const ip::udp::endpoint& /*peer_endpoint*/, uint16_t& /*port*/) {});
+  }
+
+  Session& session() { return session_; }
+  const Peer& peer() const { return peer_; }
+  const NodeId& node_id() const { return node_id_; }
+
+ private:
+  Multiplexer multiplexer_;
+  Peer peer_;
+  TickTimer tick_timer_;
+  ip::udp::endpoint external_endpoint_;
+  std::mutex external_endpoint_mutex_;
+  NatType nat_type_;
+  Session session_;
+  NodeId node_id_;
+  std::shared_ptr<asymm::PublicKey> public_key_;
+};
+
+}  // unnamed namespace
+
+class SessionTest : public testing::Test {
+ protected:
+  SessionTest()
+      : emulator_(1),
+        io_service_(),
+        node0_(io_service_, emulator_, ip::udp::endpoint(ip::address_v4::loopback(), 5000)),
+        node1_(io_service_, emulator_, ip::udp::endpoint(ip::address_v4::loopback(), 6000)) {
+    SessionTickets::Instance().Clear();
+    LinkConditions conditions;
+    conditions.delay = kDelay;
+    emulator_.SetDefaultLinkConditions(conditions);
+  }
+
+  ~SessionTest() { SessionTickets::Instance().Clear(); }
+
+  // Opens node1, which waits for node0 to open, and returns the time taken by node0 to connect.
+  bptime::time_duration ConnectLate(uint32_t id) {
+    node1_.Open(node0_, id + 1);
+    // Between node1's connection requests, which are sent every 250 ms.
+    emulator_.RunFor(bptime::milliseconds(1125));
+    bptime::ptime start(emulator_.Now());
+    node0_.Open(node1_, id);
+    EXPECT_TRUE(emulator_.RunUntil([&] {
+                  return node0_.session().IsConnected() && node1_.session().IsConnected();
+                }, bptime::seconds(10)));
+    return emulator_.Now() - start;
+  }
+
+  // Opens both ends at once and returns the time taken until both are connected.
+  bptime::time_duration Connect(uint32_t id) {
+    bptime::ptime start(emulator_.Now());
+    node0_.Open(node1_, id);
+    node1_.Open(node0_, id + 1);
+    EXPECT_TRUE(emulator_.RunUntil([&] {
+                  return node0_.session().IsConnected() && node1_.session().IsConnected();
+                }, bptime::seconds(10)));
+    return emulator_.Now() - start;
+  }
+
+  const bptime::time_duration kDelay = bptime::milliseconds(50);
+  NetworkEmulator emulator_;
+  asio::io_service io_service_;
+  Node node0_, node1_;
+};
+
+TEST_F(SessionTest, BEH_ResumeInOneRoundTrip) {
+  bptime::time_duration full_handshake(ConnectLate(10));
+  EXPECT_FALSE(node0_.session().Resumed());
+  EXPECT_FALSE(node1_.session().Resumed());
+  SessionTicket ticket0, ticket1;
+  ASSERT_TRUE(SessionTickets::Instance().Find(node0_.node_id(), node1_.node_id(), ticket0));
+  ASSERT_TRUE(SessionTickets::Instance().Find(node1_.node_id(), node0_.node_id(), ticket1));
+  EXPECT_EQ(ticket0.issued_ticket, ticket1.peer_ticket);
+  EXPECT_EQ(ticket1.issued_ticket, ticket0.peer_ticket);
+
+  // node0's request is answered by node1's cookie, completing the handshake.
+  bptime::time_duration resumption(ConnectLate(20));
+  EXPECT_TRUE(node0_.session().Resumed());
+  EXPECT_TRUE(node1_.session().Resumed());
+  EXPECT_EQ(kDelay * 2, resumption);
+  EXPECT_LT(resumption, full_handshake);
+  EXPECT_EQ(20U, node1_.peer().SocketId());
+  EXPECT_EQ(21U, node0_.peer().SocketId());
+
+  // Opening both ends at once resumes too.
+  Connect(30);
+  EXPECT_TRUE(node0_.session().Resumed());
+  EXPECT_TRUE(node1_.session().Resumed());
+}
+
+TEST_F(SessionTest, BEH_FullHandshakeWithUnknownTicket) {
+  Connect(10);
+  // node1 forgets its tickets, as though it had restarted.
+  SessionTickets::Instance().Remove(node1_.node_id(), node0_.node_id());
+  Connect(20);
+  EXPECT_FALSE(node0_.session().Resumed());
+  EXPECT_FALSE(node1_.session().Resumed());
+  SessionTicket ticket0, ticket1;
+  ASSERT_TRUE(SessionTickets::Instance().Find(node0_.node_id(), node1_.node_id(), ticket0));
+  ASSERT_TRUE(SessionTickets::Instance().Find(node1_.node_id(), node0_.node_id(), ticket1));
+  EXPECT_EQ(ticket0.issued_ticket, ticket1.peer_ticket);
+  EXPECT_EQ(ticket1.issued_ticket, ticket0.peer_ticket);
+}
+
+TEST_F(SessionTest, BEH_FullHandshakeWithForgedTicket) {
+  Connect(10);
+  // Each node presents its ticket with a MAC which the other didn't issue.
+  for (auto ids : { std::make_pair(node0_.node_id(), node1_.node_id()),
+                    std::make_pair(node1_.node_id(), node0_.node_id()) }) {
+    SessionTicket ticket;
+    ASSERT_TRUE(SessionTickets::Instance().Find(ids.first, ids.second, ticket));
+    ticket.peer_ticket_mac ^= 1;
+    SessionTickets::Instance().Store(ids.first, ids.second, ticket);
+  }
+  ConnectLate(20);
+  EXPECT_FALSE(node0_.session().Resumed());
+  EXPECT_FALSE(node1_.session().Resumed());
+}
+
+TEST_F(SessionTest, BEH_TicketExpires) {
+  Connect(10);
+  emulator_.RunFor(Parameters::session_ticket_lifetime);
+  SessionTicket ticket;
+  EXPECT_FALSE(SessionTickets::Instance().Find(node0_.node_id(), node1_.node_id(), ticket));
+  Connect(20);
+  EXPECT_FALSE(node0_.session().Resumed());
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,248 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include <memory>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+
+#include "maidsafe/common/rsa.h"
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/connection_manager.h"
+#include "maidsafe/rudp/parameters.h"
+#include "maidsafe/rudp/core/clock.h"
+#include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/network_emulator.h"
+#include "maidsafe/rudp/core/session.h"
+#include "maidsafe/rudp/core/session_tickets.h"
+#include "maidsafe/rudp/core/syn_cookies.h"
+#include "maidsafe/rudp/packets/handshake_packet.h"
+
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+class SynCookiesTest : public testing::Test {
+ protected:
+  SynCookiesTest()
+      : now_(bptime::microsec_clock::universal_time()),
+        endpoint_(ip::address::from_string("203.0.113.7"), 5483),
+        node_id_(NodeId::kRandomId) {
+    Clock::SetNowFunctor([this] { return now_; });
+  }
+
+  ~SynCookiesTest() { Clock::SetNowFunctor(Clock::NowFunctor()); }
+
+  bptime::ptime now_;
+  ip::udp::endpoint endpoint_;
+  NodeId node_id_;
+};
+
+TEST_F(SynCookiesTest, BEH_ValidateMatchingRequest) {
+  SynCookies syn_cookies;
+  const uint32_t kSocketId(0x12345678);
+  uint32_t cookie(syn_cookies.Generate(endpoint_, node_id_, kSocketId));
+  EXPECT_NE(0U, cookie);
+  EXPECT_EQ(cookie, syn_cookies.Generate(endpoint_, node_id_, kSocketId));
+  EXPECT_TRUE(syn_cookies.Validate(cookie, endpoint_, node_id_, kSocketId));
+
+  // A missing cookie, or one for any other request, is rejected.
+  EXPECT_FALSE(syn_cookies.Validate(0, endpoint_, node_id_, kSocketId));
+  EXPECT_FALSE(syn_cookies.Validate(cookie + 1, endpoint_, node_id_, kSocketId));
+  EXPECT_FALSE(syn_cookies.Validate(cookie, ip::udp::endpoint(endpoint_.address(), 5484), node_id_,
+                                    kSocketId));
+  EXPECT_FALSE(syn_cookies.Validate(cookie, ip::udp::endpoint(
+                                        ip::address::from_string("203.0.113.8"), 5483),
+                                    node_id_, kSocketId));
+  EXPECT_FALSE(syn_cookies.Validate(cookie, endpoint_, NodeId(NodeId::kRandomId), kSocketId));
+  EXPECT_FALSE(syn_cookies.Validate(cookie, endpoint_, node_id_, kSocketId + 1));
+
+  // Another instance has its own key.
+  SynCookies other_syn_cookies;
+  EXPECT_FALSE(other_syn_cookies.Validate(cookie, endpoint_, node_id_, kSocketId));
+}
+
+TEST_F(SynCookiesTest, BEH_Ipv6) {
+  SynCookies syn_cookies;
+  ip::udp::endpoint endpoint(ip::address::from_string("2001:db8::7"), 5483);
+  uint32_t cookie(syn_cookies.Generate(endpoint, node_id_, 1));
+  EXPECT_TRUE(syn_cookies.Validate(cookie, endpoint, node_id_, 1));
+  EXPECT_FALSE(syn_cookies.Validate(cookie, endpoint_, node_id_, 1));
+}
+
+TEST_F(SynCookiesTest, BEH_Rotation) {
+  SynCookies syn_cookies;
+  uint32_t cookie(syn_cookies.Generate(endpoint_, node_id_, 1));
+
+  // Still valid after one rotation, though newly-issued cookies differ.
+  now_ += Parameters::syn_cookie_lifetime;
+  EXPECT_TRUE(syn_cookies.Validate(cookie, endpoint_, node_id_, 1));
+  uint32_t next_cookie(syn_cookies.Generate(endpoint_, node_id_, 1));
+  EXPECT_NE(cookie, next_cookie);
+
+  // Expired after a second rotation.
+  now_ += Parameters::syn_cookie_lifetime;
+  EXPECT_FALSE(syn_cookies.Validate(cookie, endpoint_, node_id_, 1));
+  EXPECT_TRUE(syn_cookies.Validate(next_cookie, endpoint_, node_id_, 1));
+
+  // If no request arrives for two lifetimes, every outstanding cookie expires at once.
+  now_ += Parameters::syn_cookie_lifetime * 2;
+  EXPECT_FALSE(syn_cookies.Validate(next_cookie, endpoint_, node_id_, 1));
+}
+
+TEST(SynCookiesConnectionManagerTest, BEH_ConnectionRequestVersions) {
+  const ip::udp::endpoint kThisEndpoint(ip::address_v4::loopback(), 5483),
+                          kRequesterEndpoint(ip::address_v4::loopback(), 5484);
+  asio::io_service io_service;
+  NetworkEmulator emulator(1);
+  std::shared_ptr<Multiplexer> multiplexer(std::make_shared<Multiplexer>(io_service));
+  multiplexer->UseEmulator(emulator, kThisEndpoint);
+  asymm::Keys keys(asymm::GenerateKeyPair());
+  ConnectionManager connection_manager(std::shared_ptr<Transport>(),
+                                       asio::io_service::strand(io_service), multiplexer,
+                                       NodeId(NodeId::kRandomId),
+                                       std::make_shared<asymm::PublicKey>(keys.public_key));
+  std::vector<HandshakePacket> replies;
+  emulator.Attach(kRequesterEndpoint,
+                  [&](const asio::const_buffer& data, const ip::udp::endpoint&) {
+                    HandshakePacket reply;
+                    if (reply.Decode(data))
+                      replies.push_back(reply);
+                  });
+
+  HandshakePacket request;
+  request.SetSocketType(HandshakePacket::kStreamSocketType);
+  request.SetSocketId(0x12345678);
+  request.set_node_id(NodeId(NodeId::kRandomId));
+  request.SetPeerEndpoint(kThisEndpoint);
+  request.SetDestinationSocketId(0);
+  request.SetConnectionType(1);
+  request.SetConnectionReason(Session::kBootstrapAndKeep);
+  auto send_request([&](uint32_t rudp_version, uint32_t syn_cookie) {
+    request.SetRudpVersion(rudp_version);
+    request.SetSynCookie(syn_cookie);
+    std::vector<unsigned char> buffer(Parameters::kUDPPayload);
+    size_t length(request.Encode(asio::buffer(buffer)));
+    EXPECT_EQ(nullptr, connection_manager.GetSocket(asio::buffer(&buffer[0], length),
+                                                    kRequesterEndpoint));
+    emulator.RunFor(bptime::milliseconds(1));
+  });
+
+  // A current node is sent a cookie, and once it echoes that, it isn't sent another.
+  send_request(HandshakePacket::kRudpVersion, 0);
+  ASSERT_EQ(1U, replies.size());
+  EXPECT_EQ(0U, replies[0].SocketId());
+  EXPECT_EQ(request.SocketId(), replies[0].DestinationSocketId());
+  EXPECT_NE(0U, replies[0].SynCookie());
+  send_request(HandshakePacket::kRudpVersion, replies[0].SynCookie());
+  EXPECT_EQ(1U, replies.size());
+
+  // A node predating cookies couldn't make sense of one, so is never sent one, whether its request
+  // is accepted or refused.
+  send_request(HandshakePacket::kSynCookieVersion - 1, 0);
+  EXPECT_EQ(1U, replies.size());
+  Parameters::accept_legacy_connection_requests = false;
+  send_request(HandshakePacket::kSynCookieVersion - 1, 0);
+  Parameters::accept_legacy_connection_requests = true;
+  EXPECT_EQ(1U, replies.size());
+}
+
+TEST(SynCookiesConnectionManagerTest, BEH_SessionTicketSkipsCookie) {
+  const ip::udp::endpoint kThisEndpoint(ip::address_v4::loopback(), 5483),
+                          kRequesterEndpoint(ip::address_v4::loopback(), 5484);
+  asio::io_service io_service;
+  NetworkEmulator emulator(1);
+  std::shared_ptr<Multiplexer> multiplexer(std::make_shared<Multiplexer>(io_service));
+  multiplexer->UseEmulator(emulator, kThisEndpoint);
+  asymm::Keys keys(asymm::GenerateKeyPair());
+  const NodeId kThisNodeId(NodeId::kRandomId), kRequesterId(NodeId::kRandomId);
+  ConnectionManager connection_manager(std::shared_ptr<Transport>(),
+                                       asio::io_service::strand(io_service), multiplexer,
+                                       kThisNodeId,
+                                       std::make_shared<asymm::PublicKey>(keys.public_key));
+  std::vector<HandshakePacket> replies;
+  emulator.Attach(kRequesterEndpoint,
+                  [&](const asio::const_buffer& data, const ip::udp::endpoint&) {
+                    HandshakePacket reply;
+                    if (reply.Decode(data))
+                      replies.push_back(reply);
+                  });
+
+  // The ticket this node issued to the requester in an earlier session.
+  SessionTickets::Instance().Clear();
+  SessionTicket ticket;
+  ticket.issued_ticket = 0x600dcafe;
+  SessionTickets::Instance().Store(kThisNodeId, kRequesterId, ticket);
+  const uint64_t kMac(SessionTickets::Instance().Mac(kThisNodeId, kRequesterId,
+                                                     ticket.issued_ticket, kRequesterEndpoint));
+
+  // Returns the number of round trips the requester takes to be admitted, echoing any cookie.
+  auto round_trips([&](uint32_t resumption_ticket, uint64_t mac)->int {
+    HandshakePacket request;
+    request.SetRudpVersion(HandshakePacket::kRudpVersion);
+    request.SetSocketType(HandshakePacket::kStreamSocketType);
+    request.SetSocketId(0x12345678);
+    request.set_node_id(kRequesterId);
+    request.SetPeerEndpoint(kThisEndpoint);
+    request.SetDestinationSocketId(0);
+    request.SetConnectionType(1);
+    request.SetConnectionReason(Session::kBootstrapAndKeep);
+    request.SetResume(resumption_ticket != 0);
+    request.SetResumptionTicket(resumption_ticket);
+    request.SetResumptionTicketMac(mac);
+    for (int trips(1); trips <= 3; ++trips) {
+      replies.clear();
+      std::vector<unsigned char> buffer(Parameters::kUDPPayload);
+      size_t length(request.Encode(asio::buffer(buffer)));
+      connection_manager.GetSocket(asio::buffer(&buffer[0], length), kRequesterEndpoint);
+      emulator.RunFor(bptime::milliseconds(1));
+      if (replies.empty())
+        return trips;
+      request.SetSynCookie(replies.back().SynCookie());
+    }
+    return -1;
+  });
+
+  // Without a ticket, the requester has to echo a cookie first.
+  EXPECT_EQ(2, round_trips(0, 0));
+  // A valid ticket is admitted straight away.
+  EXPECT_EQ(1, round_trips(ticket.issued_ticket, kMac));
+  // But not if its MAC is wrong, or was made for the requester at another endpoint.
+  EXPECT_EQ(2, round_trips(ticket.issued_ticket, kMac ^ 1));
+  EXPECT_EQ(2, round_trips(ticket.issued_ticket,
+                           SessionTickets::Instance().Mac(
+                               kThisNodeId, kRequesterId, ticket.issued_ticket,
+                               ip::udp::endpoint(ip::address_v4::loopback(), 5485))));
+  // Nor once this node has forgotten the ticket.
+  SessionTickets::Instance().Clear();
+  EXPECT_EQ(2, round_trips(ticket.issued_ticket, kMac));
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
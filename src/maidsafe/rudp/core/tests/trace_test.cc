@@ -0,0 +1,132 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/rudp/core/trace.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+// Rings are shared by every test in the process, so each test uses its own socket ID.
+std::vector<TraceRecord> RecordsFor(uint32_t socket_id) {
+  std::vector<TraceRecord> all(Trace::Snapshot()), matching;
+  std::copy_if(all.begin(), all.end(), std::back_inserter(matching),
+               [socket_id](const TraceRecord& record) { return record.socket_id == socket_id; });
+  return matching;
+}
+
+}  // unnamed namespace
+
+TEST(TraceTest, BEH_RecordOnlyWhileStarted) {
+  const uint32_t kSocketId(0xabc0001);
+  Trace::Stop();
+  Trace::Record(TraceEvent::kTick, kSocketId);
+  EXPECT_TRUE(RecordsFor(kSocketId).empty());
+
+  Trace::Start();
+  Trace::Record(TraceEvent::kDataSent, kSocketId, 7, 1000);
+  Trace::Stop();
+  Trace::Record(TraceEvent::kTick, kSocketId);
+
+  auto records(RecordsFor(kSocketId));
+  ASSERT_EQ(1U, records.size());
+  EXPECT_EQ(static_cast<uint8_t>(TraceEvent::kDataSent), records[0].event);
+  EXPECT_EQ(7U, records[0].value1);
+  EXPECT_EQ(1000U, records[0].value2);
+  EXPECT_NE(0U, records[0].time);
+}
+
+TEST(TraceTest, BEH_RingKeepsLatestEvents) {
+  const uint32_t kSocketId(0xabc0002);
+  const uint32_t kCount(Trace::kRingCapacity + 100);
+  Trace::Start();
+  // A new thread has a ring of its own.
+  std::thread recorder([&] {
+    for (uint32_t i(0); i != kCount; ++i)
+      Trace::Record(TraceEvent::kDataReceived, kSocketId, i);
+  });
+  recorder.join();
+  Trace::Stop();
+
+  auto records(RecordsFor(kSocketId));
+  // The oldest event held by a full ring is never copied.
+  ASSERT_EQ(static_cast<size_t>(Trace::kRingCapacity - 1), records.size());
+  EXPECT_EQ(101U, records.front().value1);
+  EXPECT_EQ(kCount - 1, records.back().value1);
+  for (const auto& record : records)
+    EXPECT_EQ(records.front().thread, record.thread);
+}
+
+TEST(TraceTest, BEH_WriteReadAndTimeline) {
+  const uint32_t kSocketId(0xabc0003);
+  Trace::Start();
+  Trace::Record(TraceEvent::kAckSent, kSocketId, 10, 1);
+  std::thread recorder([&] { Trace::Record(TraceEvent::kWindowChanged, kSocketId, 16, 64); });
+  recorder.join();
+  Trace::Stop();
+
+  std::stringstream binary;
+  Trace::Write(binary);
+  std::vector<TraceRecord> read;
+  ASSERT_TRUE(Trace::Read(binary, read));
+  std::vector<TraceRecord> expected(RecordsFor(kSocketId)), matching;
+  std::copy_if(read.begin(), read.end(), std::back_inserter(matching),
+               [kSocketId](const TraceRecord& record) { return record.socket_id == kSocketId; });
+  ASSERT_EQ(2U, matching.size());
+  ASSERT_EQ(expected.size(), matching.size());
+  for (size_t i(0); i != matching.size(); ++i) {
+    EXPECT_EQ(expected[i].time, matching[i].time);
+    EXPECT_EQ(expected[i].event, matching[i].event);
+    EXPECT_EQ(expected[i].value1, matching[i].value1);
+    EXPECT_EQ(expected[i].value2, matching[i].value2);
+    EXPECT_EQ(expected[i].thread, matching[i].thread);
+  }
+  EXPECT_NE(matching[0].thread, matching[1].thread);
+
+  std::ostringstream timeline;
+  Trace::WriteTimeline(matching, timeline);
+  std::string json(timeline.str());
+  EXPECT_NE(std::string::npos, json.find("\"traceEvents\""));
+  EXPECT_NE(std::string::npos, json.find("\"name\":\"AckSent\""));
+  EXPECT_NE(std::string::npos, json.find("\"ack_number\":1"));
+  EXPECT_NE(std::string::npos, json.find("\"ph\":\"C\""));
+  EXPECT_NE(std::string::npos, json.find("\"send\":16,\"receive\":64"));
+
+  // A truncated trace is rejected.
+  std::string truncated(binary.str());
+  truncated.resize(truncated.size() - 1);
+  std::istringstream truncated_stream(truncated);
+  EXPECT_FALSE(Trace::Read(truncated_stream, read));
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,160 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include <algorithm>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/write_scheduler.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+const size_t kPacketSize(100);
+
+SendOptions MakeOptions(bool in_order, SendPriority priority, uint32_t weight) {
+  SendOptions options;
+  options.in_order = in_order;
+  options.priority = priority;
+  options.weight = weight;
+  return options;
+}
+
+// Runs the scheduler until it's empty, returning the message number chosen for each packet.
+std::vector<uint32_t> Drain(WriteScheduler& scheduler) {
+  std::vector<uint32_t> chosen;
+  uint32_t message_number(0);
+  while (scheduler.Next(kPacketSize, message_number)) {
+    chosen.push_back(message_number);
+    scheduler.OnPacketAdded(message_number, kPacketSize);
+  }
+  EXPECT_TRUE(scheduler.IsEmpty());
+  return chosen;
+}
+
+}  // unnamed namespace
+
+TEST(WriteSchedulerTest, BEH_Priority) {
+  WriteScheduler scheduler(64);
+  uint32_t message_number(0);
+  EXPECT_TRUE(scheduler.IsEmpty());
+  EXPECT_FALSE(scheduler.Next(kPacketSize, message_number));
+
+  // A high priority message added after a low priority one overtakes it at the next packet
+  scheduler.Add(1, 10 * kPacketSize, MakeOptions(false, SendPriority::kLow, 1));
+  ASSERT_TRUE(scheduler.Next(kPacketSize, message_number));
+  EXPECT_EQ(1U, message_number);
+  scheduler.OnPacketAdded(1, kPacketSize);
+  scheduler.Add(2, 2 * kPacketSize, MakeOptions(false, SendPriority::kHigh, 1));
+  std::vector<uint32_t> chosen(Drain(scheduler));
+  ASSERT_EQ(11U, chosen.size());
+  EXPECT_EQ(2U, chosen[0]);
+  EXPECT_EQ(2U, chosen[1]);
+  for (size_t i(2); i != chosen.size(); ++i)
+    EXPECT_EQ(1U, chosen[i]);
+}
+
+TEST(WriteSchedulerTest, BEH_Weight) {
+  WriteScheduler scheduler(64);
+  scheduler.Add(1, 20 * kPacketSize, MakeOptions(false, SendPriority::kNormal, 1));
+  scheduler.Add(2, 20 * kPacketSize, MakeOptions(false, SendPriority::kNormal, 3));
+  std::vector<uint32_t> chosen(Drain(scheduler));
+  ASSERT_EQ(40U, chosen.size());
+  // While both are waiting, message 2 gets three packets for every one of message 1
+  size_t message_2_count(0);
+  for (size_t i(0); i != 16; ++i) {
+    if (chosen[i] == 2)
+      ++message_2_count;
+  }
+  EXPECT_EQ(12U, message_2_count);
+
+  // A weight of 0 is treated as 1
+  scheduler.Add(3, 4 * kPacketSize, MakeOptions(false, SendPriority::kNormal, 0));
+  scheduler.Add(4, 4 * kPacketSize, MakeOptions(false, SendPriority::kNormal, 1));
+  chosen = Drain(scheduler);
+  std::vector<uint32_t> expected = { 3, 4, 3, 4, 3, 4, 3, 4 };
+  EXPECT_EQ(expected, chosen);
+}
+
+TEST(WriteSchedulerTest, BEH_InOrder) {
+  // In-order messages are sent one after another regardless of priority, but unordered ones can be
+  // interleaved with them
+  WriteScheduler scheduler(64);
+  scheduler.Add(1, 3 * kPacketSize, MakeOptions(true, SendPriority::kLow, 1));
+  scheduler.Add(2, 2 * kPacketSize, MakeOptions(true, SendPriority::kHigh, 1));
+  scheduler.Add(3, 1 * kPacketSize, MakeOptions(false, SendPriority::kNormal, 1));
+  std::vector<uint32_t> chosen(Drain(scheduler));
+  std::vector<uint32_t> expected = { 3, 1, 1, 1, 2, 2 };
+  EXPECT_EQ(expected, chosen);
+}
+
+TEST(WriteSchedulerTest, BEH_UnorderedFitsWindow) {
+  const size_t kWindowSize(4);
+  WriteScheduler scheduler(kWindowSize);
+  scheduler.Add(1, 3 * kPacketSize, MakeOptions(false, SendPriority::kNormal, 1));
+  scheduler.Add(2, 100 * kPacketSize, MakeOptions(true, SendPriority::kNormal, 1));
+  scheduler.Add(3, 3 * kPacketSize, MakeOptions(false, SendPriority::kNormal, 1));
+  std::vector<uint32_t> chosen(Drain(scheduler));
+  ASSERT_EQ(106U, chosen.size());
+
+  // Every unordered message's packets span no more than the window
+  for (uint32_t message_number(1); message_number <= 3; message_number += 2) {
+    size_t first(chosen.size()), last(0);
+    for (size_t i(0); i != chosen.size(); ++i) {
+      if (chosen[i] == message_number) {
+        first = std::min(first, i);
+        last = i;
+      }
+    }
+    EXPECT_LT(last - first, kWindowSize);
+  }
+  // The in-order message is interleaved with the first unordered one
+  std::vector<uint32_t> expected_start = { 1, 2, 1, 1 };
+  EXPECT_EQ(expected_start, std::vector<uint32_t>(chosen.begin(), chosen.begin() + 4));
+}
+
+TEST(WriteSchedulerTest, BEH_Remove) {
+  WriteScheduler scheduler(4);
+  scheduler.Add(1, 4 * kPacketSize, MakeOptions(false, SendPriority::kNormal, 1));
+  scheduler.Add(2, 2 * kPacketSize, MakeOptions(true, SendPriority::kNormal, 1));
+  uint32_t message_number(0);
+  ASSERT_TRUE(scheduler.Next(kPacketSize, message_number));
+  EXPECT_EQ(1U, message_number);
+  scheduler.OnPacketAdded(message_number, kPacketSize);
+  // The unordered message fills the window, so nothing else can be interleaved with it
+  ASSERT_TRUE(scheduler.Next(kPacketSize, message_number));
+  EXPECT_EQ(1U, message_number);
+
+  // Once removed, it no longer holds up the other message
+  scheduler.Remove(1);
+  std::vector<uint32_t> expected = { 2, 2 };
+  EXPECT_EQ(expected, Drain(scheduler));
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -20,6 +20,8 @@ License.
 
 #include "boost/asio/deadline_timer.hpp"
 
+#include "maidsafe/rudp/core/clock.h"
+
 namespace maidsafe {
 
 namespace rudp {
@@ -27,7 +29,8 @@ namespace rudp {
 namespace detail {
 
 // Lightweight wrapper around a deadline_timer that avoids modifying the expiry time if it would
-// move it further away.
+// move it further away.  The expiry time is measured by Clock, so if the io_service's timers aren't
+// in step with it (i.e. in a simulation) the owner must poll ExpiresAt() rather than use AsyncWait.
 class TickTimer {
  public:
   explicit TickTimer(boost::asio::io_service& asio_service)
@@ -35,12 +38,14 @@ class TickTimer {
     Reset();
   }
 
-  static boost::posix_time::ptime Now() { return boost::asio::deadline_timer::traits_type::now(); }
+  static boost::posix_time::ptime Now() { return Clock::Now(); }
 
   void Cancel() { timer_.cancel(); }
 
   void Reset() { timer_.expires_at(boost::posix_time::pos_infin); }
 
+  boost::posix_time::ptime ExpiresAt() const { return timer_.expires_at(); }
+
   bool Expired() const {
     // Infinite time out will be counted as expired
     if (timer_.expires_at() == boost::posix_time::pos_infin)
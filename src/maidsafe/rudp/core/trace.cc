@@ -0,0 +1,242 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/core/trace.h"
+
+#include <algorithm>
+#include <set>
+
+#include "maidsafe/rudp/trace.h"
+#include "maidsafe/rudp/core/clock.h"
+
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+struct EventDescription {
+  const char* name;
+  // Names of the values in the timeline, or nullptr if unused.
+  const char* value1;
+  const char* value2;
+};
+
+const EventDescription kEventDescriptions[] = {
+  { "DataSent", "sequence_number", "bytes" },
+  { "DataResent", "sequence_number", "bytes" },
+  { "DataReceived", "sequence_number", "bytes" },
+  { "AckSent", "sequence_number", "ack_number" },
+  { "AckReceived", "sequence_number", "ack_number" },
+  { "NegativeAckSent", nullptr, nullptr },
+  { "NegativeAckReceived", nullptr, nullptr },
+  { "SendTimeout", "packets_lost", nullptr },
+  { "Window", "send", "receive" },
+  { "Tick", nullptr, nullptr }
+};
+
+static_assert(sizeof(kEventDescriptions) / sizeof(kEventDescriptions[0]) ==
+                  static_cast<size_t>(TraceEvent::kEventCount),
+              "Each trace event needs a description.");
+
+const char kMagic[8] = { 'R', 'U', 'D', 'P', 'T', 'R', 'C', '1' };
+
+// The file format is independent of the host's byte order so that traces can be read elsewhere.
+template <typename T>
+void WriteLittleEndian(T value, std::ostream& stream) {
+  for (size_t i(0); i != sizeof(T); ++i)
+    stream.put(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+template <typename T>
+bool ReadLittleEndian(std::istream& stream, T& value) {
+  value = 0;
+  for (size_t i(0); i != sizeof(T); ++i) {
+    int c(stream.get());
+    if (c == std::char_traits<char>::eof())
+      return false;
+    value |= static_cast<T>(static_cast<T>(c & 0xff) << (8 * i));
+  }
+  return true;
+}
+
+uint64_t MicrosecondsSinceEpoch(const bptime::ptime& time) {
+  static const bptime::ptime kEpoch(boost::gregorian::date(1970, 1, 1));
+  return static_cast<uint64_t>((time - kEpoch).total_microseconds());
+}
+
+}  // unnamed namespace
+
+struct Trace::Ring {
+  explicit Ring(uint16_t thread_in) : records(), count(0), thread(thread_in) {}
+  std::array<TraceRecord, kRingCapacity> records;
+  // The number of records ever pushed.  Only the owning thread writes records; it publishes each
+  // one by incrementing count.
+  std::atomic<uint64_t> count;
+  const uint16_t thread;
+};
+
+std::atomic<bool> Trace::enabled_(false);
+
+const char* TraceEventName(TraceEvent event) {
+  return event < TraceEvent::kEventCount ? kEventDescriptions[static_cast<size_t>(event)].name :
+                                           "Unknown";
+}
+
+std::mutex& Trace::RingsMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::vector<std::unique_ptr<Trace::Ring>>& Trace::Rings() {  // NOLINT (Fraser)
+  static std::vector<std::unique_ptr<Ring>> rings;
+  return rings;
+}
+
+void Trace::Start() { enabled_.store(true); }
+
+void Trace::Stop() { enabled_.store(false); }
+
+Trace::Ring& Trace::ThisThreadRing() {
+  static thread_local Ring* ring(nullptr);
+  if (!ring) {
+    std::lock_guard<std::mutex> lock(RingsMutex());
+    Rings().emplace_back(new Ring(static_cast<uint16_t>(Rings().size())));
+    ring = Rings().back().get();
+  }
+  return *ring;
+}
+
+void Trace::DoRecord(TraceEvent event, uint32_t socket_id, uint32_t value1, uint32_t value2) {
+  Ring& ring(ThisThreadRing());
+  uint64_t n(ring.count.load(std::memory_order_relaxed));
+  TraceRecord& record(ring.records[n % kRingCapacity]);
+  record.time = MicrosecondsSinceEpoch(Clock::Now());
+  record.socket_id = socket_id;
+  record.value1 = value1;
+  record.value2 = value2;
+  record.thread = ring.thread;
+  record.event = static_cast<uint8_t>(event);
+  ring.count.store(n + 1, std::memory_order_release);
+}
+
+std::vector<TraceRecord> Trace::Snapshot() {
+  std::vector<TraceRecord> records;
+  std::lock_guard<std::mutex> lock(RingsMutex());
+  for (const auto& ring : Rings()) {
+    uint64_t end(ring->count.load(std::memory_order_acquire));
+    uint64_t begin(end > kRingCapacity ? end - kRingCapacity : 0);
+    std::vector<TraceRecord> copied;
+    copied.reserve(static_cast<size_t>(end - begin));
+    for (uint64_t n(begin); n != end; ++n)
+      copied.push_back(ring->records[n % kRingCapacity]);
+    // The owner may have overwritten the oldest records while they were being copied, and may be
+    // part way through overwriting the next one.
+    uint64_t now_end(ring->count.load(std::memory_order_acquire));
+    uint64_t first_valid(now_end + 1 > kRingCapacity ? now_end + 1 - kRingCapacity : 0);
+    if (first_valid > begin)
+      copied.erase(copied.begin(),
+                   copied.begin() + static_cast<size_t>(std::min(first_valid, end) - begin));
+    records.insert(records.end(), copied.begin(), copied.end());
+  }
+  std::stable_sort(records.begin(), records.end(),
+                   [](const TraceRecord& lhs, const TraceRecord& rhs) {
+                     return lhs.time < rhs.time;
+                   });
+  return records;
+}
+
+void Trace::Write(std::ostream& stream) {
+  std::vector<TraceRecord> records(Snapshot());
+  stream.write(kMagic, sizeof(kMagic));
+  WriteLittleEndian(static_cast<uint64_t>(records.size()), stream);
+  for (const auto& record : records) {
+    WriteLittleEndian(record.time, stream);
+    WriteLittleEndian(record.socket_id, stream);
+    WriteLittleEndian(record.value1, stream);
+    WriteLittleEndian(record.value2, stream);
+    WriteLittleEndian(record.thread, stream);
+    WriteLittleEndian(record.event, stream);
+  }
+}
+
+bool Trace::Read(std::istream& stream, std::vector<TraceRecord>& records) {
+  records.clear();
+  char magic[sizeof(kMagic)];
+  uint64_t count(0);
+  if (!stream.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), kMagic) ||
+      !ReadLittleEndian(stream, count)) {
+    return false;
+  }
+  for (uint64_t n(0); n != count; ++n) {
+    TraceRecord record;
+    if (!ReadLittleEndian(stream, record.time) || !ReadLittleEndian(stream, record.socket_id) ||
+        !ReadLittleEndian(stream, record.value1) || !ReadLittleEndian(stream, record.value2) ||
+        !ReadLittleEndian(stream, record.thread) || !ReadLittleEndian(stream, record.event)) {
+      return false;
+    }
+    records.push_back(record);
+  }
+  return true;
+}
+
+void Trace::WriteTimeline(const std::vector<TraceRecord>& records, std::ostream& stream) {
+  // Timestamps are relative to the first event, which is given in the metadata.
+  uint64_t start_time(records.empty() ? 0 : records.front().time);
+  for (const auto& record : records)
+    start_time = std::min(start_time, record.time);
+
+  stream << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"start_time_us\":" << start_time
+         << "},\"traceEvents\":[";
+  const char* separator("\n");
+  std::set<uint32_t> named_sockets;
+  for (const auto& record : records) {
+    if (named_sockets.insert(record.socket_id).second) {
+      stream << separator << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << record.socket_id
+             << ",\"args\":{\"name\":\"Connection to socket " << record.socket_id << "\"}}";
+      separator = ",\n";
+    }
+    if (record.event >= static_cast<uint8_t>(TraceEvent::kEventCount))
+      continue;
+    const EventDescription& description(kEventDescriptions[record.event]);
+    bool counter(record.event == static_cast<uint8_t>(TraceEvent::kWindowChanged));
+    stream << separator << "{\"name\":\"" << description.name << "\",\"cat\":\"rudp\",\"ph\":\""
+           << (counter ? "C" : "i\",\"s\":\"t") << "\",\"ts\":" << record.time - start_time
+           << ",\"pid\":" << record.socket_id << ",\"tid\":" << record.thread << ",\"args\":{";
+    if (description.value1)
+      stream << "\"" << description.value1 << "\":" << record.value1;
+    if (description.value2)
+      stream << ",\"" << description.value2 << "\":" << record.value2;
+    stream << "}}";
+    separator = ",\n";
+  }
+  stream << "\n]}\n";
+}
+
+}  // namespace detail
+
+void StartTracing() { detail::Trace::Start(); }
+
+void StopTracing() { detail::Trace::Stop(); }
+
+void WriteTrace(std::ostream& binary_stream) { detail::Trace::Write(binary_stream); }
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,115 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CORE_TRACE_H_
+#define MAIDSAFE_RUDP_CORE_TRACE_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// The packet-level events which can be traced.  The meaning of a record's values depends on its
+// event.
+enum class TraceEvent : uint8_t {
+  kDataSent = 0,         // value1: packet sequence number, value2: payload bytes
+  kDataResent,           // value1: packet sequence number, value2: payload bytes
+  kDataReceived,         // value1: packet sequence number, value2: payload bytes
+  kAckSent,              // value1: next expected packet sequence number, value2: ack number
+  kAckReceived,          // value1: next expected packet sequence number, value2: ack number
+  kNegativeAckSent,      // (no values)
+  kNegativeAckReceived,  // (no values)
+  kSendTimeout,          // value1: number of packets marked lost
+  kWindowChanged,        // value1: send window size, value2: receive window size
+  kTick,                 // (no values)
+  kEventCount
+};
+
+const char* TraceEventName(TraceEvent event);
+
+// One traced event.  Connections are identified by the peer's socket ID, which is unique among the
+// connections of this node, and threads by the order in which they first recorded an event.
+struct TraceRecord {
+  TraceRecord() : time(0), socket_id(0), value1(0), value2(0), thread(0), event(0), reserved(0) {}
+  // Microseconds since the epoch, as given by Clock::Now().
+  uint64_t time;
+  uint32_t socket_id, value1, value2;
+  uint16_t thread;
+  uint8_t event, reserved;
+};
+
+// Records events into a ring buffer per thread.  Recording takes no locks, so it is cheap enough to
+// leave on under load; while tracing is stopped, Record costs a single relaxed atomic load.  Each
+// ring keeps only the latest kRingCapacity events of its thread.
+class Trace {
+ public:
+  enum { kRingCapacity = 1 << 14 };
+
+  static bool Enabled() { return enabled_.load(std::memory_order_relaxed); }
+  static void Start();
+  static void Stop();
+
+  static void Record(TraceEvent event, uint32_t socket_id, uint32_t value1 = 0,
+                     uint32_t value2 = 0) {
+    if (Enabled())
+      DoRecord(event, socket_id, value1, value2);
+  }
+
+  // Copies the events currently held by every thread's ring, in order of time.  Events being
+  // overwritten while they are copied are left out, as is the oldest event of a full ring since its
+  // owner may be part way through overwriting it.
+  static std::vector<TraceRecord> Snapshot();
+
+  // Writes a snapshot in a binary format which can be read back by Read.
+  static void Write(std::ostream& stream);
+
+  // Reads the output of Write.  Returns false if "stream" doesn't hold a complete trace.
+  static bool Read(std::istream& stream, std::vector<TraceRecord>& records);
+
+  // Converts records to the Trace Event Format (JSON) understood by timeline viewers such as
+  // chrome://tracing and Perfetto.  Each connection is shown as a process, with window sizes as
+  // counters and all other events as instants on the thread which recorded them.
+  static void WriteTimeline(const std::vector<TraceRecord>& records, std::ostream& stream);
+
+ private:
+  struct Ring;
+
+  static void DoRecord(TraceEvent event, uint32_t socket_id, uint32_t value1, uint32_t value2);
+  static Ring& ThisThreadRing();
+  // Rings are never freed, so that the events of threads which have exited can still be written and
+  // so that each thread's cached pointer to its ring remains valid.
+  static std::mutex& RingsMutex();
+  static std::vector<std::unique_ptr<Ring>>& Rings();  // NOLINT (Fraser)
+
+  static std::atomic<bool> enabled_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_TRACE_H_
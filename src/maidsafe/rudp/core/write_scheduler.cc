@@ -0,0 +1,176 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/core/write_scheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+// The pass advances by kStride per byte for a message of weight 1.
+const uint64_t kStride(1 << 16);
+
+}  // unnamed namespace
+
+WriteScheduler::Message::Message(size_t size, const SendOptions& options, uint64_t pass_in)
+    : remaining(size),
+      in_order(options.in_order),
+      priority(options.priority),
+      weight(std::max<uint32_t>(options.weight, 1)),
+      pass(pass_in),
+      started(false),
+      first_packet(0) {}
+
+WriteScheduler::WriteScheduler(size_t window_size)
+    : window_size_(window_size),
+      messages_(),
+      in_order_(),
+      unordered_(),
+      started_unordered_(),
+      virtual_times_(),
+      packets_added_(0) {}
+
+void WriteScheduler::Add(uint32_t message_number, size_t size, const SendOptions& options) {
+  assert(size != 0);
+  auto result(messages_.insert(std::make_pair(
+      message_number, Message(size, options, virtual_times_[options.priority]))));
+  if (!result.second)
+    return;
+  if (options.in_order)
+    in_order_.insert(message_number);
+  else
+    unordered_.insert(RankOf(message_number, result.first->second));
+}
+
+void WriteScheduler::Remove(uint32_t message_number) {
+  auto itr(messages_.find(message_number));
+  if (itr == messages_.end())
+    return;
+  if (itr->second.in_order) {
+    in_order_.erase(message_number);
+  } else {
+    unordered_.erase(RankOf(message_number, itr->second));
+    started_unordered_.erase(message_number);
+  }
+  messages_.erase(itr);
+}
+
+void WriteScheduler::Clear() {
+  messages_.clear();
+  in_order_.clear();
+  unordered_.clear();
+  started_unordered_.clear();
+  virtual_times_.clear();
+}
+
+bool WriteScheduler::IsEmpty() const { return messages_.empty(); }
+
+bool WriteScheduler::Next(size_t packet_size, uint32_t& message_number) const {
+  // Work out how much of the window is committed to unordered messages already started: the
+  // packets added since the first of them started, plus those still needed to finish them all.
+  bool unordered_started(!started_unordered_.empty());
+  uint64_t oldest_first_packet(std::numeric_limits<uint64_t>::max());
+  size_t committed(0);
+  for (uint32_t number : started_unordered_) {
+    const Message& message(messages_.find(number)->second);
+    oldest_first_packet = std::min(oldest_first_packet, message.first_packet);
+    committed += PacketCount(message.remaining, packet_size);
+  }
+  if (unordered_started)
+    committed += static_cast<size_t>(packets_added_ - oldest_first_packet);
+
+  auto allowed([&](const Message& message)->bool {
+    if (!unordered_started || (!message.in_order && message.started))
+      return true;
+    size_t needed(message.in_order ? 1 : PacketCount(message.remaining, packet_size));
+    return committed + needed <= window_size_;
+  });
+
+  // In-order messages make up a single stream, so only the earliest of them can be sent.
+  Rank best;
+  bool found(false);
+  if (!in_order_.empty()) {
+    const Message& message(messages_.find(*in_order_.begin())->second);
+    if (allowed(message)) {
+      best = RankOf(*in_order_.begin(), message);
+      found = true;
+    }
+  }
+  for (const Rank& rank : unordered_) {
+    if (found && !(rank < best))
+      break;
+    if (allowed(messages_.find(std::get<2>(rank))->second)) {
+      best = rank;
+      found = true;
+      break;
+    }
+  }
+  if (found)
+    message_number = std::get<2>(best);
+  return found;
+}
+
+void WriteScheduler::OnPacketAdded(uint32_t message_number, size_t length) {
+  auto itr(messages_.find(message_number));
+  assert(itr != messages_.end());
+  if (itr == messages_.end())
+    return;
+
+  Message& message(itr->second);
+  if (!message.in_order)
+    unordered_.erase(RankOf(message_number, message));
+  if (!message.started) {
+    message.started = true;
+    message.first_packet = packets_added_;
+    if (!message.in_order)
+      started_unordered_.insert(message_number);
+  }
+  ++packets_added_;
+  virtual_times_[message.priority] = message.pass;
+  message.pass += length * kStride / message.weight;
+  message.remaining -= std::min(length, message.remaining);
+  if (message.remaining == 0) {
+    if (message.in_order)
+      in_order_.erase(message_number);
+    else
+      started_unordered_.erase(message_number);
+    messages_.erase(itr);
+  } else if (!message.in_order) {
+    unordered_.insert(RankOf(message_number, message));
+  }
+}
+
+WriteScheduler::Rank WriteScheduler::RankOf(uint32_t message_number, const Message& message) {
+  return Rank(-static_cast<int>(message.priority), message.pass, message_number);
+}
+
+size_t WriteScheduler::PacketCount(size_t size, size_t packet_size) {
+  assert(packet_size != 0);
+  return (size + packet_size - 1) / packet_size;
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
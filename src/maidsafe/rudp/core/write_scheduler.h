@@ -0,0 +1,119 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_CORE_WRITE_SCHEDULER_H_
+#define MAIDSAFE_RUDP_CORE_WRITE_SCHEDULER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <tuple>
+
+#include "maidsafe/rudp/send_options.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Chooses which of the messages waiting to be written to a socket supplies its next data packet.
+// Messages of a higher priority always go first.  Within a priority, packets are shared between
+// messages in proportion to their weights using stride scheduling, so a small message waiting
+// alongside a large one doesn't have to wait for the whole of the large one to be sent.
+//
+// The peer can only pass an unordered message up once all of its packets are held in its receive
+// window, and the window can't move past an incomplete unordered message.  So the packets sent
+// from the first to the last packet of any unordered message must all fit in the window.  Packets
+// from other messages are only interleaved while that still holds; otherwise only the unordered
+// messages already started are scheduled.
+//
+// In-order messages form a single stream, so they are sent one after another in the order added.
+//
+// Messages are identified by the socket's message number, which must increase as they're added.
+// All sizes are in bytes.  Choosing the next message doesn't visit every waiting message, since a
+// socket may have thousands queued.
+class WriteScheduler {
+ public:
+  // "window_size" is the number of packets which the peer's receive window is certain to hold.
+  explicit WriteScheduler(size_t window_size);
+
+  // Add a message of "size" bytes.  options.stream_id is ignored.
+  void Add(uint32_t message_number, size_t size, const SendOptions& options);
+
+  // Remove a message before all of it has been added, e.g. because it timed out.
+  void Remove(uint32_t message_number);
+
+  // Remove all messages.
+  void Clear();
+
+  bool IsEmpty() const;
+
+  // Choose the message which should supply the next packet, given that packets carry at most
+  // "packet_size" bytes.  Returns false only if there are no messages.
+  bool Next(size_t packet_size, uint32_t& message_number) const;
+
+  // Record that a packet of "length" bytes from the message has been added to the sender's window.
+  // Once all of it has been added, the message is removed.
+  void OnPacketAdded(uint32_t message_number, size_t length);
+
+ private:
+  // Disallow copying and assignment.
+  WriteScheduler(const WriteScheduler&);
+  WriteScheduler& operator=(const WriteScheduler&);
+
+  struct Message {
+    Message(size_t size, const SendOptions& options, uint64_t pass);
+    size_t remaining;
+    bool in_order;
+    SendPriority priority;
+    uint32_t weight;
+    // The stride scheduling pass; the message with the lowest pass in the highest priority goes
+    // next, and each packet advances it in inverse proportion to the weight.
+    uint64_t pass;
+    // Whether any packets have been added yet, and if so the value of packets_added_ at the first.
+    bool started;
+    uint64_t first_packet;
+  };
+
+  // Orders messages best first: highest priority, then lowest pass, then earliest message.
+  typedef std::tuple<int, uint64_t, uint32_t> Rank;
+  static Rank RankOf(uint32_t message_number, const Message& message);
+
+  // The number of packets needed to carry "size" bytes.
+  static size_t PacketCount(size_t size, size_t packet_size);
+
+  size_t window_size_;
+  std::map<uint32_t, Message> messages_;
+  // The in-order messages, of which only the first can be sent.
+  std::set<uint32_t> in_order_;
+  // The unordered messages, best first, and those of them which have started.
+  std::set<Rank> unordered_;
+  std::set<uint32_t> started_unordered_;
+  // The pass of the message which most recently supplied a packet, per priority.  New messages
+  // start here so they neither jump ahead of nor fall behind those already waiting.
+  std::map<SendPriority, uint64_t> virtual_times_;
+  // The total number of packets added for all messages.
+  uint64_t packets_added_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_WRITE_SCHEDULER_H_
@@ -16,17 +16,22 @@ License.
 #include "maidsafe/rudp/managed_connections.h"
 
 #include <algorithm>
+#include <chrono>
 #include <functional>
+#include <future>
 #include <iterator>
 #include <map>
+#include <utility>
 
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/utils.h"
 
 #include "maidsafe/rudp/return_codes.h"
+#include "maidsafe/rudp/bootstrap_cache.h"
 #include "maidsafe/rudp/transport.h"
 #include "maidsafe/rudp/connection.h"
 #include "maidsafe/rudp/utils.h"
+#include "maidsafe/rudp/core/metrics.h"
 
 namespace args = std::placeholders;
 namespace bptime = boost::posix_time;
@@ -75,6 +80,33 @@ int CheckBootstrappingParameters(const std::vector<Endpoint>& bootstrap_endpoint
   return kSuccess;
 }
 
+// Gathers the per-peer results of a batch operation, invoking functor once the last one is in.
+template <typename Result>
+class BatchResults {
+ public:
+  typedef std::function<void(const std::map<NodeId, Result>&)> Functor;
+  BatchResults(size_t count, Functor functor)
+      : mutex_(), outstanding_(count), results_(), functor_(functor) {}
+  void Set(const NodeId& peer_id, const Result& result) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      results_[peer_id] = result;
+      assert(outstanding_ != 0);
+      if (--outstanding_ != 0)
+        return;
+    }
+    functor_(results_);
+  }
+
+ private:
+  BatchResults(const BatchResults&);
+  BatchResults& operator=(const BatchResults&);
+  std::mutex mutex_;
+  size_t outstanding_;
+  std::map<NodeId, Result> results_;
+  Functor functor_;
+};
+
 }  // unnamed namespace
 
 ManagedConnections::PendingConnection::PendingConnection(const NodeId& node_id_in,
@@ -84,7 +116,8 @@ ManagedConnections::PendingConnection::PendingConnection(const NodeId& node_id_i
       pending_transport(transport),
       timer(io_service,
             bptime::microsec_clock::universal_time() + Parameters::rendezvous_connect_timeout),
-      connecting(false) {}
+      connecting(false),
+      add_functor() {}
 
 
 ManagedConnections::ManagedConnections()
@@ -99,26 +132,44 @@ ManagedConnections::ManagedConnections()
       connections_(),
       pendings_(),
       idle_transports_(),
+      starting_transports_(),
       mutex_(),
       local_ip_(),
-      nat_type_(NatType::kUnknown) {}
+      nat_type_(NatType::kUnknown),
+      bootstrap_cache_(),
+      starting_spare_transport_(false),
+      spare_transport_waiters_() {}
 
 ManagedConnections::~ManagedConnections() {
+  // The transports are closed without holding mutex_, as closing waits on each transport's strand,
+  // which may be running a handler blocked in one of our slots waiting for mutex_.
+  decltype(connections_) connections;
+  decltype(pendings_) pendings;
+  decltype(idle_transports_) idle_transports;
+  decltype(starting_transports_) starting_transports;
   {
     std::lock_guard<std::mutex> lock(mutex_);
-    for (auto connection_details : connections_)
-      connection_details.second->Close();
-    connections_.clear();
-    for (auto& pending : pendings_)
-      pending->pending_transport->Close();
-    pendings_.clear();
-    for (auto idle_transport : idle_transports_)
-      idle_transport->Close();
-    idle_transports_.clear();
+    connections.swap(connections_);
+    pendings.swap(pendings_);
+    idle_transports.swap(idle_transports_);
+    starting_transports.swap(starting_transports_);
   }
+  for (auto connection_details : connections)
+    connection_details.second->Close();
+  for (auto& pending : pendings)
+    pending.second->pending_transport->Close();
+  for (auto idle_transport : idle_transports)
+    idle_transport->Close();
+  for (auto starting_transport : starting_transports)
+    starting_transport->Close();
   asio_service_.Stop();
 }
 
+void ManagedConnections::SetBootstrapCache(const boost::filesystem::path& cache_path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  bootstrap_cache_ = std::make_shared<detail::BootstrapCache>(cache_path);
+}
+
 int ManagedConnections::Bootstrap(const std::vector<Endpoint>& bootstrap_endpoints,
                                   MessageReceivedFunctor message_received_functor,
                                   ConnectionLostFunctor connection_lost_functor,
@@ -128,6 +179,27 @@ int ManagedConnections::Bootstrap(const std::vector<Endpoint>& bootstrap_endpoin
                                   NodeId& chosen_bootstrap_peer,
                                   NatType& nat_type,
                                   Endpoint local_endpoint) {
+  auto promise(std::make_shared<std::promise<int>>());
+  auto future(promise->get_future());
+  Bootstrap(bootstrap_endpoints, message_received_functor, connection_lost_functor, this_node_id,
+            private_key, public_key,
+            [&, promise](int result, const NodeId& chosen_id, NatType detected_nat_type) {
+              chosen_bootstrap_peer = chosen_id;
+              nat_type = detected_nat_type;
+              promise->set_value(result);
+            },
+            local_endpoint);
+  return future.get();
+}
+
+void ManagedConnections::Bootstrap(const std::vector<Endpoint>& bootstrap_endpoints,
+                                   MessageReceivedFunctor message_received_functor,
+                                   ConnectionLostFunctor connection_lost_functor,
+                                   NodeId this_node_id,
+                                   std::shared_ptr<asymm::PrivateKey> private_key,
+                                   std::shared_ptr<asymm::PublicKey> public_key,
+                                   BootstrapFunctor bootstrap_functor,
+                                   Endpoint local_endpoint) {
   ClearConnectionsAndIdleTransports();
   int result(CheckBootstrappingParameters(bootstrap_endpoints,
                                           message_received_functor,
@@ -136,7 +208,7 @@ int ManagedConnections::Bootstrap(const std::vector<Endpoint>& bootstrap_endpoin
                                           private_key,
                                           public_key));
   if (result != kSuccess)
-    return result;
+    return bootstrap_functor(result, NodeId(), nat_type_);
 
 
   this_node_id_ = this_node_id;
@@ -146,23 +218,35 @@ int ManagedConnections::Bootstrap(const std::vector<Endpoint>& bootstrap_endpoin
 
   result = TryToDetermineLocalEndpoint(local_endpoint);
   if (result != kSuccess)
-    return result;
+    return bootstrap_functor(result, NodeId(), nat_type_);
 
-  result = AttemptStartNewTransport(bootstrap_endpoints,
-                                    local_endpoint,
-                                    chosen_bootstrap_peer,
-                                    nat_type);
-  if (result != kSuccess)
-    return result;
-
-  // Add callbacks now.
-  {
-    std::lock_guard<std::mutex> guard(callback_mutex_);
-    message_received_functor_ = message_received_functor;
-    connection_lost_functor_ = connection_lost_functor;
+  NodeIdEndpointPairs bootstrap_peers;
+  for (auto element : bootstrap_cache_ ? bootstrap_cache_->Rank(bootstrap_endpoints) :
+                                         bootstrap_endpoints) {
+    bootstrap_peers.push_back(std::make_pair(NodeId(), element));
   }
+  StartNewTransport(bootstrap_peers, local_endpoint,
+                    [=](bool started) {
+    if (!started) {
+      LOG(kError) << "Failed to bootstrap managed connections.";
+      return bootstrap_functor(kTransportStartFailure, NodeId(), nat_type_);
+    }
 
-  return kSuccess;
+    // Add callbacks now.
+    {
+      std::lock_guard<std::mutex> guard(callback_mutex_);
+      message_received_functor_ = message_received_functor;
+      connection_lost_functor_ = connection_lost_functor;
+    }
+
+    NodeId chosen_bootstrap_peer;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      chosen_bootstrap_peer = chosen_bootstrap_node_id_;
+      StartReplenishingSpareTransports();
+    }
+    bootstrap_functor(kSuccess, chosen_bootstrap_peer, nat_type_);
+  });
 }
 
 void ManagedConnections::ClearConnectionsAndIdleTransports() {
@@ -179,6 +263,13 @@ void ManagedConnections::ClearConnectionsAndIdleTransports() {
   for (auto idle_transport : idle_transports_)
     idle_transport->Close();
   idle_transports_.clear();
+  // Otherwise a spare transport which bootstrapped off the old connections could leave its peer
+  // to be reported as chosen by this bootstrap.
+  chosen_bootstrap_node_id_ = NodeId();
+  // A spare transport may still be bootstrapping off the old connections.
+  for (auto starting_transport : starting_transports_)
+    starting_transport->Close();
+  starting_transports_.clear();
 }
 
 int ManagedConnections::TryToDetermineLocalEndpoint(Endpoint& local_endpoint) {
@@ -196,24 +287,9 @@ int ManagedConnections::TryToDetermineLocalEndpoint(Endpoint& local_endpoint) {
   return kSuccess;
 }
 
-int ManagedConnections::AttemptStartNewTransport(const std::vector<Endpoint>& bootstrap_endpoints,
-                                                 const Endpoint& local_endpoint,
-                                                 NodeId& chosen_bootstrap_peer,
-                                                 NatType& nat_type) {
-  NodeIdEndpointPairs bootstrap_peers;
-  for (auto element : bootstrap_endpoints)
-    bootstrap_peers.push_back(std::make_pair(NodeId(), element));
-  if (!StartNewTransport(bootstrap_peers, local_endpoint)) {
-    LOG(kError) << "Failed to bootstrap managed connections.";
-    return kTransportStartFailure;
-  }
-  chosen_bootstrap_peer = chosen_bootstrap_node_id_;
-  nat_type = nat_type_;
-  return kSuccess;
-}
-
-bool ManagedConnections::StartNewTransport(NodeIdEndpointPairs bootstrap_peers,
-                                           Endpoint local_endpoint) {
+void ManagedConnections::StartNewTransport(NodeIdEndpointPairs bootstrap_peers,
+                                           Endpoint local_endpoint,
+                                           std::function<void(bool)> on_started) {
   TransportPtr transport(new detail::Transport(asio_service_, nat_type_));
   bool bootstrap_off_existing_connection(bootstrap_peers.empty());
   boost::asio::ip::address external_address;
@@ -223,47 +299,59 @@ bool ManagedConnections::StartNewTransport(NodeIdEndpointPairs bootstrap_peers,
   //  bootstrap_endpoints.insert(bootstrap_endpoints.begin(),
   //                             Endpoint(local_ip_, kResiliencePort()));
 
-  transport->SetManagedConnectionsDebugPrintout([this]() { return DebugString(); });  // NOLINT (Fraser)
-  NodeId chosen_id;
-  if (!transport->Bootstrap(bootstrap_peers,
-                            this_node_id_,
-                            public_key_,
-                            local_endpoint,
-                            bootstrap_off_existing_connection,
-                            std::bind(&ManagedConnections::OnMessageSlot, this, args::_1),
-                            [this] (const NodeId& peer_id,
-                                    TransportPtr transport,
-                                    bool temporary_connection,
-                                    bool& is_duplicate_normal_connection) {
-                              OnConnectionAddedSlot(peer_id,
-                                                    transport,
-                                                    temporary_connection,
-                                                    is_duplicate_normal_connection);
-                            },
-                            std::bind(&ManagedConnections::OnConnectionLostSlot, this,
-                                      args::_1, args::_2, args::_3),
-                            std::bind(&ManagedConnections::OnNatDetectionRequestedSlot, this,
-                                      args::_1, args::_2, args::_3, args::_4),
-                            chosen_id)) {
+  {
     std::lock_guard<std::mutex> lock(mutex_);
-    LOG(kWarning) << "Failed to start a new Transport.";
-    transport->Close();
-    return false;
-  }
-
-  if (chosen_bootstrap_node_id_ == NodeId())
-    chosen_bootstrap_node_id_ = chosen_id;
-
-  if (!detail::IsValid(transport->external_endpoint()) && !external_address.is_unspecified()) {
-    // Means this node's NAT is symmetric or unknown, so guess that it will be mapped to existing
-    // external address and local port.
-    transport->SetBestGuessExternalEndpoint(Endpoint(external_address,
-                                                     transport->local_endpoint().port()));
+    starting_transports_.insert(transport);
   }
+  transport->SetManagedConnectionsDebugPrintout([this]() { return DebugString(); });  // NOLINT (Fraser)
+  transport->SetBootstrapCache(bootstrap_cache_);
+  transport->Bootstrap(bootstrap_peers,
+                       this_node_id_,
+                       public_key_,
+                       local_endpoint,
+                       bootstrap_off_existing_connection,
+                       std::bind(&ManagedConnections::OnMessageSlot, this, args::_1),
+                       [this] (const NodeId& peer_id,
+                               TransportPtr transport,
+                               bool temporary_connection,
+                               bool& is_duplicate_normal_connection) {
+                         OnConnectionAddedSlot(peer_id,
+                                               transport,
+                                               temporary_connection,
+                                               is_duplicate_normal_connection);
+                       },
+                       std::bind(&ManagedConnections::OnConnectionLostSlot, this,
+                                 args::_1, args::_2, args::_3),
+                       std::bind(&ManagedConnections::OnNatDetectionRequestedSlot, this,
+                                 args::_1, args::_2, args::_3, args::_4),
+                       [this, transport, external_address, on_started] (bool started,
+                                                                        const NodeId& chosen_id) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (starting_transports_.erase(transport) == 0U) {
+        // ManagedConnections has been reset or destroyed meanwhile, and has closed the transport.
+        started = false;
+      } else if (!started) {
+        LOG(kWarning) << "Failed to start a new Transport.";
+        transport->Close();
+      } else if (chosen_bootstrap_node_id_ == NodeId()) {
+        chosen_bootstrap_node_id_ = chosen_id;
+      }
+    }
+    if (!started)
+      return on_started(false);
+
+    if (!detail::IsValid(transport->external_endpoint()) && !external_address.is_unspecified()) {
+      // Means this node's NAT is symmetric or unknown, so guess that it will be mapped to existing
+      // external address and local port.
+      transport->SetBestGuessExternalEndpoint(Endpoint(external_address,
+                                                       transport->local_endpoint().port()));
+    }
 
-  LOG(kVerbose) << "Started a new transport on " << transport->external_endpoint() << " / "
-                << transport->local_endpoint() << " behind " << nat_type_;
-  return true;
+    LOG(kVerbose) << "Started a new transport on " << transport->external_endpoint() << " / "
+                  << transport->local_endpoint() << " behind " << nat_type_;
+    on_started(true);
+  });
 }
 
 void ManagedConnections::GetBootstrapEndpoints(NodeIdEndpointPairs& bootstrap_peers,
@@ -307,64 +395,233 @@ int ManagedConnections::GetAvailableEndpoint(NodeId peer_id,
                                              EndpointPair peer_endpoint_pair,
                                              EndpointPair& this_endpoint_pair,
                                              NatType& this_nat_type) {
+  auto promise(std::make_shared<std::promise<int>>());
+  auto future(promise->get_future());
+  GetAvailableEndpoint(peer_id, peer_endpoint_pair,
+                       [&, promise](int result, const EndpointPair& endpoint_pair,
+                                    NatType nat_type) {
+                         this_endpoint_pair = endpoint_pair;
+                         this_nat_type = nat_type;
+                         promise->set_value(result);
+                       });
+  return future.get();
+}
+
+void ManagedConnections::GetAvailableEndpoint(NodeId peer_id,
+                                              EndpointPair peer_endpoint_pair,
+                                              GetAvailableEndpointFunctor get_available_functor) {
   if (peer_id == this_node_id_) {
     LOG(kError) << "Can't use this node's ID (" << DebugId(this_node_id_) << ") as peerID.";
-    return kOwnId;
+    return get_available_functor(kOwnId, EndpointPair(), NatType::kUnknown);
   }
 
-  // Functor to handle resetting parameters in case of failure.
-  const auto kDoFail([&] (const std::string& message, int result)->int {  // NOLINT (Fraser)
-                       this_endpoint_pair.external = this_endpoint_pair.local = Endpoint();
-                       this_nat_type = NatType::kUnknown;
-                       if (!message.empty())
-                         LOG(kError) << message;
-                       return result;
-                     });
+  EndpointPair this_endpoint_pair;
+  NatType this_nat_type;
+  int result(kSuccess);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    this_nat_type = nat_type_;
+    if (connections_.empty() && idle_transports_.empty()) {
+      LOG(kError) << "No running Transports.";
+      result = kNotBootstrapped;
+    } else if (ExistingConnectionAttempt(peer_id, this_endpoint_pair)) {
+      // Check for an existing connection attempt.
+      result = kConnectAttemptAlreadyRunning;
+    } else if (ExistingConnection(peer_id, this_endpoint_pair, result)) {
+      // Check for existing connection to peer.
+      if (result == kConnectionAlreadyExists) {
+        LOG(kError) << "A non-bootstrap managed connection from " << DebugId(this_node_id_)
+                    << " to " << DebugId(peer_id) << " already exists";
+      }
+    } else if (SelectIdleTransport(peer_id, this_endpoint_pair)) {
+      // Use an existing idle transport.
+      StartReplenishingSpareTransports();
+    } else if (starting_spare_transport_) {
+      // The spare transport being started is likely to be ready sooner than a new one would be.
+      spare_transport_waiters_.push_back([=] {
+        GetAvailableEndpointFromNewTransport(peer_id, peer_endpoint_pair, get_available_functor);
+      });
+      return;
+    } else {
+      result = kPendingResult;
+    }
+  }
 
+  if (result == kPendingResult)
+    return GetAvailableEndpointFromNewTransport(peer_id, peer_endpoint_pair, get_available_functor);
+  if (result == kNotBootstrapped || result == kConnectionAlreadyExists)
+    return get_available_functor(result, EndpointPair(), NatType::kUnknown);
+  get_available_functor(result, this_endpoint_pair, this_nat_type);
+}
+
+void ManagedConnections::GetAvailableEndpointFromNewTransport(
+    const NodeId& peer_id,
+    const EndpointPair& peer_endpoint_pair,
+    const GetAvailableEndpointFunctor& functor) {
+  EndpointPair this_endpoint_pair;
+  NatType this_nat_type;
+  int result(kPendingResult);
   {
     std::lock_guard<std::mutex> lock(mutex_);
     this_nat_type = nat_type_;
-    if (connections_.empty() && idle_transports_.empty())
-      return kDoFail("No running Transports.", kNotBootstrapped);
-
-    // Check for an existing connection attempt.
-    if (ExistingConnectionAttempt(peer_id, this_endpoint_pair))
-      return kConnectAttemptAlreadyRunning;
-
-    // Check for existing connection to peer.
-    int return_code(kSuccess);
-    if (ExistingConnection(peer_id, this_endpoint_pair, return_code)) {
-      if (return_code == kConnectionAlreadyExists) {
-        return kDoFail(std::string("A non-bootstrap managed connection from ") +
-                       DebugId(this_node_id_) + std::string(" to ") + DebugId(peer_id) +
-                       " already exists", kConnectionAlreadyExists);
+    if (ExistingConnectionAttempt(peer_id, this_endpoint_pair)) {
+      result = kConnectAttemptAlreadyRunning;
+    } else if (SelectIdleTransport(peer_id, this_endpoint_pair)) {
+      StartReplenishingSpareTransports();
+      result = kSuccess;
+    } else if (!ShouldStartNewTransport(peer_endpoint_pair)) {
+      if (SelectAnyTransport(peer_id, this_endpoint_pair)) {
+        StartReplenishingSpareTransports();
+        result = kSuccess;
       } else {
-        return return_code;
+        LOG(kError) << "All connectable Transports are full.";
+        result = kFull;
       }
     }
+  }
+  if (result == kFull)
+    return functor(result, EndpointPair(), NatType::kUnknown);
+  if (result != kPendingResult)
+    return functor(result, this_endpoint_pair, this_nat_type);
+
+  StartNewTransport(NodeIdEndpointPairs(), Endpoint(local_ip_, 0),
+                    [this, peer_id, functor](bool started) {
+                      if (!started) {
+                        LOG(kError) << "Failed to start transport.";
+                        return functor(kTransportStartFailure, EndpointPair(), NatType::kUnknown);
+                      }
+                      GetAvailableEndpointFromAnyTransport(peer_id, functor);
+                    });
+}
 
-    // Try to use an existing idle transport.
-    if (SelectIdleTransport(peer_id, this_endpoint_pair))
-      return kSuccess;
+void ManagedConnections::GetAvailableEndpointFromAnyTransport(
+    const NodeId& peer_id,
+    const GetAvailableEndpointFunctor& functor) {
+  EndpointPair this_endpoint_pair;
+  NatType this_nat_type;
+  int result(kSuccess);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // NAT type may have just been deduced by newly-started transport.
+    this_nat_type = nat_type_;
+    // Check again for an existing connection attempt in case it was added while mutex unlocked
+    // during starting new transport.
+    if (ExistingConnectionAttempt(peer_id, this_endpoint_pair)) {
+      result = kConnectAttemptAlreadyRunning;
+    } else if (SelectAnyTransport(peer_id, this_endpoint_pair)) {
+      StartReplenishingSpareTransports();
+    } else {
+      LOG(kError) << "All connectable Transports are full.";
+      result = kFull;
+    }
   }
+  if (result == kFull)
+    return functor(result, EndpointPair(), NatType::kUnknown);
+  functor(result, this_endpoint_pair, this_nat_type);
+}
 
-  if (ShouldStartNewTransport(peer_endpoint_pair) &&
-      !StartNewTransport(NodeIdEndpointPairs(), Endpoint(local_ip_, 0))) {  // NOLINT (Fraser)
-    return kDoFail("Failed to start transport.", kTransportStartFailure);
+void ManagedConnections::GetAvailableEndpoints(const PeerEndpointPairs& peers,
+                                               GetAvailableEndpointsFunctor get_available_functor) {
+  typedef std::pair<int, EndpointPair> Result;
+  std::map<NodeId, EndpointPair> unique_peers(peers.begin(), peers.end());
+  if (unique_peers.empty()) {
+    NatType this_nat_type;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      this_nat_type = nat_type_;
+    }
+    return get_available_functor(std::map<NodeId, Result>(), this_nat_type);
   }
 
-  std::lock_guard<std::mutex> lock(mutex_);
-  // Check again for an existing connection attempt in case it was added while mutex unlocked
-  // during starting new transport.
-  if (ExistingConnectionAttempt(peer_id, this_endpoint_pair))
-    return kConnectAttemptAlreadyRunning;
+  auto batch(std::make_shared<BatchResults<Result>>(
+      unique_peers.size(),
+      [this, get_available_functor](const std::map<NodeId, Result>& results) {
+        NatType this_nat_type;
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          this_nat_type = nat_type_;
+        }
+        get_available_functor(results, this_nat_type);
+      }));
+
+  std::vector<std::pair<NodeId, Result>> results;
+  PeerEndpointPairs unplaced_peers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (connections_.empty() && idle_transports_.empty()) {
+      LOG(kError) << "No running Transports.";
+      for (const auto& peer : unique_peers)
+        results.push_back(std::make_pair(peer.first, Result(kNotBootstrapped, EndpointPair())));
+    } else {
+      // The number of connections each running transport has or is about to have.
+      std::map<TransportPtr, size_t> loads;
+      for (const auto& connection : connections_)
+        loads[connection.second] = connection.second->NormalConnectionsCount();
+      for (const auto& transport : idle_transports_) {
+        if (transport->IsAvailable())
+          loads[transport] = transport->NormalConnectionsCount();
+      }
+      for (const auto& pending : pendings_) {
+        auto itr(loads.find(pending.second->pending_transport));
+        if (itr != loads.end())
+          ++itr->second;
+      }
 
-  // NAT type may have just been deduced by newly-started transport.
-  this_nat_type = nat_type_;
+      bool placed_any(false);
+      for (const auto& peer : unique_peers) {
+        EndpointPair this_endpoint_pair;
+        int result(kSuccess);
+        if (peer.first == this_node_id_) {
+          LOG(kError) << "Can't use this node's ID (" << DebugId(this_node_id_) << ") as peerID.";
+          result = kOwnId;
+        } else if (ExistingConnectionAttempt(peer.first, this_endpoint_pair)) {
+          result = kConnectAttemptAlreadyRunning;
+        } else if (ExistingConnection(peer.first, this_endpoint_pair, result)) {
+          if (result == kConnectionAlreadyExists)
+            this_endpoint_pair = EndpointPair();
+        } else if (nat_type_ == NatType::kSymmetric && ShouldStartNewTransport(peer.second)) {
+          // This peer needs a transport of its own.
+          unplaced_peers.push_back(peer);
+          continue;
+        } else {
+          auto least_loaded(std::min_element(
+              loads.begin(), loads.end(),
+              [](const std::pair<const TransportPtr, size_t>& lhs,
+                 const std::pair<const TransportPtr, size_t>& rhs) {
+                return lhs.second < rhs.second;
+              }));
+          if (least_loaded == loads.end() ||
+              static_cast<int>(least_loaded->second) >= detail::Transport::kMaxConnections()) {
+            unplaced_peers.push_back(peer);
+            continue;
+          }
+          TransportPtr transport(least_loaded->first);
+          ++least_loaded->second;
+          this_endpoint_pair.local = transport->local_endpoint();
+          this_endpoint_pair.external = transport->external_endpoint();
+          std::unique_ptr<PendingConnection> connection(
+              new PendingConnection(peer.first, transport, asio_service_.service()));
+          AddPending(std::move(connection));
+          placed_any = true;
+        }
+        results.push_back(std::make_pair(peer.first, Result(result, this_endpoint_pair)));
+      }
+      if (placed_any)
+        StartReplenishingSpareTransports();
+    }
+  }
 
-  return SelectAnyTransport(peer_id, this_endpoint_pair) ?
-             kSuccess :
-             kDoFail("All connectable Transports are full.", kFull);
+  // Peers which couldn't be placed take the single-peer route, which starts transports as needed.
+  for (const auto& peer : unplaced_peers) {
+    NodeId peer_id(peer.first);
+    GetAvailableEndpoint(peer_id, peer.second,
+                         [batch, peer_id](int result, const EndpointPair& this_endpoint_pair,
+                                          NatType) {
+                           batch->Set(peer_id, Result(result, this_endpoint_pair));
+                         });
+  }
+  for (const auto& result : results)
+    batch->Set(result.first, result.second);
 }
 
 bool ManagedConnections::ExistingConnectionAttempt(const NodeId& peer_id,
@@ -373,9 +630,9 @@ bool ManagedConnections::ExistingConnectionAttempt(const NodeId& peer_id,
   if (existing_attempt == pendings_.end())
     return false;
 
-  this_endpoint_pair.local = (*existing_attempt)->pending_transport->local_endpoint();
-  this_endpoint_pair.external = (*existing_attempt)->pending_transport->external_endpoint();
-  assert((*existing_attempt)->pending_transport->IsAvailable());
+  this_endpoint_pair.local = existing_attempt->second->pending_transport->local_endpoint();
+  this_endpoint_pair.external = existing_attempt->second->pending_transport->external_endpoint();
+  assert(existing_attempt->second->pending_transport->IsAvailable());
   return true;
 }
 
@@ -487,51 +744,131 @@ bool ManagedConnections::ShouldStartNewTransport(const EndpointPair& peer_endpoi
   return start_new_transport;
 }
 
+size_t ManagedConnections::SpareTransportCount() const {
+  auto is_pending([this](const TransportPtr& transport) {
+    return std::any_of(pendings_.begin(), pendings_.end(),
+                       [&transport](const PendingMap::value_type& pending) {
+                         return pending.second->pending_transport == transport;
+                       });
+  });
+  return static_cast<size_t>(std::count_if(
+      idle_transports_.begin(), idle_transports_.end(), [&](const TransportPtr& transport) {
+        return transport->IsIdle() && transport->IsAvailable() && !is_pending(transport);
+      }));
+}
+
+void ManagedConnections::StartReplenishingSpareTransports() {
+  if (starting_spare_transport_ || connections_.empty() ||
+      SpareTransportCount() >= Parameters::spare_transports ||
+      !ShouldStartNewTransport(EndpointPair())) {
+    return;
+  }
+  // Spares are started one at a time, each bootstrapping off the existing connections.
+  starting_spare_transport_ = true;
+  asio_service_.service().post([this] { StartSpareTransport(); });
+}
+
+void ManagedConnections::StartSpareTransport() {
+  StartNewTransport(NodeIdEndpointPairs(), Endpoint(local_ip_, 0), [this](bool started) {
+    if (!started)
+      LOG(kWarning) << "Failed to start a spare transport.";
+    std::vector<std::function<void()>> waiters;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      starting_spare_transport_ = false;
+      waiters.swap(spare_transport_waiters_);
+      if (started)
+        StartReplenishingSpareTransports();
+    }
+    for (const auto& waiter : waiters)
+      waiter();
+  });
+}
+
 void ManagedConnections::AddPending(std::unique_ptr<PendingConnection> connection) {
   NodeId peer_id(connection->node_id);
-  pendings_.push_back(std::move(connection));
-  pendings_.back()->timer.async_wait([peer_id, this] (const boost::system::error_code& ec) {
+  auto result(pendings_.insert(std::make_pair(peer_id, std::move(connection))));
+  assert(result.second);
+  result.first->second->timer.async_wait([peer_id, this] (const boost::system::error_code& ec) {
                                        if (ec != boost::asio::error::operation_aborted) {
                                          std::lock_guard<std::mutex> lock(mutex_);
-                                         RemovePending(peer_id);
+                                         RemovePending(peer_id, kConnectError);
                                        }
                                      });
 }
 
-void ManagedConnections::RemovePending(const NodeId& peer_id) {
+void ManagedConnections::RemovePending(const NodeId& peer_id, int result) {
   auto itr(FindPendingTransportWithNodeId(peer_id));
-  if (itr != pendings_.end())
-    pendings_.erase(itr);
+  if (itr == pendings_.end())
+    return;
+  AddFunctor add_functor(itr->second->add_functor);
+  pendings_.erase(itr);
+  if (add_functor)
+    asio_service_.service().post([add_functor, result] { add_functor(result); });
 }
 
-std::vector<std::unique_ptr<ManagedConnections::PendingConnection>>::const_iterator  // NOLINT (Fraser)
-    ManagedConnections::FindPendingTransportWithNodeId(const NodeId& peer_id) const {
-  return std::find_if(pendings_.cbegin(),
-                      pendings_.cend(),
-                      [&peer_id] (const std::unique_ptr<PendingConnection>& element) {
-                        return element->node_id == peer_id;
-                      });
+ManagedConnections::PendingMap::const_iterator ManagedConnections::FindPendingTransportWithNodeId(
+    const NodeId& peer_id) const {
+  return pendings_.find(peer_id);
 }
 
-std::vector<std::unique_ptr<ManagedConnections::PendingConnection>>::iterator  // NOLINT (Fraser)
-    ManagedConnections::FindPendingTransportWithNodeId(const NodeId& peer_id) {
-  return std::find_if(pendings_.begin(),
-                      pendings_.end(),
-                      [&peer_id] (const std::unique_ptr<PendingConnection>& element) {
-                        return element->node_id == peer_id;
-                      });
+ManagedConnections::PendingMap::iterator ManagedConnections::FindPendingTransportWithNodeId(
+    const NodeId& peer_id) {
+  return pendings_.find(peer_id);
 }
 
 int ManagedConnections::Add(NodeId peer_id,
                             EndpointPair peer_endpoint_pair,
                             std::string validation_data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return DoAdd(peer_id, peer_endpoint_pair, validation_data, AddFunctor());
+}
+
+void ManagedConnections::Add(NodeId peer_id,
+                             EndpointPair peer_endpoint_pair,
+                             std::string validation_data,
+                             AddFunctor add_functor) {
+  int result(kSuccess);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    result = DoAdd(peer_id, peer_endpoint_pair, validation_data, add_functor);
+  }
+  if (result != kPendingResult)
+    add_functor(result);
+}
+
+void ManagedConnections::Add(const PeerEndpointPairs& peers,
+                             std::string validation_data,
+                             AddPeersFunctor add_functor) {
+  std::map<NodeId, EndpointPair> unique_peers(peers.begin(), peers.end());
+  if (unique_peers.empty())
+    return add_functor(std::map<NodeId, int>());
+
+  auto batch(std::make_shared<BatchResults<int>>(unique_peers.size(), add_functor));
+  std::vector<std::pair<NodeId, int>> results;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& peer : unique_peers) {
+      NodeId peer_id(peer.first);
+      int result(DoAdd(peer_id, peer.second, validation_data,
+                       [batch, peer_id](int result) { batch->Set(peer_id, result); }));
+      if (result != kPendingResult)
+        results.push_back(std::make_pair(peer_id, result));
+    }
+  }
+  for (const auto& result : results)
+    batch->Set(result.first, result.second);
+}
+
+int ManagedConnections::DoAdd(const NodeId& peer_id,
+                              const EndpointPair& peer_endpoint_pair,
+                              const std::string& validation_data,
+                              const AddFunctor& add_functor) {
   if (peer_id == this_node_id_) {
     LOG(kError) << "Can't use this node's ID (" << DebugId(this_node_id_) << ") as peerID.";
     return kOwnId;
   }
 
-  std::lock_guard<std::mutex> lock(mutex_);
-
   auto itr(FindPendingTransportWithNodeId(peer_id));
   if (itr == pendings_.end()) {
     if (connections_.find(peer_id) != connections_.end()) {
@@ -545,14 +882,14 @@ int ManagedConnections::Add(NodeId peer_id,
     return kNoPendingConnectAttempt;
   }
 
-  if ((*itr)->connecting) {
+  if (itr->second->connecting) {
     LOG(kWarning) << "A connection attempt from " << DebugId(this_node_id_) << " to "
                   << DebugId(peer_id) << " is already happening";
     return kConnectAttemptAlreadyRunning;
   }
 
-  TransportPtr selected_transport((*itr)->pending_transport);
-  (*itr)->connecting = true;
+  TransportPtr selected_transport(itr->second->pending_transport);
+  itr->second->connecting = true;
 
   if (validation_data.empty()) {
     LOG(kError) << "Invalid validation_data passed.";
@@ -594,8 +931,9 @@ int ManagedConnections::Add(NodeId peer_id,
     }
   }
 
+  itr->second->add_functor = add_functor;
   selected_transport->Connect(peer_id, peer_endpoint_pair, validation_data);
-  return kSuccess;
+  return add_functor ? kPendingResult : kSuccess;
 }
 
 int ManagedConnections::MarkConnectionAsValid(NodeId peer_id, Endpoint& peer_endpoint) {
@@ -641,6 +979,30 @@ void ManagedConnections::Remove(NodeId peer_id) {
 void ManagedConnections::Send(NodeId peer_id,
                               std::string message,
                               MessageSentFunctor message_sent_functor) {
+  Send(peer_id, message, message_sent_functor, SendOptions());
+}
+
+void ManagedConnections::Send(NodeId peer_id,
+                              std::string message,
+                              MessageSentFunctor message_sent_functor,
+                              SendOptions options) {
+  if (peer_id == this_node_id_) {
+    LOG(kError) << "Can't use this node's ID (" << DebugId(this_node_id_) << ") as peerID.";
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(connections_.find(peer_id));
+  if (itr != connections_.end()) {
+    if ((*itr).second->Send(peer_id, message, message_sent_functor, options))
+      return;
+  }
+  HandleSendToUnconnectedPeer(peer_id, message_sent_functor);
+}
+
+void ManagedConnections::SendDatagram(NodeId peer_id,
+                                      std::string message,
+                                      MessageSentFunctor message_sent_functor) {
   if (peer_id == this_node_id_) {
     LOG(kError) << "Can't use this node's ID (" << DebugId(this_node_id_) << ") as peerID.";
     return;
@@ -649,9 +1011,15 @@ void ManagedConnections::Send(NodeId peer_id,
   std::lock_guard<std::mutex> lock(mutex_);
   auto itr(connections_.find(peer_id));
   if (itr != connections_.end()) {
-    if ((*itr).second->Send(peer_id, message, message_sent_functor))
+    if ((*itr).second->SendDatagram(peer_id, message, message_sent_functor))
       return;
   }
+  HandleSendToUnconnectedPeer(peer_id, message_sent_functor);
+}
+
+void ManagedConnections::HandleSendToUnconnectedPeer(
+    const NodeId& peer_id,
+    const MessageSentFunctor& message_sent_functor) {
   LOG(kError) << "Can't send from " << DebugId(this_node_id_) << " to " << DebugId(peer_id)
               << " - not in map.";
   if (message_sent_functor) {
@@ -671,11 +1039,13 @@ void ManagedConnections::OnMessageSlot(const std::string& message) {
   LOG(kVerbose) << "\n^^^^^^^^^^^^ OnMessageSlot ^^^^^^^^^^^^\n" + DebugString();
 
   try {
+    auto start_time(std::chrono::steady_clock::now());
     std::string decrypted_message(
 #ifdef TESTING
         !Parameters::rudp_encrypt ? message :
 #endif
             asymm::Decrypt(asymm::CipherText(message), *private_key_).string());
+    detail::Metrics::Instance().decryption_time.RecordSince(start_time);
     MessageReceivedFunctor local_callback;
     {
       std::lock_guard<std::mutex> guard(callback_mutex_);
@@ -683,7 +1053,11 @@ void ManagedConnections::OnMessageSlot(const std::string& message) {
     }
 
     if (local_callback) {
-      asio_service_.service().post([=] {local_callback(decrypted_message); });
+      auto post_time(std::chrono::steady_clock::now());
+      asio_service_.service().post([=] {
+        detail::Metrics::Instance().callback_delay.RecordSince(post_time);
+        local_callback(decrypted_message);
+      });
     }
   }
   catch(const std::exception& e) {
@@ -706,7 +1080,7 @@ void ManagedConnections::OnConnectionAddedSlot(const NodeId& peer_id,
       idle_transports_.erase(transport);
     }
   } else {
-    RemovePending(peer_id);
+    RemovePending(peer_id, kSuccess);
     auto result(connections_.insert(std::make_pair(peer_id, transport)));
     is_duplicate_normal_connection = !result.second;
     if (is_duplicate_normal_connection) {
@@ -741,6 +1115,34 @@ unsigned ManagedConnections::GetActiveConnectionCount() const {
   return static_cast<unsigned>(connections_.size());
 }
 
+int ManagedConnections::GetConnectionStats(NodeId peer_id, ConnectionStats& stats) {
+  stats = ConnectionStats();
+  TransportPtr transport;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto itr(connections_.find(peer_id));
+    if (itr == connections_.end())
+      return kInvalidConnection;
+    transport = itr->second;
+  }
+  return transport->GetConnectionStats(peer_id, stats) ? kSuccess : kInvalidConnection;
+}
+
+std::map<NodeId, ConnectionStats> ManagedConnections::GetConnectionStats() {
+  ConnectionMap connections;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections = connections_;
+  }
+  std::map<NodeId, ConnectionStats> all_stats;
+  for (const auto& connection : connections) {
+    ConnectionStats stats;
+    if (connection.second->GetConnectionStats(connection.first, stats))
+      all_stats.insert(std::make_pair(connection.first, stats));
+  }
+  return all_stats;
+}
+
 void ManagedConnections::OnConnectionLostSlot(const NodeId& peer_id,
                                               TransportPtr transport,
                                               bool temporary_connection) {
@@ -758,7 +1160,7 @@ void ManagedConnections::OnConnectionLostSlot(const NodeId& peer_id,
   // If this is a bootstrap connection, it may have already had GetAvailableEndpoint called on it,
   // but not yet had Add called, in which case peer_id will be in pendings_.  In all other cases,
   // peer_id should not be in pendings_.
-  RemovePending(peer_id);
+  RemovePending(peer_id, kConnectError);
 
   auto itr(connections_.find(peer_id));
   if (itr != connections_.end()) {
@@ -829,10 +1231,11 @@ std::string ManagedConnections::DebugString() const {
 
   s += "\nThis node's pending connections:\n";
   for (auto& pending : pendings_) {
-    s += "\tPending to peer " + DebugId(pending->node_id).substr(0, 7);
+    TransportPtr transport(pending.second->pending_transport);
+    s += "\tPending to peer " + DebugId(pending.first).substr(0, 7);
     s += " on this node's transport ";
-    s += boost::lexical_cast<std::string>(pending->pending_transport->external_endpoint()) + " / ";
-    s += boost::lexical_cast<std::string>(pending->pending_transport->local_endpoint()) + '\n';
+    s += boost::lexical_cast<std::string>(transport->external_endpoint()) + " / ";
+    s += boost::lexical_cast<std::string>(transport->local_endpoint()) + '\n';
   }
   s += "\n\n";
 
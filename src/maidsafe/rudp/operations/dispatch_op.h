@@ -24,6 +24,7 @@ License.
 #include "boost/asio/handler_invoke_hook.hpp"
 #include "boost/system/error_code.hpp"
 #include "maidsafe/rudp/core/dispatcher.h"
+#include "maidsafe/rudp/core/metrics.h"
 
 namespace maidsafe {
 
@@ -39,13 +40,15 @@ class DispatchOp {
              boost::asio::ip::udp::socket& socket,
              const boost::asio::mutable_buffer& buffer,
              boost::asio::ip::udp::endpoint& sender_endpoint,
-             Dispatcher& dispatcher)
+             Dispatcher& dispatcher,
+             MultiplexerMetrics& metrics)
       : handler_(handler),
         socket_(socket),
         buffer_(buffer),
         mutex_(std::make_shared<std::mutex>()),
         sender_endpoint_(sender_endpoint),
-        dispatcher_(dispatcher) {}
+        dispatcher_(dispatcher),
+        metrics_(metrics) {}
 
   DispatchOp(const DispatchOp& other)
       : handler_(other.handler_),
@@ -53,12 +56,15 @@ class DispatchOp {
         buffer_(other.buffer_),
         mutex_(other.mutex_),
         sender_endpoint_(other.sender_endpoint_),
-        dispatcher_(other.dispatcher_) {}
+        dispatcher_(other.dispatcher_),
+        metrics_(other.metrics_) {}
 
   void operator()(const boost::system::error_code& ec, size_t bytes_transferred) {
     boost::system::error_code local_ec = ec;
     while (!local_ec) {
       std::lock_guard<std::mutex> lock(*mutex_);
+      metrics_.packets_in.Add();
+      metrics_.bytes_in.Add(bytes_transferred);
       dispatcher_.HandleReceiveFrom(boost::asio::buffer(buffer_, bytes_transferred),
                                     sender_endpoint_);
       bytes_transferred = socket_.receive_from(boost::asio::buffer(buffer_),
@@ -96,6 +102,7 @@ class DispatchOp {
   std::shared_ptr<std::mutex> mutex_;
   boost::asio::ip::udp::endpoint& sender_endpoint_;
   Dispatcher& dispatcher_;
+  MultiplexerMetrics& metrics_;
 };
 
 }  // namespace detail
@@ -0,0 +1,76 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/packets/datagram_packet.h"
+
+#include <cstring>
+
+namespace asio = boost::asio;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+DatagramPacket::DatagramPacket() : data_() { SetType(kPacketType); }
+
+uint32_t DatagramPacket::SequenceNumber() const { return AdditionalInfo(); }
+
+void DatagramPacket::SetSequenceNumber(uint32_t n) { SetAdditionalInfo(n); }
+
+const std::string& DatagramPacket::Data() const { return data_; }
+
+void DatagramPacket::SetData(const std::string& data) { data_ = data; }
+
+bool DatagramPacket::IsValid(const asio::const_buffer& buffer) {
+  return (IsValidBase(buffer, kPacketType) && (asio::buffer_size(buffer) > kHeaderSize));
+}
+
+bool DatagramPacket::Decode(const asio::const_buffer& buffer) {
+  // Refuse to decode if the input buffer is not valid.
+  if (!IsValid(buffer))
+    return false;
+
+  // Decode the common parts of the control packet.
+  if (!DecodeBase(buffer, kPacketType))
+    return false;
+
+  const unsigned char* p = asio::buffer_cast<const unsigned char*>(buffer);
+  data_.assign(p + kHeaderSize, p + asio::buffer_size(buffer));
+
+  return true;
+}
+
+size_t DatagramPacket::Encode(const asio::mutable_buffer& buffer) const {
+  // Refuse to encode if there is no payload or the output buffer is not big enough.
+  if (data_.empty() || asio::buffer_size(buffer) < kHeaderSize + data_.size())
+    return 0;
+
+  // Encode the common parts of the control packet.
+  if (EncodeBase(buffer) == 0)
+    return 0;
+
+  unsigned char* p = asio::buffer_cast<unsigned char*>(buffer);
+  std::memcpy(p + kHeaderSize, data_.data(), data_.size());
+
+  return kHeaderSize + data_.size();
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,108 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/packets/fec_packet.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace asio = boost::asio;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+FecPacket::FecPacket() : block_size_(0), length_xor_(0), header_xor_(0), payload_xor_() {
+  SetType(kPacketType);
+}
+
+uint32_t FecPacket::FirstSequenceNumber() const { return AdditionalInfo(); }
+
+void FecPacket::SetFirstSequenceNumber(uint32_t n) { SetAdditionalInfo(n); }
+
+uint32_t FecPacket::BlockSize() const { return block_size_; }
+
+void FecPacket::SetBlockSize(uint32_t n) {
+  assert(n <= 0xff);
+  block_size_ = n;
+}
+
+uint16_t FecPacket::LengthXor() const { return length_xor_; }
+
+void FecPacket::SetLengthXor(uint16_t n) { length_xor_ = n; }
+
+uint32_t FecPacket::HeaderXor() const { return header_xor_; }
+
+void FecPacket::SetHeaderXor(uint32_t n) { header_xor_ = n; }
+
+const std::string& FecPacket::PayloadXor() const { return payload_xor_; }
+
+void FecPacket::SetPayloadXor(const std::string& payload_xor) { payload_xor_ = payload_xor; }
+
+bool FecPacket::IsValid(const asio::const_buffer& buffer) {
+  return (IsValidBase(buffer, kPacketType) && (asio::buffer_size(buffer) >= kFixedSize));
+}
+
+bool FecPacket::Decode(const asio::const_buffer& buffer) {
+  // Refuse to decode if the input buffer is not valid.
+  if (!IsValid(buffer))
+    return false;
+
+  // Decode the common parts of the control packet.
+  if (!DecodeBase(buffer, kPacketType))
+    return false;
+
+  const unsigned char* p = asio::buffer_cast<const unsigned char*>(buffer);
+  size_t length = asio::buffer_size(buffer);
+  p += kHeaderSize;
+
+  block_size_ = p[0];
+  // p[1] is reserved.
+  length_xor_ = static_cast<uint16_t>((p[2] << 8) | p[3]);
+  DecodeUint32(&header_xor_, p + 4);
+  payload_xor_.assign(p + 8, p + length - kHeaderSize);
+
+  return true;
+}
+
+size_t FecPacket::Encode(const asio::mutable_buffer& buffer) const {
+  // Refuse to encode if the output buffer is not big enough.
+  if (asio::buffer_size(buffer) < kFixedSize + payload_xor_.size())
+    return 0;
+
+  // Encode the common parts of the control packet.
+  if (EncodeBase(buffer) == 0)
+    return 0;
+
+  unsigned char* p = asio::buffer_cast<unsigned char*>(buffer);
+  p += kHeaderSize;
+
+  p[0] = static_cast<unsigned char>(block_size_);
+  p[1] = 0;  // Reserved.
+  p[2] = static_cast<unsigned char>(length_xor_ >> 8);
+  p[3] = static_cast<unsigned char>(length_xor_);
+  EncodeUint32(header_xor_, p + 4);
+  std::memcpy(p + 8, payload_xor_.data(), payload_xor_.size());
+
+  return kFixedSize + payload_xor_.size();
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,80 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_PACKETS_FEC_PACKET_H_
+#define MAIDSAFE_RUDP_PACKETS_FEC_PACKET_H_
+
+#include <cstdint>
+#include <string>
+
+#include "boost/asio/buffer.hpp"
+#include "maidsafe/rudp/packets/control_packet.h"
+#include "maidsafe/rudp/packets/data_packet.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Forward error correction repair packet.  Carries the XOR of a block of consecutive data packets,
+// so that the receiver can rebuild any one of them which is lost without waiting for it to be
+// retransmitted.  Each data packet contributes its flags and message number (the "header"), the
+// length of its data, and its data padded with zeros to the length of the longest in the block.
+class FecPacket : public ControlPacket {
+ public:
+  enum { kPacketType = 9 };
+  enum { kFixedSize = ControlPacket::kHeaderSize + 8 };
+  // The number of bytes by which a repair packet exceeds the largest data packet it protects.
+  enum { kOverhead = kFixedSize - DataPacket::kHeaderSize };
+
+  FecPacket();
+  virtual ~FecPacket() {}
+
+  // Sequence number of the first data packet in the block.
+  uint32_t FirstSequenceNumber() const;
+  void SetFirstSequenceNumber(uint32_t n);
+
+  // Number of data packets in the block (at most 255).
+  uint32_t BlockSize() const;
+  void SetBlockSize(uint32_t n);
+
+  uint16_t LengthXor() const;
+  void SetLengthXor(uint16_t n);
+
+  uint32_t HeaderXor() const;
+  void SetHeaderXor(uint32_t n);
+
+  const std::string& PayloadXor() const;
+  void SetPayloadXor(const std::string& payload_xor);
+
+  static bool IsValid(const boost::asio::const_buffer& buffer);
+  bool Decode(const boost::asio::const_buffer& buffer);
+  size_t Encode(const boost::asio::mutable_buffer& buffer) const;
+
+ private:
+  uint32_t block_size_;
+  uint16_t length_xor_;
+  uint32_t header_xor_;
+  std::string payload_xor_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_PACKETS_FEC_PACKET_H_
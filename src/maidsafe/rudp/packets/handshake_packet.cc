@@ -22,6 +22,8 @@ License.
 
 #include "maidsafe/common/log.h"
 
+#include "maidsafe/rudp/packets/public_key_cache.h"
+
 namespace asio = boost::asio;
 
 namespace maidsafe {
@@ -41,6 +43,10 @@ HandshakePacket::HandshakePacket()
       socket_id_(0),
       node_id_(),
       syn_cookie_(0),
+      resume_(false),
+      resumed_(false),
+      resumption_ticket_(0),
+      resumption_ticket_mac_(0),
       request_nat_detection_port_(false),
       nat_detection_port_(0),
       peer_endpoint_(),
@@ -105,6 +111,22 @@ void HandshakePacket::SetSynCookie(uint32_t n) { syn_cookie_ = n; }
 //      ip_address_ = address.to_v6();
 //  }
 
+bool HandshakePacket::Resume() const { return resume_; }
+
+void HandshakePacket::SetResume(bool b) { resume_ = b; }
+
+bool HandshakePacket::Resumed() const { return resumed_; }
+
+void HandshakePacket::SetResumed(bool b) { resumed_ = b; }
+
+uint32_t HandshakePacket::ResumptionTicket() const { return resumption_ticket_; }
+
+void HandshakePacket::SetResumptionTicket(uint32_t n) { resumption_ticket_ = n; }
+
+uint64_t HandshakePacket::ResumptionTicketMac() const { return resumption_ticket_mac_; }
+
+void HandshakePacket::SetResumptionTicketMac(uint64_t n) { resumption_ticket_mac_ = n; }
+
 bool HandshakePacket::RequestNatDetectionPort() const { return request_nat_detection_port_; }
 
 void HandshakePacket::SetRequestNatDetectionPort(bool b) { request_nat_detection_port_ = b; }
@@ -157,6 +179,9 @@ bool HandshakePacket::Decode(const asio::const_buffer& buffer) {
   DecodeUint32(&syn_cookie_, p + 96);
 
   request_nat_detection_port_ = ((p[100] & 0x80) != 0);
+  resume_ = ((p[100] & 0x40) != 0);
+  resumed_ = ((p[100] & 0x20) != 0);
+  bool has_ticket((p[100] & 0x10) != 0);
   nat_detection_port_ = p[101];
   nat_detection_port_ = ((nat_detection_port_ << 8) | p[102]);
 
@@ -175,37 +200,43 @@ bool HandshakePacket::Decode(const asio::const_buffer& buffer) {
 
   peer_endpoint_ = asio::ip::udp::endpoint(ip_address, port);
 
-  if (asio::buffer_size(buffer) != kMinPacketSize) {
-    asymm::EncodedPublicKey encoded_public_key(std::string(p + 121, p + length));
-    try {
-      public_key_ = std::make_shared<asymm::PublicKey>(asymm::DecodeKey(encoded_public_key));
-      if (!asymm::ValidateKey(*public_key_)) {
-        LOG(kError) << "Failed to validate peer's public key.";
-        return false;
-      }
-    }
-    catch(const std::exception& e) {
-      LOG(kError) << "Failed to parse peer's public key: " << e.what();
+  size_t ticket_size(has_ticket ? kTicketSize : 0);
+  if (asio::buffer_size(buffer) < kMinPacketSize + ticket_size)
+    return false;
+  resumption_ticket_ = 0;
+  resumption_ticket_mac_ = 0;
+  if (has_ticket) {
+    const unsigned char* ticket = p + length - kTicketSize;
+    uint32_t mac_high(0), mac_low(0);
+    DecodeUint32(&resumption_ticket_, ticket);
+    DecodeUint32(&mac_high, ticket + 4);
+    DecodeUint32(&mac_low, ticket + 8);
+    resumption_ticket_mac_ = (static_cast<uint64_t>(mac_high) << 32) | mac_low;
+  }
+
+  if (asio::buffer_size(buffer) != kMinPacketSize + ticket_size) {
+    public_key_ = PublicKeyCache::Instance().Decode(std::string(p + 121,
+                                                                p + length - ticket_size));
+    if (!public_key_)
       return false;
-    }
   }
 
   return true;
 }
 
 size_t HandshakePacket::Encode(const asio::mutable_buffer& buffer) const {
-  std::string encoded_public_key;
+  size_t ticket_size(resumption_ticket_ != 0 ? kTicketSize : 0);
+  std::shared_ptr<const std::string> encoded_public_key;
   if (public_key_) {
+    encoded_public_key = PublicKeyCache::Instance().Encode(public_key_);
     // Refuse to encode if the output buffer is not big enough.
-    if (asio::buffer_size(buffer) == kMinPacketSize) {
+    if (asio::buffer_size(buffer) < kMinPacketSize + encoded_public_key->size() + ticket_size) {
       LOG(kError) << "Not enough space in buffer to encode public key.";
       return 0;
     }
-    assert(asymm::ValidateKey(*public_key_));
-    encoded_public_key = asymm::EncodeKey(*public_key_).string();
   } else {
     // Refuse to encode if the output buffer is not big enough.
-    if (asio::buffer_size(buffer) < kMinPacketSize)
+    if (asio::buffer_size(buffer) < kMinPacketSize + ticket_size)
       return 0;
   }
 
@@ -227,7 +258,8 @@ size_t HandshakePacket::Encode(const asio::mutable_buffer& buffer) const {
   std::memcpy(p + 32, node_id_.string().data(), 64);
   EncodeUint32(syn_cookie_, p + 96);
 
-  p[100] = (request_nat_detection_port_ ? 0x80 : 0);
+  p[100] = (request_nat_detection_port_ ? 0x80 : 0) | (resume_ ? 0x40 : 0) |
+           (resumed_ ? 0x20 : 0) | (ticket_size != 0 ? 0x10 : 0);
   p[101] = ((nat_detection_port_ >> 8) & 0xff);
   p[102] = (nat_detection_port_ & 0xff);
 
@@ -243,9 +275,20 @@ size_t HandshakePacket::Encode(const asio::mutable_buffer& buffer) const {
   p[119] = ((peer_endpoint_.port() >> 8) & 0xff);
   p[120] = (peer_endpoint_.port() & 0xff);
 
-  std::memcpy(p + 121, encoded_public_key.data(), encoded_public_key.size());
+  size_t size(kMinPacketSize);
+  if (encoded_public_key) {
+    std::memcpy(p + 121, encoded_public_key->data(), encoded_public_key->size());
+    size += encoded_public_key->size();
+  }
 
-  return kMinPacketSize + encoded_public_key.size();
+  if (ticket_size != 0) {
+    unsigned char* ticket = p + size - kHeaderSize;
+    EncodeUint32(resumption_ticket_, ticket);
+    EncodeUint32(static_cast<uint32_t>(resumption_ticket_mac_ >> 32), ticket + 4);
+    EncodeUint32(static_cast<uint32_t>(resumption_ticket_mac_), ticket + 8);
+    size += ticket_size;
+  }
+  return size;
 }
 
 }  // namespace detail
@@ -40,11 +40,18 @@ namespace detail {
 class HandshakePacket : public ControlPacket {
  public:
   enum { kMinPacketSize = ControlPacket::kHeaderSize + 121 };
+  // A ticket, with its MAC, follows everything else including any public key.
+  enum { kTicketSize = 12 };
   enum { kPacketType = 0 };
 
   HandshakePacket();
   virtual ~HandshakePacket() {}
 
+  // The protocol version sent by this node.  Nodes sending an earlier version predate SYN cookies
+  // and session tickets, so can't echo a cookie, and would fail to decode a packet with a ticket.
+  static const uint32_t kRudpVersion = 5;
+  static const uint32_t kSynCookieVersion = 5;
+  static const uint32_t kSessionTicketVersion = 5;
   uint32_t RudpVersion() const;
   void SetRudpVersion(uint32_t n);
 
@@ -77,6 +84,25 @@ class HandshakePacket : public ControlPacket {
   uint32_t SynCookie() const;
   void SetSynCookie(uint32_t n);
 
+  // In a connection request, the sender asks to resume an earlier session, presenting the ticket
+  // which the recipient issued then.
+  bool Resume() const;
+  void SetResume(bool b);
+
+  // In a cookie, the sender has accepted the recipient's ticket and resumed the earlier session.
+  bool Resumed() const;
+  void SetResumed(bool b);
+
+  // The ticket presented by a request to resume, or otherwise the ticket issued to the recipient
+  // with which it can later resume this session.  0 if none, in which case the packet has the same
+  // layout as one from a node predating tickets.
+  uint32_t ResumptionTicket() const;
+  void SetResumptionTicket(uint32_t n);
+
+  // The issuer's MAC of the ticket, which must be presented along with it.
+  uint64_t ResumptionTicketMac() const;
+  void SetResumptionTicketMac(uint64_t n);
+
   bool RequestNatDetectionPort() const;
   void SetRequestNatDetectionPort(bool b);
 
@@ -104,6 +130,9 @@ class HandshakePacket : public ControlPacket {
   uint32_t socket_id_;
   NodeId node_id_;
   uint32_t syn_cookie_;
+  bool resume_, resumed_;
+  uint32_t resumption_ticket_;
+  uint64_t resumption_ticket_mac_;
   bool request_nat_detection_port_;
   uint16_t nat_detection_port_;
   boost::asio::ip::udp::endpoint peer_endpoint_;
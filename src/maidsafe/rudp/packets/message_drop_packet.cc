@@ -0,0 +1,78 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/packets/message_drop_packet.h"
+
+namespace asio = boost::asio;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+MessageDropPacket::MessageDropPacket() : last_sequence_number_(0) { SetType(kPacketType); }
+
+uint32_t MessageDropPacket::FirstSequenceNumber() const { return AdditionalInfo(); }
+
+void MessageDropPacket::SetFirstSequenceNumber(uint32_t n) { SetAdditionalInfo(n); }
+
+uint32_t MessageDropPacket::LastSequenceNumber() const { return last_sequence_number_; }
+
+void MessageDropPacket::SetLastSequenceNumber(uint32_t n) { last_sequence_number_ = n; }
+
+bool MessageDropPacket::IsValid(const asio::const_buffer& buffer) {
+  return (IsValidBase(buffer, kPacketType) && (asio::buffer_size(buffer) == kPacketSize));
+}
+
+bool MessageDropPacket::Decode(const asio::const_buffer& buffer) {
+  // Refuse to decode if the input buffer is not valid.
+  if (!IsValid(buffer))
+    return false;
+
+  // Decode the common parts of the control packet.
+  if (!DecodeBase(buffer, kPacketType))
+    return false;
+
+  const unsigned char* p = asio::buffer_cast<const unsigned char*>(buffer);
+  p += kHeaderSize;
+
+  DecodeUint32(&last_sequence_number_, p);
+
+  return true;
+}
+
+size_t MessageDropPacket::Encode(const asio::mutable_buffer& buffer) const {
+  // Refuse to encode if the output buffer is not big enough.
+  if (asio::buffer_size(buffer) < kPacketSize)
+    return 0;
+
+  // Encode the common parts of the control packet.
+  if (EncodeBase(buffer) == 0)
+    return 0;
+
+  unsigned char* p = asio::buffer_cast<unsigned char*>(buffer);
+  p += kHeaderSize;
+
+  EncodeUint32(last_sequence_number_, p);
+
+  return kPacketSize;
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,61 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_PACKETS_MESSAGE_DROP_PACKET_H_
+#define MAIDSAFE_RUDP_PACKETS_MESSAGE_DROP_PACKET_H_
+
+#include <cstdint>
+
+#include "boost/asio/buffer.hpp"
+#include "maidsafe/rudp/packets/control_packet.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Tells the receiver that the sender has abandoned the data packets in an inclusive range of
+// sequence numbers (e.g. because the message they carry passed its deadline), so the receiver
+// should treat them as received and skip them rather than wait for them.
+class MessageDropPacket : public ControlPacket {
+ public:
+  enum { kPacketSize = ControlPacket::kHeaderSize + 4 };
+  enum { kPacketType = 8 };
+
+  MessageDropPacket();
+  virtual ~MessageDropPacket() {}
+
+  uint32_t FirstSequenceNumber() const;
+  void SetFirstSequenceNumber(uint32_t n);
+
+  uint32_t LastSequenceNumber() const;
+  void SetLastSequenceNumber(uint32_t n);
+
+  static bool IsValid(const boost::asio::const_buffer& buffer);
+  bool Decode(const boost::asio::const_buffer& buffer);
+  size_t Encode(const boost::asio::mutable_buffer& buffer) const;
+
+ private:
+  uint32_t last_sequence_number_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_PACKETS_MESSAGE_DROP_PACKET_H_
@@ -0,0 +1,96 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/packets/mtu_probe_packet.h"
+
+#include <cstring>
+
+namespace asio = boost::asio;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+MtuProbePacket::MtuProbePacket() : probe_size_(kPacketSize) { SetType(kPacketType); }
+
+uint32_t MtuProbePacket::SequenceNumber() const { return AdditionalInfo(); }
+
+void MtuProbePacket::SetSequenceNumber(uint32_t n) { SetAdditionalInfo(n); }
+
+bool MtuProbePacket::IsRequest() const { return (AdditionalInfo() & 0x00000001) != 0; }
+
+bool MtuProbePacket::IsResponse() const { return !IsRequest(); }
+
+bool MtuProbePacket::IsResponseOf(uint32_t sequence_number) const {
+  return (IsResponse() && (sequence_number & 0x00000001) &&
+          sequence_number + 1 == SequenceNumber());
+}
+
+uint32_t MtuProbePacket::ProbeSize() const { return probe_size_; }
+
+void MtuProbePacket::SetProbeSize(uint32_t n) { probe_size_ = n; }
+
+bool MtuProbePacket::IsValid(const asio::const_buffer& buffer) {
+  return (IsValidBase(buffer, kPacketType) && (asio::buffer_size(buffer) >= kPacketSize));
+}
+
+bool MtuProbePacket::Decode(const asio::const_buffer& buffer) {
+  // Refuse to decode if the input buffer is not valid.
+  if (!IsValid(buffer))
+    return false;
+
+  // Decode the common parts of the control packet.
+  if (!DecodeBase(buffer, kPacketType))
+    return false;
+
+  const unsigned char* p = asio::buffer_cast<const unsigned char*>(buffer);
+  p += kHeaderSize;
+
+  DecodeUint32(&probe_size_, p);
+
+  // A request is only valid if the whole padded probe arrived; a response is never padded.
+  size_t expected_size(IsRequest() ? static_cast<size_t>(probe_size_) :
+                                     static_cast<size_t>(kPacketSize));
+  return asio::buffer_size(buffer) == expected_size;
+}
+
+size_t MtuProbePacket::Encode(const asio::mutable_buffer& buffer) const {
+  size_t encoded_size(IsRequest() ? static_cast<size_t>(probe_size_) :
+                                    static_cast<size_t>(kPacketSize));
+
+  // Refuse to encode if the probe size is invalid or the output buffer is not big enough.
+  if (encoded_size < kPacketSize || asio::buffer_size(buffer) < encoded_size)
+    return 0;
+
+  // Encode the common parts of the control packet.
+  if (EncodeBase(buffer) == 0)
+    return 0;
+
+  unsigned char* p = asio::buffer_cast<unsigned char*>(buffer);
+  p += kHeaderSize;
+
+  EncodeUint32(probe_size_, p);
+  std::memset(p + 4, 0, encoded_size - kPacketSize);
+
+  return encoded_size;
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,68 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_PACKETS_MTU_PROBE_PACKET_H_
+#define MAIDSAFE_RUDP_PACKETS_MTU_PROBE_PACKET_H_
+
+#include <cstdint>
+
+#include "boost/asio/buffer.hpp"
+#include "maidsafe/rudp/packets/control_packet.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Used for datagram packetization layer path MTU discovery.  A request is padded out to the size
+// being probed, and is only valid if it arrives intact.  The response is a small unpadded packet
+// which echoes the probed size, so that acknowledgement of probes is independent of data packets.
+class MtuProbePacket : public ControlPacket {
+ public:
+  enum { kPacketSize = ControlPacket::kHeaderSize + 4 };
+  enum { kPacketType = 4 };
+
+  MtuProbePacket();
+  virtual ~MtuProbePacket() {}
+
+  void SetSequenceNumber(uint32_t n);
+  uint32_t SequenceNumber() const;
+  // Request will have odd sequence number
+  bool IsRequest() const;
+  // Response will have even sequence number
+  bool IsResponse() const;
+  // Checks if this is a response to provided request sequence number (odd).
+  bool IsResponseOf(uint32_t sequence_number) const;
+
+  // The total size in bytes of the encoded request packet, including padding.
+  uint32_t ProbeSize() const;
+  void SetProbeSize(uint32_t n);
+
+  static bool IsValid(const boost::asio::const_buffer& buffer);
+  bool Decode(const boost::asio::const_buffer& buffer);
+  size_t Encode(const boost::asio::mutable_buffer& buffer) const;
+
+ private:
+  uint32_t probe_size_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_PACKETS_MTU_PROBE_PACKET_H_
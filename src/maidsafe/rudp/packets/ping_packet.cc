@@ -0,0 +1,86 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/packets/ping_packet.h"
+
+#include <cstring>
+#include <string>
+
+namespace asio = boost::asio;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+PingPacket::PingPacket() : node_id_() { SetType(kPacketType); }
+
+uint32_t PingPacket::SequenceNumber() const { return AdditionalInfo(); }
+
+void PingPacket::SetSequenceNumber(uint32_t n) { SetAdditionalInfo(n); }
+
+bool PingPacket::IsRequest() const { return (AdditionalInfo() & 0x00000001) != 0; }
+
+bool PingPacket::IsResponse() const { return !IsRequest(); }
+
+bool PingPacket::IsResponseOf(uint32_t sequence_number) const {
+  return (IsResponse() && (sequence_number & 0x00000001) &&
+          sequence_number + 1 == SequenceNumber());
+}
+
+NodeId PingPacket::node_id() const { return node_id_; }
+
+void PingPacket::set_node_id(const NodeId& node_id) { node_id_ = node_id; }
+
+bool PingPacket::IsValid(const asio::const_buffer& buffer) {
+  return (IsValidBase(buffer, kPacketType) && (asio::buffer_size(buffer) == kPacketSize));
+}
+
+bool PingPacket::Decode(const asio::const_buffer& buffer) {
+  // Refuse to decode if the input buffer is not valid.
+  if (!IsValid(buffer))
+    return false;
+
+  // Decode the common parts of the control packet.
+  if (!DecodeBase(buffer, kPacketType))
+    return false;
+
+  const char* p = asio::buffer_cast<const char*>(buffer);
+  node_id_ = NodeId(std::string(p + kHeaderSize, p + kPacketSize));
+
+  return true;
+}
+
+size_t PingPacket::Encode(const asio::mutable_buffer& buffer) const {
+  // Refuse to encode if the output buffer is not big enough.
+  if (asio::buffer_size(buffer) < kPacketSize)
+    return 0;
+
+  // Encode the common parts of the control packet.
+  if (EncodeBase(buffer) == 0)
+    return 0;
+
+  unsigned char* p = asio::buffer_cast<unsigned char*>(buffer);
+  std::memcpy(p + kHeaderSize, node_id_.string().data(), kPacketSize - kHeaderSize);
+
+  return kPacketSize;
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,71 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_PACKETS_PING_PACKET_H_
+#define MAIDSAFE_RUDP_PACKETS_PING_PACKET_H_
+
+#include <cstdint>
+
+#include "boost/asio/buffer.hpp"
+
+#include "maidsafe/common/node_id.h"
+
+#include "maidsafe/rudp/packets/control_packet.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Tests whether a peer's endpoint is reachable without setting up a connection.  It's sent with a
+// destination socket ID of 0 and is answered directly by the ConnectionManager.  The request and
+// response are the same size (so a forged request can't be used to amplify a flood) and each
+// carries the sender's node ID.
+class PingPacket : public ControlPacket {
+ public:
+  enum { kPacketSize = ControlPacket::kHeaderSize + 64 };
+  enum { kPacketType = 10 };
+
+  PingPacket();
+  virtual ~PingPacket() {}
+
+  void SetSequenceNumber(uint32_t n);
+  uint32_t SequenceNumber() const;
+  // Request will have odd sequence number
+  bool IsRequest() const;
+  // Response will have even sequence number
+  bool IsResponse() const;
+  // Checks if this is a response to provided request sequence number (odd).
+  bool IsResponseOf(uint32_t sequence_number) const;
+
+  NodeId node_id() const;
+  void set_node_id(const NodeId& node_id);
+
+  static bool IsValid(const boost::asio::const_buffer& buffer);
+  bool Decode(const boost::asio::const_buffer& buffer);
+  size_t Encode(const boost::asio::mutable_buffer& buffer) const;
+
+ private:
+  NodeId node_id_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_PACKETS_PING_PACKET_H_
@@ -0,0 +1,119 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/packets/public_key_cache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <exception>
+
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/rudp/parameters.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+PublicKeyCache& PublicKeyCache::Instance() {
+  // Never destroyed, since handshakes may be encoded during the destruction of other statics.
+  static PublicKeyCache* cache(new PublicKeyCache);
+  return *cache;
+}
+
+PublicKeyCache::PublicKeyCache() : mutex_(), encoded_(), decoded_(), recency_() {}
+
+std::shared_ptr<const std::string> PublicKeyCache::Encode(
+    const std::shared_ptr<asymm::PublicKey>& public_key) {
+  assert(public_key);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    encoded_.erase(std::remove_if(encoded_.begin(), encoded_.end(),
+                                  [](const EncodedEntry& entry) { return entry.first.expired(); }),
+                   encoded_.end());
+    std::owner_less<std::weak_ptr<asymm::PublicKey>> less;
+    for (const auto& entry : encoded_) {
+      if (!less(entry.first, public_key) && !less(public_key, entry.first))
+        return entry.second;
+    }
+  }
+  assert(asymm::ValidateKey(*public_key));
+  std::shared_ptr<const std::string> encoded(
+      std::make_shared<std::string>(asymm::EncodeKey(*public_key).string()));
+  std::lock_guard<std::mutex> lock(mutex_);
+  encoded_.push_back(std::make_pair(std::weak_ptr<asymm::PublicKey>(public_key), encoded));
+  return encoded;
+}
+
+std::shared_ptr<asymm::PublicKey> PublicKeyCache::Decode(const std::string& encoded_public_key) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto itr(decoded_.find(encoded_public_key));
+    if (itr != decoded_.end()) {
+      recency_.splice(recency_.begin(), recency_, itr->second.recency);
+      return itr->second.public_key;
+    }
+  }
+
+  std::shared_ptr<asymm::PublicKey> public_key;
+  try {
+    public_key = std::make_shared<asymm::PublicKey>(
+        asymm::DecodeKey(asymm::EncodedPublicKey(encoded_public_key)));
+  }
+  catch(const std::exception& e) {
+    LOG(kError) << "Failed to parse peer's public key: " << e.what();
+    return nullptr;
+  }
+  if (!asymm::ValidateKey(*public_key)) {
+    LOG(kError) << "Failed to validate peer's public key.";
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (Parameters::public_key_cache_size == 0)
+    return public_key;
+  // Another thread may have added the same key meanwhile.
+  auto result(decoded_.insert(std::make_pair(encoded_public_key, DecodedEntry())));
+  if (!result.second)
+    return result.first->second.public_key;
+  result.first->second.public_key = public_key;
+  result.first->second.recency = recency_.insert(recency_.begin(), &result.first->first);
+  while (decoded_.size() > Parameters::public_key_cache_size) {
+    auto oldest(decoded_.find(*recency_.back()));
+    recency_.pop_back();
+    decoded_.erase(oldest);
+  }
+  return public_key;
+}
+
+void PublicKeyCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  encoded_.clear();
+  decoded_.clear();
+  recency_.clear();
+}
+
+size_t PublicKeyCache::DecodedCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return decoded_.size();
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,87 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_PACKETS_PUBLIC_KEY_CACHE_H_
+#define MAIDSAFE_RUDP_PACKETS_PUBLIC_KEY_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "maidsafe/common/rsa.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Saves the RSA work of encoding and decoding the public keys carried by handshake packets, which
+// are resent every 250 ms until answered, and are decoded by both ConnectionManager and Socket.
+//
+// Each node's own key is encoded once; the entry lasts as long as the key.  Peers' keys are decoded
+// and validated once, and kept in a least-recently-used list of Parameters::public_key_cache_size
+// entries keyed by the exact encoded bytes, so a hit is for bytes which have already been validated.
+// Keys which fail to decode or validate aren't cached.  All methods are thread-safe.
+class PublicKeyCache {
+ public:
+  static PublicKeyCache& Instance();
+
+  // Get the encoding of "public_key".  The key must be valid.
+  std::shared_ptr<const std::string> Encode(const std::shared_ptr<asymm::PublicKey>& public_key);
+
+  // Get the validated key encoded by "encoded_public_key", or nullptr if it can't be decoded or is
+  // invalid.
+  std::shared_ptr<asymm::PublicKey> Decode(const std::string& encoded_public_key);
+
+  // Discard all entries.
+  void Clear();
+
+  // Number of peers' keys held.
+  size_t DecodedCount() const;
+
+ private:
+  typedef std::pair<std::weak_ptr<asymm::PublicKey>, std::shared_ptr<const std::string>>
+      EncodedEntry;
+  // Points to the keys of decoded_, whose nodes are stable.
+  typedef std::list<const std::string*> RecencyList;
+  struct DecodedEntry {
+    std::shared_ptr<asymm::PublicKey> public_key;
+    RecencyList::iterator recency;
+  };
+
+  PublicKeyCache();
+  PublicKeyCache(const PublicKeyCache&);
+  PublicKeyCache& operator=(const PublicKeyCache&);
+
+  mutable std::mutex mutex_;
+  // Few enough (one per node in the process) to be searched linearly.
+  std::vector<EncodedEntry> encoded_;
+  std::unordered_map<std::string, DecodedEntry> decoded_;
+  // The encodings in decoded_, most recently used first.
+  RecencyList recency_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_PACKETS_PUBLIC_KEY_CACHE_H_
@@ -14,15 +14,25 @@ License.
 */
 
 
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
 #include "maidsafe/common/test.h"
 #include "maidsafe/common/log.h"
 
 #include "maidsafe/rudp/packets/packet.h"
 #include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/packets/datagram_packet.h"
 #include "maidsafe/rudp/packets/control_packet.h"
 #include "maidsafe/rudp/packets/ack_packet.h"
+#include "maidsafe/rudp/packets/fec_packet.h"
 #include "maidsafe/rudp/packets/handshake_packet.h"
 #include "maidsafe/rudp/packets/keepalive_packet.h"
+#include "maidsafe/rudp/packets/message_drop_packet.h"
+#include "maidsafe/rudp/packets/mtu_probe_packet.h"
+#include "maidsafe/rudp/packets/ping_packet.h"
 #include "maidsafe/rudp/packets/shutdown_packet.h"
 #include "maidsafe/rudp/packets/ack_of_ack_packet.h"
 #include "maidsafe/rudp/packets/negative_ack_packet.h"
@@ -491,14 +501,17 @@ TEST_F(HandshakePacketTest, BEH_EncodeDecode) {
     handshake_packet_.SetSynCookie(0xaaaaaaaa);
     handshake_packet_.SetRequestNatDetectionPort(true);
     handshake_packet_.SetNatDetectionPort(9999);
+    handshake_packet_.SetResume(true);
+    handshake_packet_.SetResumptionTicket(0x66666666);
+    handshake_packet_.SetResumptionTicketMac(0x0123456789abcdefULL);
     boost::asio::ip::udp::endpoint endpoint(
         boost::asio::ip::address::from_string("2001:db8:85a3:8d3:1319:8a2e:370:7348"),
         12345);
     handshake_packet_.SetPeerEndpoint(endpoint);
 
-    char char_array1[HandshakePacket::kMinPacketSize] = {0};
+    char char_array1[HandshakePacket::kMinPacketSize + HandshakePacket::kTicketSize] = {0};
     boost::asio::mutable_buffer dbuffer(boost::asio::buffer(char_array1));
-    ASSERT_EQ(HandshakePacket::kMinPacketSize,
+    ASSERT_EQ(HandshakePacket::kMinPacketSize + HandshakePacket::kTicketSize,
               handshake_packet_.Encode(boost::asio::buffer(dbuffer)));
 
     handshake_packet_.SetRudpVersion(0);
@@ -513,6 +526,9 @@ TEST_F(HandshakePacketTest, BEH_EncodeDecode) {
     handshake_packet_.SetSynCookie(0);
     handshake_packet_.SetRequestNatDetectionPort(false);
     handshake_packet_.SetNatDetectionPort(0);
+    handshake_packet_.SetResume(false);
+    handshake_packet_.SetResumptionTicket(0);
+    handshake_packet_.SetResumptionTicketMac(0);
     handshake_packet_.SetPeerEndpoint(boost::asio::ip::udp::endpoint());
     EXPECT_FALSE(handshake_packet_.PublicKey());
 
@@ -531,6 +547,10 @@ TEST_F(HandshakePacketTest, BEH_EncodeDecode) {
     EXPECT_TRUE(handshake_packet_.RequestNatDetectionPort());
     EXPECT_EQ(9999, handshake_packet_.NatDetectionPort());
     EXPECT_EQ(endpoint, handshake_packet_.PeerEndpoint());
+    EXPECT_TRUE(handshake_packet_.Resume());
+    EXPECT_FALSE(handshake_packet_.Resumed());
+    EXPECT_EQ(0x66666666, handshake_packet_.ResumptionTicket());
+    EXPECT_EQ(0x0123456789abcdefULL, handshake_packet_.ResumptionTicketMac());
     EXPECT_FALSE(handshake_packet_.PublicKey());
 
     // Encode and decode with a valid public key
@@ -541,8 +561,9 @@ TEST_F(HandshakePacketTest, BEH_EncodeDecode) {
     char char_array2[10000] = {0};
     dbuffer = boost::asio::buffer(char_array2);
 
-    ASSERT_EQ(HandshakePacket::kMinPacketSize + encoded_key.size(),
-              handshake_packet_.Encode(boost::asio::buffer(dbuffer)));
+    size_t size(handshake_packet_.Encode(boost::asio::buffer(dbuffer)));
+    ASSERT_EQ(HandshakePacket::kMinPacketSize + encoded_key.size() + HandshakePacket::kTicketSize,
+              size);
 
     handshake_packet_.SetRudpVersion(0);
     handshake_packet_.SetSocketType(0);
@@ -556,10 +577,12 @@ TEST_F(HandshakePacketTest, BEH_EncodeDecode) {
     handshake_packet_.SetSynCookie(0);
     handshake_packet_.SetRequestNatDetectionPort(false);
     handshake_packet_.SetNatDetectionPort(0);
+    handshake_packet_.SetResumptionTicket(0);
+    handshake_packet_.SetResumptionTicketMac(0);
     handshake_packet_.SetPeerEndpoint(boost::asio::ip::udp::endpoint());
     handshake_packet_.SetPublicKey(std::shared_ptr<asymm::PublicKey>());
 
-    handshake_packet_.Decode(dbuffer);
+    handshake_packet_.Decode(boost::asio::buffer(char_array2, size));
 
     EXPECT_EQ(0x11111111, handshake_packet_.RudpVersion());
     EXPECT_EQ(0x22222222, handshake_packet_.SocketType());
@@ -574,6 +597,8 @@ TEST_F(HandshakePacketTest, BEH_EncodeDecode) {
     EXPECT_TRUE(handshake_packet_.RequestNatDetectionPort());
     EXPECT_EQ(9999, handshake_packet_.NatDetectionPort());
     EXPECT_EQ(endpoint, handshake_packet_.PeerEndpoint());
+    EXPECT_EQ(0x66666666, handshake_packet_.ResumptionTicket());
+    EXPECT_EQ(0x0123456789abcdefULL, handshake_packet_.ResumptionTicketMac());
     bool public_key_not_null(handshake_packet_.PublicKey());
     ASSERT_TRUE(public_key_not_null);
     EXPECT_TRUE(asymm::MatchingKeys(keys.public_key, *handshake_packet_.PublicKey()));
@@ -586,6 +611,66 @@ TEST_F(HandshakePacketTest, BEH_EncodeDecode) {
   }
 }
 
+TEST_F(HandshakePacketTest, BEH_DecodeEarlierVersion) {
+  // A packet as sent by a node predating session tickets: the public key directly follows the peer
+  // endpoint, with nothing after it.
+  NodeId node_id(NodeId::kRandomId);
+  asymm::Keys keys(asymm::GenerateKeyPair());
+  std::string encoded_key(asymm::EncodeKey(keys.public_key).string());
+  std::vector<unsigned char> earlier(HandshakePacket::kMinPacketSize + encoded_key.size(), 0);
+  earlier[0] = 0x80;
+  earlier[1] = HandshakePacket::kPacketType;
+  unsigned char* p = &earlier[ControlPacket::kHeaderSize];
+  p[3] = 4;  // version
+  p[31] = 0x2a;  // socket ID
+  std::memcpy(p + 32, node_id.string().data(), 64);
+  p[100] = 0x80;  // request NAT detection port
+  p[101] = 0x27;
+  p[102] = 0x0f;  // NAT detection port 9999
+  p[115] = 192;
+  p[116] = 0;
+  p[117] = 2;
+  p[118] = 1;  // peer address 192.0.2.1, as an IPv4-compatible IPv6 address
+  p[119] = 0x30;
+  p[120] = 0x39;  // peer port 12345
+  std::memcpy(p + 121, encoded_key.data(), encoded_key.size());
+
+  ASSERT_TRUE(handshake_packet_.Decode(boost::asio::buffer(earlier)));
+  EXPECT_EQ(4U, handshake_packet_.RudpVersion());
+  EXPECT_EQ(0x2aU, handshake_packet_.SocketId());
+  EXPECT_EQ(node_id, handshake_packet_.node_id());
+  EXPECT_TRUE(handshake_packet_.RequestNatDetectionPort());
+  EXPECT_EQ(9999, handshake_packet_.NatDetectionPort());
+  EXPECT_FALSE(handshake_packet_.Resume());
+  EXPECT_FALSE(handshake_packet_.Resumed());
+  EXPECT_EQ(0U, handshake_packet_.ResumptionTicket());
+  EXPECT_EQ(boost::asio::ip::udp::endpoint(boost::asio::ip::address::from_string("192.0.2.1"),
+                                           12345),
+            handshake_packet_.PeerEndpoint());
+  ASSERT_TRUE(handshake_packet_.PublicKey());
+  EXPECT_TRUE(asymm::MatchingKeys(keys.public_key, *handshake_packet_.PublicKey()));
+
+  // Without a ticket, a packet is encoded exactly as such a node would encode it, so it can decode
+  // ours.
+  std::vector<unsigned char> current(earlier.size() + HandshakePacket::kTicketSize);
+  ASSERT_EQ(earlier.size(), handshake_packet_.Encode(boost::asio::buffer(current)));
+  current.resize(earlier.size());
+  EXPECT_TRUE(current == earlier);
+
+  // A ticket is appended after the key, and flagged.
+  handshake_packet_.SetResumptionTicket(0x66666666);
+  handshake_packet_.SetResumptionTicketMac(0x0123456789abcdefULL);
+  current.resize(earlier.size() + HandshakePacket::kTicketSize);
+  ASSERT_EQ(current.size(), handshake_packet_.Encode(boost::asio::buffer(current)));
+  EXPECT_EQ(0x90, current[ControlPacket::kHeaderSize + 100]);
+  EXPECT_TRUE(std::equal(earlier.begin() + ControlPacket::kHeaderSize + 121, earlier.end(),
+                         current.begin() + ControlPacket::kHeaderSize + 121));
+
+  // A flagged packet too short to hold a ticket is rejected.
+  current.resize(HandshakePacket::kMinPacketSize + HandshakePacket::kTicketSize - 1);
+  EXPECT_FALSE(handshake_packet_.Decode(boost::asio::buffer(current)));
+}
+
 TEST(KeepalivePacketTest, BEH_All) {
   // Generally, KeepalivePacket uses Base(ControlPacket)'s IsValid and
   // Encode/Decode directly. So here we only test those error condition branches
@@ -800,6 +885,217 @@ TEST_F(NegativeAckPacketTest, BEH_EncodeDecode) {
   }
 }
 
+TEST(MtuProbePacketTest, BEH_All) {
+  MtuProbePacket mtu_probe_packet;
+  {
+    // Buffer length too short
+    char char_array[MtuProbePacket::kPacketSize - 1] = {0};
+    char_array[0] = static_cast<unsigned char>(0x80);
+    char_array[1] = MtuProbePacket::kPacketType;
+    EXPECT_FALSE(mtu_probe_packet.Decode(boost::asio::buffer(char_array)));
+  }
+  const uint32_t kProbeSize(1600);
+  char char_array[kProbeSize] = {0};
+  char_array[0] = static_cast<unsigned char>(0x80);
+  {
+    // Packet type wrong
+    char_array[1] = AckPacket::kPacketType;
+    EXPECT_FALSE(mtu_probe_packet.Decode(boost::asio::buffer(char_array)));
+  }
+  {
+    // Request is padded to the probe size
+    mtu_probe_packet.SetSequenceNumber(0x11111111);
+    mtu_probe_packet.SetProbeSize(kProbeSize);
+    EXPECT_TRUE(mtu_probe_packet.IsRequest());
+    boost::asio::mutable_buffer dbuffer(boost::asio::buffer(char_array));
+    EXPECT_EQ(kProbeSize, mtu_probe_packet.Encode(dbuffer));
+    // Output buffer too small for the padding
+    EXPECT_EQ(0U, mtu_probe_packet.Encode(boost::asio::buffer(char_array, kProbeSize - 1)));
+
+    MtuProbePacket decoded_packet;
+    EXPECT_TRUE(decoded_packet.Decode(dbuffer));
+    EXPECT_EQ(0x11111111U, decoded_packet.SequenceNumber());
+    EXPECT_EQ(kProbeSize, decoded_packet.ProbeSize());
+    // A truncated request is rejected
+    EXPECT_FALSE(decoded_packet.Decode(boost::asio::buffer(char_array, kProbeSize - 1)));
+  }
+  {
+    // Response is never padded
+    mtu_probe_packet.SetSequenceNumber(0x11111112);
+    EXPECT_TRUE(mtu_probe_packet.IsResponse());
+    EXPECT_TRUE(mtu_probe_packet.IsResponseOf(0x11111111));
+    EXPECT_FALSE(mtu_probe_packet.IsResponseOf(0x11111113));
+    boost::asio::mutable_buffer dbuffer(boost::asio::buffer(char_array));
+    EXPECT_EQ(MtuProbePacket::kPacketSize, mtu_probe_packet.Encode(dbuffer));
+
+    MtuProbePacket decoded_packet;
+    EXPECT_TRUE(decoded_packet.Decode(boost::asio::buffer(char_array, MtuProbePacket::kPacketSize)));
+    EXPECT_EQ(0x11111112U, decoded_packet.SequenceNumber());
+    EXPECT_EQ(kProbeSize, decoded_packet.ProbeSize());
+    EXPECT_FALSE(decoded_packet.Decode(dbuffer));
+  }
+}
+
+TEST(PingPacketTest, BEH_All) {
+  PingPacket ping_packet;
+  {
+    // Buffer length wrong
+    char char_array[PingPacket::kPacketSize + 1] = {0};
+    char_array[0] = static_cast<unsigned char>(0x80);
+    char_array[1] = PingPacket::kPacketType;
+    EXPECT_FALSE(ping_packet.Decode(boost::asio::buffer(char_array)));
+    EXPECT_FALSE(ping_packet.Decode(boost::asio::buffer(char_array, PingPacket::kPacketSize - 1)));
+    EXPECT_EQ(0U, ping_packet.Encode(boost::asio::buffer(char_array, PingPacket::kPacketSize - 1)));
+  }
+  char char_array[PingPacket::kPacketSize] = {0};
+  char_array[0] = static_cast<unsigned char>(0x80);
+  {
+    // Packet type wrong
+    char_array[1] = KeepalivePacket::kPacketType;
+    EXPECT_FALSE(ping_packet.Decode(boost::asio::buffer(char_array)));
+  }
+  const NodeId kNodeId(NodeId::kRandomId);
+  {
+    // Encode then Decode a request
+    ping_packet.SetSequenceNumber(0x11111111);
+    ping_packet.SetDestinationSocketId(0);
+    ping_packet.set_node_id(kNodeId);
+    EXPECT_TRUE(ping_packet.IsRequest());
+    boost::asio::mutable_buffer dbuffer(boost::asio::buffer(char_array));
+    EXPECT_EQ(PingPacket::kPacketSize, ping_packet.Encode(dbuffer));
+
+    PingPacket decoded_packet;
+    EXPECT_TRUE(decoded_packet.Decode(dbuffer));
+    EXPECT_TRUE(decoded_packet.IsRequest());
+    EXPECT_EQ(0x11111111U, decoded_packet.SequenceNumber());
+    EXPECT_EQ(0U, decoded_packet.DestinationSocketId());
+    EXPECT_EQ(kNodeId, decoded_packet.node_id());
+  }
+  {
+    // Response
+    ping_packet.SetSequenceNumber(0x11111112);
+    EXPECT_TRUE(ping_packet.IsResponse());
+    EXPECT_TRUE(ping_packet.IsResponseOf(0x11111111));
+    EXPECT_FALSE(ping_packet.IsResponseOf(0x11111113));
+    boost::asio::mutable_buffer dbuffer(boost::asio::buffer(char_array));
+    EXPECT_EQ(PingPacket::kPacketSize, ping_packet.Encode(dbuffer));
+
+    PingPacket decoded_packet;
+    EXPECT_TRUE(decoded_packet.Decode(dbuffer));
+    EXPECT_TRUE(decoded_packet.IsResponseOf(0x11111111));
+    EXPECT_EQ(kNodeId, decoded_packet.node_id());
+  }
+}
+
+TEST(DatagramPacketTest, BEH_All) {
+  DatagramPacket datagram_packet;
+  {
+    // No payload
+    char char_array[ControlPacket::kHeaderSize] = {0};
+    char_array[0] = static_cast<unsigned char>(0x80);
+    char_array[1] = DatagramPacket::kPacketType;
+    EXPECT_FALSE(datagram_packet.Decode(boost::asio::buffer(char_array)));
+    EXPECT_EQ(0U, datagram_packet.Encode(boost::asio::buffer(char_array)));
+  }
+  const std::string kData("Datagram payload");
+  char char_array[ControlPacket::kHeaderSize + 16] = {0};
+  char_array[0] = static_cast<unsigned char>(0x80);
+  {
+    // Packet type wrong
+    char_array[1] = AckPacket::kPacketType;
+    EXPECT_FALSE(datagram_packet.Decode(boost::asio::buffer(char_array)));
+  }
+  {
+    // Output buffer too small
+    datagram_packet.SetData(kData + "x");
+    EXPECT_EQ(0U, datagram_packet.Encode(boost::asio::buffer(char_array)));
+  }
+  {
+    // Encode then Decode
+    datagram_packet.SetSequenceNumber(0xffffffff);
+    datagram_packet.SetDestinationSocketId(0x12345678);
+    datagram_packet.SetData(kData);
+    boost::asio::mutable_buffer dbuffer(boost::asio::buffer(char_array));
+    EXPECT_EQ(ControlPacket::kHeaderSize + kData.size(), datagram_packet.Encode(dbuffer));
+
+    DatagramPacket decoded_packet;
+    EXPECT_TRUE(decoded_packet.Decode(dbuffer));
+    EXPECT_EQ(0xffffffff, decoded_packet.SequenceNumber());
+    EXPECT_EQ(0x12345678U, decoded_packet.DestinationSocketId());
+    EXPECT_EQ(kData, decoded_packet.Data());
+  }
+}
+
+TEST(MessageDropPacketTest, BEH_All) {
+  MessageDropPacket message_drop_packet;
+  char char_array[MessageDropPacket::kPacketSize] = {0};
+  char_array[0] = static_cast<unsigned char>(0x80);
+  {
+    // Buffer length wrong
+    char_array[1] = MessageDropPacket::kPacketType;
+    EXPECT_FALSE(message_drop_packet.Decode(
+        boost::asio::buffer(char_array, MessageDropPacket::kPacketSize - 1)));
+    EXPECT_EQ(0U, message_drop_packet.Encode(
+        boost::asio::buffer(char_array, MessageDropPacket::kPacketSize - 1)));
+  }
+  {
+    // Packet type wrong
+    char_array[1] = AckPacket::kPacketType;
+    EXPECT_FALSE(message_drop_packet.Decode(boost::asio::buffer(char_array)));
+  }
+  {
+    // Encode then Decode
+    message_drop_packet.SetFirstSequenceNumber(0x7ffffffe);
+    message_drop_packet.SetLastSequenceNumber(0x00000001);
+    message_drop_packet.SetDestinationSocketId(0x12345678);
+    boost::asio::mutable_buffer dbuffer(boost::asio::buffer(char_array));
+    EXPECT_EQ(MessageDropPacket::kPacketSize, message_drop_packet.Encode(dbuffer));
+
+    MessageDropPacket decoded_packet;
+    EXPECT_TRUE(decoded_packet.Decode(dbuffer));
+    EXPECT_EQ(0x7ffffffeU, decoded_packet.FirstSequenceNumber());
+    EXPECT_EQ(0x00000001U, decoded_packet.LastSequenceNumber());
+    EXPECT_EQ(0x12345678U, decoded_packet.DestinationSocketId());
+  }
+}
+
+TEST(FecPacketTest, BEH_All) {
+  FecPacket fec_packet;
+  char char_array[FecPacket::kFixedSize + 5] = {0};
+  char_array[0] = static_cast<unsigned char>(0x80);
+  {
+    // Buffer length wrong
+    char_array[1] = FecPacket::kPacketType;
+    EXPECT_FALSE(fec_packet.Decode(boost::asio::buffer(char_array, FecPacket::kFixedSize - 1)));
+    fec_packet.SetPayloadXor("12345");
+    EXPECT_EQ(0U, fec_packet.Encode(boost::asio::buffer(char_array, FecPacket::kFixedSize + 4)));
+  }
+  {
+    // Packet type wrong
+    char_array[1] = DatagramPacket::kPacketType;
+    EXPECT_FALSE(fec_packet.Decode(boost::asio::buffer(char_array)));
+  }
+  {
+    // Encode then Decode
+    fec_packet.SetFirstSequenceNumber(0x7fffffe0);
+    fec_packet.SetBlockSize(32);
+    fec_packet.SetLengthXor(0xabcd);
+    fec_packet.SetHeaderXor(0xe1234567);
+    fec_packet.SetDestinationSocketId(0x12345678);
+    boost::asio::mutable_buffer dbuffer(boost::asio::buffer(char_array));
+    EXPECT_EQ(FecPacket::kFixedSize + 5U, fec_packet.Encode(dbuffer));
+
+    FecPacket decoded_packet;
+    EXPECT_TRUE(decoded_packet.Decode(dbuffer));
+    EXPECT_EQ(0x7fffffe0U, decoded_packet.FirstSequenceNumber());
+    EXPECT_EQ(32U, decoded_packet.BlockSize());
+    EXPECT_EQ(0xabcd, decoded_packet.LengthXor());
+    EXPECT_EQ(0xe1234567U, decoded_packet.HeaderXor());
+    EXPECT_EQ("12345", decoded_packet.PayloadXor());
+    EXPECT_EQ(0x12345678U, decoded_packet.DestinationSocketId());
+  }
+}
+
 }  // namespace test
 
 }  // namespace detail
@@ -0,0 +1,103 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include <memory>
+#include <string>
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/parameters.h"
+#include "maidsafe/rudp/packets/public_key_cache.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+class PublicKeyCacheTest : public testing::Test {
+ protected:
+  PublicKeyCacheTest() : cache_size_(Parameters::public_key_cache_size) {
+    PublicKeyCache::Instance().Clear();
+  }
+
+  ~PublicKeyCacheTest() {
+    Parameters::public_key_cache_size = cache_size_;
+    PublicKeyCache::Instance().Clear();
+  }
+
+  static std::string EncodedKey() {
+    return asymm::EncodeKey(asymm::GenerateKeyPair().public_key).string();
+  }
+
+  const uint32_t cache_size_;
+};
+
+TEST_F(PublicKeyCacheTest, BEH_EncodeOncePerKey) {
+  PublicKeyCache& cache(PublicKeyCache::Instance());
+  asymm::Keys keys(asymm::GenerateKeyPair());
+  std::shared_ptr<asymm::PublicKey> public_key(std::make_shared<asymm::PublicKey>(keys.public_key));
+  std::shared_ptr<const std::string> encoded(cache.Encode(public_key));
+  ASSERT_TRUE(encoded);
+  EXPECT_EQ(asymm::EncodeKey(keys.public_key).string(), *encoded);
+  EXPECT_EQ(encoded, cache.Encode(public_key));
+
+  // A different object holding the same key is encoded afresh.
+  std::shared_ptr<asymm::PublicKey> copy(std::make_shared<asymm::PublicKey>(keys.public_key));
+  std::shared_ptr<const std::string> copy_encoded(cache.Encode(copy));
+  EXPECT_NE(encoded, copy_encoded);
+  EXPECT_EQ(*encoded, *copy_encoded);
+}
+
+TEST_F(PublicKeyCacheTest, BEH_DecodeOncePerKey) {
+  PublicKeyCache& cache(PublicKeyCache::Instance());
+  asymm::Keys keys(asymm::GenerateKeyPair());
+  std::string encoded(asymm::EncodeKey(keys.public_key).string());
+  std::shared_ptr<asymm::PublicKey> public_key(cache.Decode(encoded));
+  ASSERT_TRUE(public_key.get() != nullptr);
+  EXPECT_TRUE(asymm::MatchingKeys(keys.public_key, *public_key));
+  EXPECT_EQ(public_key, cache.Decode(encoded));
+  EXPECT_EQ(1U, cache.DecodedCount());
+}
+
+TEST_F(PublicKeyCacheTest, BEH_EvictLeastRecentlyUsed) {
+  Parameters::public_key_cache_size = 2;
+  PublicKeyCache& cache(PublicKeyCache::Instance());
+  std::string first(EncodedKey()), second(EncodedKey()), third(EncodedKey());
+  std::shared_ptr<asymm::PublicKey> first_key(cache.Decode(first));
+  std::shared_ptr<asymm::PublicKey> second_key(cache.Decode(second));
+  // Using the first key makes the second the least recently used.
+  EXPECT_EQ(first_key, cache.Decode(first));
+  cache.Decode(third);
+  EXPECT_EQ(2U, cache.DecodedCount());
+  EXPECT_EQ(first_key, cache.Decode(first));
+  EXPECT_NE(second_key, cache.Decode(second));
+  EXPECT_EQ(2U, cache.DecodedCount());
+
+  Parameters::public_key_cache_size = 0;
+  cache.Clear();
+  EXPECT_TRUE(cache.Decode(first).get() != nullptr);
+  EXPECT_EQ(0U, cache.DecodedCount());
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
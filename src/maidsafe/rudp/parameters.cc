@@ -23,6 +23,7 @@ namespace rudp {
 
 uint32_t Parameters::thread_count(2);
 int Parameters::max_transports(10);
+uint32_t Parameters::spare_transports(1);
 uint32_t Parameters::default_window_size(64);
 uint32_t Parameters::maximum_window_size(512);
 uint32_t Parameters::default_size(1480);
@@ -36,6 +37,7 @@ uint32_t Parameters::max_size(8192);
 uint32_t Parameters::max_data_size(8162);
 // #endif
 uint32_t Parameters::default_data_size(1450);
+uint32_t Parameters::stream_window_size(32);
 Timeout Parameters::default_send_timeout(bptime::milliseconds(500));
 Timeout Parameters::default_receive_timeout(bptime::milliseconds(500));
 Timeout Parameters::default_send_delay(bptime::milliseconds(10));
@@ -45,13 +47,25 @@ Timeout Parameters::ack_interval(bptime::milliseconds(100));
 Timeout Parameters::speed_calculate_inverval(bptime::seconds(10));
 uint32_t Parameters::slow_speed_threshold(1024);
 Timeout Parameters::rendezvous_connect_timeout(bptime::seconds(5));
+Timeout Parameters::connect_race_delay(bptime::milliseconds(250));
 Timeout Parameters::bootstrap_connect_timeout(bptime::seconds(2));
+uint32_t Parameters::bootstrap_connect_concurrency(4);
+uint32_t Parameters::bootstrap_cache_size(256);
 Timeout Parameters::ping_timeout(bptime::seconds(2));
 Timeout Parameters::keepalive_interval(bptime::milliseconds(500));
 Timeout Parameters::keepalive_timeout(bptime::milliseconds(400));
 uint32_t Parameters::maximum_keepalive_failures(20);
 Timeout Parameters::bootstrap_connection_lifespan(bptime::minutes(10));
+Timeout Parameters::syn_cookie_lifetime(bptime::seconds(30));
+bool Parameters::accept_legacy_connection_requests(true);
+Timeout Parameters::session_ticket_lifetime(bptime::minutes(10));
 Timeout Parameters::disconnection_timeout(bptime::milliseconds(500));
+uint32_t Parameters::mtu_probe_max_attempts(3);
+Timeout Parameters::mtu_probe_timeout(bptime::seconds(1));
+Timeout Parameters::mtu_raise_interval(bptime::minutes(10));
+uint32_t Parameters::mtu_black_hole_timeouts(3);
+bool Parameters::forward_error_correction(true);
+uint32_t Parameters::public_key_cache_size(1024);
 Parameters::ConnectionType Parameters::connection_type(Parameters::kWireless);
 #ifdef TESTING
 bool Parameters::rudp_encrypt(true);
@@ -0,0 +1,188 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/bootstrap_cache.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/operations.hpp"
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/parameters.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+typedef BootstrapCache::Endpoint Endpoint;
+
+class BootstrapCacheTest : public testing::Test {
+ protected:
+  BootstrapCacheTest()
+      : path_(fs::temp_directory_path() / fs::unique_path("rudp_bootstrap_cache_%%%%-%%%%")),
+        default_cache_size_(Parameters::bootstrap_cache_size) {}
+
+  ~BootstrapCacheTest() {
+    Parameters::bootstrap_cache_size = default_cache_size_;
+    boost::system::error_code ec;
+    fs::remove(path_, ec);
+  }
+
+  static Endpoint MakeEndpoint(const std::string& address, uint16_t port) {
+    return Endpoint(boost::asio::ip::address::from_string(address), port);
+  }
+
+  fs::path path_;
+  uint32_t default_cache_size_;
+};
+
+TEST_F(BootstrapCacheTest, BEH_ExpectedConnectTime) {
+  // A peer never tried is expected to fail once for each success.
+  EXPECT_DOUBLE_EQ(Parameters::bootstrap_connect_timeout.total_milliseconds(),
+                   BootstrapCache::ExpectedConnectTime(0, 0, 0));
+  EXPECT_DOUBLE_EQ(50.0, BootstrapCache::ExpectedConnectTime(50000, 0xffff, 0) -
+                   Parameters::bootstrap_connect_timeout.total_milliseconds() / 65536.0);
+  EXPECT_LT(BootstrapCache::ExpectedConnectTime(200000, 5, 0),
+            BootstrapCache::ExpectedConnectTime(1000, 5, 5));
+  EXPECT_LT(BootstrapCache::ExpectedConnectTime(1000, 5, 0),
+            BootstrapCache::ExpectedConnectTime(2000, 5, 0));
+}
+
+TEST_F(BootstrapCacheTest, BEH_Rank) {
+  BootstrapCache cache(path_);
+  const Endpoint kUnknown(MakeEndpoint("10.0.0.1", 5000)), kFast(MakeEndpoint("10.0.0.2", 5000)),
+      kSlow(MakeEndpoint("10.0.0.3", 5000)), kFlaky(MakeEndpoint("10.0.0.4", 5000)),
+      kCachedOnly(MakeEndpoint("::1", 6000));
+  cache.RecordSuccess(kSlow, 300000);
+  cache.RecordSuccess(kFast, 10000);
+  cache.RecordSuccess(kCachedOnly, 20000);
+  cache.RecordSuccess(kFlaky, 1000);
+  for (int i(0); i != 3; ++i)
+    cache.RecordFailure(kFlaky);
+  EXPECT_EQ(4U, cache.Size());
+
+  std::vector<Endpoint> bootstrap_endpoints;
+  bootstrap_endpoints.push_back(kUnknown);
+  bootstrap_endpoints.push_back(kFlaky);
+  bootstrap_endpoints.push_back(kSlow);
+  bootstrap_endpoints.push_back(kFast);
+  bootstrap_endpoints.push_back(kFast);
+  std::vector<Endpoint> ranked(cache.Rank(bootstrap_endpoints));
+  ASSERT_EQ(5U, ranked.size());
+  EXPECT_EQ(kFast, ranked[0]);
+  EXPECT_EQ(kCachedOnly, ranked[1]);
+  EXPECT_EQ(kSlow, ranked[2]);
+  EXPECT_EQ(kUnknown, ranked[3]);
+  EXPECT_EQ(kFlaky, ranked[4]);
+
+  // Unmeasured round trip times don't disturb the smoothed value.
+  cache.RecordRoundTripTime(kFast, 0);
+  cache.RecordSuccess(kFast, 0);
+  // Round trip times for peers not in the cache are ignored.
+  cache.RecordRoundTripTime(kUnknown, 1000);
+  EXPECT_EQ(4U, cache.Size());
+  EXPECT_EQ(kFast, cache.Rank(std::vector<Endpoint>()).front());
+}
+
+TEST_F(BootstrapCacheTest, BEH_Persistence) {
+  const Endpoint kV4(MakeEndpoint("192.168.1.1", 5483)), kV6(MakeEndpoint("2001:db8::1", 5484));
+  {
+    BootstrapCache cache(path_);
+    EXPECT_EQ(0U, cache.Size());
+    cache.RecordSuccess(kV6, 40000);
+    cache.RecordSuccess(kV4, 20000);
+    cache.RecordFailure(kV6);
+  }
+  EXPECT_EQ(BootstrapCache::kHeaderSize + 2 * BootstrapCache::kRecordSize, fs::file_size(path_));
+
+  BootstrapCache cache(path_);
+  EXPECT_EQ(2U, cache.Size());
+  std::vector<Endpoint> ranked(cache.Rank(std::vector<Endpoint>()));
+  ASSERT_EQ(2U, ranked.size());
+  EXPECT_EQ(kV4, ranked[0]);
+  EXPECT_TRUE(ranked[0].address().is_v4());
+  EXPECT_EQ(kV6, ranked[1]);
+
+  // Updates are written in place.
+  cache.RecordSuccess(kV4, 20000);
+  EXPECT_EQ(BootstrapCache::kHeaderSize + 2 * BootstrapCache::kRecordSize, fs::file_size(path_));
+}
+
+TEST_F(BootstrapCacheTest, BEH_Eviction) {
+  Parameters::bootstrap_cache_size = 3;
+  BootstrapCache cache(path_);
+  for (uint16_t port(5000); port != 5005; ++port)
+    cache.RecordSuccess(MakeEndpoint("10.0.0.1", port), 1000);
+  EXPECT_EQ(3U, cache.Size());
+  EXPECT_EQ(BootstrapCache::kHeaderSize + 3 * BootstrapCache::kRecordSize, fs::file_size(path_));
+
+  Parameters::bootstrap_cache_size = 2;
+  EXPECT_EQ(2U, BootstrapCache(path_).Size());
+}
+
+TEST_F(BootstrapCacheTest, BEH_UnrecognisedFile) {
+  {
+    std::ofstream file(path_.string().c_str(), std::ios::binary);
+    file << "Not a bootstrap cache file at all.";
+  }
+  {
+    BootstrapCache cache(path_);
+    EXPECT_EQ(0U, cache.Size());
+    // The file is replaced by an empty cache.
+    EXPECT_EQ(BootstrapCache::kHeaderSize, fs::file_size(path_));
+    cache.RecordSuccess(MakeEndpoint("10.0.0.1", 5000), 1000);
+    EXPECT_EQ(1U, cache.Size());
+  }
+  EXPECT_EQ(1U, BootstrapCache(path_).Size());
+}
+
+TEST_F(BootstrapCacheTest, BEH_OtherVersion) {
+  {
+    BootstrapCache cache(path_);
+    cache.RecordSuccess(MakeEndpoint("10.0.0.1", 5000), 1000);
+    cache.RecordSuccess(MakeEndpoint("10.0.0.2", 5000), 1000);
+  }
+  {
+    // Bump the version in the header.
+    std::fstream file(path_.string().c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(11);
+    file.put(2);
+  }
+  {
+    BootstrapCache cache(path_);
+    EXPECT_EQ(0U, cache.Size());
+    EXPECT_EQ(BootstrapCache::kHeaderSize, fs::file_size(path_));
+    cache.RecordSuccess(MakeEndpoint("10.0.0.3", 5000), 1000);
+  }
+  BootstrapCache cache(path_);
+  ASSERT_EQ(1U, cache.Size());
+  EXPECT_EQ(MakeEndpoint("10.0.0.3", 5000), cache.Rank(std::vector<Endpoint>()).front());
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,142 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/asio/ip/address.hpp"
+#include "boost/program_options.hpp"
+
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/rudp/tests/impairment_relay_impl.h"
+
+namespace bptime = boost::posix_time;
+namespace ip = boost::asio::ip;
+namespace po = boost::program_options;
+
+namespace {
+
+const char kUsage[] =
+    "Relays UDP between two rudp_node instances, impairing each direction.\n\n"
+    "rudp_node binds to port 9500 unless its peer uses that port, when it binds to 9501.  So on\n"
+    "one machine, with the relay's defaults:\n"
+    "  rudp_impairment_relay --target <local IP>:9501 --scenario <file>\n"
+    "  rudp_node -i 0 -r 1 --peer <local IP>:9502   (node A, binds to 9500)\n"
+    "  rudp_node -i 1 -r 0 --peer <local IP>:9500   (node B, binds to 9501)\n"
+    "The relay uses port 9500 to talk to node B, and so must be started first.\n\n"
+    "Without a scenario file, the conditions given by --conditions apply to both directions for\n"
+    "--duration seconds.  For the scenario file format, see impairment_relay_impl.h.  An example:\n"
+    "  # Clean path, then congested, then a period of bursty loss on the forward path\n"
+    "  0   both    rate=1000000 delay=20\n"
+    "  30  both    rate=250000 queue=50000 delay=20 jitter=5\n"
+    "  60  a_to_b  rate=1000000 delay=20 burst=0.005,0.3 reorder=0.01\n"
+    "  90  end\n\n";
+
+}  // unnamed namespace
+
+int main(int argc, char** argv) {
+  maidsafe::log::Logging::Instance().Initialise(argc, argv);
+
+  try {
+    uint16_t a_port(0), b_port(0);
+    uint32_t seed(0);
+    int report_interval(0), duration(0);
+    po::options_description options_description("Options");
+    options_description.add_options()
+        ("help,h", "Print options.")
+        ("a_port", po::value<uint16_t>(&a_port)->default_value(9502),
+            "Port on which node A reaches the relay.")
+        ("b_port", po::value<uint16_t>(&b_port)->default_value(9500),
+            "Port from which the relay reaches node B.")
+        ("target,t", po::value<std::string>(), "Endpoint of node B, as <IP>:<port>.")
+        ("scenario,s", po::value<std::string>(), "Path to scenario file.")
+        ("conditions,c", po::value<std::string>()->default_value(""),
+            "Settings applied to both directions when no scenario is given, e.g. "
+            "\"rate=1000000 delay=20 loss=0.01\".")
+        ("duration,d", po::value<int>(&duration)->default_value(60),
+            "Seconds to run for when no scenario is given.")
+        ("report_interval", po::value<int>(&report_interval)->default_value(1000),
+            "Milliseconds between rows of the report.")
+        ("report,r", po::value<std::string>(), "Path to write report to (default is stdout).")
+        ("seed", po::value<uint32_t>(&seed)->default_value(0),
+            "Seed for the random impairments.");
+
+    po::variables_map variables_map;
+    po::store(po::command_line_parser(argc, argv).options(options_description).allow_unregistered().
+                                                  run(), variables_map);
+    po::notify(variables_map);
+
+    if (variables_map.count("help") || !variables_map.count("target")) {
+      std::cout << kUsage << options_description << std::endl;
+      return variables_map.count("help") ? 0 : -1;
+    }
+
+    std::string target(variables_map.at("target").as<std::string>());
+    size_t delimiter(target.rfind(':'));
+    if (delimiter == std::string::npos) {
+      std::cout << "Could not parse target endpoint from " << target << std::endl;
+      return -1;
+    }
+    ip::udp::endpoint b_endpoint(ip::address::from_string(target.substr(0, delimiter)),
+                                 static_cast<uint16_t>(std::stoi(target.substr(delimiter + 1))));
+
+    maidsafe::rudp::test::Scenario scenario;
+    std::string error;
+    if (variables_map.count("scenario")) {
+      std::ifstream scenario_file(variables_map.at("scenario").as<std::string>());
+      if (!scenario_file) {
+        std::cout << "Could not open scenario file." << std::endl;
+        return -1;
+      }
+      if (!maidsafe::rudp::test::ParseScenario(scenario_file, scenario, error)) {
+        std::cout << "Invalid scenario: " << error << std::endl;
+        return -1;
+      }
+    } else {
+      std::istringstream conditions(variables_map.at("conditions").as<std::string>());
+      std::vector<std::string> settings;
+      std::string setting;
+      while (conditions >> setting)
+        settings.push_back(setting);
+      maidsafe::rudp::test::ScenarioStep step;
+      step.a_to_b = step.b_to_a = true;
+      step.description = "both " + variables_map.at("conditions").as<std::string>();
+      if (!maidsafe::rudp::test::ParseLinkConditions(settings, step.conditions, error)) {
+        std::cout << "Invalid conditions: " << error << std::endl;
+        return -1;
+      }
+      scenario.steps.push_back(step);
+      scenario.end = bptime::seconds(duration);
+    }
+
+    std::ofstream report_file;
+    if (variables_map.count("report"))
+      report_file.open(variables_map.at("report").as<std::string>());
+    maidsafe::rudp::test::ImpairmentRelay relay(a_port, b_port, b_endpoint, seed);
+    std::cout << "Relaying between port " << a_port << " and " << b_endpoint << " via port "
+              << b_port << std::endl;
+    relay.Run(scenario, bptime::milliseconds(report_interval),
+              report_file.is_open() ? report_file : std::cout);
+  }
+  catch(const std::exception& e) {
+    std::cout << "Error: " << e.what() << std::endl;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,373 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/rudp/tests/impairment_relay_impl.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+#include "maidsafe/common/log.h"
+
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace test {
+
+namespace {
+
+bptime::time_duration ParseDuration(const std::string& value, int64_t microseconds_per_unit) {
+  double units(std::stod(value));
+  if (units < 0.0)
+    throw std::invalid_argument("negative duration");
+  return bptime::microseconds(static_cast<int64_t>(units * microseconds_per_unit));
+}
+
+double ParseProbability(const std::string& value) {
+  double probability(std::stod(value));
+  if (probability < 0.0 || probability > 1.0)
+    throw std::invalid_argument("probability out of range");
+  return probability;
+}
+
+double Mean(const std::vector<int64_t>& samples) {
+  if (samples.empty())
+    return 0.0;
+  double total(0.0);
+  for (auto sample : samples)
+    total += static_cast<double>(sample);
+  return total / samples.size();
+}
+
+int64_t Percentile(std::vector<int64_t> samples, size_t percent) {
+  if (samples.empty())
+    return 0;
+  auto itr(samples.begin() + (samples.size() - 1) * percent / 100);
+  std::nth_element(samples.begin(), itr, samples.end());
+  return *itr;
+}
+
+}  // unnamed namespace
+
+bool ParseLinkConditions(const std::vector<std::string>& settings,
+                         detail::LinkConditions& conditions, std::string& error) {
+  conditions = detail::LinkConditions();
+  for (const auto& setting : settings) {
+    size_t delimiter(setting.find('='));
+    if (delimiter == std::string::npos) {
+      error = "Expected <setting>=<value> but got \"" + setting + "\"";
+      return false;
+    }
+    std::string name(setting.substr(0, delimiter)), value(setting.substr(delimiter + 1));
+    try {
+      if (name == "rate") {
+        conditions.bandwidth = std::stoull(value);
+      } else if (name == "queue") {
+        conditions.queue_size = std::stoull(value);
+      } else if (name == "delay") {
+        conditions.delay = ParseDuration(value, 1000);
+      } else if (name == "jitter") {
+        conditions.jitter = ParseDuration(value, 1000);
+      } else if (name == "loss") {
+        conditions.loss = ParseProbability(value);
+      } else if (name == "burst") {
+        size_t comma(value.find(','));
+        if (comma == std::string::npos)
+          throw std::invalid_argument("missing comma");
+        conditions.burst_loss_start = ParseProbability(value.substr(0, comma));
+        conditions.burst_loss_end = ParseProbability(value.substr(comma + 1));
+        if (conditions.burst_loss_start > 0.0 && conditions.burst_loss_end == 0.0)
+          throw std::invalid_argument("bursts would never end");
+      } else if (name == "reorder") {
+        conditions.reordering = ParseProbability(value);
+      } else {
+        error = "Unknown setting \"" + name + "\"";
+        return false;
+      }
+    }
+    catch(const std::exception&) {
+      error = "Invalid value for \"" + setting + "\"";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ParseScenario(std::istream& input, Scenario& scenario, std::string& error) {
+  scenario = Scenario();
+  bool ended(false);
+  std::string line;
+  for (int line_number(1); std::getline(input, line); ++line_number) {
+    std::istringstream line_stream(line);
+    std::string start, direction, setting;
+    if (!(line_stream >> start) || start[0] == '#')
+      continue;
+    std::string location("Line " + std::to_string(line_number) + ": ");
+    if (ended) {
+      error = location + "steps follow the end of the scenario";
+      return false;
+    }
+    ScenarioStep step;
+    step.description = line;
+    try {
+      step.start = ParseDuration(start, 1000000);
+    }
+    catch(const std::exception&) {
+      error = location + "invalid start time \"" + start + "\"";
+      return false;
+    }
+    if (!scenario.steps.empty() && step.start < scenario.steps.back().start) {
+      error = location + "steps must be in order of start time";
+      return false;
+    }
+    line_stream >> direction;
+    if (direction == "end") {
+      scenario.end = step.start;
+      ended = true;
+      continue;
+    }
+    step.a_to_b = (direction == "a_to_b" || direction == "both");
+    step.b_to_a = (direction == "b_to_a" || direction == "both");
+    if (!step.a_to_b && !step.b_to_a) {
+      error = location + "expected a_to_b, b_to_a, both or end but got \"" + direction + "\"";
+      return false;
+    }
+    std::vector<std::string> settings;
+    while (line_stream >> setting)
+      settings.push_back(setting);
+    if (!ParseLinkConditions(settings, step.conditions, error)) {
+      error = location + error;
+      return false;
+    }
+    scenario.steps.push_back(step);
+  }
+  if (!ended) {
+    error = "Scenario has no end";
+    return false;
+  }
+  return true;
+}
+
+ImpairmentRelay::ImpairmentRelay(uint16_t a_port, uint16_t b_port,
+                                 const ip::udp::endpoint& b_endpoint, uint32_t seed)
+    : io_service_(),
+      a_socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), a_port)),
+      b_socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), b_port)),
+      b_endpoint_(b_endpoint),
+      a_to_b_("a_to_b", a_socket_, b_socket_),
+      b_to_a_("b_to_a", b_socket_, a_socket_),
+      generator_(seed),
+      pending_packets_(),
+      next_order_(0),
+      send_timer_(io_service_),
+      step_timer_(io_service_),
+      report_timer_(io_service_),
+      scenario_(nullptr),
+      next_step_(0),
+      start_time_(),
+      period_start_(),
+      report_interval_(),
+      report_(nullptr) {
+  a_to_b_.destination = b_endpoint_;
+}
+
+void ImpairmentRelay::Run(const Scenario& scenario, const bptime::time_duration& report_interval,
+                          std::ostream& report) {
+  scenario_ = &scenario;
+  next_step_ = 0;
+  report_interval_ = report_interval;
+  report_ = &report;
+  start_time_ = asio::deadline_timer::traits_type::now();
+  *report_ << "time\tdirection\treceived\tforwarded\tlost\tqueue_full\tthroughput_bytes_per_sec"
+           << "\tlatency_mean_ms\tlatency_p50_ms\tlatency_p99_ms" << std::endl;
+
+  StartReceive(a_to_b_);
+  StartReceive(b_to_a_);
+  period_start_ = bptime::time_duration();
+  ApplySteps(period_start_);
+  report_timer_.expires_at(start_time_ + report_interval_);
+  report_timer_.async_wait([this](const boost::system::error_code& ec) {
+    HandleReportTimer(ec);
+  });
+  io_service_.run();
+}
+
+void ImpairmentRelay::StartReceive(Direction& direction) {
+  direction.in_socket.async_receive_from(
+      asio::buffer(direction.buffer), direction.sender,
+      [this, &direction](const boost::system::error_code& ec, size_t length) {
+        HandleReceive(direction, ec, length);
+      });
+}
+
+void ImpairmentRelay::HandleReceive(Direction& direction, const boost::system::error_code& ec,
+                                    size_t length) {
+  if (ec == asio::error::operation_aborted)
+    return;
+  if (ec) {
+    LOG(kWarning) << "Error receiving on " << direction.name << ": " << ec.message();
+    return StartReceive(direction);
+  }
+
+  if (&direction == &a_to_b_) {
+    b_to_a_.destination = direction.sender;
+  } else if (direction.sender != b_endpoint_ || direction.destination.port() == 0) {
+    // Only node B's packets are relayed to node A, and only once A's endpoint is known.
+    return StartReceive(direction);
+  }
+
+  bptime::ptime now(asio::deadline_timer::traits_type::now());
+  ++direction.interval_statistics.packets_received;
+  ++direction.step_statistics.packets_received;
+  PendingPacket packet;
+  switch (direction.link.Transmit(now, length, generator_, packet.send_time)) {
+    case detail::ImpairedLink::Result::kLost:
+      ++direction.interval_statistics.packets_lost;
+      ++direction.step_statistics.packets_lost;
+      break;
+    case detail::ImpairedLink::Result::kQueueFull:
+      ++direction.interval_statistics.packets_queue_full;
+      ++direction.step_statistics.packets_queue_full;
+      break;
+    case detail::ImpairedLink::Result::kDelivered:
+      packet.receive_time = now;
+      packet.order = next_order_++;
+      packet.direction = &direction;
+      packet.data.assign(direction.buffer.begin(), direction.buffer.begin() + length);
+      pending_packets_.push(packet);
+      if (pending_packets_.top().order == packet.order)
+        ScheduleSend();
+      break;
+  }
+  StartReceive(direction);
+}
+
+void ImpairmentRelay::ScheduleSend() {
+  if (pending_packets_.empty())
+    return;
+  send_timer_.expires_at(pending_packets_.top().send_time);
+  send_timer_.async_wait([this](const boost::system::error_code& ec) { HandleSendTimer(ec); });
+}
+
+void ImpairmentRelay::HandleSendTimer(const boost::system::error_code& ec) {
+  if (ec == asio::error::operation_aborted)
+    return;
+  bptime::ptime now(asio::deadline_timer::traits_type::now());
+  while (!pending_packets_.empty() && pending_packets_.top().send_time <= now) {
+    const PendingPacket& packet(pending_packets_.top());
+    Direction& direction(*packet.direction);
+    boost::system::error_code send_ec;
+    direction.out_socket.send_to(asio::buffer(packet.data), direction.destination, 0, send_ec);
+    if (send_ec) {
+      LOG(kWarning) << "Error sending on " << direction.name << ": " << send_ec.message();
+    } else {
+      int64_t latency((now - packet.receive_time).total_microseconds());
+      for (Statistics* statistics :
+           { &direction.interval_statistics, &direction.step_statistics }) {
+        ++statistics->packets_forwarded;
+        statistics->bytes_forwarded += packet.data.size();
+        statistics->latencies.push_back(latency);
+      }
+    }
+    pending_packets_.pop();
+  }
+  ScheduleSend();
+}
+
+void ImpairmentRelay::HandleStepTimer(const boost::system::error_code& ec) {
+  if (ec == asio::error::operation_aborted)
+    return;
+  bptime::time_duration elapsed(asio::deadline_timer::traits_type::now() - start_time_);
+  WriteSummary(a_to_b_, elapsed);
+  WriteSummary(b_to_a_, elapsed);
+  period_start_ = elapsed;
+  if (elapsed >= scenario_->end) {
+    std::cout << "Scenario finished after " << elapsed << std::endl;
+    io_service_.stop();
+    return;
+  }
+  ApplySteps(elapsed);
+}
+
+void ImpairmentRelay::ApplySteps(const bptime::time_duration& elapsed) {
+  while (next_step_ != scenario_->steps.size() && scenario_->steps[next_step_].start <= elapsed) {
+    const ScenarioStep& step(scenario_->steps[next_step_++]);
+    std::cout << "At " << elapsed << " applying: " << step.description << std::endl;
+    if (step.a_to_b)
+      a_to_b_.link.SetConditions(step.conditions);
+    if (step.b_to_a)
+      b_to_a_.link.SetConditions(step.conditions);
+  }
+
+  bptime::time_duration next_change(scenario_->end);
+  if (next_step_ != scenario_->steps.size())
+    next_change = std::min(next_change, scenario_->steps[next_step_].start);
+  step_timer_.expires_at(start_time_ + next_change);
+  step_timer_.async_wait([this](const boost::system::error_code& ec) { HandleStepTimer(ec); });
+}
+
+void ImpairmentRelay::HandleReportTimer(const boost::system::error_code& ec) {
+  if (ec == asio::error::operation_aborted)
+    return;
+  bptime::time_duration elapsed(asio::deadline_timer::traits_type::now() - start_time_);
+  WriteRow(a_to_b_, elapsed);
+  WriteRow(b_to_a_, elapsed);
+  a_to_b_.interval_statistics = Statistics();
+  b_to_a_.interval_statistics = Statistics();
+  report_timer_.expires_at(report_timer_.expires_at() + report_interval_);
+  report_timer_.async_wait([this](const boost::system::error_code& ec) {
+    HandleReportTimer(ec);
+  });
+}
+
+void ImpairmentRelay::WriteRow(const Direction& direction, const bptime::time_duration& elapsed) {
+  const Statistics& statistics(direction.interval_statistics);
+  *report_ << std::fixed << std::setprecision(3) << elapsed.total_milliseconds() / 1000.0 << '\t'
+           << direction.name << '\t' << statistics.packets_received << '\t'
+           << statistics.packets_forwarded << '\t' << statistics.packets_lost << '\t'
+           << statistics.packets_queue_full << '\t'
+           << statistics.bytes_forwarded * 1000000 / report_interval_.total_microseconds() << '\t'
+           << Mean(statistics.latencies) / 1000.0 << '\t'
+           << Percentile(statistics.latencies, 50) / 1000.0 << '\t'
+           << Percentile(statistics.latencies, 99) / 1000.0 << std::endl;
+}
+
+void ImpairmentRelay::WriteSummary(Direction& direction,
+                                   const bptime::time_duration& elapsed) {
+  Statistics& statistics(direction.step_statistics);
+  int64_t period_microseconds(std::max<int64_t>(1, (elapsed - period_start_).total_microseconds()));
+  std::cout << "  " << direction.name << ": received " << statistics.packets_received
+            << ", forwarded " << statistics.packets_forwarded << ", lost "
+            << statistics.packets_lost << ", dropped by full queue "
+            << statistics.packets_queue_full << ", throughput "
+            << statistics.bytes_forwarded * 1000000 / period_microseconds << " B/s, latency mean "
+            << Mean(statistics.latencies) / 1000.0 << " ms, median "
+            << Percentile(statistics.latencies, 50) / 1000.0 << " ms, 99th percentile "
+            << Percentile(statistics.latencies, 99) / 1000.0 << " ms" << std::endl;
+  statistics = Statistics();
+}
+
+}  // namespace test
+
+}  // namespace rudp
+
+}  // namespace maidsafe
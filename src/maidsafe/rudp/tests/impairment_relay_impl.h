@@ -0,0 +1,166 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_RUDP_TESTS_IMPAIRMENT_RELAY_IMPL_H_
+#define MAIDSAFE_RUDP_TESTS_IMPAIRMENT_RELAY_IMPL_H_
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "boost/asio/deadline_timer.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/ip/udp.hpp"
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+#include "maidsafe/rudp/core/impaired_link.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace test {
+
+// From "start" onwards, the chosen directions of the relay take on "conditions".
+struct ScenarioStep {
+  ScenarioStep() : start(), a_to_b(false), b_to_a(false), conditions(), description() {}
+  boost::posix_time::time_duration start;
+  bool a_to_b, b_to_a;
+  detail::LinkConditions conditions;
+  std::string description;
+};
+
+// A timed sequence of link conditions, ending at "end".  In a scenario file, each line holds
+//   <start seconds> <a_to_b|b_to_a|both> [<setting>=<value>...]
+// or, to finish the scenario,
+//   <end seconds> end
+// where the settings are
+//   rate=<bytes per second>  queue=<bytes>  delay=<ms>  jitter=<ms>  loss=<probability>
+//   burst=<start probability>,<end probability>  reorder=<probability>
+// Settings not given are unimpaired.  Blank lines and those starting with '#' are ignored.
+struct Scenario {
+  Scenario() : steps(), end() {}
+  std::vector<ScenarioStep> steps;
+  boost::posix_time::time_duration end;
+};
+
+// Both return false and set "error" if the input is malformed.
+bool ParseScenario(std::istream& input, Scenario& scenario, std::string& error);
+bool ParseLinkConditions(const std::vector<std::string>& settings,
+                         detail::LinkConditions& conditions, std::string& error);
+
+// Relays UDP between two nodes, impairing each direction as a scenario dictates.  Node A sends to
+// the relay's "a_port", and the relay forwards its packets to node B at "b_endpoint" from its
+// "b_port".  Node B's packets are forwarded back from "a_port" to wherever node A last sent from.
+// Each node therefore sees the relay as its peer.
+class ImpairmentRelay {
+ public:
+  ImpairmentRelay(uint16_t a_port, uint16_t b_port,
+                  const boost::asio::ip::udp::endpoint& b_endpoint, uint32_t seed);
+
+  // Relays until the scenario ends.  A tab-separated row for each direction is written to "report"
+  // every "report_interval", and a summary of each step is written to std::cout as it ends.
+  void Run(const Scenario& scenario, const boost::posix_time::time_duration& report_interval,
+           std::ostream& report);
+
+ private:
+  ImpairmentRelay(const ImpairmentRelay&);
+  ImpairmentRelay& operator=(const ImpairmentRelay&);
+
+  struct Statistics {
+    Statistics()
+        : packets_received(0),
+          packets_forwarded(0),
+          packets_lost(0),
+          packets_queue_full(0),
+          bytes_forwarded(0),
+          latencies() {}
+    uint64_t packets_received, packets_forwarded, packets_lost, packets_queue_full,
+        bytes_forwarded;
+    // The time spent in the relay by each packet forwarded, in microseconds.
+    std::vector<int64_t> latencies;
+  };
+
+  struct Direction {
+    Direction(const std::string& name, boost::asio::ip::udp::socket& in_socket,
+              boost::asio::ip::udp::socket& out_socket)
+        : name(name),
+          in_socket(in_socket),
+          out_socket(out_socket),
+          sender(),
+          destination(),
+          link(),
+          interval_statistics(),
+          step_statistics(),
+          buffer() {}
+    std::string name;
+    boost::asio::ip::udp::socket &in_socket, &out_socket;
+    boost::asio::ip::udp::endpoint sender, destination;
+    detail::ImpairedLink link;
+    Statistics interval_statistics, step_statistics;
+    std::array<unsigned char, 65536> buffer;
+  };
+
+  struct PendingPacket {
+    boost::posix_time::ptime send_time, receive_time;
+    uint64_t order;
+    Direction* direction;
+    std::vector<unsigned char> data;
+    bool operator>(const PendingPacket& other) const {
+      return send_time != other.send_time ? send_time > other.send_time : order > other.order;
+    }
+  };
+
+  void StartReceive(Direction& direction);
+  void HandleReceive(Direction& direction, const boost::system::error_code& ec, size_t length);
+  void ScheduleSend();
+  void HandleSendTimer(const boost::system::error_code& ec);
+  void HandleStepTimer(const boost::system::error_code& ec);
+  // Applies the steps due by "elapsed", and waits for the next one or for the end.
+  void ApplySteps(const boost::posix_time::time_duration& elapsed);
+  void HandleReportTimer(const boost::system::error_code& ec);
+  void WriteRow(const Direction& direction, const boost::posix_time::time_duration& elapsed);
+  void WriteSummary(Direction& direction, const boost::posix_time::time_duration& elapsed);
+
+  boost::asio::io_service io_service_;
+  boost::asio::ip::udp::socket a_socket_, b_socket_;
+  boost::asio::ip::udp::endpoint b_endpoint_;
+  Direction a_to_b_, b_to_a_;
+  std::mt19937 generator_;
+  std::priority_queue<PendingPacket, std::vector<PendingPacket>, std::greater<PendingPacket>>
+      pending_packets_;
+  uint64_t next_order_;
+  boost::asio::deadline_timer send_timer_, step_timer_, report_timer_;
+  const Scenario* scenario_;
+  size_t next_step_;
+  boost::posix_time::ptime start_time_;
+  // When the conditions last changed, relative to start_time_.
+  boost::posix_time::time_duration period_start_;
+  boost::posix_time::time_duration report_interval_;
+  std::ostream* report_;
+};
+
+}  // namespace test
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_TESTS_IMPAIRMENT_RELAY_IMPL_H_
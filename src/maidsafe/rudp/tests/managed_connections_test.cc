@@ -15,6 +15,7 @@ License.
 
 #include "maidsafe/rudp/managed_connections.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <future>
@@ -248,6 +249,23 @@ TEST_F(ManagedConnectionsTest, BEH_API_Bootstrap) {
   EXPECT_FALSE(chosen_bootstrap.IsZero());
 }
 
+TEST_F(ManagedConnectionsTest, BEH_API_BootstrapPastDeadPeers) {
+  ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, 2));
+  // Bootstrap peers are tried in parallel, so those which aren't running don't each hold up
+  // bootstrapping until they time out.
+  std::vector<Endpoint> bootstrap_endpoints;
+  for (int i(0); i != 3; ++i)
+    bootstrap_endpoints.push_back(Endpoint(GetLocalIp(), maidsafe::test::GetRandomPort()));
+  bootstrap_endpoints.push_back(bootstrap_endpoints_[1]);
+  NodeId chosen_node;
+  auto start_point(std::chrono::steady_clock::now());
+  ASSERT_EQ(kSuccess, node_.Bootstrap(bootstrap_endpoints, chosen_node));
+  EXPECT_EQ(nodes_[1]->node_id(), chosen_node);
+  std::chrono::milliseconds bootstrap_connect_timeout(
+      Parameters::bootstrap_connect_timeout.total_milliseconds());
+  EXPECT_LT(std::chrono::steady_clock::now() - start_point, 2 * bootstrap_connect_timeout);
+}
+
 TEST_F(ManagedConnectionsTest, BEH_API_GetAvailableEndpoint) {
   ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, 2));
 
@@ -309,6 +327,34 @@ TEST_F(ManagedConnectionsTest, BEH_API_GetAvailableEndpoint) {
   EXPECT_NE(this_endpoint_pair.local, another_endpoint_pair.local);
 }
 
+TEST_F(ManagedConnectionsTest, BEH_API_GetAvailableEndpointFromSpare) {
+  ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, 2));
+  NodeId chosen_node;
+  auto start_point(std::chrono::steady_clock::now());
+  ASSERT_EQ(kSuccess, node_.Bootstrap(bootstrap_endpoints_, chosen_node));
+  auto bootstrap_duration(std::chrono::steady_clock::now() - start_point);
+
+  // Give the spare transport time to start in the background.
+  Sleep(boost::posix_time::seconds(1));
+  EndpointPair bootstrap_endpoint_pair, this_endpoint_pair;
+  NatType nat_type;
+  EXPECT_EQ(kBootstrapConnectionAlreadyExists,
+            node_.managed_connections()->GetAvailableEndpoint(chosen_node, EndpointPair(),
+                                                              bootstrap_endpoint_pair, nat_type));
+  for (int i(0); i != 3; ++i) {
+    // Each pick from the spare transport triggers starting another, but doesn't wait for it.
+    start_point = std::chrono::steady_clock::now();
+    EXPECT_EQ(kSuccess,
+              node_.managed_connections()->GetAvailableEndpoint(NodeId(NodeId::kRandomId),
+                                                                EndpointPair(),
+                                                                this_endpoint_pair,
+                                                                nat_type));
+    EXPECT_LT(std::chrono::steady_clock::now() - start_point, bootstrap_duration / 4);
+    EXPECT_TRUE(detail::IsValid(this_endpoint_pair.local));
+    EXPECT_NE(bootstrap_endpoint_pair.local, this_endpoint_pair.local);
+  }
+}
+
 TEST_F(ManagedConnectionsTest, BEH_API_PendingConnectionsPruning) {
   const int kNodeCount(8);
   ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, kNodeCount));
@@ -470,6 +516,214 @@ TEST_F(ManagedConnectionsTest, BEH_API_Add) {
   EXPECT_EQ(nodes_[2]->validation_data(), this_node_messages[0]);
 }
 
+TEST_F(ManagedConnectionsTest, BEH_API_AsyncBootstrapGetAvailableEndpointAndAdd) {
+  ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, 2));
+
+  // Invalid parameters are reported before Bootstrap returns.
+  bool bootstrap_functor_invoked(false);
+  node_.managed_connections()->Bootstrap(std::vector<Endpoint>(),
+                                         do_nothing_on_message_,
+                                         do_nothing_on_connection_lost_,
+                                         node_.node_id(),
+                                         node_.private_key(),
+                                         node_.public_key(),
+                                         [&](int result, const NodeId& chosen_node, NatType) {
+                                           EXPECT_EQ(kNoBootstrapEndpoints, result);
+                                           EXPECT_TRUE(chosen_node.IsZero());
+                                           bootstrap_functor_invoked = true;
+                                         });
+  EXPECT_TRUE(bootstrap_functor_invoked);
+
+  auto bootstrap_promise(std::make_shared<std::promise<std::pair<int, NodeId>>>());
+  auto bootstrap_future(bootstrap_promise->get_future());
+  node_.managed_connections()->Bootstrap(std::vector<Endpoint>(1, bootstrap_endpoints_[0]),
+                                         do_nothing_on_message_,
+                                         do_nothing_on_connection_lost_,
+                                         node_.node_id(),
+                                         node_.private_key(),
+                                         node_.public_key(),
+                                         [bootstrap_promise](int result, const NodeId& chosen_node,
+                                                             NatType) {
+                                           bootstrap_promise->set_value(
+                                               std::make_pair(result, chosen_node));
+                                         });
+  ASSERT_EQ(std::future_status::ready, bootstrap_future.wait_for(rendezvous_connect_timeout));
+  auto bootstrap_result(bootstrap_future.get());
+  ASSERT_EQ(kSuccess, bootstrap_result.first);
+  EXPECT_EQ(nodes_[0]->node_id(), bootstrap_result.second);
+
+  auto get_available([](ManagedConnections& managed_connections, const NodeId& peer_id,
+                         const EndpointPair& peer_endpoint_pair) {
+    auto promise(std::make_shared<std::promise<std::pair<int, EndpointPair>>>());
+    managed_connections.GetAvailableEndpoint(
+        peer_id, peer_endpoint_pair,
+        [promise](int result, const EndpointPair& this_endpoint_pair, NatType) {
+          promise->set_value(std::make_pair(result, this_endpoint_pair));
+        });
+    return promise->get_future();
+  });
+  auto this_future(get_available(*node_.managed_connections(), nodes_[1]->node_id(),
+                                 EndpointPair()));
+  ASSERT_EQ(std::future_status::ready, this_future.wait_for(rendezvous_connect_timeout));
+  auto this_result(this_future.get());
+  ASSERT_EQ(kSuccess, this_result.first);
+  auto peer_future(get_available(*nodes_[1]->managed_connections(), node_.node_id(),
+                                 this_result.second));
+  ASSERT_EQ(std::future_status::ready, peer_future.wait_for(rendezvous_connect_timeout));
+  auto peer_result(peer_future.get());
+  ASSERT_EQ(kSuccess, peer_result.first);
+  EXPECT_TRUE(detail::IsValid(this_result.second.local));
+  EXPECT_TRUE(detail::IsValid(peer_result.second.local));
+
+  // Each add_functor is invoked once the connection has been made.
+  auto add([](ManagedConnections& managed_connections, const NodeId& peer_id,
+              const EndpointPair& peer_endpoint_pair, const std::string& validation_data) {
+    auto promise(std::make_shared<std::promise<int>>());
+    managed_connections.Add(peer_id, peer_endpoint_pair, validation_data,
+                            [promise](int result) { promise->set_value(result); });
+    return promise->get_future();
+  });
+  auto peer_add_future(add(*nodes_[1]->managed_connections(), node_.node_id(),
+                           this_result.second, nodes_[1]->validation_data()));
+  auto this_add_future(add(*node_.managed_connections(), nodes_[1]->node_id(),
+                           peer_result.second, node_.validation_data()));
+  ASSERT_EQ(std::future_status::ready, peer_add_future.wait_for(rendezvous_connect_timeout));
+  EXPECT_EQ(kSuccess, peer_add_future.get());
+  ASSERT_EQ(std::future_status::ready, this_add_future.wait_for(rendezvous_connect_timeout));
+  EXPECT_EQ(kSuccess, this_add_future.get());
+
+  // Failures to start are reported before Add returns.
+  auto duplicate_add_future(add(*node_.managed_connections(), nodes_[1]->node_id(),
+                                peer_result.second, node_.validation_data()));
+  ASSERT_EQ(std::future_status::ready, duplicate_add_future.wait_for(std::chrono::seconds(0)));
+  EXPECT_EQ(kConnectionAlreadyExists, duplicate_add_future.get());
+}
+
+TEST_F(ManagedConnectionsTest, BEH_API_GetAvailableEndpointsAndAddPeers) {
+  const int kPeerCount(4);
+  ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, kPeerCount + 1));
+  NodeId chosen_node;
+  ASSERT_EQ(kSuccess,
+            node_.Bootstrap(std::vector<Endpoint>(1, bootstrap_endpoints_[0]), chosen_node));
+  Sleep(boost::posix_time::milliseconds(250));
+
+  typedef std::map<NodeId, std::pair<int, EndpointPair>> AvailableResults;
+  auto get_available([](ManagedConnections& managed_connections, const PeerEndpointPairs& peers) {
+    auto promise(std::make_shared<std::promise<AvailableResults>>());
+    managed_connections.GetAvailableEndpoints(
+        peers,
+        [promise](const AvailableResults& results, NatType) { promise->set_value(results); });
+    return promise->get_future();
+  });
+
+  // An empty batch completes immediately.
+  auto empty_future(get_available(*node_.managed_connections(), PeerEndpointPairs()));
+  ASSERT_EQ(std::future_status::ready, empty_future.wait_for(std::chrono::seconds(0)));
+  EXPECT_TRUE(empty_future.get().empty());
+
+  // Duplicated peers and this node's own ID are each reported once.
+  PeerEndpointPairs this_requests;
+  for (int i(1); i <= kPeerCount; ++i)
+    this_requests.push_back(std::make_pair(nodes_[i]->node_id(), EndpointPair()));
+  this_requests.push_back(this_requests.front());
+  this_requests.push_back(std::make_pair(node_.node_id(), EndpointPair()));
+  auto this_future(get_available(*node_.managed_connections(), this_requests));
+  ASSERT_EQ(std::future_status::ready, this_future.wait_for(rendezvous_connect_timeout));
+  AvailableResults this_results(this_future.get());
+  ASSERT_EQ(kPeerCount + 1, static_cast<int>(this_results.size()));
+  EXPECT_EQ(kOwnId, this_results[node_.node_id()].first);
+
+  PeerEndpointPairs this_adds;
+  std::vector<std::future<int>> peer_add_futures;
+  for (int i(1); i <= kPeerCount; ++i) {
+    auto this_result(this_results[nodes_[i]->node_id()]);
+    ASSERT_EQ(kSuccess, this_result.first);
+    EXPECT_TRUE(detail::IsValid(this_result.second.local));
+    EndpointPair peer_endpoint_pair;
+    NatType nat_type;
+    ASSERT_EQ(kSuccess,
+              nodes_[i]->managed_connections()->GetAvailableEndpoint(
+                  node_.node_id(), this_result.second, peer_endpoint_pair, nat_type));
+    this_adds.push_back(std::make_pair(nodes_[i]->node_id(), peer_endpoint_pair));
+    auto promise(std::make_shared<std::promise<int>>());
+    peer_add_futures.push_back(promise->get_future());
+    nodes_[i]->managed_connections()->Add(node_.node_id(), this_result.second,
+                                          nodes_[i]->validation_data(),
+                                          [promise](int result) { promise->set_value(result); });
+  }
+
+  // All of the connections are made concurrently and reported together.
+  auto add_promise(std::make_shared<std::promise<std::map<NodeId, int>>>());
+  auto add_future(add_promise->get_future());
+  node_.managed_connections()->Add(this_adds, node_.validation_data(),
+                                   [add_promise](const std::map<NodeId, int>& results) {
+                                     add_promise->set_value(results);
+                                   });
+  ASSERT_EQ(std::future_status::ready, add_future.wait_for(rendezvous_connect_timeout));
+  std::map<NodeId, int> add_results(add_future.get());
+  ASSERT_EQ(kPeerCount, static_cast<int>(add_results.size()));
+  for (const auto& add_result : add_results)
+    EXPECT_EQ(kSuccess, add_result.second);
+  for (auto& peer_add_future : peer_add_futures) {
+    ASSERT_EQ(std::future_status::ready, peer_add_future.wait_for(rendezvous_connect_timeout));
+    EXPECT_EQ(kSuccess, peer_add_future.get());
+  }
+
+  // Asking again reports the existing (as yet unvalidated) connections without waiting.
+  this_requests.pop_back();
+  auto again_future(get_available(*node_.managed_connections(), this_requests));
+  ASSERT_EQ(std::future_status::ready, again_future.wait_for(std::chrono::seconds(0)));
+  for (const auto& result : again_future.get())
+    EXPECT_EQ(kUnvalidatedConnectionAlreadyExists, result.second.first);
+}
+
+TEST_F(ManagedConnectionsTest, BEH_API_AddRacesEndpoints) {
+  ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, 2));
+  NodeId chosen_node;
+  ASSERT_EQ(kSuccess,
+            node_.Bootstrap(std::vector<Endpoint>(1, bootstrap_endpoints_[0]), chosen_node));
+  Sleep(boost::posix_time::milliseconds(250));
+
+  EndpointPair this_endpoint_pair, peer_endpoint_pair;
+  NatType nat_type(NatType::kUnknown);
+  EXPECT_EQ(kSuccess,
+            node_.managed_connections()->GetAvailableEndpoint(nodes_[1]->node_id(),
+                                                              EndpointPair(),
+                                                              this_endpoint_pair,
+                                                              nat_type));
+  EXPECT_EQ(kSuccess,
+            nodes_[1]->managed_connections()->GetAvailableEndpoint(node_.node_id(),
+                                                                   this_endpoint_pair,
+                                                                   peer_endpoint_pair,
+                                                                   nat_type));
+  // Neither external endpoint is reachable, so the connection must be made via the local ones
+  // without first waiting for the external attempts to time out.
+  this_endpoint_pair.external =
+      Endpoint(boost::asio::ip::address::from_string("192.0.2.1"), this_endpoint_pair.local.port());
+  peer_endpoint_pair.external =
+      Endpoint(boost::asio::ip::address::from_string("192.0.2.1"), peer_endpoint_pair.local.port());
+
+  nodes_[1]->ResetData();
+  auto peer_futures(nodes_[1]->GetFutureForMessages(1));
+  auto this_node_futures(node_.GetFutureForMessages(1));
+  EXPECT_EQ(kSuccess, nodes_[1]->managed_connections()->Add(node_.node_id(),
+                                                            this_endpoint_pair,
+                                                            nodes_[1]->validation_data()));
+  EXPECT_EQ(kSuccess, node_.managed_connections()->Add(nodes_[1]->node_id(),
+                                                       peer_endpoint_pair,
+                                                       node_.validation_data()));
+  std::chrono::milliseconds race_timeout(rendezvous_connect_timeout / 2);
+  ASSERT_EQ(std::future_status::ready, peer_futures.wait_for(race_timeout));
+  ASSERT_EQ(std::future_status::ready, this_node_futures.wait_for(race_timeout));
+  EXPECT_EQ(node_.validation_data(), peer_futures.get().at(0));
+  EXPECT_EQ(nodes_[1]->validation_data(), this_node_futures.get().at(0));
+
+  // The losing attempts mustn't be reported as lost connections.
+  Sleep(Parameters::rendezvous_connect_timeout);
+  EXPECT_TRUE(node_.connection_lost_node_ids().empty());
+  EXPECT_TRUE(nodes_[1]->connection_lost_node_ids().empty());
+}
+
 void DispatchHandler(const boost::system::error_code& ec,
                      std::shared_ptr<detail::Multiplexer> muxer) {
   if (!ec)
@@ -756,6 +1010,388 @@ TEST_F(ManagedConnectionsTest, BEH_API_SimpleSend) {
 }
 
 
+TEST_F(ManagedConnectionsTest, BEH_API_SendDatagram) {
+  ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, 2));
+
+  int result_of_send(kSuccess);
+  int result_arrived_count(0);
+  std::condition_variable cond_var;
+  std::mutex mutex;
+  std::unique_lock<std::mutex> lock(mutex);
+  MessageSentFunctor message_sent_functor([&](int result_in) {
+    std::lock_guard<std::mutex> lock(mutex);
+    result_of_send = result_in;
+    ++result_arrived_count;
+    cond_var.notify_one();
+  });
+  auto wait_for_result([&](int count) {
+    return cond_var.wait_for(lock,
+                             std::chrono::seconds(60),
+                             [&]() { return result_arrived_count == count; });  // NOLINT (Fraser)
+  });
+
+  NodeId chosen_node;
+  EXPECT_EQ(kSuccess,
+            node_.Bootstrap(std::vector<Endpoint>(1, bootstrap_endpoints_[0]), chosen_node));
+  ASSERT_EQ(nodes_[0]->node_id(), chosen_node);
+  for (unsigned count(0);
+       nodes_[0]->managed_connections()->GetActiveConnectionCount() < 2 && count < 10;
+       ++count)
+    Sleep(bptime::milliseconds(100));
+  EXPECT_EQ(nodes_[0]->managed_connections()->GetActiveConnectionCount(), 2);
+
+  EndpointPair this_endpoint_pair, peer_endpoint_pair;
+  NatType nat_type;
+  EXPECT_EQ(kSuccess,
+            node_.managed_connections()->GetAvailableEndpoint(nodes_[1]->node_id(),
+                                                              EndpointPair(),
+                                                              this_endpoint_pair,
+                                                              nat_type));
+  EXPECT_EQ(kSuccess,
+            nodes_[1]->managed_connections()->GetAvailableEndpoint(node_.node_id(),
+                                                                   this_endpoint_pair,
+                                                                   peer_endpoint_pair,
+                                                                   nat_type));
+  EXPECT_TRUE(detail::IsValid(this_endpoint_pair.local));
+  EXPECT_TRUE(detail::IsValid(peer_endpoint_pair.local));
+
+  auto peer_futures(nodes_[1]->GetFutureForMessages(1));
+  auto this_node_futures(node_.GetFutureForMessages(1));
+  EXPECT_EQ(kSuccess,
+            nodes_[1]->managed_connections()->Add(node_.node_id(),
+                                                  this_endpoint_pair,
+                                                  nodes_[1]->validation_data()));
+  EXPECT_EQ(kSuccess,
+            node_.managed_connections()->Add(nodes_[1]->node_id(),
+                                             peer_endpoint_pair,
+                                             node_.validation_data()));
+  ASSERT_EQ(std::future_status::ready, peer_futures.wait_for(rendezvous_connect_timeout));
+  auto peer_messages(peer_futures.get());
+  ASSERT_EQ(std::future_status::ready, this_node_futures.wait_for(rendezvous_connect_timeout));
+  auto this_node_messages(this_node_futures.get());
+  ASSERT_EQ(1U, peer_messages.size());
+  ASSERT_EQ(1U, this_node_messages.size());
+  EXPECT_EQ(node_.validation_data(), peer_messages[0]);
+  EXPECT_EQ(nodes_[1]->validation_data(), this_node_messages[0]);
+
+  node_.ResetData();
+  nodes_[1]->ResetData();
+
+  // A datagram which fits in a single packet is delivered
+  peer_futures = nodes_[1]->GetFutureForMessages(1);
+  const std::string kMessage(RandomAlphaNumericString(256));
+  node_.managed_connections()->SendDatagram(nodes_[1]->node_id(), kMessage, message_sent_functor);
+  ASSERT_TRUE(wait_for_result(1));
+  EXPECT_EQ(kSuccess, result_of_send);
+  ASSERT_EQ(std::future_status::ready, peer_futures.wait_for(std::chrono::seconds(10)));
+  peer_messages = peer_futures.get();
+  ASSERT_EQ(1U, peer_messages.size());
+  EXPECT_EQ(kMessage, peer_messages[0]);
+
+  // A datagram which doesn't fit in a single packet is rejected
+  node_.managed_connections()->SendDatagram(nodes_[1]->node_id(),
+                                            RandomAlphaNumericString(Parameters::max_data_size + 1),
+                                            message_sent_functor);
+  ASSERT_TRUE(wait_for_result(2));
+  EXPECT_EQ(kMessageTooLarge, result_of_send);
+
+  // Sending to an unconnected peer fails
+  node_.managed_connections()->SendDatagram(NodeId(NodeId::kRandomId), kMessage,
+                                            message_sent_functor);
+  ASSERT_TRUE(wait_for_result(3));
+  EXPECT_EQ(kInvalidConnection, result_of_send);
+}
+
+TEST_F(ManagedConnectionsTest, BEH_API_GetConnectionStats) {
+  ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, 2));
+  ManagedConnections& sender(*nodes_[0]->managed_connections());
+  ManagedConnections& receiver(*nodes_[1]->managed_connections());
+
+  ConnectionStats stats;
+  EXPECT_EQ(kInvalidConnection, sender.GetConnectionStats(NodeId(NodeId::kRandomId), stats));
+  EXPECT_EQ(0U, stats.packets_sent);
+
+  ConnectionStats sender_before, receiver_before;
+  ASSERT_EQ(kSuccess, sender.GetConnectionStats(nodes_[1]->node_id(), sender_before));
+  ASSERT_EQ(kSuccess, receiver.GetConnectionStats(nodes_[0]->node_id(), receiver_before));
+
+  int result_of_send(kConnectError), result_of_get_stats(kConnectError);
+  std::promise<void> sent;
+  auto sent_future(sent.get_future());
+  const std::string kMessage(RandomAlphaNumericString(256 * 1024));
+  auto peer_futures(nodes_[1]->GetFutureForMessages(1));
+  sender.Send(nodes_[1]->node_id(), kMessage, [&](int result_in) {
+    result_of_send = result_in;
+    // Stats must be available from within a functor run by the transport's io_service.
+    ConnectionStats stats_in_functor;
+    result_of_get_stats = sender.GetConnectionStats(nodes_[1]->node_id(), stats_in_functor);
+    sent.set_value();
+  });
+  ASSERT_EQ(std::future_status::ready, sent_future.wait_for(std::chrono::seconds(60)));
+  EXPECT_EQ(kSuccess, result_of_send);
+  EXPECT_EQ(kSuccess, result_of_get_stats);
+  ASSERT_EQ(std::future_status::ready, peer_futures.wait_for(std::chrono::seconds(10)));
+  // Stats are snapshotted as each socket ticks or receives a packet, so let the final acks land.
+  Sleep(Parameters::ack_interval * 3);
+
+  ASSERT_EQ(kSuccess, sender.GetConnectionStats(nodes_[1]->node_id(), stats));
+  EXPECT_TRUE(detail::IsValid(stats.peer_endpoint));
+  EXPECT_LT(sender_before.bytes_sent + kMessage.size(), stats.bytes_sent);
+  EXPECT_LT(sender_before.packets_sent, stats.packets_sent);
+  EXPECT_LE(stats.packets_retransmitted, stats.packets_sent);
+  EXPECT_LE(stats.bytes_retransmitted, stats.bytes_sent);
+  EXPECT_NE(0U, stats.send_window_size);
+  EXPECT_NE(0U, stats.send_data_size);
+  EXPECT_EQ(0U, stats.send_queue_messages);
+  EXPECT_EQ(0U, stats.send_queue_bytes);
+
+  ASSERT_EQ(kSuccess, receiver.GetConnectionStats(nodes_[0]->node_id(), stats));
+  EXPECT_TRUE(detail::IsValid(stats.peer_endpoint));
+  EXPECT_LE(receiver_before.bytes_received + kMessage.size(), stats.bytes_received);
+  EXPECT_LT(receiver_before.packets_received, stats.packets_received);
+  EXPECT_NE(0U, stats.receive_window_size);
+
+  auto all_stats(sender.GetConnectionStats());
+  EXPECT_EQ(sender.GetActiveConnectionCount(), all_stats.size());
+  EXPECT_EQ(1U, all_stats.count(nodes_[1]->node_id()));
+}
+
+TEST_F(ManagedConnectionsTest, BEH_API_SendUnordered) {
+  ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, 2));
+
+  int result_of_send(kSuccess);
+  int result_arrived_count(0);
+  std::condition_variable cond_var;
+  std::mutex mutex;
+  std::unique_lock<std::mutex> lock(mutex);
+  MessageSentFunctor message_sent_functor([&](int result_in) {
+    std::lock_guard<std::mutex> lock(mutex);
+    result_of_send = result_in;
+    ++result_arrived_count;
+    cond_var.notify_one();
+  });
+  auto wait_for_result([&](int count) {
+    return cond_var.wait_for(lock,
+                             std::chrono::seconds(60),
+                             [&]() { return result_arrived_count == count; });  // NOLINT (Fraser)
+  });
+
+  NodeId chosen_node;
+  EXPECT_EQ(kSuccess,
+            node_.Bootstrap(std::vector<Endpoint>(1, bootstrap_endpoints_[0]), chosen_node));
+  ASSERT_EQ(nodes_[0]->node_id(), chosen_node);
+  for (unsigned count(0);
+       nodes_[0]->managed_connections()->GetActiveConnectionCount() < 2 && count < 10;
+       ++count)
+    Sleep(bptime::milliseconds(100));
+  EXPECT_EQ(nodes_[0]->managed_connections()->GetActiveConnectionCount(), 2);
+
+  EndpointPair this_endpoint_pair, peer_endpoint_pair;
+  NatType nat_type;
+  EXPECT_EQ(kSuccess,
+            node_.managed_connections()->GetAvailableEndpoint(nodes_[1]->node_id(),
+                                                              EndpointPair(),
+                                                              this_endpoint_pair,
+                                                              nat_type));
+  EXPECT_EQ(kSuccess,
+            nodes_[1]->managed_connections()->GetAvailableEndpoint(node_.node_id(),
+                                                                   this_endpoint_pair,
+                                                                   peer_endpoint_pair,
+                                                                   nat_type));
+  EXPECT_TRUE(detail::IsValid(this_endpoint_pair.local));
+  EXPECT_TRUE(detail::IsValid(peer_endpoint_pair.local));
+
+  auto peer_futures(nodes_[1]->GetFutureForMessages(1));
+  auto this_node_futures(node_.GetFutureForMessages(1));
+  EXPECT_EQ(kSuccess,
+            nodes_[1]->managed_connections()->Add(node_.node_id(),
+                                                  this_endpoint_pair,
+                                                  nodes_[1]->validation_data()));
+  EXPECT_EQ(kSuccess,
+            node_.managed_connections()->Add(nodes_[1]->node_id(),
+                                             peer_endpoint_pair,
+                                             node_.validation_data()));
+  ASSERT_EQ(std::future_status::ready, peer_futures.wait_for(rendezvous_connect_timeout));
+  auto peer_messages(peer_futures.get());
+  ASSERT_EQ(std::future_status::ready, this_node_futures.wait_for(rendezvous_connect_timeout));
+  auto this_node_messages(this_node_futures.get());
+  ASSERT_EQ(1U, peer_messages.size());
+  ASSERT_EQ(1U, this_node_messages.size());
+  EXPECT_EQ(node_.validation_data(), peer_messages[0]);
+  EXPECT_EQ(nodes_[1]->validation_data(), this_node_messages[0]);
+
+  node_.ResetData();
+  nodes_[1]->ResetData();
+
+  // Unordered messages, both single- and multi-packet, are all delivered, though not necessarily in
+  // the order they were sent
+  const int kMessageCount(10);
+  SendOptions options;
+  options.in_order = false;
+  std::vector<std::string> sent_messages;
+  peer_futures = nodes_[1]->GetFutureForMessages(kMessageCount);
+  for (int i(0); i != kMessageCount; ++i) {
+    sent_messages.push_back(RandomAlphaNumericString(i % 2 ? 256 : 10 * 1024));
+    node_.managed_connections()->Send(nodes_[1]->node_id(), sent_messages.back(),
+                                      message_sent_functor, options);
+  }
+  ASSERT_TRUE(wait_for_result(kMessageCount));
+  EXPECT_EQ(kSuccess, result_of_send);
+  ASSERT_EQ(std::future_status::ready, peer_futures.wait_for(std::chrono::seconds(10)));
+  peer_messages = peer_futures.get();
+  ASSERT_EQ(sent_messages.size(), peer_messages.size());
+  std::sort(sent_messages.begin(), sent_messages.end());
+  std::sort(peer_messages.begin(), peer_messages.end());
+  EXPECT_TRUE(sent_messages == peer_messages);
+
+  // An in-order message sent after them is still delivered
+  nodes_[1]->ResetData();
+  peer_futures = nodes_[1]->GetFutureForMessages(1);
+  const std::string kMessage(RandomAlphaNumericString(256));
+  node_.managed_connections()->Send(nodes_[1]->node_id(), kMessage, message_sent_functor);
+  ASSERT_TRUE(wait_for_result(kMessageCount + 1));
+  EXPECT_EQ(kSuccess, result_of_send);
+  ASSERT_EQ(std::future_status::ready, peer_futures.wait_for(std::chrono::seconds(10)));
+  peer_messages = peer_futures.get();
+  ASSERT_EQ(1U, peer_messages.size());
+  EXPECT_EQ(kMessage, peer_messages[0]);
+}
+
+TEST_F(ManagedConnectionsTest, BEH_API_SendOnStreams) {
+  ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, 2));
+
+  int result_of_send(kSuccess);
+  int result_arrived_count(0);
+  std::condition_variable cond_var;
+  std::mutex mutex;
+  std::unique_lock<std::mutex> lock(mutex);
+  MessageSentFunctor message_sent_functor([&](int result_in) {
+    std::lock_guard<std::mutex> lock(mutex);
+    result_of_send = result_in;
+    ++result_arrived_count;
+    cond_var.notify_one();
+  });
+  auto wait_for_result([&](int count) {
+    return cond_var.wait_for(lock,
+                             std::chrono::seconds(60),
+                             [&]() { return result_arrived_count == count; });  // NOLINT (Fraser)
+  });
+
+  NodeId chosen_node;
+  EXPECT_EQ(kSuccess,
+            node_.Bootstrap(std::vector<Endpoint>(1, bootstrap_endpoints_[0]), chosen_node));
+  ASSERT_EQ(nodes_[0]->node_id(), chosen_node);
+  for (unsigned count(0);
+       nodes_[0]->managed_connections()->GetActiveConnectionCount() < 2 && count < 10;
+       ++count)
+    Sleep(bptime::milliseconds(100));
+  EXPECT_EQ(nodes_[0]->managed_connections()->GetActiveConnectionCount(), 2);
+
+  EndpointPair this_endpoint_pair, peer_endpoint_pair;
+  NatType nat_type;
+  EXPECT_EQ(kSuccess,
+            node_.managed_connections()->GetAvailableEndpoint(nodes_[1]->node_id(),
+                                                              EndpointPair(),
+                                                              this_endpoint_pair,
+                                                              nat_type));
+  EXPECT_EQ(kSuccess,
+            nodes_[1]->managed_connections()->GetAvailableEndpoint(node_.node_id(),
+                                                                   this_endpoint_pair,
+                                                                   peer_endpoint_pair,
+                                                                   nat_type));
+  EXPECT_TRUE(detail::IsValid(this_endpoint_pair.local));
+  EXPECT_TRUE(detail::IsValid(peer_endpoint_pair.local));
+
+  auto peer_futures(nodes_[1]->GetFutureForMessages(1));
+  auto this_node_futures(node_.GetFutureForMessages(1));
+  EXPECT_EQ(kSuccess,
+            nodes_[1]->managed_connections()->Add(node_.node_id(),
+                                                  this_endpoint_pair,
+                                                  nodes_[1]->validation_data()));
+  EXPECT_EQ(kSuccess,
+            node_.managed_connections()->Add(nodes_[1]->node_id(),
+                                             peer_endpoint_pair,
+                                             node_.validation_data()));
+  ASSERT_EQ(std::future_status::ready, peer_futures.wait_for(rendezvous_connect_timeout));
+  auto peer_messages(peer_futures.get());
+  ASSERT_EQ(std::future_status::ready, this_node_futures.wait_for(rendezvous_connect_timeout));
+  auto this_node_messages(this_node_futures.get());
+  ASSERT_EQ(1U, peer_messages.size());
+  ASSERT_EQ(1U, this_node_messages.size());
+  EXPECT_EQ(node_.validation_data(), peer_messages[0]);
+  EXPECT_EQ(nodes_[1]->validation_data(), this_node_messages[0]);
+
+  node_.ResetData();
+  nodes_[1]->ResetData();
+
+  // A bulk message on one stream and a series of small messages on another are all delivered, with
+  // the small messages in the order they were sent
+  const int kControlMessageCount(10);
+  SendOptions bulk_options, control_options;
+  bulk_options.stream_id = 1;
+  control_options.stream_id = 2;
+  const std::string kBulkMessage(RandomAlphaNumericString(1024 * 1024));
+  std::vector<std::string> control_messages;
+  peer_futures = nodes_[1]->GetFutureForMessages(kControlMessageCount + 1);
+  node_.managed_connections()->Send(nodes_[1]->node_id(), kBulkMessage, message_sent_functor,
+                                    bulk_options);
+  for (int i(0); i != kControlMessageCount; ++i) {
+    control_messages.push_back(RandomAlphaNumericString(256));
+    node_.managed_connections()->Send(nodes_[1]->node_id(), control_messages.back(),
+                                      message_sent_functor, control_options);
+  }
+  ASSERT_TRUE(wait_for_result(kControlMessageCount + 1));
+  EXPECT_EQ(kSuccess, result_of_send);
+  ASSERT_EQ(std::future_status::ready, peer_futures.wait_for(std::chrono::seconds(20)));
+  peer_messages = peer_futures.get();
+  ASSERT_EQ(kControlMessageCount + 1U, peer_messages.size());
+  auto bulk_itr(std::find(peer_messages.begin(), peer_messages.end(), kBulkMessage));
+  ASSERT_TRUE(bulk_itr != peer_messages.end());
+  peer_messages.erase(bulk_itr);
+  EXPECT_TRUE(control_messages == peer_messages);
+}
+
+TEST_F(ManagedConnectionsTest, BEH_API_StreamFlowControl) {
+  // With a window of two messages per stream, the sender has to wait for credit from the peer many
+  // times over.  Messages on each stream must still all arrive, in the order they were sent.
+  const uint32_t kDefaultStreamWindowSize(Parameters::stream_window_size);
+  Parameters::stream_window_size = 2;
+  ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, 2));
+
+  std::atomic<int> success_count(0), failure_count(0);
+  MessageSentFunctor message_sent_functor([&](int result_in) {
+    ++(result_in == kSuccess ? success_count : failure_count);
+  });
+
+  const int kMessageCount(40);
+  std::vector<std::string> stream1_messages, stream2_messages;
+  SendOptions stream1_options, stream2_options;
+  stream1_options.stream_id = 1;
+  stream2_options.stream_id = 2;
+  auto peer_futures(nodes_[1]->GetFutureForMessages(2 * kMessageCount));
+  for (int i(0); i != kMessageCount; ++i) {
+    stream1_messages.push_back("1:" + RandomAlphaNumericString(256));
+    nodes_[0]->managed_connections()->Send(nodes_[1]->node_id(), stream1_messages.back(),
+                                           message_sent_functor, stream1_options);
+    stream2_messages.push_back("2:" + RandomAlphaNumericString(256));
+    nodes_[0]->managed_connections()->Send(nodes_[1]->node_id(), stream2_messages.back(),
+                                           message_sent_functor, stream2_options);
+  }
+  ASSERT_EQ(std::future_status::ready, peer_futures.wait_for(std::chrono::seconds(20)));
+  auto peer_messages(peer_futures.get());
+  ASSERT_EQ(2U * kMessageCount, peer_messages.size());
+  std::vector<std::string> received1, received2;
+  for (const auto& message : peer_messages)
+    (message[0] == '1' ? received1 : received2).push_back(message);
+  EXPECT_TRUE(stream1_messages == received1);
+  EXPECT_TRUE(stream2_messages == received2);
+  for (int count(0); success_count != 2 * kMessageCount && count != 50; ++count)
+    Sleep(bptime::milliseconds(100));
+  EXPECT_EQ(2 * kMessageCount, success_count);
+  EXPECT_EQ(0, failure_count);
+  Parameters::stream_window_size = kDefaultStreamWindowSize;
+}
+
 TEST_F(ManagedConnectionsTest, BEH_API_ManyTimesSimpleSend) {
   ASSERT_TRUE(SetupNetwork(nodes_, bootstrap_endpoints_, 2));
 
@@ -1211,11 +1847,11 @@ TEST_F(ManagedConnectionsTest, FUNC_API_ParallelReceive) {
   // Perform sends
   std::vector<boost::thread> threads(kNetworkSize);
   for (int i(0); i != kNetworkSize - 1; ++i) {
-    threads[i] = boost::thread(&ManagedConnections::Send,
-                               nodes_[i]->managed_connections().get(),
-                               node_.node_id(),
-                               sent_messages[i],
-                               message_sent_functors[i]);
+    threads[i] = boost::thread([&, i] {
+                                 nodes_[i]->managed_connections()->Send(node_.node_id(),
+                                                                        sent_messages[i],
+                                                                        message_sent_functors[i]);
+                               });
   }
   for (boost::thread& thread : threads)
     thread.join();
@@ -0,0 +1,576 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+// Microbenchmarks for the hot paths of the protocol: packet encoding and decoding, the sliding
+// window, NAK lookups, ACK generation, per-packet processing by Sender and Receiver, and the cost
+// to a bootstrap node of a flood of unsolicited connection requests.  Each
+// benchmark is repeated until it has run for at least half a second, and the time per iteration is
+// reported.  Pass a substring of benchmark names as the first argument to run a subset.
+//
+// Forward error correction is also run over emulated links which lose packets at random, reporting
+// how many losses it repairs and at what cost in repair packets.  The loss rates can be given as a
+// comma-separated second argument, e.g. "rudp_microbenchmarks Fec 0.01,0.1".
+
+#ifdef MAIDSAFE_WIN32
+#  include <windows.h>
+#  include <psapi.h>
+#  ifdef _MSC_VER
+#    pragma comment(lib, "psapi.lib")
+#  endif
+#else
+#  include <sys/resource.h>
+#  include <sys/time.h>
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/io_service.hpp"
+
+#include "maidsafe/common/rsa.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/rudp/connection_manager.h"
+#include "maidsafe/rudp/core/congestion_control.h"
+#include "maidsafe/rudp/core/fec.h"
+#include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/network_emulator.h"
+#include "maidsafe/rudp/core/peer.h"
+#include "maidsafe/rudp/core/receiver.h"
+#include "maidsafe/rudp/core/sender.h"
+#include "maidsafe/rudp/core/session.h"
+#include "maidsafe/rudp/core/sliding_window.h"
+#include "maidsafe/rudp/core/tick_timer.h"
+#include "maidsafe/rudp/packets/ack_of_ack_packet.h"
+#include "maidsafe/rudp/packets/ack_packet.h"
+#include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/packets/datagram_packet.h"
+#include "maidsafe/rudp/packets/fec_packet.h"
+#include "maidsafe/rudp/packets/handshake_packet.h"
+#include "maidsafe/rudp/packets/keepalive_packet.h"
+#include "maidsafe/rudp/packets/message_drop_packet.h"
+#include "maidsafe/rudp/packets/mtu_probe_packet.h"
+#include "maidsafe/rudp/packets/negative_ack_packet.h"
+#include "maidsafe/rudp/packets/shutdown_packet.h"
+#include "maidsafe/rudp/parameters.h"
+
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+// Results are accumulated here so that the compiler can't discard the work being measured.
+volatile uint64_t g_sink(0);
+
+std::string g_filter;
+
+// Runs "operation", which performs "batch_size" iterations per call, until at least half a second
+// has passed.  If "bytes_per_iteration" is non-zero, a throughput is reported too.
+template <typename Operation>
+void Benchmark(const std::string& name, size_t batch_size, size_t bytes_per_iteration,
+               Operation operation) {
+  if (name.find(g_filter) == std::string::npos)
+    return;
+  const std::chrono::milliseconds kMinimumDuration(500);
+  operation();  // Warm up
+  uint64_t iterations(0);
+  size_t calls(1);
+  auto start(std::chrono::steady_clock::now());
+  std::chrono::steady_clock::duration elapsed;
+  for (;;) {
+    for (size_t i(0); i != calls; ++i)
+      operation();
+    iterations += calls * batch_size;
+    elapsed = std::chrono::steady_clock::now() - start;
+    if (elapsed >= kMinimumDuration)
+      break;
+    calls *= 2;
+  }
+  double nanoseconds(
+      static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+  std::cout << std::left << std::setw(44) << name << std::right << std::setw(12) << iterations
+            << std::setw(12) << std::fixed << std::setprecision(1) << nanoseconds / iterations
+            << " ns";
+  if (bytes_per_iteration != 0) {
+    std::cout << std::setw(12) << std::setprecision(1)
+              << bytes_per_iteration * iterations * 1000.0 / nanoseconds << " MB/s";
+  }
+  std::cout << '\n';
+}
+
+// Total user and system CPU time used by this process.
+double CpuSeconds() {
+#ifdef MAIDSAFE_WIN32
+  FILETIME creation, exit, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    return 0.0;
+  auto to_seconds([](const FILETIME& time) {
+    return ((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7;
+  });
+  return to_seconds(kernel) + to_seconds(user);
+#else
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0.0;
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+// The largest resident set size of this process so far.
+uint64_t PeakRssKilobytes() {
+#ifdef MAIDSAFE_WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize / 1024;
+#else
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#  ifdef __APPLE__
+  return usage.ru_maxrss / 1024;  // Bytes on OS X
+#  else
+  return usage.ru_maxrss;
+#  endif
+#endif
+}
+
+template <typename Packet>
+void BenchmarkPacket(const std::string& name, const Packet& packet) {
+  std::vector<unsigned char> buffer(Parameters::kUDPPayload);
+  size_t length(packet.Encode(asio::buffer(buffer)));
+  if (length == 0) {
+    std::cout << name << " failed to encode\n";
+    return;
+  }
+  Benchmark(name + "::Encode", 1, length, [&] {
+    g_sink += packet.Encode(asio::buffer(buffer));
+  });
+  Benchmark(name + "::Decode", 1, length, [&] {
+    Packet decoded;
+    g_sink += decoded.Decode(asio::buffer(&buffer[0], length));
+  });
+}
+
+void BenchmarkPackets() {
+  const std::string kPayload(RandomString(Parameters::max_data_size));
+  {
+    DataPacket packet;
+    packet.SetPacketSequenceNumber(123456);
+    packet.SetMessageNumber(42);
+    packet.SetFirstPacketInMessage(true);
+    packet.SetInOrder(true);
+    packet.SetData(kPayload);
+    BenchmarkPacket("DataPacket", packet);
+  }
+  {
+    AckPacket packet;
+    packet.SetAckSequenceNumber(1);
+    packet.SetPacketSequenceNumber(123456);
+    BenchmarkPacket("AckPacket", packet);
+    packet.SetHasOptionalFields(true);
+    packet.SetRoundTripTime(10000);
+    packet.SetRoundTripTimeVariance(1000);
+    packet.SetAvailableBufferSize(16);
+    packet.SetPacketsReceivingRate(1000);
+    packet.SetEstimatedLinkCapacity(10000);
+    BenchmarkPacket("AckPacket(optional fields)", packet);
+  }
+  {
+    AckOfAckPacket packet;
+    packet.SetAckSequenceNumber(1);
+    BenchmarkPacket("AckOfAckPacket", packet);
+  }
+  {
+    NegativeAckPacket packet;
+    for (uint32_t n(0); n != 32; ++n)
+      packet.AddSequenceNumber(1000 + n * 3);
+    BenchmarkPacket("NegativeAckPacket", packet);
+  }
+  {
+    KeepalivePacket packet;
+    packet.SetSequenceNumber(1);
+    BenchmarkPacket("KeepalivePacket", packet);
+  }
+  {
+    ShutdownPacket packet;
+    BenchmarkPacket("ShutdownPacket", packet);
+  }
+  {
+    MtuProbePacket packet;
+    packet.SetSequenceNumber(1);
+    packet.SetProbeSize(1400);
+    BenchmarkPacket("MtuProbePacket", packet);
+  }
+  {
+    DatagramPacket packet;
+    packet.SetSequenceNumber(1);
+    packet.SetData(kPayload.substr(0, 100));
+    BenchmarkPacket("DatagramPacket", packet);
+  }
+  {
+    MessageDropPacket packet;
+    packet.SetFirstSequenceNumber(100);
+    packet.SetLastSequenceNumber(200);
+    BenchmarkPacket("MessageDropPacket", packet);
+  }
+  {
+    FecPacket packet;
+    packet.SetFirstSequenceNumber(128);
+    packet.SetBlockSize(8);
+    packet.SetPayloadXor(kPayload.substr(0, Parameters::max_data_size - FecPacket::kOverhead));
+    BenchmarkPacket("FecPacket", packet);
+  }
+  {
+    HandshakePacket packet;
+    packet.SetRudpVersion(HandshakePacket::kRudpVersion);
+    packet.SetSocketType(1);
+    packet.SetInitialPacketSequenceNumber(123456);
+    packet.SetMaximumPacketSize(Parameters::max_size);
+    packet.SetMaximumFlowWindowSize(Parameters::default_window_size);
+    packet.SetConnectionType(1);
+    packet.SetSocketId(1);
+    packet.set_node_id(NodeId(NodeId::kRandomId));
+    packet.SetPeerEndpoint(ip::udp::endpoint(ip::address_v4::loopback(), 5483));
+    BenchmarkPacket("HandshakePacket", packet);
+    asymm::Keys keys(asymm::GenerateKeyPair());
+    packet.SetPublicKey(std::make_shared<asymm::PublicKey>(keys.public_key));
+    BenchmarkPacket("HandshakePacket(public key)", packet);
+    // The uncached key work, which each handshake used to repeat.
+    Benchmark("asymm::EncodeKey", 1, 0, [&] {
+      g_sink += asymm::EncodeKey(keys.public_key).string().size();
+    });
+    const asymm::EncodedPublicKey kEncodedKey(asymm::EncodeKey(keys.public_key));
+    Benchmark("asymm::DecodeKey+ValidateKey", 1, 0, [&] {
+      g_sink += asymm::ValidateKey(asymm::DecodeKey(kEncodedKey));
+    });
+  }
+}
+
+void BenchmarkSlidingWindow() {
+  const size_t kWindowSize(Parameters::maximum_window_size);
+  SlidingWindow<uint32_t> window(SlidingWindow<uint32_t>::kMaxSequenceNumber - 100);
+  window.SetMaximumSize(kWindowSize);
+  Benchmark("SlidingWindow::Append+Remove", kWindowSize, 0, [&] {
+    for (size_t i(0); i != kWindowSize; ++i)
+      window[window.Append()] = static_cast<uint32_t>(i);
+    while (!window.IsEmpty()) {
+      g_sink += window.Front();
+      window.Remove();
+    }
+  });
+  while (!window.IsFull())
+    window[window.Append()] = 1;
+  Benchmark("SlidingWindow::operator[]", kWindowSize, 0, [&] {
+    uint64_t total(0);
+    for (uint32_t n(window.Begin()); n != window.End(); n = window.Next(n))
+      total += window[n];
+    g_sink += total;
+  });
+}
+
+void BenchmarkNegativeAck() {
+  NegativeAckPacket packet;
+  for (uint32_t n(0); n != 64; ++n) {
+    if (n % 2 == 0)
+      packet.AddSequenceNumber(1000 + n * 10);
+    else
+      packet.AddSequenceNumbers(1000 + n * 10, 1000 + n * 10 + 5);
+  }
+  Benchmark("NegativeAckPacket::ContainsSequenceNumber", 1024, 0, [&] {
+    uint64_t found(0);
+    for (uint32_t n(1000); n != 2024; ++n)
+      found += packet.ContainsSequenceNumber(n);
+    g_sink += found;
+  });
+}
+
+void BenchmarkXorInto() {
+  const std::string kSource(RandomString(Parameters::max_data_size));
+  std::vector<unsigned char> destination(kSource.size());
+  Benchmark(std::string("XorInto(") + XorInstructionSet() + ")", 1, kSource.size(), [&] {
+    XorInto(&destination[0], reinterpret_cast<const unsigned char*>(kSource.data()),
+            kSource.size());
+    g_sink += destination[0];
+  });
+}
+
+DataPacket MakeFecTestPacket(uint32_t sequence_number, size_t max_data_size,
+                             std::mt19937& generator) {
+  DataPacket packet;
+  packet.SetPacketSequenceNumber(sequence_number);
+  packet.SetFirstPacketInMessage(sequence_number % 3 == 0);
+  packet.SetLastPacketInMessage(sequence_number % 3 == 2);
+  packet.SetInOrder(sequence_number % 2 == 0);
+  packet.SetMessageNumber((sequence_number / 3) & 0x1fffffff);
+  std::string data(1 + generator() % max_data_size, '\0');
+  for (auto& c : data)
+    c = static_cast<char>(generator());
+  packet.SetData(data);
+  return packet;
+}
+
+// Sends packets over a link which loses each packet (data or repair) independently, reporting to
+// the encoder only the losses which FEC fails to repair, as the receiver's negative acks would.
+void EmulateFecLoss(const std::vector<double>& loss_rates) {
+  const std::string kName("FecLossEmulation");
+  if (kName.find(g_filter) == std::string::npos)
+    return;
+  const size_t kMaxDataSize(1000);
+  const uint32_t kPacketCount(20000);
+  std::cout << '\n' << std::right << std::setw(12) << "Loss rate" << std::setw(12) << "Lost"
+            << std::setw(12) << "Repaired" << std::setw(12) << "Residual" << std::setw(12)
+            << "Overhead" << '\n';
+  for (double loss_rate : loss_rates) {
+    std::mt19937 generator(5);
+    std::bernoulli_distribution lose(loss_rate);
+    FecEncoder encoder;
+    FecDecoder decoder;
+    FecPacket repair_packet;
+    std::vector<uint32_t> lost_in_block;
+    size_t lost_count(0), recovered_count(0), repair_count(0);
+    for (uint32_t n(0); n != kPacketCount; ++n) {
+      DataPacket packet(MakeFecTestPacket(n, kMaxDataSize, generator));
+      if (lose(generator)) {
+        ++lost_count;
+        lost_in_block.push_back(n);
+      } else {
+        decoder.Add(packet);
+      }
+      bool repair(encoder.Add(packet, kMaxDataSize, repair_packet));
+      bool block_done(repair || encoder.BlockSize() == 0 || (n + 1) % encoder.BlockSize() == 0);
+      if (repair) {
+        ++repair_count;
+        DataPacket recovered_packet;
+        if (!lose(generator) && decoder.Recover(repair_packet, recovered_packet)) {
+          ++recovered_count;
+          decoder.Add(recovered_packet);
+          lost_in_block.pop_back();
+        }
+      }
+      if (block_done) {
+        for (size_t i(0); i != lost_in_block.size(); ++i)
+          encoder.OnPacketLost();
+        lost_in_block.clear();
+      }
+    }
+    std::cout << std::fixed << std::setprecision(1) << std::right << std::setw(11)
+              << 100.0 * loss_rate << '%' << std::setw(12) << lost_count << std::setw(11)
+              << (lost_count == 0 ? 0.0 : 100.0 * recovered_count / lost_count) << '%'
+              << std::setw(11) << 100.0 * (lost_count - recovered_count) / kPacketCount << '%'
+              << std::setw(11) << 100.0 * repair_count / kPacketCount << "%\n";
+  }
+}
+
+std::vector<double> ParseLossRates(const std::string& text) {
+  std::vector<double> loss_rates;
+  std::istringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    double loss_rate(std::stod(item));
+    if (loss_rate >= 0.0 && loss_rate < 1.0)
+      loss_rates.push_back(loss_rate);
+    else
+      std::cout << "Ignoring loss rate " << item << " - must be in [0, 1).\n";
+  }
+  return loss_rates;
+}
+
+void BenchmarkCongestionControl(NetworkEmulator& emulator) {
+  CongestionControl congestion_control;
+  congestion_control.OnOpen(1, 1);
+  uint32_t seqnum(1);
+  Benchmark("CongestionControl::OnGenerateAck", 16, 0, [&] {
+    for (int i(0); i != 16; ++i) {
+      emulator.RunFor(bptime::microseconds(100));
+      congestion_control.OnDataPacketReceived(seqnum);
+      congestion_control.OnGenerateAck(seqnum);
+      seqnum = SlidingWindow<int>::Next(seqnum);
+    }
+  });
+}
+
+// Sender and Receiver send through a Multiplexer backed by the emulator, so that only their own
+// processing is measured.
+void BenchmarkSenderAndReceiver(NetworkEmulator& emulator) {
+  asio::io_service io_service;
+  Multiplexer multiplexer(io_service);
+  multiplexer.UseEmulator(emulator, ip::udp::endpoint(ip::address_v4::loopback(), 1000));
+  Peer peer(multiplexer);
+  peer.SetPeerEndpoint(ip::udp::endpoint(ip::address_v4::loopback(), 2000));
+  peer.SetSocketId(1);
+  TickTimer tick_timer(io_service);
+  const std::string kData(RandomString(Parameters::max_data_size));
+
+  {
+    CongestionControl congestion_control;
+    Sender sender(peer, tick_timer, congestion_control);
+    congestion_control.OnOpen(sender.GetNextPacketSequenceNumber(), 1);
+    const size_t kBatchSize(16);
+    uint32_t message_number(0);
+    Benchmark("Sender::AddPacket+SendPackets+HandleAck", kBatchSize, kData.size(), [&] {
+      for (size_t i(0); i != kBatchSize; ++i) {
+        sender.AddPacket(asio::buffer(kData), message_number++ & 0x1fffffff, true, true,
+                         bptime::pos_infin);
+        sender.SendPackets();
+      }
+      AckPacket ack_packet;
+      ack_packet.SetPacketSequenceNumber(sender.GetNextPacketSequenceNumber());
+      std::vector<uint32_t> completed_message_numbers;
+      sender.HandleAck(ack_packet, completed_message_numbers);
+      g_sink += completed_message_numbers.size();
+      emulator.RunFor(bptime::time_duration());
+    });
+  }
+  {
+    CongestionControl congestion_control;
+    Receiver receiver(peer, tick_timer, congestion_control);
+    uint32_t seqnum(SlidingWindow<int>::kMaxSequenceNumber - 1000);
+    congestion_control.OnOpen(1, seqnum);
+    receiver.Reset(seqnum);
+    DataPacket packet;
+    packet.SetFirstPacketInMessage(true);
+    packet.SetLastPacketInMessage(true);
+    packet.SetInOrder(true);
+    packet.SetData(kData);
+    std::vector<unsigned char> read_buffer(kData.size());
+    std::vector<std::string> unordered_messages;
+    // The receiver's ACKs are answered, as the sender would, so that its window of ACKs drains.
+    AckOfAckPacket ack_of_ack_packet;
+    bool ack_received(false);
+    emulator.Attach(peer.PeerEndpoint(), [&](const asio::const_buffer& data,
+                                             const ip::udp::endpoint& /*sender*/) {
+      AckPacket ack_packet;
+      if (ack_packet.Decode(data)) {
+        ack_of_ack_packet.SetAckSequenceNumber(ack_packet.AckSequenceNumber());
+        ack_received = true;
+      }
+    });
+    const size_t kBatchSize(16);
+    Benchmark("Receiver::HandleData+ReadData", kBatchSize, kData.size(), [&] {
+      for (size_t i(0); i != kBatchSize; ++i) {
+        packet.SetPacketSequenceNumber(seqnum);
+        packet.SetMessageNumber(seqnum & 0x1fffffff);
+        seqnum = SlidingWindow<int>::Next(seqnum);
+        receiver.HandleData(packet, unordered_messages);
+        g_sink += receiver.ReadData(asio::buffer(read_buffer));
+      }
+      emulator.RunFor(bptime::time_duration());
+      if (ack_received) {
+        receiver.HandleAckOfAck(ack_of_ack_packet);
+        ack_received = false;
+      }
+    });
+    emulator.Detach(peer.PeerEndpoint());
+  }
+}
+
+// Each request comes from a different (spoofed) loopback endpoint and never echoes the cookie it is
+// sent, so the time per request and the number of connections allocated should stay flat however
+// long the flood lasts.  The cookies are sent through a real UDP socket, as a bootstrap node's
+// would be.  After the timed run, a fixed flood of kFloodSize requests reports the CPU time used
+// and the growth in peak RSS; run this benchmark alone ("rudp_microbenchmarks unsolicited") so that
+// the peak isn't already set by an earlier one.
+void BenchmarkUnsolicitedHandshakes() {
+  const std::string kName("ConnectionManager::GetSocket(unsolicited)");
+  if (kName.find(g_filter) == std::string::npos)
+    return;
+  asio::io_service io_service;
+  std::shared_ptr<Multiplexer> multiplexer(std::make_shared<Multiplexer>(io_service));
+  if (multiplexer->Open(ip::udp::endpoint(ip::address_v4::loopback(), 0)) != kSuccess) {
+    std::cout << kName << " failed to open a socket\n";
+    return;
+  }
+  asymm::Keys keys(asymm::GenerateKeyPair());
+  ConnectionManager connection_manager(std::shared_ptr<Transport>(),
+                                       asio::io_service::strand(io_service), multiplexer,
+                                       NodeId(NodeId::kRandomId),
+                                       std::make_shared<asymm::PublicKey>(keys.public_key));
+  HandshakePacket packet;
+  packet.SetRudpVersion(HandshakePacket::kRudpVersion);
+  packet.SetSocketType(HandshakePacket::kStreamSocketType);
+  packet.SetSocketId(1);
+  packet.set_node_id(NodeId(NodeId::kRandomId));
+  packet.SetDestinationSocketId(0);
+  packet.SetConnectionType(1);
+  packet.SetConnectionReason(Session::kBootstrapAndKeep);
+  std::vector<unsigned char> buffer(Parameters::kUDPPayload);
+  size_t length(packet.Encode(asio::buffer(buffer)));
+  const size_t kBatchSize(64);
+  uint32_t source(ip::address_v4::from_string("127.0.0.2").to_ulong());
+  auto flood([&] {
+    for (size_t i(0); i != kBatchSize; ++i) {
+      ip::udp::endpoint endpoint(ip::address_v4(source++), 5483);
+      g_sink += connection_manager.GetSocket(asio::buffer(&buffer[0], length), endpoint) != nullptr;
+    }
+  });
+  Benchmark(kName, kBatchSize, 0, flood);
+
+  const size_t kFloodSize(1 << 20);
+  uint64_t rss_before(PeakRssKilobytes());
+  double cpu_before(CpuSeconds());
+  for (size_t i(0); i != kFloodSize / kBatchSize; ++i)
+    flood();
+  double cpu_seconds(CpuSeconds() - cpu_before);
+  std::cout << "  flood of " << kFloodSize << " requests: " << std::fixed << std::setprecision(2)
+            << cpu_seconds << " s CPU (" << std::setprecision(0)
+            << cpu_seconds * 1e9 / kFloodSize << " ns per request), peak RSS " << rss_before
+            << " -> " << PeakRssKilobytes() << " kB, connections allocated: "
+            << connection_manager.NormalConnectionsCount() << '\n';
+}
+
+}  // unnamed namespace
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+int main(int argc, char** argv) {
+  if (argc > 1)
+    maidsafe::rudp::detail::g_filter = argv[1];
+  std::vector<double> loss_rates(
+      maidsafe::rudp::detail::ParseLossRates(argc > 2 ? argv[2] : "0.005,0.02,0.05,0.1"));
+  std::cout << std::left << std::setw(44) << "Benchmark" << std::right << std::setw(12)
+            << "Iterations" << std::setw(15) << "Time" << std::setw(17) << "Throughput\n";
+  maidsafe::rudp::detail::BenchmarkPackets();
+  maidsafe::rudp::detail::BenchmarkSlidingWindow();
+  maidsafe::rudp::detail::BenchmarkNegativeAck();
+  maidsafe::rudp::detail::BenchmarkXorInto();
+  // The emulator provides a virtual clock and a sink for packets sent.
+  maidsafe::rudp::detail::NetworkEmulator emulator(0);
+  maidsafe::rudp::detail::BenchmarkCongestionControl(emulator);
+  maidsafe::rudp::detail::BenchmarkSenderAndReceiver(emulator);
+  maidsafe::rudp::detail::BenchmarkUnsolicitedHandshakes();
+  maidsafe::rudp::detail::EmulateFecLoss(loss_rates);
+  return 0;
+}
@@ -13,116 +13,567 @@ implied. See the License for the specific language governing permissions and lim
 License.
 */
 
+#ifdef MAIDSAFE_WIN32
+#  include <windows.h>
+#  include <psapi.h>
+#  ifdef _MSC_VER
+#    pragma comment(lib, "psapi.lib")
+#  endif
+#else
+#  include <sys/resource.h>
+#  include <sys/time.h>
+#endif
+
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "boost/program_options.hpp"
+
 #include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
 
 #include "maidsafe/rudp/managed_connections.h"
+#include "maidsafe/rudp/parameters.h"
 #include "maidsafe/rudp/return_codes.h"
 #include "maidsafe/rudp/tests/test_utils.h"
 
+namespace po = boost::program_options;
 
 namespace {
 
-bool ParseArgs(int argc, char **argv, int& message_count, int& message_size) {
-  auto fail([]()->bool {
-    std::cout << "Pass no. of messages and size of messages (in bytes) as first 2 arguments.\n";
-    return false;
+// A stream of messages from one node to another.
+typedef std::pair<int, int> Flow;
+
+struct RunResult {
+  RunResult()
+      : scenario(),
+        message_size(0),
+        message_count(0),
+        peer_count(0),
+        failures(0),
+        elapsed_seconds(0.0),
+        cpu_seconds(0.0),
+        peak_rss_kB(0),
+        latencies_ms() {}
+  std::string scenario;
+  int message_size, message_count, peer_count, failures;
+  double elapsed_seconds, cpu_seconds;
+  uint64_t peak_rss_kB;
+  // From calling Send until the message was acknowledged by the receiver, for each message sent.
+  std::vector<double> latencies_ms;
+};
+
+// Total user and system CPU time used by this process.
+double CpuSeconds() {
+#ifdef MAIDSAFE_WIN32
+  FILETIME creation, exit, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    return 0.0;
+  auto to_seconds([](const FILETIME& time) {
+    return ((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7;
   });
+  return to_seconds(kernel) + to_seconds(user);
+#else
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0.0;
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+}
 
-  if (argc < 3)
-    return fail();
+// The largest resident set size of this process so far.
+uint64_t PeakRssKilobytes() {
+#ifdef MAIDSAFE_WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize / 1024;
+#else
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#  ifdef __APPLE__
+  return usage.ru_maxrss / 1024;  // Bytes on OS X
+#  else
+  return usage.ru_maxrss;
+#  endif
+#endif
+}
 
-  try {
-    message_count = std::stoi(argv[1]);
-    message_size = std::stoi(argv[2]);
-    if (message_count < 1 || message_size < 12) {
-      std::cout << "Message count must be >= 1 and size of messages must be >= 12.\n";
-      return false;
+double Percentile(std::vector<double> samples, int percent) {
+  if (samples.empty())
+    return 0.0;
+  auto itr(samples.begin() + (samples.size() - 1) * percent / 100);
+  std::nth_element(samples.begin(), itr, samples.end());
+  return *itr;
+}
+
+// Sends "message_count" messages of "message_size" bytes along each flow, all at once, and waits
+// for them all to be acknowledged and received.
+RunResult Run(const std::string& scenario, std::vector<maidsafe::rudp::test::NodePtr>& nodes,
+              const std::vector<Flow>& flows, int message_count, int message_size) {
+  RunResult run_result;
+  run_result.scenario = scenario;
+  run_result.message_size = message_size;
+  run_result.message_count = message_count * static_cast<int>(flows.size());
+  for (const auto& flow : flows)
+    run_result.peer_count = std::max(run_result.peer_count, std::max(flow.first, flow.second));
+
+  std::vector<int> expected_counts(nodes.size(), 0);
+  for (const auto& flow : flows)
+    expected_counts[flow.second] += message_count;
+  std::vector<std::future<std::vector<std::string>>> received_futures;
+  for (size_t i(0); i != nodes.size(); ++i) {
+    nodes[i]->ResetData();
+    if (expected_counts[i] != 0)
+      received_futures.push_back(nodes[i]->GetFutureForMessages(expected_counts[i]));
+  }
+  std::string message(maidsafe::RandomAlphaNumericString(message_size));
+
+  // Shared with the sent functors, which could outlive this function if the run times out.
+  struct Tally {
+    Tally() : mutex(), cond_var(), result_arrived_count(0), failures(0), latencies_ms() {}
+    std::mutex mutex;
+    std::condition_variable cond_var;
+    int result_arrived_count, failures;
+    std::vector<double> latencies_ms;
+  };
+  auto tally(std::make_shared<Tally>());
+  double cpu_start(CpuSeconds());
+  auto start_point(std::chrono::steady_clock::now());
+  for (int i(0); i != message_count; ++i) {
+    for (const auto& flow : flows) {
+      auto send_point(std::chrono::steady_clock::now());
+      nodes[flow.first]->managed_connections()->Send(
+          nodes[flow.second]->node_id(), message, [tally, send_point](int result) {
+            auto latency(std::chrono::steady_clock::now() - send_point);
+            std::lock_guard<std::mutex> lock(tally->mutex);
+            if (result == maidsafe::rudp::kSuccess) {
+              tally->latencies_ms.push_back(
+                  std::chrono::duration_cast<std::chrono::microseconds>(latency).count() / 1000.0);
+            } else {
+              ++tally->failures;
+            }
+            ++tally->result_arrived_count;
+            tally->cond_var.notify_one();
+          });
+    }
+  }
+
+  const std::chrono::minutes kTimeout(10);
+  {
+    std::unique_lock<std::mutex> lock(tally->mutex);
+    if (!tally->cond_var.wait_for(lock, kTimeout, [&] {
+          return tally->result_arrived_count == run_result.message_count;
+        })) {
+      LOG(kError) << "Timed out waiting for " << scenario << " messages to be sent.";
+      tally->failures += run_result.message_count - tally->result_arrived_count;
+    }
+    run_result.failures = tally->failures;
+    run_result.latencies_ms = tally->latencies_ms;
+  }
+  for (auto& received_future : received_futures) {
+    if (received_future.wait_for(kTimeout) != std::future_status::ready) {
+      LOG(kError) << "Timed out waiting for " << scenario << " messages to be received.";
+      ++run_result.failures;
+    }
+  }
+  run_result.elapsed_seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_point).count() / 1e6;
+  run_result.cpu_seconds = CpuSeconds() - cpu_start;
+  run_result.peak_rss_kB = PeakRssKilobytes();
+  return run_result;
+}
+
+// Connects "connect_count" pairs of new nodes to each other, recording for each the time from
+// calling Add until both have received the other's validation data.  To mimic a LAN whose router
+// doesn't support hairpinning, each peer is given an unreachable external endpoint.  To mimic
+// peers behind different NATs, each is given an unreachable local endpoint.
+RunResult Connect(const std::string& scenario,
+                  const std::vector<maidsafe::rudp::Endpoint>& bootstrap_endpoints,
+                  int connect_count, bool lan) {
+  using maidsafe::rudp::Endpoint;
+  using maidsafe::rudp::EndpointPair;
+  RunResult run_result;
+  run_result.scenario = scenario;
+  run_result.message_count = connect_count;
+  run_result.peer_count = 1;
+
+  auto unreachable([lan](const Endpoint& endpoint) {
+    return Endpoint(boost::asio::ip::address::from_string(lan ? "192.0.2.1" : "10.255.255.1"),
+                    endpoint.port());
+  });
+  std::vector<maidsafe::rudp::test::NodePtr> pair_nodes;
+  double cpu_start(CpuSeconds());
+  auto start_point(std::chrono::steady_clock::now());
+  for (int i(0); i != connect_count; ++i) {
+    auto node0(std::make_shared<maidsafe::rudp::test::Node>(1000 + 2 * i));
+    auto node1(std::make_shared<maidsafe::rudp::test::Node>(1001 + 2 * i));
+    pair_nodes.push_back(node0);
+    pair_nodes.push_back(node1);
+    maidsafe::NodeId chosen_node_id;
+    EndpointPair endpoint_pair0, endpoint_pair1;
+    maidsafe::rudp::NatType nat_type;
+    auto available([](int result) {
+      return result == maidsafe::rudp::kSuccess ||
+             result == maidsafe::rudp::kBootstrapConnectionAlreadyExists;
+    });
+    if (node0->Bootstrap(bootstrap_endpoints, chosen_node_id) != maidsafe::rudp::kSuccess ||
+        node1->Bootstrap(bootstrap_endpoints, chosen_node_id) != maidsafe::rudp::kSuccess ||
+        !available(node0->managed_connections()->GetAvailableEndpoint(
+            node1->node_id(), EndpointPair(), endpoint_pair0, nat_type)) ||
+        !available(node1->managed_connections()->GetAvailableEndpoint(
+            node0->node_id(), endpoint_pair0, endpoint_pair1, nat_type))) {
+      LOG(kError) << "Failed to prepare " << scenario << " connection " << i;
+      ++run_result.failures;
+      continue;
+    }
+    for (EndpointPair* endpoint_pair : { &endpoint_pair0, &endpoint_pair1 }) {
+      if (lan) {
+        endpoint_pair->external = unreachable(endpoint_pair->local);
+      } else {
+        endpoint_pair->external = endpoint_pair->local;
+        endpoint_pair->local = unreachable(endpoint_pair->local);
+      }
     }
+
+    node0->ResetData();
+    node1->ResetData();
+    auto future0(node0->GetFutureForMessages(1)), future1(node1->GetFutureForMessages(1));
+    auto add_point(std::chrono::steady_clock::now());
+    node1->managed_connections()->Add(node0->node_id(), endpoint_pair0, node1->validation_data());
+    node0->managed_connections()->Add(node1->node_id(), endpoint_pair1, node0->validation_data());
+    const std::chrono::seconds kTimeout(30);
+    if (future0.wait_for(kTimeout) != std::future_status::ready ||
+        future1.wait_for(kTimeout) != std::future_status::ready) {
+      LOG(kError) << "Timed out waiting for " << scenario << " connection " << i;
+      ++run_result.failures;
+      continue;
+    }
+    run_result.latencies_ms.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - add_point).count() / 1000.0);
   }
-  catch(const std::exception&) {
-    return fail();
+  run_result.elapsed_seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_point).count() / 1e6;
+  run_result.cpu_seconds = CpuSeconds() - cpu_start;
+  run_result.peak_rss_kB = PeakRssKilobytes();
+  return run_result;
+}
+
+// Starts "bootstrap_count" new nodes, recording the time each takes to bootstrap from a list of 8
+// endpoints of which "dead_fraction" have nothing listening.  The dead ones are listed first.
+RunResult StartUp(const std::vector<maidsafe::rudp::Endpoint>& bootstrap_endpoints,
+                  int bootstrap_count, double dead_fraction) {
+  using maidsafe::rudp::Endpoint;
+  RunResult run_result;
+  run_result.scenario = "bootstrap";
+  run_result.message_count = bootstrap_count;
+  run_result.peer_count = static_cast<int>(bootstrap_endpoints.size());
+
+  const int kListSize(8);
+  int dead_count(static_cast<int>(dead_fraction * kListSize + 0.5));
+  std::vector<Endpoint> endpoints;
+  for (int i(0); i != kListSize; ++i) {
+    if (i < dead_count)
+      endpoints.push_back(Endpoint(maidsafe::GetLocalIp(), maidsafe::test::GetRandomPort()));
+    else
+      endpoints.push_back(bootstrap_endpoints[i % bootstrap_endpoints.size()]);
   }
 
-  return true;
+  std::vector<maidsafe::rudp::test::NodePtr> new_nodes;
+  double cpu_start(CpuSeconds());
+  auto start_point(std::chrono::steady_clock::now());
+  for (int i(0); i != bootstrap_count; ++i) {
+    new_nodes.push_back(std::make_shared<maidsafe::rudp::test::Node>(2000 + i));
+    maidsafe::NodeId chosen_node_id;
+    auto bootstrap_point(std::chrono::steady_clock::now());
+    if (new_nodes.back()->Bootstrap(endpoints, chosen_node_id) != maidsafe::rudp::kSuccess) {
+      LOG(kError) << "Failed to bootstrap node " << i;
+      ++run_result.failures;
+      continue;
+    }
+    run_result.latencies_ms.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - bootstrap_point).count() / 1000.0);
+  }
+  run_result.elapsed_seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_point).count() / 1e6;
+  run_result.cpu_seconds = CpuSeconds() - cpu_start;
+  run_result.peak_rss_kB = PeakRssKilobytes();
+  return run_result;
+}
+
+// Connects "churn_count" new peers in turn to one node, keeping only the latest four connected, and
+// records the time the node's GetAvailableEndpoint takes for each.
+RunResult Churn(const std::string& scenario,
+                const std::vector<maidsafe::rudp::Endpoint>& bootstrap_endpoints,
+                int churn_count) {
+  using maidsafe::rudp::EndpointPair;
+  RunResult run_result;
+  run_result.scenario = scenario;
+  run_result.message_count = churn_count;
+  run_result.peer_count = 1;
+
+  auto hub(std::make_shared<maidsafe::rudp::test::Node>(3000));
+  maidsafe::NodeId chosen_node_id;
+  if (hub->Bootstrap(bootstrap_endpoints, chosen_node_id) != maidsafe::rudp::kSuccess) {
+    LOG(kError) << "Failed to bootstrap " << scenario << " node.";
+    run_result.failures = churn_count;
+    return run_result;
+  }
+
+  const size_t kConnectedPeers(4);
+  std::deque<maidsafe::rudp::test::NodePtr> peers;
+  double cpu_start(CpuSeconds());
+  auto start_point(std::chrono::steady_clock::now());
+  for (int i(0); i != churn_count; ++i) {
+    if (peers.size() == kConnectedPeers) {
+      hub->managed_connections()->Remove(peers.front()->node_id());
+      peers.pop_front();
+    }
+    auto peer(std::make_shared<maidsafe::rudp::test::Node>(3001 + i));
+    EndpointPair hub_endpoint_pair, peer_endpoint_pair;
+    maidsafe::rudp::NatType nat_type;
+    if (peer->Bootstrap(bootstrap_endpoints, chosen_node_id) != maidsafe::rudp::kSuccess) {
+      LOG(kError) << "Failed to bootstrap " << scenario << " peer " << i;
+      ++run_result.failures;
+      continue;
+    }
+    auto get_available_point(std::chrono::steady_clock::now());
+    int result(hub->managed_connections()->GetAvailableEndpoint(
+        peer->node_id(), EndpointPair(), hub_endpoint_pair, nat_type));
+    auto get_available_duration(std::chrono::steady_clock::now() - get_available_point);
+    if (result != maidsafe::rudp::kSuccess ||
+        peer->managed_connections()->GetAvailableEndpoint(
+            hub->node_id(), hub_endpoint_pair, peer_endpoint_pair, nat_type) !=
+                maidsafe::rudp::kSuccess) {
+      LOG(kError) << "Failed to get available endpoints for " << scenario << " peer " << i;
+      ++run_result.failures;
+      continue;
+    }
+    run_result.latencies_ms.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+        get_available_duration).count() / 1000.0);
+
+    hub->ResetData();
+    peer->ResetData();
+    auto hub_future(hub->GetFutureForMessages(1)), peer_future(peer->GetFutureForMessages(1));
+    peer->managed_connections()->Add(hub->node_id(), hub_endpoint_pair, peer->validation_data());
+    hub->managed_connections()->Add(peer->node_id(), peer_endpoint_pair, hub->validation_data());
+    const std::chrono::seconds kTimeout(30);
+    if (hub_future.wait_for(kTimeout) != std::future_status::ready ||
+        peer_future.wait_for(kTimeout) != std::future_status::ready) {
+      LOG(kError) << "Timed out waiting for " << scenario << " peer " << i << " to connect.";
+      ++run_result.failures;
+      continue;
+    }
+    peers.push_back(peer);
+  }
+  run_result.elapsed_seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_point).count() / 1e6;
+  run_result.cpu_seconds = CpuSeconds() - cpu_start;
+  run_result.peak_rss_kB = PeakRssKilobytes();
+  return run_result;
+}
+
+void Report(const RunResult& run_result) {
+  double elapsed(std::max(run_result.elapsed_seconds, 1e-6));
+  auto transfer_rate(static_cast<uint64_t>(
+      static_cast<double>(run_result.message_count) * run_result.message_size / elapsed));
+  TLOG(kDefaultColour) << run_result.scenario << ": " << run_result.message_count
+                       << " messages of " << run_result.message_size << " bytes between "
+                       << run_result.peer_count + 1 << " nodes in " << elapsed << " s\n"
+                       << "  Transfer rate: "
+                       << maidsafe::BytesToDecimalSiUnits(transfer_rate) << "/sec, "
+                       << run_result.message_count / elapsed << " msg/sec, "
+                       << run_result.failures << " failures\n"
+                       << "  Latency (ms): p50 " << Percentile(run_result.latencies_ms, 50)
+                       << ", p90 " << Percentile(run_result.latencies_ms, 90)
+                       << ", p99 " << Percentile(run_result.latencies_ms, 99)
+                       << ", max " << Percentile(run_result.latencies_ms, 100) << '\n'
+                       << "  CPU time: " << run_result.cpu_seconds << " s, peak RSS: "
+                       << run_result.peak_rss_kB << " kB\n";
+}
+
+void WriteJson(const std::vector<RunResult>& run_results, std::ostream& output) {
+  output << "{\n  \"benchmark\": \"rudp_performance_tool\",\n  \"runs\": [";
+  for (size_t i(0); i != run_results.size(); ++i) {
+    const RunResult& run_result(run_results[i]);
+    double elapsed(std::max(run_result.elapsed_seconds, 1e-6));
+    output << (i == 0 ? "\n" : ",\n")
+           << "    {\"scenario\": \"" << run_result.scenario << "\", "
+           << "\"message_size\": " << run_result.message_size << ", "
+           << "\"message_count\": " << run_result.message_count << ", "
+           << "\"peers\": " << run_result.peer_count << ", "
+           << "\"failures\": " << run_result.failures << ", "
+           << "\"elapsed_seconds\": " << run_result.elapsed_seconds << ", "
+           << "\"bytes_per_second\": "
+           << static_cast<double>(run_result.message_count) * run_result.message_size / elapsed
+           << ", \"messages_per_second\": " << run_result.message_count / elapsed << ", "
+           << "\"latency_ms\": {\"p50\": " << Percentile(run_result.latencies_ms, 50)
+           << ", \"p90\": " << Percentile(run_result.latencies_ms, 90)
+           << ", \"p99\": " << Percentile(run_result.latencies_ms, 99)
+           << ", \"max\": " << Percentile(run_result.latencies_ms, 100) << "}, "
+           << "\"cpu_seconds\": " << run_result.cpu_seconds << ", "
+           << "\"peak_rss_kB\": " << run_result.peak_rss_kB << "}";
+  }
+  output << "\n  ]\n}\n";
+}
+
+std::vector<int> ParseSizes(const std::string& sizes) {
+  std::vector<int> result;
+  std::istringstream input(sizes);
+  std::string size;
+  while (std::getline(input, size, ','))
+    result.push_back(std::stoi(size));
+  return result;
 }
 
 }  // unnamed namespace
 
 int main(int argc, char **argv) {
-  auto message_count(0), message_size(0);
-  if (!ParseArgs(argc, argv, message_count, message_size))
+  maidsafe::log::Logging::Instance().Initialise(argc, argv);
+
+  int message_count(0), peer_count(0), connect_count(0), bootstrap_count(0), churn_count(0);
+  double dead_fraction(0.0);
+  std::vector<int> message_sizes;
+  std::string scenarios, json_path;
+  try {
+    po::options_description options_description("Options");
+    options_description.add_options()
+        ("help,h", "Print options.")
+        ("count,c", po::value<int>(&message_count)->default_value(100),
+            "Messages sent along each flow in each run.")
+        ("sizes,s", po::value<std::string>()->default_value("1024,16384,262144,1048576"),
+            "Comma-separated message sizes in bytes.  The sweep uses each of them; the other "
+            "scenarios use the first.")
+        ("peers,p", po::value<int>(&peer_count)->default_value(4),
+            "Number of peers receiving concurrently in the fan-out scenario.")
+        ("scenarios", po::value<std::string>(&scenarios)->default_value("sweep,fan_out,duplex"),
+            "Comma-separated scenarios to run, from sweep (one sender and receiver per message "
+            "size), fan_out (one sender to all peers), duplex (two nodes sending to each "
+            "other), connect_lan and connect_nat (the time taken for pairs of new nodes to "
+            "connect when only their local or only their external endpoints are reachable), "
+            "bootstrap (the time taken for new nodes to bootstrap) and churn (the time taken by "
+            "GetAvailableEndpoint as peers connect and disconnect, with and without spare "
+            "transports).")
+        ("connects", po::value<int>(&connect_count)->default_value(5),
+            "Number of pairs of nodes connected in each connect scenario.")
+        ("bootstraps", po::value<int>(&bootstrap_count)->default_value(5),
+            "Number of new nodes started in the bootstrap scenario.")
+        ("dead-fraction", po::value<double>(&dead_fraction)->default_value(0.5),
+            "Fraction of the bootstrap list in the bootstrap scenario which isn't running.")
+        ("churns", po::value<int>(&churn_count)->default_value(20),
+            "Number of peers connected in turn in the churn scenario.")
+        ("json,j", po::value<std::string>(&json_path), "Path to write results to as JSON.");
+
+    po::variables_map variables_map;
+    po::store(po::command_line_parser(argc, argv).options(options_description).allow_unregistered().
+                                                  run(), variables_map);
+    po::notify(variables_map);
+    if (variables_map.count("help")) {
+      std::cout << options_description << std::endl;
+      return 0;
+    }
+    message_sizes = ParseSizes(variables_map.at("sizes").as<std::string>());
+  }
+  catch(const std::exception& e) {
+    std::cout << "Error: " << e.what() << std::endl;
     return -1;
+  }
+  if (message_count < 1 || peer_count < 1 || connect_count < 1 || bootstrap_count < 1 ||
+      churn_count < 1 || dead_fraction < 0.0 || dead_fraction > 1.0 || message_sizes.empty() ||
+      *std::min_element(message_sizes.begin(), message_sizes.end()) < 1) {
+    std::cout << "Message count, peer count, connects, bootstraps, churns and message sizes must "
+              << "all be >= 1, and the dead fraction must be between 0 and 1.\n";
+    return -1;
+  }
 
-  maidsafe::log::Logging::Instance().Initialise(argc, argv);
-  TLOG(kDefaultColour) << "Starting RUDP benchmark using " << message_count << " messages of "
-                       << message_size << " bytes.\n";
+  bool run_sweep(scenarios.find("sweep") != std::string::npos),
+       run_fan_out(scenarios.find("fan_out") != std::string::npos),
+       run_duplex(scenarios.find("duplex") != std::string::npos),
+       run_connect_lan(scenarios.find("connect_lan") != std::string::npos),
+       run_connect_nat(scenarios.find("connect_nat") != std::string::npos),
+       run_bootstrap(scenarios.find("bootstrap") != std::string::npos),
+       run_churn(scenarios.find("churn") != std::string::npos);
+  int node_count(run_fan_out ? peer_count + 1 : 2);
+  TLOG(kDefaultColour) << "Starting RUDP benchmark using " << node_count << " nodes.\n";
 
   std::vector<maidsafe::rudp::test::NodePtr> nodes;
   std::vector<maidsafe::rudp::Endpoint> bootstrap_endpoints;
-  if (!maidsafe::rudp::test::SetupNetwork(nodes, bootstrap_endpoints, 2)) {
+  if (!maidsafe::rudp::test::SetupNetwork(nodes, bootstrap_endpoints, node_count)) {
     LOG(kError) << "Failed to setup network.";
     return -2;
   }
 
-  maidsafe::rudp::MessageReceivedFunctor do_nothing_on_message;
-  maidsafe::rudp::ConnectionLostFunctor do_nothing_on_connection_lost;
-
-  nodes[0]->ResetData();
-  nodes[1]->ResetData();
-  auto messages_futures(nodes[1]->GetFutureForMessages(message_count));
-  std::vector<std::string> messages;
-  messages.reserve(message_count);
-  std::string message(maidsafe::RandomAlphaNumericString(message_size - 12));
-  for (int i(0); i != message_count; ++i) {
-    std::string prefix(std::to_string(i));
-    prefix.insert(0, 10 - prefix.size(), '0');
-    messages.push_back(prefix + ": " + message);
-  }
-  int result_of_send(maidsafe::rudp::kConnectError);
-  int result_arrived_count(0);
-  std::condition_variable cond_var;
-  std::mutex mutex;
-  std::unique_lock<std::mutex> lock(mutex);
-  maidsafe::rudp::MessageSentFunctor message_sent_functor([&](int result_in) {
-    std::lock_guard<std::mutex> lock(mutex);
-    result_of_send = result_in;
-    ++result_arrived_count;
-    cond_var.notify_one();
-  });
+  std::vector<RunResult> run_results;
+  if (run_sweep) {
+    for (int message_size : message_sizes) {
+      run_results.push_back(
+          Run("sweep", nodes, std::vector<Flow>(1, Flow(0, 1)), message_count, message_size));
+      Report(run_results.back());
+    }
+  }
+  if (run_fan_out) {
+    std::vector<Flow> flows;
+    for (int i(1); i <= peer_count; ++i)
+      flows.push_back(Flow(0, i));
+    run_results.push_back(Run("fan_out", nodes, flows, message_count, message_sizes.front()));
+    Report(run_results.back());
+  }
+  if (run_duplex) {
+    std::vector<Flow> flows;
+    flows.push_back(Flow(0, 1));
+    flows.push_back(Flow(1, 0));
+    run_results.push_back(Run("duplex", nodes, flows, message_count, message_sizes.front()));
+    Report(run_results.back());
+  }
+  if (run_connect_lan) {
+    run_results.push_back(Connect("connect_lan", bootstrap_endpoints, connect_count, true));
+    Report(run_results.back());
+  }
+  if (run_connect_nat) {
+    run_results.push_back(Connect("connect_nat", bootstrap_endpoints, connect_count, false));
+    Report(run_results.back());
+  }
+  if (run_bootstrap) {
+    run_results.push_back(StartUp(bootstrap_endpoints, bootstrap_count, dead_fraction));
+    Report(run_results.back());
+  }
+  if (run_churn) {
+    // GetAvailableEndpoint is measured both with and without spare transports to hand out.
+    uint32_t spare_transports(std::max(maidsafe::rudp::Parameters::spare_transports, 1U));
+    maidsafe::rudp::Parameters::spare_transports = 0;
+    run_results.push_back(Churn("churn_no_spares", bootstrap_endpoints, churn_count));
+    Report(run_results.back());
+    maidsafe::rudp::Parameters::spare_transports = spare_transports;
+    run_results.push_back(Churn("churn", bootstrap_endpoints, churn_count));
+    Report(run_results.back());
+  }
 
-  // Send and assess results
-  LOG(kSuccess) << "Starting to send.";
-  auto start_point(std::chrono::steady_clock::now());
-  for (int i(0); i != message_count; ++i)
-    nodes[0]->managed_connections()->Send(nodes[1]->node_id(), messages[i], message_sent_functor);
-
-  LOG(kSuccess) << "All messages enqueued.";
-  cond_var.wait(lock,
-      [message_count, &result_arrived_count] { return result_arrived_count == message_count; });  // NOLINT (Fraser)
-
-  auto received_messages(messages_futures.get());
-  if (received_messages.size() != static_cast<size_t>(message_count)) {
-    LOG(kError) << "Only received " << received_messages.size() << " of " << message_count
-                << " messages.";
-    return -3;
-  }
-  std::chrono::milliseconds elapsed(std::chrono::duration_cast<std::chrono::milliseconds>(
-      std::chrono::steady_clock::now() - start_point));
-
-  LOG(kSuccess) << "All messages sent and received.";
-  intmax_t transfer_rate((message_count * message_size * 1000) / elapsed.count());
-  intmax_t message_rate((message_count * 1000) / elapsed.count());
-  TLOG(kDefaultColour) << "\nSent " << message_count << " messages of " << message_size
-                       << " bytes in " << elapsed.count() << " milliseconds.\nTransfer rate: "
-                       << maidsafe::BytesToDecimalSiUnits(transfer_rate) << "/sec.\nMessage rate:  "
-                       << message_rate << " msg/sec.\n\n";
+  if (!json_path.empty()) {
+    std::ofstream json_file(json_path);
+    WriteJson(run_results, json_file);
+    if (!json_file) {
+      LOG(kError) << "Failed to write results to " << json_path;
+      return -3;
+    }
+  }
 
+  for (const auto& run_result : run_results) {
+    if (run_result.failures != 0)
+      return -3;
+  }
   return 0;
 }
@@ -0,0 +1,84 @@
+/* Copyright 2012 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "boost/program_options.hpp"
+
+#include "maidsafe/rudp/core/trace.h"
+
+namespace po = boost::program_options;
+
+namespace {
+
+const char kUsage[] =
+    "Converts a trace written by maidsafe::rudp::WriteTrace to the Trace Event Format, which can\n"
+    "be loaded into chrome://tracing or https://ui.perfetto.dev.  Each connection is shown as a\n"
+    "process, with its window sizes as counters.\n\n"
+    "  rudp_trace_dump --input rudp.trace --output rudp_trace.json\n\n";
+
+}  // unnamed namespace
+
+int main(int argc, char** argv) {
+  try {
+    po::options_description options_description("Options");
+    options_description.add_options()
+        ("help,h", "Print options.")
+        ("input,i", po::value<std::string>(), "Path to binary trace.")
+        ("output,o", po::value<std::string>(), "Path to write timeline to (default is stdout).");
+
+    po::variables_map variables_map;
+    po::store(po::command_line_parser(argc, argv).options(options_description).run(),
+              variables_map);
+    po::notify(variables_map);
+
+    if (variables_map.count("help") || !variables_map.count("input")) {
+      std::cout << kUsage << options_description << std::endl;
+      return variables_map.count("help") ? 0 : -1;
+    }
+
+    std::ifstream input(variables_map.at("input").as<std::string>(), std::ios::binary);
+    if (!input) {
+      std::cout << "Could not open trace file." << std::endl;
+      return -1;
+    }
+    std::vector<maidsafe::rudp::detail::TraceRecord> records;
+    if (!maidsafe::rudp::detail::Trace::Read(input, records)) {
+      std::cout << "Trace file is truncated or invalid." << std::endl;
+      return -1;
+    }
+
+    std::ofstream output_file;
+    if (variables_map.count("output")) {
+      output_file.open(variables_map.at("output").as<std::string>());
+      if (!output_file) {
+        std::cout << "Could not open output file." << std::endl;
+        return -1;
+      }
+    }
+    maidsafe::rudp::detail::Trace::WriteTimeline(records,
+                                                 output_file.is_open() ? output_file : std::cout);
+    if (output_file.is_open())
+      std::cout << "Wrote " << records.size() << " events." << std::endl;
+  }
+  catch(const std::exception& e) {
+    std::cout << "Error: " << e.what() << std::endl;
+    return -1;
+  }
+  return 0;
+}
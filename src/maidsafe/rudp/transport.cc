@@ -19,11 +19,13 @@ License.
 
 #include <algorithm>
 #include <cassert>
+#include <future>
 
 #include "boost/thread/condition_variable.hpp"
 #include "boost/thread/mutex.hpp"
 #include "maidsafe/common/log.h"
 
+#include "maidsafe/rudp/bootstrap_cache.h"
 #include "maidsafe/rudp/connection.h"
 #include "maidsafe/rudp/connection_manager.h"
 #include "maidsafe/rudp/core/multiplexer.h"
@@ -42,43 +44,14 @@ namespace rudp {
 
 namespace detail {
 
-template<typename Rep>
-std::chrono::duration<Rep> BoostToChrono(bptime::time_duration const & from) {
-  return std::chrono::duration_cast<std::chrono::duration<Rep>>(
-             std::chrono::nanoseconds(from.total_nanoseconds()));
-}
-
 namespace {
 
 typedef boost::asio::ip::udp::endpoint Endpoint;
 
-template<typename FunctorType>
-class LocalFunctorReplacement {
- public:
-  LocalFunctorReplacement(std::mutex& mutex,
-                          FunctorType& functor_to_replace,
-                          FunctorType& save_slot,
-                          FunctorType replacement)
-      : mutex_(mutex),
-        functor_to_replace_(functor_to_replace),
-        save_slot_(save_slot) {
-    std::lock_guard<std::mutex> guard(mutex_);
-    save_slot_ = std::move(functor_to_replace_);
-    functor_to_replace_ = std::move(replacement);
-  }
-  ~LocalFunctorReplacement() {
-    std::lock_guard<std::mutex> guard(mutex_);
-    functor_to_replace_ = std::move(save_slot_);
-  }
-
- private:
-  std::mutex& mutex_;
-  FunctorType& functor_to_replace_;
-  FunctorType& save_slot_;
-
-  explicit LocalFunctorReplacement(LocalFunctorReplacement const&);
-  LocalFunctorReplacement& operator=(LocalFunctorReplacement const&);
-};
+// Whether an attempt in a ConnectRace is still in progress.
+bool InProgress(const std::shared_ptr<Connection>& attempt) {
+  return static_cast<bool>(attempt);
+}
 
 }  // namespace
 
@@ -88,12 +61,14 @@ Transport::Transport(AsioService& asio_service, NatType& nat_type)
       strand_(asio_service.service()),
       multiplexer_(new Multiplexer(asio_service.service())),
       connection_manager_(),
+      connect_races_(),
       callback_mutex_(),
       on_message_(),
       on_connection_added_(),
       on_connection_lost_(),
       on_nat_detection_requested_slot_(),
-      managed_connections_debug_printout_() {}
+      managed_connections_debug_printout_(),
+      bootstrap_cache_() {}
 
 Transport::~Transport() { Close(); }
 
@@ -108,14 +83,39 @@ bool Transport::Bootstrap(
     OnConnectionLost on_connection_lost_slot,
     const Session::OnNatDetectionRequested::slot_function_type& on_nat_detection_requested_slot,
     NodeId& chosen_id) {
+  auto promise(std::make_shared<std::promise<std::pair<bool, NodeId>>>());
+  auto future(promise->get_future());
+  Bootstrap(bootstrap_peers, this_node_id, this_public_key, local_endpoint,
+            bootstrap_off_existing_connection, on_message_slot, on_connection_added_slot,
+            on_connection_lost_slot, on_nat_detection_requested_slot,
+            [promise](bool started, const NodeId& bootstrap_peer_id) {
+              promise->set_value(std::make_pair(started, bootstrap_peer_id));
+            });
+  auto outcome(future.get());
+  chosen_id = outcome.second;
+  return outcome.first;
+}
+
+void Transport::Bootstrap(
+    const std::vector<std::pair<NodeId, Endpoint> > &bootstrap_peers,
+    const NodeId& this_node_id,
+    std::shared_ptr<asymm::PublicKey> this_public_key,
+    Endpoint local_endpoint,
+    bool bootstrap_off_existing_connection,
+    OnMessage on_message_slot,
+    OnConnectionAdded on_connection_added_slot,
+    OnConnectionLost on_connection_lost_slot,
+    const Session::OnNatDetectionRequested::slot_function_type& on_nat_detection_requested_slot,
+    OnBootstrapped on_bootstrapped) {
   assert(on_nat_detection_requested_slot);
+  assert(on_bootstrapped);
   assert(!multiplexer_->IsOpen());
 
-  chosen_id = NodeId();
   ReturnCode result = multiplexer_->Open(local_endpoint);
   if (result != kSuccess) {
     LOG(kError) << "Failed to open multiplexer.  Result: " << result;
-    return false;
+    asio_service_.service().post([on_bootstrapped] { on_bootstrapped(false, NodeId()); });
+    return;
   }
 
   // We want these 3 slots to be invoked before any others connected, so that if we wait elsewhere
@@ -135,12 +135,12 @@ bool Transport::Bootstrap(
 
   StartDispatch();
 
-  return TryBootstrapping(bootstrap_peers, bootstrap_off_existing_connection, chosen_id);
+  TryBootstrapping(bootstrap_peers, bootstrap_off_existing_connection, on_bootstrapped);
 }
 
-bool Transport::TryBootstrapping(const std::vector<std::pair<NodeId, Endpoint> > &bootstrap_peers,
+void Transport::TryBootstrapping(const std::vector<std::pair<NodeId, Endpoint> > &bootstrap_peers,
                                  bool bootstrap_off_existing_connection,
-                                 NodeId& chosen_id) {
+                                 OnBootstrapped on_bootstrapped) {
   bool try_connect(true);
   bptime::time_duration lifespan;
   if (bootstrap_off_existing_connection)
@@ -150,129 +150,181 @@ bool Transport::TryBootstrapping(const std::vector<std::pair<NodeId, Endpoint> >
 
   if (!try_connect) {
     LOG(kVerbose) << "Started new transport on " << multiplexer_->local_endpoint();
-    return true;
+    asio_service_.service().post([on_bootstrapped] { on_bootstrapped(true, NodeId()); });
+    return;
   }
 
-  for (auto peer : bootstrap_peers) {
-    chosen_id = ConnectToBootstrapEndpoint(peer.first, peer.second, lifespan);
-    if (chosen_id != NodeId()) {
-      LOG(kVerbose) << "Started new transport on " << multiplexer_->local_endpoint()
-                    << " connected to " << DebugId(peer.first).substr(0, 7) << " - " << peer.second;
-      return true;
-    }
+  // Several bootstrap peers are tried at once, so that stale entries in the list don't each delay
+  // startup by bootstrap_connect_timeout.  The first to connect is used and the rest are cancelled.
+  auto race(std::make_shared<BootstrapRace>(bootstrap_peers, lifespan, on_bootstrapped,
+                                            asio_service_.service()));
+  {
+    std::lock_guard<std::mutex> guard(callback_mutex_);
+    race->saved_on_connection_added = std::move(on_connection_added_);
+    on_connection_added_ = std::bind(&Transport::HandleBootstrapConnectionAdded, this, race,
+                                     args::_1, args::_2, args::_3, args::_4);
   }
 
-  return false;
+  std::lock_guard<std::mutex> lock(race->mutex);
+  LaunchBootstrapAttempts(race);
+  if (race->in_flight == 0) {
+    CancelBootstrapAttempts(race);
+    return;
+  }
+  race->timer.expires_from_now(Parameters::bootstrap_connect_timeout + bptime::seconds(1));
+  race->timer.async_wait(std::bind(&Transport::HandleBootstrapTimeout, shared_from_this(), race,
+                                   args::_1));
+}
+
+void Transport::LaunchBootstrapAttempts(const std::shared_ptr<BootstrapRace>& race) {
+  while (race->chosen_id == NodeId() && !race->cancelling &&
+         race->next_peer != race->peers.size() &&
+         race->in_flight < Parameters::bootstrap_connect_concurrency) {
+    const auto& peer(race->peers[race->next_peer++]);
+    if (!IsValid(peer.second)) {
+      LOG(kError) << peer.second << " is an invalid endpoint.";
+      continue;
+    }
+    ++race->in_flight;
+    Endpoint peer_endpoint(peer.second);
+    race->attempts.push_back(connection_manager_->Connect(
+        peer.first, peer_endpoint, "", Parameters::bootstrap_connect_timeout, race->lifespan,
+        [this, race, peer_endpoint] { HandleBootstrapAttemptFailure(race, peer_endpoint); }));
+  }
 }
 
-NodeId Transport::ConnectToBootstrapEndpoint(const NodeId& bootstrap_node_id,
-                                             const Endpoint& bootstrap_endpoint,
-                                             const bptime::time_duration& lifespan) {
-  if (!IsValid(bootstrap_endpoint)) {
-    LOG(kError) << bootstrap_endpoint << " is an invalid endpoint.";
-    return NodeId();
+void Transport::HandleBootstrapAttemptFailure(const std::shared_ptr<BootstrapRace>& race,
+                                              const Endpoint& peer_endpoint) {
+  if (bootstrap_cache_)
+    bootstrap_cache_->RecordFailure(peer_endpoint);
+  std::lock_guard<std::mutex> lock(race->mutex);
+  --race->in_flight;
+  if (race->chosen_id != NodeId())
+    return;
+  LaunchBootstrapAttempts(race);
+  if (race->in_flight == 0 && !race->cancelling) {
+    race->timer.cancel();
+    CancelBootstrapAttempts(race);
   }
+}
 
-  // Temporarily connect to the signals until the connect attempt has succeeded or failed.
-  std::mutex local_mutex;
-  std::condition_variable local_cond_var;
-  bool slot_called(false);
-  bool timed_out_connecting(false);
-  NodeId peer_id;
-  std::unique_lock<std::mutex> lock(local_mutex, std::defer_lock);
-
+void Transport::HandleBootstrapConnectionAdded(const std::shared_ptr<BootstrapRace>& race,
+                                               const NodeId& peer_id,
+                                               TransportPtr transport,
+                                               bool temporary_connection,
+                                               bool& is_duplicate_normal_connection) {
   {
-    OnConnectionAdded saved_on_connection_added;
-    OnConnectionLost saved_on_connection_lost;
-
-    LocalFunctorReplacement<OnConnectionAdded> on_conn_added_guard(
-        callback_mutex_,
-        on_connection_added_,
-        saved_on_connection_added,
-        [&] (const NodeId& connected_peer_id,
-             TransportPtr transport,
-             bool temporary_connection,
-             bool& is_duplicate_normal_connection) {
-          saved_on_connection_added(connected_peer_id,
-                                    transport,
-                                    temporary_connection,
-                                    is_duplicate_normal_connection);
-          assert(!slot_called);
-          std::lock_guard<std::mutex> local_lock(local_mutex);
-          slot_called = true;
-          peer_id = connected_peer_id;
-          local_cond_var.notify_one();
-        });
-    LocalFunctorReplacement<OnConnectionLost> on_conn_lost_guard(
-        callback_mutex_,
-        on_connection_lost_,
-        saved_on_connection_lost,
-        [&] (const NodeId& connected_peer_id,
-             TransportPtr transport,
-             bool temporary_connection,
-             bool timed_out) {
-          saved_on_connection_lost(connected_peer_id, transport, temporary_connection, timed_out);
-          std::lock_guard<std::mutex> local_lock(local_mutex);
-          if (!slot_called) {
-            slot_called = true;
-            peer_id = connected_peer_id;
-            timed_out_connecting = timed_out;
-            local_cond_var.notify_one();
-          }
-        });
-
-    connection_manager_->Connect(bootstrap_node_id,
-                                 bootstrap_endpoint,
-                                 "",
-                                 Parameters::bootstrap_connect_timeout,
-                                 lifespan);
-
-    lock.lock();
-    if (!local_cond_var.wait_for(lock,
-                                 BoostToChrono<int>(Parameters::bootstrap_connect_timeout +
-                                                    bptime::seconds(1)),
-                                 [&] { return slot_called; })) {  // NOLINT (Fraser)
-      LOG(kError) << "Timed out waiting for connection. External endpoint: "
-                  << multiplexer_->external_endpoint() << "  Local endpoint: "
-                  << multiplexer_->local_endpoint();
-      return NodeId();
+    std::lock_guard<std::mutex> lock(race->mutex);
+    if (race->chosen_id != NodeId() || race->cancelling) {
+      // A slower attempt which connected before it could be cancelled.
+      is_duplicate_normal_connection = true;
+      return;
     }
+    race->chosen_id = peer_id;
   }
-
-  if (timed_out_connecting) {
-    LOG(kInfo) << "Failed to make bootstrap connection to " << bootstrap_endpoint;
-    return NodeId();
+  race->saved_on_connection_added(peer_id, transport, temporary_connection,
+                                  is_duplicate_normal_connection);
+  // Detecting the NAT type overlaps with cancelling the other attempts.
+  StartNatDetection(peer_id, race);
+  std::lock_guard<std::mutex> lock(race->mutex);
+  if (!race->cancelling)
+    CancelBootstrapAttempts(race);
+}
+
+void Transport::HandleBootstrapTimeout(const std::shared_ptr<BootstrapRace>& race,
+                                       const boost::system::error_code& ec) {
+  if (ec == asio::error::operation_aborted)
+    return;
+  std::unique_lock<std::mutex> lock(race->mutex);
+  if (race->chosen_id == NodeId()) {
+    LOG(kError) << "Timed out waiting for connection. External endpoint: "
+                << multiplexer_->external_endpoint() << "  Local endpoint: "
+                << multiplexer_->local_endpoint();
+    if (!race->cancelling)
+      CancelBootstrapAttempts(race);
+    return;
   }
-
-  DetectNatType(peer_id, lock);
-  return peer_id;
+  if (race->nat_detection_result == kPendingResult)
+    race->nat_detection_result = kPingFailed;
+  lock.unlock();
+  FinishBootstrapping(race);
+}
+
+void Transport::CancelBootstrapAttempts(const std::shared_ptr<BootstrapRace>& race) {
+  race->cancelling = true;
+  // Once this has run on strand_, none of the attempts can connect and reach the replaced functor.
+  std::vector<ConnectionPtr> attempts;
+  attempts.swap(race->attempts);
+  TransportPtr transport(shared_from_this());
+  strand_.post([transport, race, attempts] {
+    for (auto attempt : attempts) {
+      if (attempt && attempt->GetAndClearFailureFunctor())
+        attempt->MarkAsDuplicateAndClose(Connection::State::kExactDuplicate);
+    }
+    {
+      std::lock_guard<std::mutex> guard(transport->callback_mutex_);
+      // If the transport has been closed meanwhile, its functors stay cleared.
+      if (transport->on_connection_added_)
+        transport->on_connection_added_ = std::move(race->saved_on_connection_added);
+    }
+    {
+      std::lock_guard<std::mutex> lock(race->mutex);
+      race->cancelled = true;
+    }
+    transport->FinishBootstrapping(race);
+  });
 }
 
-void Transport::DetectNatType(NodeId const& peer_id, std::unique_lock<std::mutex>& lock) {
-  assert(lock.owns_lock());
-
+void Transport::StartNatDetection(const NodeId& peer_id,
+                                  const std::shared_ptr<BootstrapRace>& race) {
   Endpoint nat_detection_endpoint(connection_manager_->RemoteNatDetectionEndpoint(peer_id));
-  if (IsValid(nat_detection_endpoint)) {
-    std::condition_variable local_cond_var;
-    std::mutex& local_mutex = *lock.mutex();
-    int result(kPendingResult);
-    connection_manager_->Ping(peer_id,
-                              nat_detection_endpoint,
-                              [&](int result_in) {
-                                boost::lock_guard<std::mutex> local_lock(local_mutex);
-                                result = result_in;
-                                local_cond_var.notify_one();
-                              });
-
-    bool const success = local_cond_var.wait_for(lock,
-                                                 BoostToChrono<int>(Parameters::ping_timeout +
-                                                                    bptime::seconds(1)),
-                                                 [&] { return result != kPendingResult; });  // NOLINT (Fraser)
-    if (!success || result != kSuccess) {
+  if (!IsValid(nat_detection_endpoint))
+    return;
+  {
+    std::lock_guard<std::mutex> local_lock(race->mutex);
+    race->nat_detection_result = kPendingResult;
+    race->timer.expires_from_now(Parameters::ping_timeout + bptime::seconds(1));
+    race->timer.async_wait(std::bind(&Transport::HandleBootstrapTimeout, shared_from_this(),
+                                     race, args::_1));
+  }
+  TransportPtr transport(shared_from_this());
+  connection_manager_->Ping(peer_id,
+                            nat_detection_endpoint,
+                            [transport, race](int result) {
+                              {
+                                std::lock_guard<std::mutex> local_lock(race->mutex);
+                                if (race->nat_detection_result != kPendingResult)
+                                  return;
+                                race->nat_detection_result = result;
+                              }
+                              transport->FinishBootstrapping(race);
+                            });
+}
+
+void Transport::FinishBootstrapping(const std::shared_ptr<BootstrapRace>& race) {
+  OnBootstrapped on_bootstrapped;
+  NodeId chosen_id;
+  {
+    std::lock_guard<std::mutex> lock(race->mutex);
+    if (!race->cancelled || race->nat_detection_result == kPendingResult ||
+        !race->on_bootstrapped) {
+      return;
+    }
+    on_bootstrapped.swap(race->on_bootstrapped);
+    chosen_id = race->chosen_id;
+    race->timer.cancel();
+    if (chosen_id != NodeId() && race->nat_detection_result != kSuccess) {
       LOG(kWarning) << "Timed out waiting for NAT detection ping - setting NAT type to symmetric";
       nat_type_ = NatType::kSymmetric;
     }
   }
+  if (chosen_id != NodeId()) {
+    LOG(kVerbose) << "Started new transport on " << multiplexer_->local_endpoint()
+                  << " connected to " << DebugId(chosen_id).substr(0, 7);
+  }
+  asio_service_.service().post([on_bootstrapped, chosen_id] {
+    on_bootstrapped(chosen_id != NodeId(), chosen_id);
+  });
 }
 
 void Transport::Close() {
@@ -304,36 +356,168 @@ void Transport::DoConnect(const NodeId& peer_id,
   if (!multiplexer_->IsOpen())
     return;
 
-  if (IsValid(peer_endpoint_pair.external)) {
-    std::function<void()> failure_functor;
-    if (peer_endpoint_pair.local != peer_endpoint_pair.external) {
-      failure_functor = [=] {
-                          if (!multiplexer_->IsOpen())
-                            return;
-                          connection_manager_->Connect(peer_id,
-                                                       peer_endpoint_pair.local,
-                                                       validation_data,
-                                                       Parameters::rendezvous_connect_timeout,
-                                                       bptime::pos_infin);
-                        };
+  // A peer's local endpoint is only likely to be reachable (and is then the most direct route) if
+  // it is behind the same NAT as this node.  Both nodes see the same external addresses, so they
+  // rank the pair of endpoints alike.
+  std::vector<Endpoint> candidates;
+  if (IsValid(peer_endpoint_pair.external))
+    candidates.push_back(peer_endpoint_pair.external);
+  if (IsValid(peer_endpoint_pair.local) &&
+      peer_endpoint_pair.local != peer_endpoint_pair.external) {
+    if (!candidates.empty() && IsValid(external_endpoint()) &&
+        external_endpoint().address() == peer_endpoint_pair.external.address()) {
+      candidates.insert(candidates.begin(), peer_endpoint_pair.local);
+    } else {
+      candidates.push_back(peer_endpoint_pair.local);
     }
-    connection_manager_->Connect(peer_id, peer_endpoint_pair.external, validation_data,
-                                 Parameters::rendezvous_connect_timeout, bptime::pos_infin,
-                                 failure_functor);
-  } else {
-    connection_manager_->Connect(peer_id, peer_endpoint_pair.local, validation_data,
-                                 Parameters::rendezvous_connect_timeout, bptime::pos_infin);
+  }
+
+  if (candidates.size() < 2U) {
+    connection_manager_->Connect(peer_id,
+                                 candidates.empty() ? peer_endpoint_pair.local : candidates[0],
+                                 validation_data, Parameters::rendezvous_connect_timeout,
+                                 bptime::pos_infin);
+    return;
+  }
+
+  std::shared_ptr<ConnectRace> race(std::make_shared<ConnectRace>(peer_id,
+                                                                  strand_.get_io_service()));
+  std::weak_ptr<ConnectRace> weak_race(race);
+  for (size_t i(0); i != candidates.size(); ++i) {
+    race->attempts.push_back(connection_manager_->Connect(
+        peer_id, candidates[i], validation_data, Parameters::rendezvous_connect_timeout,
+        bptime::pos_infin, [=] { HandleConnectRaceFailure(weak_race, i); }));
+  }
+  race->deferred = race->attempts.size();
+  connect_races_[peer_id] = race;
+}
+
+bool Transport::DeferConnect(const ConnectionPtr& connection,
+                             const std::function<void()>& complete_connect) {
+  auto race_itr(connect_races_.find(connection->Socket().PeerNodeId()));
+  if (race_itr == connect_races_.end())
+    return false;
+  std::shared_ptr<ConnectRace> race(race_itr->second);
+  auto attempt(std::find(race->attempts.begin(), race->attempts.end(), connection));
+  if (attempt == race->attempts.end())
+    return false;
+  size_t index(attempt - race->attempts.begin());
+
+  if (std::none_of(race->attempts.begin(), attempt,
+                   InProgress)) {
+    FinishConnectRace(race, index);
+    return false;
+  }
+
+  if (race->deferred < index) {
+    // A more preferred attempt is already waiting, so this one has lost.
+    race->attempts[index].reset();
+    connection->GetAndClearFailureFunctor();
+    connection->MarkAsDuplicateAndClose(Connection::State::kExactDuplicate);
+    return true;
+  }
+  if (race->deferred != race->attempts.size()) {
+    ConnectionPtr overtaken(race->attempts[race->deferred]);
+    race->attempts[race->deferred].reset();
+    overtaken->GetAndClearFailureFunctor();
+    overtaken->MarkAsDuplicateAndClose(Connection::State::kExactDuplicate);
+  }
+
+  LOG(kVerbose) << ThisDebugId() << " connected to " << connection->PeerDebugId() << " on "
+                << connection->Socket().PeerEndpoint() << " - waiting for preferred endpoint.";
+  race->deferred = index;
+  race->deferred_connect = complete_connect;
+  race->delay_timer.expires_from_now(Parameters::connect_race_delay);
+  race->delay_timer.async_wait(strand_.wrap(std::bind(&Transport::HandleConnectRaceDelay,
+                                                      shared_from_this(),
+                                                      std::weak_ptr<ConnectRace>(race),
+                                                      args::_1)));
+  return true;
+}
+
+void Transport::HandleConnectRaceFailure(const std::weak_ptr<ConnectRace>& weak_race,
+                                         size_t index) {
+  std::shared_ptr<ConnectRace> race(weak_race.lock());
+  if (!race || index >= race->attempts.size())
+    return;
+  race->attempts[index].reset();
+  if (race->deferred == index) {
+    race->deferred = race->attempts.size();
+    race->deferred_connect = nullptr;
+    race->delay_timer.cancel();
+  }
+
+  if (race->deferred != race->attempts.size()) {
+    // The waiting attempt wins as soon as all those preferred to it have failed.
+    if (std::none_of(race->attempts.begin(), race->attempts.begin() + race->deferred,
+                     InProgress)) {
+      FinishConnectRace(race, race->deferred);
+    }
+    return;
+  }
+
+  // Once a single attempt remains, it carries on alone so that its failure is reported as that of
+  // any other connection.
+  if (std::count_if(race->attempts.begin(), race->attempts.end(), InProgress) <= 1) {
+    auto last(std::find_if(race->attempts.begin(), race->attempts.end(), InProgress));
+    if (last != race->attempts.end())
+      (*last)->GetAndClearFailureFunctor();
+    race->attempts.clear();
+    race->deferred = 0;
+    auto race_itr(connect_races_.find(race->peer_id));
+    if (race_itr != connect_races_.end() && race_itr->second == race)
+      connect_races_.erase(race_itr);
   }
 }
 
+void Transport::HandleConnectRaceDelay(const std::weak_ptr<ConnectRace>& weak_race,
+                                       const boost::system::error_code& ec) {
+  if (ec == asio::error::operation_aborted)
+    return;
+  std::shared_ptr<ConnectRace> race(weak_race.lock());
+  if (race && race->deferred != race->attempts.size())
+    FinishConnectRace(race, race->deferred);
+}
+
+void Transport::FinishConnectRace(const std::shared_ptr<ConnectRace>& race, size_t winner) {
+  auto race_itr(connect_races_.find(race->peer_id));
+  if (race_itr != connect_races_.end() && race_itr->second == race)
+    connect_races_.erase(race_itr);
+  race->delay_timer.cancel();
+
+  std::function<void()> complete_connect;
+  if (race->deferred == winner)
+    complete_connect.swap(race->deferred_connect);
+  for (size_t i(0); i != race->attempts.size(); ++i) {
+    if (i == winner || !race->attempts[i])
+      continue;
+    // The losers are closed quietly, without signalling the loss of a connection to the peer.
+    race->attempts[i]->GetAndClearFailureFunctor();
+    race->attempts[i]->MarkAsDuplicateAndClose(Connection::State::kExactDuplicate);
+  }
+  LOG(kVerbose) << ThisDebugId() << " won connect race to " << DebugId(race->peer_id).substr(0, 7)
+                << " on " << race->attempts[winner]->Socket().PeerEndpoint();
+  race->attempts.clear();
+  race->deferred = 0;
+  if (complete_connect)
+    complete_connect();
+}
+
 bool Transport::CloseConnection(const NodeId& peer_id) {
   return connection_manager_->CloseConnection(peer_id);
 }
 
 bool Transport::Send(const NodeId& peer_id,
                      const std::string& message,
-                     const MessageSentFunctor& message_sent_functor) {
-  return connection_manager_->Send(peer_id, message, message_sent_functor);
+                     const MessageSentFunctor& message_sent_functor,
+                     const SendOptions& options) {
+  return connection_manager_->Send(peer_id, message, message_sent_functor, options);
+}
+
+bool Transport::SendDatagram(const NodeId& peer_id,
+                             const std::string& message,
+                             const MessageSentFunctor& message_sent_functor) {
+  return connection_manager_->SendDatagram(peer_id, message, message_sent_functor);
 }
 
 void Transport::Ping(const NodeId& peer_id,
@@ -354,6 +538,10 @@ Endpoint Transport::local_endpoint() const {
   return multiplexer_->local_endpoint();
 }
 
+bool Transport::GetConnectionStats(const NodeId& peer_id, ConnectionStats& stats) {
+  return connection_manager_->GetStats(peer_id, stats);
+}
+
 Endpoint Transport::ThisEndpointAsSeenByPeer(const NodeId& peer_id) {
   return connection_manager_->ThisEndpoint(peer_id);
 }
@@ -423,8 +611,13 @@ void Transport::AddConnection(ConnectionPtr connection) {
 }
 
 void Transport::DoAddConnection(ConnectionPtr connection) {
-  // Discard failure_functor
-  connection->GetAndClearFailureFunctor();
+  // Discard failure_functor.  Only this node's bootstrap attempts are made without validation data
+  // and with a failure_functor, and only those say how well the peer serves as a bootstrap contact.
+  if (connection->GetAndClearFailureFunctor() &&
+      (connection->state() == Connection::State::kBootstrapping ||
+       connection->state() == Connection::State::kTemporary)) {
+    RecordBootstrapSuccess(connection);
+  }
 
   // For temporary connections, we only need to invoke on_connection_lost_ then finish.
   if (connection->state() != Connection::State::kTemporary) {
@@ -443,7 +636,6 @@ void Transport::DoAddConnection(ConnectionPtr connection) {
 
   LOG(kSuccess) << "Successfully made " << connection->state() << " connection from "
                 << ThisDebugId() << " to " << connection->PeerDebugId();
-
   bool is_duplicate_normal_connection(false);
   OnConnectionAdded local_callback;
   {
@@ -473,6 +665,14 @@ void Transport::DoAddConnection(ConnectionPtr connection) {
 #endif
 }
 
+void Transport::RecordBootstrapSuccess(ConnectionPtr connection) {
+  if (!bootstrap_cache_)
+    return;
+  ConnectionStats stats;
+  connection->Socket().GetStats(stats);
+  bootstrap_cache_->RecordSuccess(connection->Socket().PeerEndpoint(), stats.round_trip_time);
+}
+
 void Transport::RemoveConnection(ConnectionPtr connection, bool timed_out) {
   strand_.dispatch(std::bind(&Transport::DoRemoveConnection,
                              shared_from_this(),
@@ -493,7 +693,22 @@ void Transport::DoRemoveConnection(ConnectionPtr connection, bool timed_out) {
   // If the connection has a failure_functor, invoke that, otherwise invoke on_connection_lost_.
   auto failure_functor(connection->GetAndClearFailureFunctor());
   if (failure_functor) {
-    return failure_functor();
+    // A temporary connection is dropped by the peer as soon as it has answered the handshake, so
+    // may be closed before it could be added.  If the peer's answer arrived, it still connected.
+    if (connection->state() != Connection::State::kTemporary || timed_out ||
+        connection->Socket().PeerNodeId() == NodeId()) {
+      return failure_functor();
+    }
+    RecordBootstrapSuccess(connection);
+    DoAddConnection(connection);
+  }
+
+  if (bootstrap_cache_) {
+    // The round trip time is only non-zero if the connection was made.
+    ConnectionStats stats;
+    connection->Socket().GetStats(stats);
+    bootstrap_cache_->RecordRoundTripTime(connection->Socket().PeerEndpoint(),
+                                          stats.round_trip_time);
   }
 
   if (connection->state() != Connection::State::kDuplicate) {
@@ -535,6 +750,10 @@ void Transport::SetManagedConnectionsDebugPrintout(std::function<std::string()>
   managed_connections_debug_printout_ = functor;
 }
 
+void Transport::SetBootstrapCache(std::shared_ptr<BootstrapCache> bootstrap_cache) {
+  bootstrap_cache_ = bootstrap_cache;
+}
+
 
 }  // namespace detail
 
@@ -20,12 +20,14 @@ License.
 
 #include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 #include <mutex>
 
+#include "boost/asio/deadline_timer.hpp"
 #include "boost/asio/strand.hpp"
 #include "boost/asio/ip/udp.hpp"
 #include "boost/date_time/posix_time/posix_time_duration.hpp"
@@ -37,6 +39,7 @@ License.
 #include "maidsafe/rudp/managed_connections.h"
 #include "maidsafe/rudp/nat_type.h"
 #include "maidsafe/rudp/parameters.h"
+#include "maidsafe/rudp/return_codes.h"
 #include "maidsafe/rudp/core/session.h"
 
 
@@ -46,6 +49,7 @@ namespace rudp {
 
 namespace detail {
 
+class BootstrapCache;
 class ConnectionManager;
 class Connection;
 class Multiplexer;
@@ -69,10 +73,16 @@ class Transport : public std::enable_shared_from_this<Transport> {
   typedef std::function<void(const NodeId&, std::shared_ptr<Transport>, bool, bool)>
           OnConnectionLost;
 
+  // Invoked with whether the transport started, and the ID of the peer it bootstrapped off (if
+  // any).
+  typedef std::function<void(bool, const NodeId&)> OnBootstrapped;
+
   Transport(AsioService& asio_service, NatType& nat_type_);
 
   virtual ~Transport();
 
+  // Blocks until the transport has started or failed to.  Mustn't be called from a thread running
+  // the asio service.
   bool Bootstrap(
       const std::vector<std::pair<NodeId, boost::asio::ip::udp::endpoint>> &bootstrap_peers,
       const NodeId& this_node_id,
@@ -85,6 +95,20 @@ class Transport : public std::enable_shared_from_this<Transport> {
       const Session::OnNatDetectionRequested::slot_function_type& on_nat_detection_requested_slot,
       NodeId& chosen_id);
 
+  // As above, but returns immediately.  on_bootstrapped is posted to the asio service once the
+  // transport has started or failed to.
+  void Bootstrap(
+      const std::vector<std::pair<NodeId, boost::asio::ip::udp::endpoint>> &bootstrap_peers,
+      const NodeId& this_node_id,
+      std::shared_ptr<asymm::PublicKey> this_public_key,
+      boost::asio::ip::udp::endpoint local_endpoint,
+      bool bootstrap_off_existing_connection,
+      OnMessage on_message_slot,
+      OnConnectionAdded on_connection_added_slot,
+      OnConnectionLost on_connection_lost_slot,
+      const Session::OnNatDetectionRequested::slot_function_type& on_nat_detection_requested_slot,
+      OnBootstrapped on_bootstrapped);
+
   void Close();
 
   void Connect(const NodeId& peer_id,
@@ -97,7 +121,12 @@ class Transport : public std::enable_shared_from_this<Transport> {
 
   bool Send(const NodeId& peer_id,
             const std::string& message,
-            const std::function<void(int)> &message_sent_functor);  // NOLINT (Fraser)
+            const std::function<void(int)> &message_sent_functor,  // NOLINT (Fraser)
+            const SendOptions& options);
+
+  bool SendDatagram(const NodeId& peer_id,
+                    const std::string& message,
+                    const std::function<void(int)> &message_sent_functor);  // NOLINT (Fraser)
 
   void Ping(const NodeId& peer_id,
             const boost::asio::ip::udp::endpoint& peer_endpoint,
@@ -105,6 +134,9 @@ class Transport : public std::enable_shared_from_this<Transport> {
 
   std::shared_ptr<Connection> GetConnection(const NodeId& peer_id);
 
+  // Returns false if the connection doesn't exist.
+  bool GetConnectionStats(const NodeId& peer_id, ConnectionStats& stats);
+
   boost::asio::ip::udp::endpoint external_endpoint() const;
   boost::asio::ip::udp::endpoint local_endpoint() const;
   boost::asio::ip::udp::endpoint ThisEndpointAsSeenByPeer(const NodeId& peer_id);
@@ -123,6 +155,9 @@ class Transport : public std::enable_shared_from_this<Transport> {
   std::string DebugString() const;
   std::string ThisDebugId() const;
   void SetManagedConnectionsDebugPrintout(std::function<std::string()> functor);
+  // If set, connections made by this transport and failed attempts to bootstrap are recorded in
+  // "bootstrap_cache".  Must be called before Bootstrap.
+  void SetBootstrapCache(std::shared_ptr<BootstrapCache> bootstrap_cache);
 
   friend class Connection;
 
@@ -133,18 +168,102 @@ class Transport : public std::enable_shared_from_this<Transport> {
   typedef std::shared_ptr<Multiplexer> MultiplexerPtr;
   typedef std::shared_ptr<Connection> ConnectionPtr;
 
-  bool TryBootstrapping(
+  // Attempts to connect to several bootstrap peers at once.  Shared with the attempts' functors and
+  // the handlers which drive it.
+  struct BootstrapRace {
+    BootstrapRace(
+        const std::vector<std::pair<NodeId, boost::asio::ip::udp::endpoint>>& peers_in,
+        const boost::posix_time::time_duration& lifespan_in,
+        OnBootstrapped on_bootstrapped_in,
+        boost::asio::io_service& io_service)
+        : mutex(),
+          peers(peers_in),
+          next_peer(0),
+          lifespan(lifespan_in),
+          in_flight(0),
+          chosen_id(),
+          cancelling(false),
+          cancelled(false),
+          nat_detection_result(kSuccess),
+          attempts(),
+          saved_on_connection_added(),
+          timer(io_service),
+          on_bootstrapped(on_bootstrapped_in) {}
+    std::mutex mutex;
+    std::vector<std::pair<NodeId, boost::asio::ip::udp::endpoint>> peers;
+    size_t next_peer;
+    boost::posix_time::time_duration lifespan;
+    uint32_t in_flight;
+    NodeId chosen_id;
+    // Set when cancelling the outstanding attempts starts and once it has finished.
+    bool cancelling, cancelled;
+    // kPendingResult while the NAT detection ping is outstanding.
+    int nat_detection_result;
+    std::vector<ConnectionPtr> attempts;
+    // on_connection_added_, which is replaced while the race runs.
+    OnConnectionAdded saved_on_connection_added;
+    // Expires if no attempt completes in time, or if the NAT detection ping isn't answered.
+    boost::asio::deadline_timer timer;
+    // Cleared once invoked.
+    OnBootstrapped on_bootstrapped;
+  };
+
+  // Simultaneous attempts to connect to each of a peer's endpoints.  The first to succeed is used
+  // and the rest are cancelled, except that one which succeeds while an attempt to a more preferred
+  // endpoint is still in progress waits up to Parameters::connect_race_delay for that.  The peer
+  // makes the same choice, since its attempts are ranked by the same rule.
+  struct ConnectRace {
+    ConnectRace(const NodeId& peer_id_in, boost::asio::io_service& io_service)
+        : peer_id(peer_id_in),
+          attempts(),
+          deferred(0),
+          deferred_connect(),
+          delay_timer(io_service) {}
+    NodeId peer_id;
+    // In order of preference.  Null once the attempt has failed.
+    std::vector<ConnectionPtr> attempts;
+    // Index of the attempt which has succeeded and is waiting, or attempts.size() if none is.
+    size_t deferred;
+    std::function<void()> deferred_connect;
+    boost::asio::deadline_timer delay_timer;
+  };
+
+  void TryBootstrapping(
       const std::vector<std::pair<NodeId, boost::asio::ip::udp::endpoint> > &bootstrap_peers,
       bool bootstrap_off_existing_connection,
-      NodeId& chosen_id);
-  NodeId ConnectToBootstrapEndpoint(const NodeId& bootstrap_node_id,
-                                    const boost::asio::ip::udp::endpoint& bootstrap_endpoint,
-                                    const boost::posix_time::time_duration& lifespan);
-  void DetectNatType(NodeId const& peer_id, std::unique_lock<std::mutex>& lock);
+      OnBootstrapped on_bootstrapped);
+  // Starts attempts until Parameters::bootstrap_connect_concurrency are in flight.  race->mutex
+  // must be locked by the caller.
+  void LaunchBootstrapAttempts(const std::shared_ptr<BootstrapRace>& race);
+  void HandleBootstrapAttemptFailure(const std::shared_ptr<BootstrapRace>& race,
+                                     const boost::asio::ip::udp::endpoint& peer_endpoint);
+  void HandleBootstrapConnectionAdded(const std::shared_ptr<BootstrapRace>& race,
+                                      const NodeId& peer_id,
+                                      std::shared_ptr<Transport> transport,
+                                      bool temporary_connection,
+                                      bool& is_duplicate_normal_connection);
+  void HandleBootstrapTimeout(const std::shared_ptr<BootstrapRace>& race,
+                              const boost::system::error_code& ec);
+  // Cancels the attempts still pending without them being reported as lost connections, then
+  // restores on_connection_added_.  race->mutex must be locked by the caller.
+  void CancelBootstrapAttempts(const std::shared_ptr<BootstrapRace>& race);
+  // Pings the NAT detection endpoint offered by the newly-connected bootstrap peer, recording the
+  // result in "race".
+  void StartNatDetection(const NodeId& peer_id, const std::shared_ptr<BootstrapRace>& race);
+  // Invokes race->on_bootstrapped if the attempts have been cancelled and the NAT type is known.
+  void FinishBootstrapping(const std::shared_ptr<BootstrapRace>& race);
 
   void DoConnect(const NodeId& peer_id,
                  const EndpointPair& peer_endpoint_pair,
                  const std::string& validation_data);
+  // Returns true if the connection is one of a race which isn't to be used yet, in which case
+  // "complete_connect" is invoked if and when it wins.  If it's the winner, the others are
+  // cancelled.
+  bool DeferConnect(const ConnectionPtr& connection, const std::function<void()>& complete_connect);
+  void HandleConnectRaceFailure(const std::weak_ptr<ConnectRace>& weak_race, size_t index);
+  void HandleConnectRaceDelay(const std::weak_ptr<ConnectRace>& weak_race,
+                              const boost::system::error_code& ec);
+  void FinishConnectRace(const std::shared_ptr<ConnectRace>& race, size_t winner);
 
   void StartDispatch();
   void HandleDispatch(const boost::system::error_code& ec);
@@ -156,6 +275,8 @@ class Transport : public std::enable_shared_from_this<Transport> {
   void DoSignalMessageReceived(const std::string& message);
   void AddConnection(ConnectionPtr connection);
   void DoAddConnection(ConnectionPtr connection);
+  // Records in bootstrap_cache_ that an attempt by this node to bootstrap off the peer succeeded.
+  void RecordBootstrapSuccess(ConnectionPtr connection);
   void RemoveConnection(ConnectionPtr connection, bool timed_out);
   void DoRemoveConnection(ConnectionPtr connection, bool timed_out);
 
@@ -164,6 +285,8 @@ class Transport : public std::enable_shared_from_this<Transport> {
   boost::asio::io_service::strand strand_;
   MultiplexerPtr multiplexer_;
   std::unique_ptr<ConnectionManager> connection_manager_;
+  // Only accessed on strand_.
+  std::map<NodeId, std::shared_ptr<ConnectRace>> connect_races_;
   std::mutex callback_mutex_;
 
   OnMessage on_message_;
@@ -171,6 +294,7 @@ class Transport : public std::enable_shared_from_this<Transport> {
   OnConnectionLost on_connection_lost_;
   Session::OnNatDetectionRequested::slot_function_type on_nat_detection_requested_slot_;
   std::function<std::string()> managed_connections_debug_printout_;
+  std::shared_ptr<BootstrapCache> bootstrap_cache_;
 };
 
 typedef std::shared_ptr<Transport> TransportPtr;